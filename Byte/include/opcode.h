@@ -15,6 +15,13 @@ enum class OpCode : uint8_t {
   JmpFalse = 0x06,
   JmpTable = 0x07,
 
+  // Superinstructions. The VM fuses these into its decoded code only; they are
+  // not part of the SBC format and the loader/verifier reject them.
+  AddLocalsI32 = 0x08,
+  IncLocalI32 = 0x09,
+  JmpFalseCmpLocalConstI32 = 0x0A,
+  LoadLocal2 = 0x0B,
+
   Pop = 0x10,
   Dup = 0x11,
   Dup2 = 0x12,
@@ -149,6 +156,7 @@ enum class OpCode : uint8_t {
   ProfileStart = 0x81,
   ProfileEnd = 0x82,
 
+  PrintFmt = 0x8F,
   Intrinsic = 0x90,
   SysCall = 0x91,
 
@@ -247,6 +255,9 @@ enum class OpCode : uint8_t {
   XorI32 = 0xF9,
   ShlI32 = 0xFA,
   ShrI32 = 0xFB,
+  NewArrayU8 = 0xFC,
+  ArrayGetU8 = 0xFD,
+  ArraySetU8 = 0xFE,
 };
 
 struct OpInfo {
@@ -258,6 +269,7 @@ struct OpInfo {
 // OpInfo operand widths are ABI-frozen; loader/verifier rely on this table.
 bool GetOpInfo(uint8_t opcode, OpInfo* info);
 const char* OpCodeName(uint8_t opcode);
+bool IsSuperinstruction(uint8_t opcode);
 
 } // namespace Simple::Byte
 
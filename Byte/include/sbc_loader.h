@@ -11,6 +11,8 @@ namespace Simple::Byte {
 
 SIMPLEVM_API LoadResult LoadModuleFromFile(const std::string& path);
 SIMPLEVM_API LoadResult LoadModuleFromBytes(const std::vector<uint8_t>& bytes);
+// Builds SbcModule::function_by_method for a module assembled outside the loader.
+SIMPLEVM_API std::vector<uint32_t> BuildFunctionByMethod(const SbcModule& module);
 
 } // namespace Simple::Byte
 
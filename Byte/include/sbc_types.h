@@ -2,6 +2,7 @@
 #define SIMPLE_SBC_TYPES_H
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -151,6 +152,22 @@ struct ExportRow {
   uint32_t reserved = 0;
 };
 
+constexpr uint32_t kNoFunctionIndex = 0xFFFFFFFFu;
+
+struct VerifyResult;
+
+// Holds the result VerifyModuleCached computed for a module. Copies start
+// empty so an edited copy of a module is always verified again.
+struct VerifyCache {
+  VerifyCache() = default;
+  VerifyCache(const VerifyCache&) {}
+  VerifyCache& operator=(const VerifyCache&) {
+    result.reset();
+    return *this;
+  }
+  std::shared_ptr<const VerifyResult> result;
+};
+
 struct SbcModule {
   SbcHeader header;
   std::vector<SectionEntry> sections;
@@ -163,6 +180,9 @@ struct SbcModule {
   std::vector<ImportRow> imports;
   std::vector<ExportRow> exports;
   std::vector<uint8_t> function_is_import;
+  // method_id -> index of the first function using that method, or
+  // kNoFunctionIndex; built once at load time.
+  std::vector<uint32_t> function_by_method;
   std::vector<uint32_t> param_types;
   std::vector<uint8_t> code;
   std::vector<uint8_t> const_pool;
@@ -171,6 +191,9 @@ struct SbcModule {
   std::vector<DebugFileRow> debug_files;
   std::vector<DebugLineRow> debug_lines;
   std::vector<DebugSymRow> debug_syms;
+  // Filled on first use by VerifyModuleCached; code that edits a module in
+  // place after verifying it must reset this.
+  mutable VerifyCache verify_cache;
 };
 
 struct LoadResult {
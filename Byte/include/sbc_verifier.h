@@ -28,6 +28,8 @@ struct StackMap {
 struct MethodVerifyInfo {
   std::vector<VmType> locals;
   std::vector<uint8_t> locals_ref_bits;
+  // Sorted by pc. One per safepoint: LINE/PROFILE markers, calls, opcodes
+  // that allocate, and backward jumps.
   std::vector<StackMap> stack_maps;
 };
 
@@ -39,6 +41,11 @@ struct VerifyResult {
 };
 
 SIMPLEVM_API VerifyResult VerifyModule(const SbcModule& module);
+// Verifies the module once and keeps the result in module.verify_cache; later
+// calls (from any thread) return the same result without re-running analysis.
+SIMPLEVM_API const VerifyResult& VerifyModuleCached(const SbcModule& module);
+// Binary search of info.stack_maps; null when pc is not a safepoint.
+SIMPLEVM_API const StackMap* FindStackMap(const MethodVerifyInfo& info, uint32_t pc);
 
 } // namespace Simple::Byte
 
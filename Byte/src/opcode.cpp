@@ -212,6 +212,9 @@ bool GetOpInfo(uint8_t opcode, OpInfo* info) {
     case OpCode::SysCall:
       *info = {4, 0, 0};
       return true;
+    case OpCode::PrintFmt:
+      *info = {5, 0, 0};
+      return true;
     case OpCode::NewObject:
       *info = {4, 0, 1};
       return true;
@@ -239,6 +242,7 @@ bool GetOpInfo(uint8_t opcode, OpInfo* info) {
     case OpCode::NewArrayF32:
     case OpCode::NewArrayF64:
     case OpCode::NewArrayRef:
+    case OpCode::NewArrayU8:
       *info = {8, 0, 1};
       return true;
     case OpCode::ArrayLen:
@@ -249,6 +253,7 @@ bool GetOpInfo(uint8_t opcode, OpInfo* info) {
     case OpCode::ArrayGetF32:
     case OpCode::ArrayGetF64:
     case OpCode::ArrayGetRef:
+    case OpCode::ArrayGetU8:
       *info = {0, 2, 1};
       return true;
     case OpCode::ArraySetI32:
@@ -256,6 +261,7 @@ bool GetOpInfo(uint8_t opcode, OpInfo* info) {
     case OpCode::ArraySetF32:
     case OpCode::ArraySetF64:
     case OpCode::ArraySetRef:
+    case OpCode::ArraySetU8:
       *info = {0, 3, 0};
       return true;
     case OpCode::NewList:
@@ -340,10 +346,27 @@ bool GetOpInfo(uint8_t opcode, OpInfo* info) {
     case OpCode::CallCheck:
       *info = {0, 0, 0};
       return true;
+    case OpCode::AddLocalsI32:
+    case OpCode::IncLocalI32:
+    case OpCode::JmpFalseCmpLocalConstI32:
+    case OpCode::LoadLocal2:
+      return false;
   }
   return false;
 }
 
+bool IsSuperinstruction(uint8_t opcode) {
+  switch (static_cast<OpCode>(opcode)) {
+    case OpCode::AddLocalsI32:
+    case OpCode::IncLocalI32:
+    case OpCode::JmpFalseCmpLocalConstI32:
+    case OpCode::LoadLocal2:
+      return true;
+    default:
+      return false;
+  }
+}
+
 const char* OpCodeName(uint8_t opcode) {
   switch (static_cast<OpCode>(opcode)) {
     case OpCode::Nop: return "Nop";
@@ -354,6 +377,10 @@ const char* OpCodeName(uint8_t opcode) {
     case OpCode::JmpTrue: return "JmpTrue";
     case OpCode::JmpFalse: return "JmpFalse";
     case OpCode::JmpTable: return "JmpTable";
+    case OpCode::AddLocalsI32: return "AddLocalsI32";
+    case OpCode::IncLocalI32: return "IncLocalI32";
+    case OpCode::JmpFalseCmpLocalConstI32: return "JmpFalseCmpLocalConstI32";
+    case OpCode::LoadLocal2: return "LoadLocal2";
     case OpCode::Pop: return "Pop";
     case OpCode::Dup: return "Dup";
     case OpCode::Dup2: return "Dup2";
@@ -480,6 +507,7 @@ const char* OpCodeName(uint8_t opcode) {
     case OpCode::Line: return "Line";
     case OpCode::ProfileStart: return "ProfileStart";
     case OpCode::ProfileEnd: return "ProfileEnd";
+    case OpCode::PrintFmt: return "PrintFmt";
     case OpCode::Intrinsic: return "Intrinsic";
     case OpCode::SysCall: return "SysCall";
     case OpCode::NewObject: return "NewObject";
@@ -573,6 +601,9 @@ const char* OpCodeName(uint8_t opcode) {
     case OpCode::XorI32: return "XorI32";
     case OpCode::ShlI32: return "ShlI32";
     case OpCode::ShrI32: return "ShrI32";
+    case OpCode::NewArrayU8: return "NewArrayU8";
+    case OpCode::ArrayGetU8: return "ArrayGetU8";
+    case OpCode::ArraySetU8: return "ArraySetU8";
     default:
       return "Unknown";
   }
@@ -72,6 +72,17 @@ LoadResult Fail(const std::string& message) {
 
 } // namespace
 
+std::vector<uint32_t> BuildFunctionByMethod(const SbcModule& module) {
+  std::vector<uint32_t> table(module.methods.size(), kNoFunctionIndex);
+  for (size_t i = 0; i < module.functions.size(); ++i) {
+    uint32_t method_id = module.functions[i].method_id;
+    if (method_id < table.size() && table[method_id] == kNoFunctionIndex) {
+      table[method_id] = static_cast<uint32_t>(i);
+    }
+  }
+  return table;
+}
+
 LoadResult LoadModuleFromFile(const std::string& path) {
   std::ifstream in(path, std::ios::binary);
   if (!in) return Fail("failed to open file");
@@ -645,7 +656,7 @@ LoadResult LoadModuleFromBytes(const std::vector<uint8_t>& bytes) {
         uint8_t opcode = module.code[pc];
         OpInfo info{};
         if (!GetOpInfo(opcode, &info)) {
-          std::string out = "unknown opcode ";
+          std::string out = IsSuperinstruction(opcode) ? "superinstruction opcode " : "unknown opcode ";
           out += format_opcode(opcode);
           out += " in ";
           out += function_label(func_index);
@@ -783,6 +794,7 @@ LoadResult LoadModuleFromBytes(const std::vector<uint8_t>& bytes) {
     const auto& row = module.globals[i];
     if (row.type_id >= module.types.size()) return Fail("global type id out of range");
   }
+  module.function_by_method = BuildFunctionByMethod(module);
 
   LoadResult result;
   result.ok = true;
@@ -1,6 +1,8 @@
 #include "sbc_verifier.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -149,6 +151,59 @@ bool ReadU32(const std::vector<uint8_t>& code, size_t offset, uint32_t* out) {
   return true;
 }
 
+// Pcs that get a stack map, so a pending collection waits at most until the
+// next call, allocation or loop iteration: debug/profile markers, calls, every
+// opcode that can allocate, and backward jumps.
+bool IsSafepoint(const std::vector<uint8_t>& code, size_t pc, size_t next, uint8_t opcode) {
+  switch (static_cast<OpCode>(opcode)) {
+    case OpCode::Line:
+    case OpCode::ProfileStart:
+    case OpCode::ProfileEnd:
+    case OpCode::Call:
+    case OpCode::CallIndirect:
+    case OpCode::TailCall:
+    case OpCode::Intrinsic:
+    case OpCode::SysCall:
+    case OpCode::ConstString:
+    case OpCode::StringConcat:
+    case OpCode::StringSlice:
+    case OpCode::NewObject:
+    case OpCode::NewClosure:
+    case OpCode::NewArray:
+    case OpCode::NewArrayI64:
+    case OpCode::NewArrayF32:
+    case OpCode::NewArrayF64:
+    case OpCode::NewArrayRef:
+    case OpCode::NewArrayU8:
+    case OpCode::NewList:
+    case OpCode::NewListI64:
+    case OpCode::NewListF32:
+    case OpCode::NewListF64:
+    case OpCode::NewListRef:
+    case OpCode::ListPushI32:
+    case OpCode::ListPushI64:
+    case OpCode::ListPushF32:
+    case OpCode::ListPushF64:
+    case OpCode::ListPushRef:
+    case OpCode::ListInsertI32:
+    case OpCode::ListInsertI64:
+    case OpCode::ListInsertF32:
+    case OpCode::ListInsertF64:
+    case OpCode::ListInsertRef:
+    case OpCode::JmpTable:
+      return true;
+    case OpCode::Jmp:
+    case OpCode::JmpTrue:
+    case OpCode::JmpFalse: {
+      uint32_t raw = 0;
+      if (!ReadU32(code, pc + 1, &raw)) return false;
+      return static_cast<int64_t>(next) + static_cast<int32_t>(raw) <= static_cast<int64_t>(pc);
+    }
+    default:
+      return false;
+  }
+}
+
 VerifyResult Fail(const std::string& message) {
   VerifyResult result;
   result.ok = false;
@@ -354,6 +409,9 @@ VerifyResult VerifyModule(const SbcModule& module) {
       boundaries.insert(pc);
       uint8_t opcode = code[pc];
       OpInfo info{};
+      if (IsSuperinstruction(opcode)) {
+        return scan_fail("superinstruction opcode not allowed in SBC", pc - func.code_offset, opcode);
+      }
       if (!GetOpInfo(opcode, &info)) {
         return scan_fail("unknown opcode in verifier", pc - func.code_offset, opcode);
       }
@@ -370,6 +428,9 @@ VerifyResult VerifyModule(const SbcModule& module) {
     pc = func.code_offset;
     int stack_height = 0;
     std::unordered_map<size_t, std::vector<ValType>> merge_types;
+    // Height on entry to each visited instruction; backward jumps must match it
+    // so a verified loop can never grow or drain the operand stack.
+    std::unordered_map<size_t, size_t> entry_heights;
     std::vector<ValType> stack_types;
     std::vector<ValType> locals(local_count, ValType::Unknown);
     std::vector<bool> locals_init(local_count, false);
@@ -410,8 +471,12 @@ VerifyResult VerifyModule(const SbcModule& module) {
     };
     size_t current_pc = 0;
     uint8_t current_opcode = 0;
+    bool type_underflow = false;
     auto pop_type = [&]() -> ValType {
-      if (stack_types.empty()) return ValType::Unknown;
+      if (stack_types.empty()) {
+        type_underflow = true;
+        return ValType::Unknown;
+      }
       ValType t = stack_types.back();
       stack_types.pop_back();
       return t;
@@ -452,12 +517,12 @@ VerifyResult VerifyModule(const SbcModule& module) {
       uint8_t opcode = code[pc];
       current_pc = pc;
       current_opcode = opcode;
+      entry_heights[pc] = stack_types.size();
+      type_underflow = false;
       OpInfo info{};
       GetOpInfo(opcode, &info);
       size_t next = pc + 1 + static_cast<size_t>(info.operand_bytes);
-      if (opcode == static_cast<uint8_t>(OpCode::Line) ||
-          opcode == static_cast<uint8_t>(OpCode::ProfileStart) ||
-          opcode == static_cast<uint8_t>(OpCode::ProfileEnd)) {
+      if (IsSafepoint(code, pc, next, opcode)) {
         StackMap map;
         map.pc = static_cast<uint32_t>(pc);
         map.stack_height = static_cast<uint32_t>(stack_types.size());
@@ -580,6 +645,7 @@ VerifyResult VerifyModule(const SbcModule& module) {
           opcode == static_cast<uint8_t>(OpCode::NewArrayF32) ||
           opcode == static_cast<uint8_t>(OpCode::NewArrayF64) ||
           opcode == static_cast<uint8_t>(OpCode::NewArrayRef) ||
+          opcode == static_cast<uint8_t>(OpCode::NewArrayU8) ||
           opcode == static_cast<uint8_t>(OpCode::NewList) ||
           opcode == static_cast<uint8_t>(OpCode::NewListI64) ||
           opcode == static_cast<uint8_t>(OpCode::NewListF32) ||
@@ -604,6 +670,25 @@ VerifyResult VerifyModule(const SbcModule& module) {
         if (!ReadU32(code, pc + 1, &const_id)) return fail_at("CONST_STRING const id out of bounds", pc, opcode);
         if (const_id + 8 > module.const_pool.size()) return fail_at("CONST_STRING const id bad", pc, opcode);
       }
+      if (opcode == static_cast<uint8_t>(OpCode::PrintFmt)) {
+        uint32_t const_id = 0;
+        if (!ReadU32(code, pc + 1, &const_id)) return fail_at("PRINT_FMT const id out of bounds", pc, opcode);
+        if (const_id + 8 > module.const_pool.size()) return fail_at("PRINT_FMT const id bad", pc, opcode);
+        uint32_t kind = 0;
+        uint32_t str_offset = 0;
+        ReadU32(module.const_pool, const_id, &kind);
+        ReadU32(module.const_pool, const_id + 4, &str_offset);
+        if (kind != 0) return fail_at("PRINT_FMT const kind mismatch", pc, opcode);
+        if (str_offset >= module.const_pool.size()) return fail_at("PRINT_FMT string out of bounds", pc, opcode);
+        size_t holes = 0;
+        for (size_t i = str_offset; i + 1 < module.const_pool.size() && module.const_pool[i] != 0; ++i) {
+          if (module.const_pool[i] == '{' && module.const_pool[i + 1] == '}') {
+            ++holes;
+            ++i;
+          }
+        }
+        if (holes != code[pc + 5]) return fail_at("PRINT_FMT placeholder count mismatch", pc, opcode);
+      }
       if (opcode == static_cast<uint8_t>(OpCode::Call) ||
           opcode == static_cast<uint8_t>(OpCode::TailCall)) {
         uint32_t func_id = 0;
@@ -691,6 +776,7 @@ VerifyResult VerifyModule(const SbcModule& module) {
         case OpCode::NewArrayF32:
         case OpCode::NewArrayF64:
         case OpCode::NewArrayRef:
+        case OpCode::NewArrayU8:
         case OpCode::NewList:
         case OpCode::NewListI64:
         case OpCode::NewListF32:
@@ -1239,7 +1325,8 @@ VerifyResult VerifyModule(const SbcModule& module) {
           push_type(ValType::I32);
           break;
         }
-        case OpCode::ArrayGetI32: {
+        case OpCode::ArrayGetI32:
+        case OpCode::ArrayGetU8: {
           ValType idx = pop_type();
           ValType arr = pop_type();
           VerifyResult r1 = check_type(arr, ValType::Ref, "ARRAY_GET type mismatch");
@@ -1289,7 +1376,8 @@ VerifyResult VerifyModule(const SbcModule& module) {
           push_type(ValType::Ref);
           break;
         }
-        case OpCode::ArraySetI32: {
+        case OpCode::ArraySetI32:
+        case OpCode::ArraySetU8: {
           ValType value = pop_type();
           ValType idx = pop_type();
           ValType arr = pop_type();
@@ -1727,6 +1815,19 @@ VerifyResult VerifyModule(const SbcModule& module) {
           extra_pushes = (intrinsic_sig.ret != 0) ? 1 : 0;
           break;
         }
+        case OpCode::PrintFmt: {
+          uint8_t arg_count = code[pc + 5];
+          if (stack_types.size() < static_cast<size_t>(arg_count) * 2u) {
+            return fail_at("PRINT_FMT stack underflow", pc, opcode);
+          }
+          for (int i = 0; i < static_cast<int>(arg_count); ++i) {
+            VerifyResult r = check_type(pop_type(), ValType::I32, "PRINT_FMT tag type mismatch");
+            if (!r.ok) return r;
+            pop_type();
+          }
+          extra_pops = static_cast<int>(arg_count) * 2;
+          break;
+        }
         case OpCode::SysCall: {
           uint32_t id = 0;
           if (!ReadU32(code, pc + 1, &id)) return fail_at("SYS_CALL id out of bounds", pc, opcode);
@@ -1931,6 +2032,8 @@ VerifyResult VerifyModule(const SbcModule& module) {
           break;
       }
 
+      if (type_underflow) return fail_at("stack underflow", pc, opcode);
+      if (stack_types.size() > func.stack_max) return fail_at("stack exceeds max", pc, opcode);
       int pop_count = info.pops + extra_pops;
       if (pop_count > 0) {
         if (stack_height - pop_count < 0) return fail_at("stack underflow", pc, opcode);
@@ -1941,6 +2044,10 @@ VerifyResult VerifyModule(const SbcModule& module) {
         return fail_at("stack exceeds max", pc, opcode);
       }
       for (size_t jump_target : jump_targets) {
+        auto seen_it = entry_heights.find(jump_target);
+        if (seen_it != entry_heights.end() && seen_it->second != stack_types.size()) {
+          return fail_at("stack merge height mismatch on backward jump", pc, opcode);
+        }
         auto it = merge_types.find(jump_target);
         if (it == merge_types.end()) {
           merge_types[jump_target] = stack_types;
@@ -1996,4 +2103,21 @@ VerifyResult VerifyModule(const SbcModule& module) {
   return result;
 }
 
+const StackMap* FindStackMap(const MethodVerifyInfo& info, uint32_t pc) {
+  auto it = std::lower_bound(info.stack_maps.begin(), info.stack_maps.end(), pc,
+                             [](const StackMap& map, uint32_t value) { return map.pc < value; });
+  if (it == info.stack_maps.end() || it->pc != pc) return nullptr;
+  return &*it;
+}
+
+const VerifyResult& VerifyModuleCached(const SbcModule& module) {
+  std::shared_ptr<const VerifyResult> cached = std::atomic_load(&module.verify_cache.result);
+  if (cached) return *cached;
+  std::shared_ptr<const VerifyResult> fresh = std::make_shared<const VerifyResult>(VerifyModule(module));
+  // Another thread may have published its result first; keep whichever won so
+  // references handed out earlier stay valid.
+  if (std::atomic_compare_exchange_strong(&module.verify_cache.result, &cached, fresh)) return *fresh;
+  return *cached;
+}
+
 } // namespace Simple::Byte
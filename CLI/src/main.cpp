@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cctype>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #if defined(__linux__)
 #include <unistd.h>
@@ -21,6 +22,7 @@
 #include "lang_validate.h"
 #include "lang_sir.h"
 #include "lsp_server.h"
+#include "opcode.h"
 #include "sbc_loader.h"
 #include "sbc_verifier.h"
 #include "vm.h"
@@ -457,7 +459,7 @@ bool WriteEmbeddedRunner(const std::string& path,
          "    std::cerr << \"verify failed: \" << vr.error << \"\\n\";\n"
          "    return 1;\n"
          "  }\n"
-         "  auto exec = Simple::VM::ExecuteModule(load.module, true);\n"
+         "  auto exec = Simple::VM::ExecuteModule(load.module, vr);\n"
          "  if (exec.status == Simple::VM::ExecStatus::Trapped) {\n"
          "    std::cerr << \"runtime trap: \" << exec.error << \"\\n\";\n"
          "    return 1;\n"
@@ -510,6 +512,7 @@ bool BuildEmbeddedExecutable(const BuildLayoutPaths& layout,
   }
   cmd += "-ldl ";
   cmd += "-lffi ";
+  cmd += "-pthread ";
   cmd += "-o " + QuoteArg(out_path);
 
   int rc = std::system(cmd.c_str());
@@ -626,6 +629,20 @@ void PrintError(const std::string& message) {
   std::cerr << "error[E0001]: " << TrimCopy(message) << "\n";
 }
 
+// Parses the value of a count flag such as --workers or --top; text is null
+// when the flag ends the command line. Prints an error unless the value is a
+// positive decimal integer.
+bool ParseCountFlag(const std::string& flag, const char* text, size_t* out) {
+  char* end = nullptr;
+  const unsigned long value = text ? std::strtoul(text, &end, 10) : 0;
+  if (!text || *text < '0' || *text > '9' || *end != '\0' || value == 0) {
+    PrintError(flag + " expects a positive integer" + (text ? ", got '" + std::string(text) + "'" : ""));
+    return false;
+  }
+  *out = static_cast<size_t>(value);
+  return true;
+}
+
 std::string DiagnosticHelpFor(const std::string& message) {
   if (message.find("unexpected character") != std::string::npos) {
     return "remove unsupported characters or escape them if inside literals";
@@ -682,6 +699,77 @@ void PrintErrorWithContext(const std::string& path, const std::string& message)
   PrintDiagnosticHelp(loc.message);
 }
 
+std::string OpcodeSequenceName(uint32_t key, size_t length) {
+  std::string out;
+  for (size_t i = length; i-- > 0;) {
+    if (!out.empty()) out += " ";
+    out += Simple::Byte::OpCodeName(static_cast<uint8_t>((key >> (i * 8)) & 0xFFu));
+  }
+  return out;
+}
+
+void PrintTopSequences(const char* title, std::vector<std::pair<uint32_t, uint64_t>> counts, size_t length,
+                       size_t top) {
+  std::sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+  std::cout << title << ":\n";
+  for (size_t i = 0; i < counts.size() && i < top; ++i) {
+    std::cout << "  " << counts[i].second << "  " << OpcodeSequenceName(counts[i].first, length) << "\n";
+  }
+}
+
+// Runs each input with opcode sequence profiling and prints the most frequent
+// adjacent pairs and triples summed over all inputs, for tuning the VM's
+// superinstruction set.
+int RunOpcodeProfile(const std::vector<std::string>& paths, size_t top, bool verify) {
+  std::vector<uint64_t> pairs(256 * 256, 0);
+  std::unordered_map<uint32_t, uint64_t> triples;
+  for (const auto& path : paths) {
+    std::vector<uint8_t> bytes;
+    std::string error;
+    Simple::Byte::LoadResult load{};
+    if (HasExt(path, ".simple")) {
+      if (!CompileSimpleFileToSbc(path, &bytes, &error)) {
+        PrintErrorWithContext(path, error);
+        return 1;
+      }
+      load = Simple::Byte::LoadModuleFromBytes(bytes);
+    } else if (HasExt(path, ".sir")) {
+      std::string text;
+      if (!ReadFileText(path, &text, &error) || !CompileSirToSbc(text, path, &bytes, &error)) {
+        PrintError(error);
+        return 1;
+      }
+      load = Simple::Byte::LoadModuleFromBytes(bytes);
+    } else {
+      load = Simple::Byte::LoadModuleFromFile(path);
+    }
+    if (!load.ok) {
+      PrintError("load failed (" + path + "): " + load.error);
+      return 1;
+    }
+    Simple::VM::ExecOptions options;
+    options.profile_opcode_sequences = true;
+    Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, verify, false, options);
+    if (exec.status == Simple::VM::ExecStatus::Trapped) {
+      PrintError("runtime trap (" + path + "): " + exec.error);
+      return 1;
+    }
+    for (size_t i = 0; i < exec.opcode_pair_counts.size() && i < pairs.size(); ++i) {
+      pairs[i] += exec.opcode_pair_counts[i];
+    }
+    for (const auto& entry : exec.opcode_triple_counts) triples[entry.first] += entry.second;
+  }
+  std::vector<std::pair<uint32_t, uint64_t>> pair_list;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    if (pairs[i] != 0) pair_list.emplace_back(static_cast<uint32_t>(i), pairs[i]);
+  }
+  PrintTopSequences("opcode pairs", std::move(pair_list), 2, top);
+  PrintTopSequences("opcode triples", {triples.begin(), triples.end()}, 3, top);
+  return 0;
+}
+
 int main(int argc, char** argv) {
   const std::string tool_name = BaseName(argv[0]);
   const bool simple_only = (tool_name == "simple");
@@ -691,7 +779,7 @@ int main(int argc, char** argv) {
       std::cerr << "  " << tool_name << " --version | -v\n"
                 << "  " << tool_name << " --help | -h\n"
                 << "  " << tool_name << " help\n"
-                << "  " << tool_name << " run <file.simple> [--no-verify]\n"
+                << "  " << tool_name << " run <file.simple> [--no-verify] [--workers <n>]\n"
                 << "  " << tool_name
                 << " build <file.simple> [--out <file.exe|file.sbc>] [-d|--dynamic|-s|--static] [--no-verify]\n"
                 << "  " << tool_name
@@ -700,18 +788,20 @@ int main(int argc, char** argv) {
                 << "  " << tool_name << " emit -sbc <file.simple> [--out <file.sbc>] [--no-verify]\n"
                 << "  " << tool_name << " check <file.simple>\n"
                 << "  " << tool_name << " lsp\n"
+                << "  " << tool_name << " profile <file.simple>... [--top <n>] [--no-verify]\n"
                 << "  " << tool_name << " <file.simple> [--no-verify]\n";
     } else {
       std::cerr << "  " << tool_name << " --version | -v\n"
                 << "  " << tool_name << " --help | -h\n"
                 << "  " << tool_name << " help\n"
-                << "  " << tool_name << " run <module.sbc|file.sir|file.simple> [--no-verify]\n"
+                << "  " << tool_name << " run <module.sbc|file.sir|file.simple> [--no-verify] [--workers <n>]\n"
                 << "  " << tool_name << " build <file.sir|file.simple> [--out <file.sbc>] [--no-verify]\n"
                 << "  " << tool_name << " compile <file.sir|file.simple> [--out <file.sbc>] [--no-verify]\n"
                 << "  " << tool_name << " emit -ir <file.simple> [--out <file.sir>]\n"
                 << "  " << tool_name << " emit -sbc <file.sir|file.simple> [--out <file.sbc>] [--no-verify]\n"
                 << "  " << tool_name << " check <file.sbc|file.sir|file.simple>\n"
                 << "  " << tool_name << " lsp\n"
+                << "  " << tool_name << " profile <module.sbc|file.sir|file.simple>... [--top <n>] [--no-verify]\n"
                 << "  " << tool_name << " <module.sbc|file.sir|file.simple> [--no-verify]\n";
     }
   };
@@ -734,16 +824,20 @@ int main(int argc, char** argv) {
 
   const std::string cmd = argv[1];
   const bool build_cmd = (cmd == "build" || cmd == "compile");
-  const bool is_command = (cmd == "run" || build_cmd || cmd == "check" || cmd == "emit" || cmd == "lsp");
+  const bool is_command = (cmd == "run" || build_cmd || cmd == "check" || cmd == "emit" || cmd == "lsp" ||
+                           cmd == "profile");
   const std::string path = is_command ? (argc > 2 ? argv[2] : "") : cmd;
   bool verify = true;
   bool build_exe = false;
   bool build_static = false;
   bool build_mode_explicit = false;
+  size_t workers = 0;
   for (int i = 2; i < argc; ++i) {
     const std::string arg = argv[i];
     if (arg == "--no-verify") {
       verify = false;
+    } else if (arg == "--workers") {
+      if (!ParseCountFlag(arg, i + 1 < argc ? argv[++i] : nullptr, &workers)) return 1;
     } else if (arg == "-d" || arg == "--dynamic") {
       build_exe = true;
       build_static = false;
@@ -764,6 +858,24 @@ int main(int argc, char** argv) {
     return Simple::LSP::RunServer(std::cin, std::cout);
   }
 
+  if (cmd == "profile") {
+    std::vector<std::string> inputs;
+    size_t top = 20;
+    for (int i = 2; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--top") {
+        if (!ParseCountFlag(arg, i + 1 < argc ? argv[++i] : nullptr, &top)) return 1;
+      } else if (arg != "--no-verify") {
+        if (simple_only && !HasExt(arg, ".simple")) {
+          PrintError("simple expects .simple input");
+          return 1;
+        }
+        inputs.push_back(arg);
+      }
+    }
+    return RunOpcodeProfile(inputs, top, verify);
+  }
+
   if (cmd == "check") {
     if (simple_only && !HasExt(path, ".simple")) {
       PrintError("simple expects .simple input");
@@ -1017,14 +1129,30 @@ int main(int argc, char** argv) {
   }
 
   if (verify) {
-    Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(load.module);
+    const Simple::Byte::VerifyResult& vr = Simple::Byte::VerifyModuleCached(load.module);
     if (!vr.ok) {
       PrintError("verify failed: " + vr.error);
       return 1;
     }
   }
 
-  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, verify);
+  if (workers > 0) {
+    // Batch mode: one isolate per worker, all sharing the loaded module.
+    std::vector<Simple::VM::ExecResult> results = Simple::VM::RunIsolates(load.module, workers, workers, verify);
+    int exit_code = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (results[i].status == Simple::VM::ExecStatus::Trapped) {
+        PrintError("runtime trap (worker " + std::to_string(i) + "): " + results[i].error);
+        return 1;
+      }
+      if (exit_code == 0) exit_code = results[i].exit_code;
+    }
+    return exit_code;
+  }
+
+  Simple::VM::ExecResult exec = verify
+      ? Simple::VM::ExecuteModule(load.module, Simple::Byte::VerifyModuleCached(load.module))
+      : Simple::VM::ExecuteModule(load.module, false);
   if (exec.status == Simple::VM::ExecStatus::Trapped) {
     PrintError("runtime trap: " + exec.error);
     return 1;
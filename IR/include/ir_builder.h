@@ -46,6 +46,7 @@ class IrBuilder {
   void EmitTailCall(uint32_t func_id, uint8_t arg_count);
   void EmitCallCheck();
   void EmitIntrinsic(uint32_t id);
+  void EmitPrintFmt(uint32_t const_id, uint8_t arg_count);
   void EmitSysCall(uint32_t id);
   void EmitJmpTable(const std::vector<IrLabel>& cases, IrLabel default_label);
   void EmitNewArray(uint32_t type_id, uint32_t length);
@@ -60,6 +61,9 @@ class IrBuilder {
   void EmitArraySetF64();
   void EmitArrayGetRef();
   void EmitArraySetRef();
+  void EmitNewArrayU8(uint32_t type_id, uint32_t length);
+  void EmitArrayGetU8();
+  void EmitArraySetU8();
   void EmitNewList(uint32_t type_id, uint32_t capacity);
   void EmitListLen();
   void EmitListGetI32();
@@ -148,6 +148,12 @@ void IrBuilder::EmitIntrinsic(uint32_t id) {
   EmitU32(id);
 }
 
+void IrBuilder::EmitPrintFmt(uint32_t const_id, uint8_t arg_count) {
+  EmitOp(OpCode::PrintFmt);
+  EmitU32(const_id);
+  EmitU8(arg_count);
+}
+
 void IrBuilder::EmitSysCall(uint32_t id) {
   EmitOp(OpCode::SysCall);
   EmitU32(id);
@@ -226,6 +232,20 @@ void IrBuilder::EmitArraySetRef() {
   EmitOp(OpCode::ArraySetRef);
 }
 
+void IrBuilder::EmitNewArrayU8(uint32_t type_id, uint32_t length) {
+  EmitOp(OpCode::NewArrayU8);
+  EmitU32(type_id);
+  EmitU32(length);
+}
+
+void IrBuilder::EmitArrayGetU8() {
+  EmitOp(OpCode::ArrayGetU8);
+}
+
+void IrBuilder::EmitArraySetU8() {
+  EmitOp(OpCode::ArraySetU8);
+}
+
 void IrBuilder::EmitNewList(uint32_t type_id, uint32_t capacity) {
   EmitOp(OpCode::NewList);
   EmitU32(type_id);
@@ -2215,6 +2215,16 @@ bool LowerIrTextToModule(const IrTextModule& text, Simple::IR::IrModule* out, st
         builder.EmitIntrinsic(id);
         continue;
       }
+      if (op == "print.fmt") {
+        uint32_t const_id = 0;
+        uint64_t arg_count = 0;
+        if (inst.args.size() != 2 || !resolve_const_string_id(inst.args[0], &const_id) ||
+            !ParseUint(inst.args[1], &arg_count) || arg_count > 0xFFu) {
+          return fail("print.fmt expects const_id arg_count");
+        }
+        builder.EmitPrintFmt(const_id, static_cast<uint8_t>(arg_count));
+        continue;
+      }
       if (op == "syscall") {
         uint32_t id = 0;
         if (inst.args.size() != 1 || !resolve_syscall_id(inst.args[0], &id)) {
@@ -2327,6 +2337,24 @@ bool LowerIrTextToModule(const IrTextModule& text, Simple::IR::IrModule* out, st
         builder.EmitArraySetRef();
         continue;
       }
+      if (op == "newarray.u8") {
+        uint32_t type_id = 0;
+        uint64_t length = 0;
+        if (inst.args.size() != 2 || !resolve_type_id(inst.args[0], &type_id) ||
+            !ParseUint(inst.args[1], &length)) {
+          return fail("newarray.u8 expects type_id length");
+        }
+        builder.EmitNewArrayU8(type_id, static_cast<uint32_t>(length));
+        continue;
+      }
+      if (op == "array.get.u8") {
+        builder.EmitArrayGetU8();
+        continue;
+      }
+      if (op == "array.set.u8") {
+        builder.EmitArraySetU8();
+        continue;
+      }
       if (op == "newlist") {
         uint32_t type_id = 0;
         uint64_t cap = 0;
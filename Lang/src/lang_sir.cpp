@@ -773,6 +773,16 @@ const char* VmTypeNameForElement(const TypeRef& type, const EmitState& st) {
   return "ref";
 }
 
+// u8{} lowers to a byte array (newarray.u8) rather than one i32 slot per element.
+bool IsByteArrayType(const TypeRef& container) {
+  return container.name == "u8" && container.pointer_depth == 0 && !container.is_proc &&
+         container.type_args.empty() && container.dims.size() == 1 && !container.dims.front().is_list;
+}
+
+const char* ArrayOpSuffixForType(const TypeRef& container, const char* element_suffix) {
+  return IsByteArrayType(container) ? "u8" : element_suffix;
+}
+
 bool CloneElementType(const TypeRef& container, TypeRef* out) {
   if (!out) return false;
   if (container.dims.empty()) return false;
@@ -1661,7 +1671,7 @@ bool EmitIndexSetOp(EmitState& st,
   if (container_type.dims.front().is_list) {
     (*st.out) << "  list.set." << op_suffix << "\n";
   } else {
-    (*st.out) << "  array.set." << op_suffix << "\n";
+    (*st.out) << "  array.set." << ArrayOpSuffixForType(container_type, op_suffix) << "\n";
   }
   PopStack(st, 3);
   return true;
@@ -1673,7 +1683,7 @@ bool EmitIndexGetOp(EmitState& st,
   if (container_type.dims.front().is_list) {
     (*st.out) << "  list.get." << op_suffix << "\n";
   } else {
-    (*st.out) << "  array.get." << op_suffix << "\n";
+    (*st.out) << "  array.get." << ArrayOpSuffixForType(container_type, op_suffix) << "\n";
   }
   PopStack(st, 2);
   return PushStack(st, 1);
@@ -2503,10 +2513,22 @@ bool EmitExpr(EmitState& st,
             if (error) *error = "call argument count mismatch for 'IO." + callee.text + "'";
             return false;
           }
+          // println folds its newline into a trailing string literal, so the
+          // line goes out as one print_any rather than two.
+          bool newline_pending = callee.text == "println";
           if (expr.args.size() == 1) {
             TypeRef arg_type;
             if (!InferExprType(expr.args[0], st, &arg_type, error)) return false;
-            if (!EmitPrintAnyValue(st, expr.args[0], arg_type, error)) return false;
+            const Expr& arg = expr.args[0];
+            if (newline_pending && arg.kind == ExprKind::Literal &&
+                arg.literal_kind == LiteralKind::String) {
+              Expr line_expr = arg;
+              line_expr.text += "\n";
+              newline_pending = false;
+              if (!EmitPrintAnyValue(st, line_expr, arg_type, error)) return false;
+            } else {
+              if (!EmitPrintAnyValue(st, arg, arg_type, error)) return false;
+            }
           } else {
             const Expr& fmt_expr = expr.args[0];
             if (!(fmt_expr.kind == ExprKind::Literal &&
@@ -2515,8 +2537,7 @@ bool EmitExpr(EmitState& st,
               return false;
             }
             size_t placeholder_count = 0;
-            std::vector<std::string> segments;
-            if (!CountFormatPlaceholders(fmt_expr.text, &placeholder_count, &segments, error)) {
+            if (!CountFormatPlaceholders(fmt_expr.text, &placeholder_count, nullptr, error)) {
               return false;
             }
             if (placeholder_count != expr.args.size() - 1) {
@@ -2527,29 +2548,30 @@ bool EmitExpr(EmitState& st,
               }
               return false;
             }
+            if (placeholder_count > 0xFFu) {
+              if (error) *error = "IO.print supports at most 255 format arguments";
+              return false;
+            }
+            // One print.fmt renders the whole line: the VM fills each "{}"
+            // from the (value, tag) pairs pushed here in argument order.
             for (size_t i = 0; i < placeholder_count; ++i) {
-              if (!segments[i].empty()) {
-                TypeRef seg_type = MakeTypeRef("string");
-                Expr seg_expr;
-                seg_expr.kind = ExprKind::Literal;
-                seg_expr.literal_kind = LiteralKind::String;
-                seg_expr.text = segments[i];
-                if (!EmitPrintAnyValue(st, seg_expr, seg_type, error)) return false;
-              }
               TypeRef arg_type;
               if (!InferExprType(expr.args[i + 1], st, &arg_type, error)) return false;
-              if (!EmitPrintAnyValue(st, expr.args[i + 1], arg_type, error)) return false;
-            }
-            if (!segments.empty() && !segments.back().empty()) {
-              TypeRef seg_type = MakeTypeRef("string");
-              Expr seg_expr;
-              seg_expr.kind = ExprKind::Literal;
-              seg_expr.literal_kind = LiteralKind::String;
-              seg_expr.text = segments.back();
-              if (!EmitPrintAnyValue(st, seg_expr, seg_type, error)) return false;
+              if (!EmitExpr(st, expr.args[i + 1], &arg_type, error)) return false;
+              uint32_t tag = 0;
+              if (!GetPrintAnyTagForType(arg_type, &tag, error)) return false;
+              (*st.out) << "  const.i32 " << static_cast<int32_t>(tag) << "\n";
+              PushStack(st, 1);
             }
+            std::string fmt_text = fmt_expr.text;
+            if (newline_pending) fmt_text += "\n";
+            newline_pending = false;
+            std::string fmt_name;
+            if (!AddStringConst(st, fmt_text, &fmt_name)) return false;
+            (*st.out) << "  print.fmt " << fmt_name << " " << placeholder_count << "\n";
+            PopStack(st, static_cast<uint32_t>(placeholder_count * 2));
           }
-          if (callee.text == "println") {
+          if (newline_pending) {
             if (!EmitPrintNewline(st, error)) return false;
           }
           return true;
@@ -3465,6 +3487,8 @@ bool EmitExpr(EmitState& st,
       uint32_t length = static_cast<uint32_t>(expr.children.size());
       if (is_list) {
         (*st.out) << "  newlist " << type_name << " " << length << "\n";
+      } else if (IsByteArrayType(*expected)) {
+        (*st.out) << "  newarray.u8 u8 " << length << "\n";
       } else {
         (*st.out) << "  newarray " << type_name << " " << length << "\n";
       }
@@ -3480,7 +3504,7 @@ bool EmitExpr(EmitState& st,
           (*st.out) << "  const.i32 " << i << "\n";
           PushStack(st, 1);
           (*st.out) << "  swap\n";
-          (*st.out) << "  array.set." << op_suffix << "\n";
+          (*st.out) << "  array.set." << ArrayOpSuffixForType(*expected, op_suffix) << "\n";
           PopStack(st, 3);
         }
       }
@@ -3514,7 +3538,7 @@ bool EmitExpr(EmitState& st,
       if (container_type.dims.front().is_list) {
         (*st.out) << "  list.get." << op_suffix << "\n";
       } else {
-        (*st.out) << "  array.get." << op_suffix << "\n";
+        (*st.out) << "  array.get." << ArrayOpSuffixForType(container_type, op_suffix) << "\n";
       }
       PopStack(st, 2);
       PushStack(st, 1);
@@ -3541,6 +3565,8 @@ bool EmitExpr(EmitState& st,
         uint32_t length = static_cast<uint32_t>(expr.children.size());
         if (is_list) {
           (*st.out) << "  newlist " << type_name << " " << length << "\n";
+        } else if (IsByteArrayType(*expected)) {
+          (*st.out) << "  newarray.u8 u8 " << length << "\n";
         } else {
           (*st.out) << "  newarray " << type_name << " " << length << "\n";
         }
@@ -3556,7 +3582,7 @@ bool EmitExpr(EmitState& st,
             (*st.out) << "  const.i32 " << i << "\n";
             PushStack(st, 1);
             (*st.out) << "  swap\n";
-            (*st.out) << "  array.set." << op_suffix << "\n";
+            (*st.out) << "  array.set." << ArrayOpSuffixForType(*expected, op_suffix) << "\n";
             PopStack(st, 3);
           }
         }
@@ -3918,7 +3944,7 @@ bool EmitStmt(EmitState& st, const Stmt& stmt, std::string* error) {
           if (container_type.dims.front().is_list) {
             (*st.out) << "  list.get." << op_suffix << "\n";
           } else {
-            (*st.out) << "  array.get." << op_suffix << "\n";
+            (*st.out) << "  array.get." << ArrayOpSuffixForType(container_type, op_suffix) << "\n";
           }
           PopStack(st, 2);
           PushStack(st, 1);
@@ -3967,7 +3993,7 @@ bool EmitStmt(EmitState& st, const Stmt& stmt, std::string* error) {
           if (container_type.dims.front().is_list) {
             (*st.out) << "  list.set." << op_suffix << "\n";
           } else {
-            (*st.out) << "  array.set." << op_suffix << "\n";
+            (*st.out) << "  array.set." << ArrayOpSuffixForType(container_type, op_suffix) << "\n";
           }
           PopStack(st, 3);
           return true;
@@ -3976,7 +4002,7 @@ bool EmitStmt(EmitState& st, const Stmt& stmt, std::string* error) {
         if (container_type.dims.front().is_list) {
           (*st.out) << "  list.set." << op_suffix << "\n";
         } else {
-          (*st.out) << "  array.set." << op_suffix << "\n";
+          (*st.out) << "  array.set." << ArrayOpSuffixForType(container_type, op_suffix) << "\n";
         }
         PopStack(st, 3);
         return true;
@@ -2144,6 +2144,10 @@ bool CheckCallArgTypes(const Expr& call_expr,
         return t.name == "i32" && !t.is_proc && t.type_args.empty() &&
                t.dims.size() == 1;
       };
+      auto is_byte_array = [&](const TypeRef& t) -> bool {
+        return t.name == "u8" && !t.is_proc && t.type_args.empty() && t.pointer_depth == 0 &&
+               t.dims.size() == 1 && !t.dims.front().is_list;
+      };
       if (mod == "Core.Math") {
         if (name == "abs") {
           if (call_expr.args.size() != 1) return true;
@@ -2264,7 +2268,7 @@ bool CheckCallArgTypes(const Expr& call_expr,
         }
         return true;
       }
-      if (mod == "File") {
+      if (mod == "Core.FS") {
         if (name == "open") {
           if (call_expr.args.size() != 2) return true;
           TypeRef path;
@@ -2293,8 +2297,8 @@ bool CheckCallArgTypes(const Expr& call_expr,
           TypeRef len;
           if (!infer_arg(0, &fd) || !infer_arg(1, &buf) || !infer_arg(2, &len)) return true;
           if (fd.name != "i32" || !fd.dims.empty() || len.name != "i32" || !len.dims.empty() ||
-              !is_i32_buffer(buf)) {
-            if (error) *error = "File." + name + " expects (i32, i32[], i32)";
+              (!is_i32_buffer(buf) && !is_byte_array(buf))) {
+            if (error) *error = "File." + name + " expects (i32, i32[] or u8{}, i32)";
             return false;
           }
           return true;
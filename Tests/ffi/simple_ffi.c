@@ -97,6 +97,16 @@ SimpleColor simple_color_make(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
   return color;
 }
 
+typedef struct SimpleLabel {
+  const char* text;
+  int32_t weight;
+} SimpleLabel;
+
+int32_t simple_label_len(SimpleLabel label) {
+  if (!label.text) return -1;
+  return (int32_t)strlen(label.text) + label.weight;
+}
+
 typedef struct Array {
   int32_t* data;
   size_t length;
@@ -6,7 +6,10 @@
 #include <string>
 #include <vector>
 
+#include "decoded_code.h"
+#include "dl_trampoline.h"
 #include "heap.h"
+#include "heap_string.h"
 #include "intrinsic_ids.h"
 #include "opcode.h"
 #include "ir_lang.h"
@@ -1322,6 +1325,57 @@ std::vector<uint8_t> BuildUpvalueOrderModule() {
   return BuildModuleWithFunctions(funcs, locals);
 }
 
+std::vector<uint8_t> BuildClosureCallSiteModule() {
+  using Simple::Byte::OpCode;
+  // apply(f) calls f through one CALL_INDIRECT site; entry passes it six
+  // different closures twice, overflowing the site's inline cache.
+  std::vector<uint8_t> apply;
+  AppendU8(apply, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(apply, 1);
+  AppendU8(apply, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(apply, 0);
+  AppendU8(apply, static_cast<uint8_t>(OpCode::CallIndirect));
+  AppendU32(apply, 0);
+  AppendU8(apply, 0);
+  AppendU8(apply, static_cast<uint8_t>(OpCode::Ret));
+
+  std::vector<uint8_t> entry;
+  AppendU8(entry, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(entry, 0);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(entry, 0);
+  for (int round = 0; round < 2; ++round) {
+    for (uint32_t method = 2; method < 8; ++method) {
+      AppendU8(entry, static_cast<uint8_t>(OpCode::NewClosure));
+      AppendU32(entry, method);
+      AppendU8(entry, 0);
+      AppendU8(entry, static_cast<uint8_t>(OpCode::Call));
+      AppendU32(entry, 1);
+      AppendU8(entry, 1);
+      AppendU8(entry, static_cast<uint8_t>(OpCode::AddI32));
+    }
+  }
+  AppendU8(entry, static_cast<uint8_t>(OpCode::Ret));
+
+  std::vector<std::vector<uint8_t>> funcs{entry, apply};
+  std::vector<uint16_t> locals{0, 1};
+  std::vector<uint32_t> sig_ids{0, 1};
+  for (int32_t value = 2; value < 8; ++value) {
+    std::vector<uint8_t> callee;
+    AppendU8(callee, static_cast<uint8_t>(OpCode::Enter));
+    AppendU16(callee, 0);
+    AppendU8(callee, static_cast<uint8_t>(OpCode::ConstI32));
+    AppendI32(callee, value);
+    AppendU8(callee, static_cast<uint8_t>(OpCode::Ret));
+    funcs.push_back(callee);
+    locals.push_back(0);
+    sig_ids.push_back(0);
+  }
+  SigSpec entry_sig{0, 0, {}};
+  SigSpec apply_sig{0, 1, {0}};
+  return BuildModuleWithFunctionsAndSigs(funcs, locals, sig_ids, {entry_sig, apply_sig});
+}
+
 std::vector<uint8_t> BuildBadUpvalueTypeVerifyModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> code;
@@ -1341,6 +1395,7 @@ std::vector<uint8_t> BuildBadUpvalueIndexModule() {
   std::vector<uint8_t> entry;
   AppendU8(entry, static_cast<uint8_t>(OpCode::Enter));
   AppendU16(entry, 1);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::ConstNull));
   AppendU8(entry, static_cast<uint8_t>(OpCode::NewClosure));
   AppendU32(entry, 1);
   AppendU8(entry, 1);
@@ -2229,6 +2284,97 @@ std::vector<uint8_t> BuildGcVmStressModule() {
   return BuildModule(code, 0, 2);
 }
 
+std::vector<uint8_t> BuildGcOversizeArrayModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::NewArray));
+  AppendU32(code, 0);
+  AppendU32(code, 64 * 1024);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Pop));
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Ret));
+  return BuildModule(code, 0, 0);
+}
+
+// A plain NEW_ARRAY with a ref element type (how SIR lowers `newarray ref`)
+// holds the only handle to a young i32[7]; a garbage loop then forces minor
+// collections before the element's length is returned.
+std::vector<uint8_t> BuildGcRefTypedArrayModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> types;
+  AppendU32(types, 0);
+  AppendU8(types, static_cast<uint8_t>(Simple::Byte::TypeKind::I32));
+  AppendU8(types, 0);
+  AppendU16(types, 0);
+  AppendU32(types, 4);
+  AppendU32(types, 0);
+  AppendU32(types, 0);
+  AppendU32(types, 0);
+  AppendU8(types, static_cast<uint8_t>(Simple::Byte::TypeKind::Ref));
+  AppendU8(types, 1);
+  AppendU16(types, 0);
+  AppendU32(types, 4);
+  AppendU32(types, 0);
+  AppendU32(types, 0);
+
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 2);
+  AppendU8(code, static_cast<uint8_t>(OpCode::NewArray));
+  AppendU32(code, 1);
+  AppendU32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::NewArray));
+  AppendU32(code, 0);
+  AppendU32(code, 7);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ArraySetRef));
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(code, 1);
+  size_t loop_start = code.size();
+  // A LINE gives the loop a safepoint with a stack map.
+  AppendU8(code, static_cast<uint8_t>(OpCode::Line));
+  AppendU32(code, 1);
+  AppendU32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::NewArray));
+  AppendU32(code, 0);
+  AppendU32(code, 16);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Pop));
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::AddI32));
+  AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 20000);
+  AppendU8(code, static_cast<uint8_t>(OpCode::CmpLtI32));
+  AppendU8(code, static_cast<uint8_t>(OpCode::JmpTrue));
+  size_t patch_loop = code.size();
+  AppendI32(code, 0);
+  PatchRel32(code, patch_loop, loop_start);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ArrayGetRef));
+  AppendU8(code, static_cast<uint8_t>(OpCode::ArrayLen));
+  AppendU8(code, static_cast<uint8_t>(OpCode::Ret));
+  return BuildModuleWithTables(code, {}, types, {}, 0, 2);
+}
+
 std::vector<uint8_t> BuildStringModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> const_pool;
@@ -2253,6 +2399,50 @@ std::vector<uint8_t> BuildStringModule() {
   return BuildModuleWithTables(code, const_pool, empty, empty, 0, 0);
 }
 
+std::vector<uint8_t> BuildConstStringLoopModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> const_pool;
+  uint32_t label_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "label: "));
+  uint32_t label_const = 0;
+  AppendConstString(const_pool, label_off, &label_const);
+
+  std::vector<uint8_t> code;
+  std::vector<size_t> patch_sites;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 2);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(code, 0);
+  size_t loop_start = code.size();
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstString));
+  AppendU32(code, label_const);
+  AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::AddI32));
+  AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 5000);
+  AppendU8(code, static_cast<uint8_t>(OpCode::CmpLtI32));
+  AppendU8(code, static_cast<uint8_t>(OpCode::JmpTrue));
+  patch_sites.push_back(code.size());
+  AppendI32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::StringLen));
+  AppendU8(code, static_cast<uint8_t>(OpCode::Ret));
+  PatchRel32(code, patch_sites[0], loop_start);
+  std::vector<uint8_t> empty;
+  return BuildModuleWithTables(code, const_pool, empty, empty, 0, 2);
+}
+
 std::vector<uint8_t> BuildStringGetCharModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> const_pool;
@@ -2419,6 +2609,16 @@ std::vector<uint8_t> BuildBadUnknownOpcodeModule() {
   return BuildModule(code, 0, 0);
 }
 
+std::vector<uint8_t> BuildBadSuperinstructionModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal2));
+  AppendU8(code, static_cast<uint8_t>(OpCode::Ret));
+  return BuildModule(code, 0, 0);
+}
+
 std::vector<uint8_t> BuildBadOperandOverrunModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> code;
@@ -4405,6 +4605,40 @@ std::vector<uint8_t> BuildIntrinsicTimeModule() {
   return BuildModuleWithTables(code, {}, {}, {}, 0, 0);
 }
 
+std::vector<uint8_t> BuildPrintFmtModule(uint8_t arg_count) {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> const_pool;
+  uint32_t fmt_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "print_fmt {} + {} = {}\n"));
+  uint32_t text_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "5"));
+  uint32_t fmt_const = 0;
+  uint32_t text_const = 0;
+  AppendConstString(const_pool, fmt_off, &fmt_const);
+  AppendConstString(const_pool, text_off, &text_const);
+
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 2);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, static_cast<int32_t>(Simple::VM::kPrintAnyTagI32));
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstF64));
+  AppendF64(code, 3.0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, static_cast<int32_t>(Simple::VM::kPrintAnyTagF64));
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstString));
+  AppendU32(code, text_const);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, static_cast<int32_t>(Simple::VM::kPrintAnyTagString));
+  AppendU8(code, static_cast<uint8_t>(OpCode::PrintFmt));
+  AppendU32(code, fmt_const);
+  AppendU8(code, arg_count);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 5);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Ret));
+  return BuildModuleWithTables(code, const_pool, {}, {}, 0, 0);
+}
+
 std::vector<uint8_t> BuildSysCallTrapModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> code;
@@ -5265,6 +5499,36 @@ std::vector<uint8_t> BuildBadJumpOobModule() {
   return BuildModule(code, 0, 0);
 }
 
+std::vector<uint8_t> BuildBadBackJumpHeightModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 0);
+  size_t loop_start = code.size();
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Jmp));
+  size_t jmp_operand = code.size();
+  AppendI32(code, 0);
+  PatchRel32(code, jmp_operand, loop_start);
+  return BuildModule(code, 0, 0);
+}
+
+std::vector<uint8_t> BuildBadNewClosureUnderflowModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::NewClosure));
+  AppendU32(code, 0);
+  AppendU8(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Pop));
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Ret));
+  return BuildModule(code, 0, 0);
+}
+
 std::vector<uint8_t> BuildBadJmpRuntimeModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> code;
@@ -6030,6 +6294,44 @@ std::vector<uint8_t> BuildBadImportsMissingConstPoolLoadModule() {
                                      imports, {});
 }
 
+std::vector<uint8_t> BuildExportedAccumulatorModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadGlobal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::AddI32));
+  AppendU8(code, static_cast<uint8_t>(OpCode::StoreGlobal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::LoadGlobal));
+  AppendU32(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Ret));
+  std::vector<uint8_t> const_pool;
+  uint32_t name = static_cast<uint32_t>(AppendStringToPool(const_pool, "bump"));
+  std::vector<uint8_t> exports;
+  AppendU32(exports, name);
+  AppendU32(exports, 0); // func_id
+  AppendU32(exports, 0); // flags
+  AppendU32(exports, 0); // reserved
+  uint32_t zero_const = static_cast<uint32_t>(const_pool.size());
+  AppendU32(const_pool, 3); // f32 kind, zero bits
+  AppendU32(const_pool, 0);
+  std::vector<uint8_t> module =
+      BuildModuleWithTablesAndSig(code, const_pool, {}, {}, 1, 1, 0, 1, 0, 0, {0}, {}, exports);
+  uint32_t section_count = ReadU32At(module, 0x08);
+  uint32_t section_table_offset = ReadU32At(module, 0x0C);
+  for (uint32_t i = 0; i < section_count; ++i) {
+    size_t off = static_cast<size_t>(section_table_offset) + i * 16u;
+    if (ReadU32At(module, off + 0) != 6) continue;
+    WriteU32(module, ReadU32At(module, off + 4) + 12, zero_const);
+    break;
+  }
+  return module;
+}
+
 std::vector<uint8_t> BuildBadExportsTableSizeLoadModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> code;
@@ -7054,11 +7356,13 @@ std::vector<uint8_t> BuildImportArgsGetIsNullModule(int32_t index_value) {
   return module;
 }
 
+// const_pool may already hold strings the code refers to; the method, module
+// and symbol names are appended to it.
 std::vector<uint8_t> BuildImportFsModule(const std::string& symbol,
                                          uint32_t ret_type_id,
                                          const std::vector<uint32_t>& param_types,
-                                         const std::vector<uint8_t>& code) {
-  std::vector<uint8_t> const_pool;
+                                         const std::vector<uint8_t>& code,
+                                         std::vector<uint8_t> const_pool = {}) {
   uint32_t main_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "main"));
   uint32_t mod_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "core.fs"));
   uint32_t sym_off = static_cast<uint32_t>(AppendStringToPool(const_pool, symbol));
@@ -7182,6 +7486,27 @@ std::vector<uint8_t> BuildImportFsOpenModule() {
   return BuildImportFsModule("open", 0, {1, 0}, code);
 }
 
+// Opens a file for writing, leaves it open and halts with the fd.
+std::vector<uint8_t> BuildImportFsOpenLeakModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> const_pool;
+  uint32_t path_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "Tests/bin/sbc_fs_reset.bin"));
+  uint32_t path_const = 0;
+  AppendConstString(const_pool, path_off, &path_const);
+  std::vector<uint8_t> code;
+  AppendU8(code, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(code, 0);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstString));
+  AppendU32(code, path_const);
+  AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(code, 1);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Call));
+  AppendU32(code, 1);
+  AppendU8(code, 2);
+  AppendU8(code, static_cast<uint8_t>(OpCode::Halt));
+  return BuildImportFsModule("open", 0, {1, 0}, code, const_pool);
+}
+
 std::vector<uint8_t> BuildImportFsReadModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> code;
@@ -7490,7 +7815,13 @@ std::vector<uint8_t> BuildImportFsRoundTripModule() {
   return module;
 }
 
-std::vector<uint8_t> BuildImportFsReadClampModule() {
+// Writes "AB" through a two-element buffer made by new_array, then reads it
+// back with an oversized length; returns 1 when read clamps to 2 and
+// element 0 is 'A'.
+std::vector<uint8_t> BuildImportFsReadClampModuleWith(Simple::Byte::OpCode new_array,
+                                                      Simple::Byte::OpCode array_set,
+                                                      Simple::Byte::OpCode array_get,
+                                                      const char* path) {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> const_pool;
   uint32_t main_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "main"));
@@ -7500,7 +7831,7 @@ std::vector<uint8_t> BuildImportFsReadClampModule() {
   uint32_t write_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "write"));
   uint32_t close_off = static_cast<uint32_t>(AppendStringToPool(const_pool, "close"));
   uint32_t path_off =
-      static_cast<uint32_t>(AppendStringToPool(const_pool, "Tests/bin/sbc_fs_read_clamp.bin"));
+      static_cast<uint32_t>(AppendStringToPool(const_pool, path));
   uint32_t path_const = 0;
   AppendConstString(const_pool, path_off, &path_const);
 
@@ -7518,7 +7849,7 @@ std::vector<uint8_t> BuildImportFsReadClampModule() {
   AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
   AppendU32(code, 0);
 
-  AppendU8(code, static_cast<uint8_t>(OpCode::NewArray));
+  AppendU8(code, static_cast<uint8_t>(new_array));
   AppendU32(code, 0);
   AppendU32(code, 2);
   AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
@@ -7529,14 +7860,14 @@ std::vector<uint8_t> BuildImportFsReadClampModule() {
   AppendI32(code, 0);
   AppendU8(code, static_cast<uint8_t>(OpCode::ConstU8));
   AppendU8(code, 'A');
-  AppendU8(code, static_cast<uint8_t>(OpCode::ArraySetI32));
+  AppendU8(code, static_cast<uint8_t>(array_set));
   AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
   AppendU32(code, 1);
   AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
   AppendI32(code, 1);
   AppendU8(code, static_cast<uint8_t>(OpCode::ConstU8));
   AppendU8(code, 'B');
-  AppendU8(code, static_cast<uint8_t>(OpCode::ArraySetI32));
+  AppendU8(code, static_cast<uint8_t>(array_set));
 
   AppendU8(code, static_cast<uint8_t>(OpCode::LoadLocal));
   AppendU32(code, 0);
@@ -7565,7 +7896,7 @@ std::vector<uint8_t> BuildImportFsReadClampModule() {
   AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
   AppendU32(code, 0);
 
-  AppendU8(code, static_cast<uint8_t>(OpCode::NewArray));
+  AppendU8(code, static_cast<uint8_t>(new_array));
   AppendU32(code, 0);
   AppendU32(code, 2);
   AppendU8(code, static_cast<uint8_t>(OpCode::StoreLocal));
@@ -7589,7 +7920,7 @@ std::vector<uint8_t> BuildImportFsReadClampModule() {
   AppendU32(code, 1);
   AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
   AppendI32(code, 0);
-  AppendU8(code, static_cast<uint8_t>(OpCode::ArrayGetI32));
+  AppendU8(code, static_cast<uint8_t>(array_get));
   AppendU8(code, static_cast<uint8_t>(OpCode::ConstU8));
   AppendU8(code, 'A');
   AppendU8(code, static_cast<uint8_t>(OpCode::CmpEqI32));
@@ -7740,6 +8071,18 @@ std::vector<uint8_t> BuildImportFsReadClampModule() {
   return module;
 }
 
+std::vector<uint8_t> BuildImportFsReadClampModule() {
+  using Simple::Byte::OpCode;
+  return BuildImportFsReadClampModuleWith(OpCode::NewArray, OpCode::ArraySetI32, OpCode::ArrayGetI32,
+                                          "Tests/bin/sbc_fs_read_clamp.bin");
+}
+
+std::vector<uint8_t> BuildImportFsReadClampU8Module() {
+  using Simple::Byte::OpCode;
+  return BuildImportFsReadClampModuleWith(OpCode::NewArrayU8, OpCode::ArraySetU8, OpCode::ArrayGetU8,
+                                          "Tests/bin/sbc_fs_read_clamp_u8.bin");
+}
+
 std::vector<uint8_t> BuildImportFsReadBadFdModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> code;
@@ -15967,13 +16310,270 @@ bool RunLoopTest() {
   return true;
 }
 
-bool RunFixtureTest(const char* path, int32_t expected_exit) {
-  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromFile(path);
+bool RunDecodedLoopTest() {
+  std::vector<uint8_t> module_bytes = BuildLoopModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
   if (!load.ok) {
     std::cerr << "load failed: " << load.error << "\n";
     return false;
   }
-  Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(load.module);
+  Simple::VM::DecodedCode decoded = Simple::VM::DecodeModuleCode(load.module);
+  const auto& func = load.module.functions[0];
+  size_t count = 0;
+  size_t pc = func.code_offset;
+  size_t loop_start = 0;
+  while (pc < func.code_offset + func.code_size) {
+    const Simple::VM::DecodedInst* inst = decoded.At(pc);
+    if (!inst) {
+      std::cerr << "missing decoded inst at pc " << pc << "\n";
+      return false;
+    }
+    if (count == 5) loop_start = pc;
+    for (size_t off = pc + 1; off < inst->next_pc; ++off) {
+      if (decoded.At(off)) {
+        std::cerr << "operand byte decoded as instruction at " << off << "\n";
+        return false;
+      }
+    }
+    if (inst->opcode == static_cast<uint8_t>(Simple::Byte::OpCode::Jmp) && inst->a != loop_start) {
+      std::cerr << "expected back-edge target " << loop_start << ", got " << inst->a << "\n";
+      return false;
+    }
+    if (inst != &decoded.insts[count]) {
+      std::cerr << "decoded run is not contiguous at pc " << pc << "\n";
+      return false;
+    }
+    pc = inst->next_pc;
+    ++count;
+  }
+  if (count + 1 != decoded.insts.size() || (decoded.insts[count].flags & Simple::VM::kDecodedEnd) == 0 ||
+      decoded.insts[count].pc != pc) {
+    std::cerr << "expected run of " << count << " insts followed by an end sentinel\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunVmInstanceInvokeTest() {
+  std::vector<uint8_t> module_bytes = BuildExportedAccumulatorModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::Vm vm;
+  if (!vm.Load(load.module)) {
+    std::cerr << "vm load failed: " << vm.error() << "\n";
+    return false;
+  }
+  int32_t expected = 0;
+  Simple::VM::ExecResult exec;
+  for (int32_t i = 1; i <= 50; ++i) {
+    exec = vm.Invoke("bump", {static_cast<uint64_t>(i)});
+    expected += i;
+    if (exec.status != Simple::VM::ExecStatus::Halted || !exec.has_return_value ||
+        static_cast<int32_t>(exec.return_value) != expected) {
+      std::cerr << "invoke " << i << " returned " << static_cast<int32_t>(exec.return_value) << ", expected "
+                << expected << " (" << exec.error << ")\n";
+      return false;
+    }
+  }
+  if (exec.call_counts.empty() || exec.call_counts[0] < 50) {
+    std::cerr << "expected call counters to persist across invocations\n";
+    return false;
+  }
+  vm.Reset();
+  exec = vm.Invoke("bump", {7});
+  if (exec.status != Simple::VM::ExecStatus::Halted || static_cast<int32_t>(exec.return_value) != 7) {
+    std::cerr << "expected reset to clear globals\n";
+    return false;
+  }
+  exec = vm.Run();
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 7) {
+    std::cerr << "expected entry run to see global 7, got " << exec.exit_code << "\n";
+    return false;
+  }
+  if (vm.Invoke("missing", {}).status != Simple::VM::ExecStatus::Trapped ||
+      vm.Invoke("bump", {}).status != Simple::VM::ExecStatus::Trapped) {
+    std::cerr << "expected unknown export and bad arg count to trap\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunVmResetClosesFilesTest() {
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(BuildImportFsOpenLeakModule());
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::Vm vm;
+  if (!vm.Load(load.module)) {
+    std::cerr << "vm load failed: " << vm.error() << "\n";
+    return false;
+  }
+  // The second run gets the next fd while the first file is still open.
+  const int32_t expected[] = {0, 1};
+  for (int32_t fd : expected) {
+    Simple::VM::ExecResult exec = vm.Run();
+    if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != fd) {
+      std::cerr << "expected fd " << fd << ", got " << exec.exit_code << " (" << exec.error << ")\n";
+      return false;
+    }
+  }
+  vm.Reset();
+  Simple::VM::ExecResult exec = vm.Run();
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 0) {
+    std::cerr << "expected reset to close open files, got fd " << exec.exit_code << " (" << exec.error << ")\n";
+    return false;
+  }
+  vm.Reset();
+  std::remove("Tests/bin/sbc_fs_reset.bin");
+  return true;
+}
+
+bool RunVmIsolatesTest() {
+  std::vector<uint8_t> module_bytes = BuildExportedAccumulatorModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::Vm source;
+  Simple::VM::Vm isolate;
+  if (!source.Load(load.module) || !isolate.LoadIsolate(source)) {
+    std::cerr << "isolate load failed: " << source.error() << isolate.error() << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult a = source.Invoke("bump", {5});
+  Simple::VM::ExecResult b = isolate.Invoke("bump", {2});
+  if (static_cast<int32_t>(a.return_value) != 5 || static_cast<int32_t>(b.return_value) != 2) {
+    std::cerr << "expected isolates to keep separate globals\n";
+    return false;
+  }
+  std::vector<uint8_t> loop_bytes = BuildLoopModule();
+  Simple::Byte::LoadResult loop = Simple::Byte::LoadModuleFromBytes(loop_bytes);
+  if (!loop.ok) {
+    std::cerr << "load failed: " << loop.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult single = Simple::VM::ExecuteModule(loop.module);
+  std::vector<Simple::VM::ExecResult> results = Simple::VM::RunIsolates(loop.module, 6, 3);
+  if (results.size() != 6) {
+    std::cerr << "expected 6 isolate results, got " << results.size() << "\n";
+    return false;
+  }
+  for (const auto& result : results) {
+    if (result.status != single.status || result.exit_code != single.exit_code) {
+      std::cerr << "isolate result differs from single run: " << result.error << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RunVerifyCacheTest() {
+  std::vector<uint8_t> module_bytes = BuildLoopModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  const Simple::Byte::VerifyResult& first = Simple::Byte::VerifyModuleCached(load.module);
+  const Simple::Byte::VerifyResult& second = Simple::Byte::VerifyModuleCached(load.module);
+  if (!first.ok || &first != &second) {
+    std::cerr << "expected cached verify result to be reused\n";
+    return false;
+  }
+  Simple::Byte::SbcModule copy = load.module;
+  if (copy.verify_cache.result) {
+    std::cerr << "expected module copy to drop the verify cache\n";
+    return false;
+  }
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, first);
+  if (exec.status != Simple::VM::ExecStatus::Halted) {
+    std::cerr << "expected precomputed verify run to halt: " << exec.error << "\n";
+    return false;
+  }
+  exec = Simple::VM::ExecuteModule(copy, false, false);
+  if (exec.status != Simple::VM::ExecStatus::Halted || copy.verify_cache.result) {
+    std::cerr << "expected unverified run without allocations to skip verification\n";
+    return false;
+  }
+  Simple::Byte::VerifyResult failed;
+  failed.error = "precomputed failure";
+  exec = Simple::VM::ExecuteModule(load.module, failed);
+  if (exec.status != Simple::VM::ExecStatus::Trapped || exec.error != failed.error) {
+    std::cerr << "expected failed verify result to trap\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunDecodedSuperinstructionTest() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> module_bytes = BuildLoopModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::DecodedCode decoded = Simple::VM::DecodeModuleCode(load.module);
+  Simple::VM::FuseSuperinstructions(&decoded);
+  std::vector<uint8_t> opcodes;
+  for (const auto& inst : decoded.insts) opcodes.push_back(inst.opcode);
+  // enter; const; store; const; store; [load const cmp_gt jmp_false] x3;
+  // [load const add store] x3; [load const sub store] x3; jmp; load; ret
+  const size_t cond = 5;
+  const size_t inc = 9;
+  const size_t dec = 13;
+  if (opcodes.size() < 20 || opcodes[cond] != static_cast<uint8_t>(OpCode::JmpFalseCmpLocalConstI32) ||
+      opcodes[inc] != static_cast<uint8_t>(OpCode::IncLocalI32) ||
+      opcodes[dec] != static_cast<uint8_t>(OpCode::IncLocalI32)) {
+    std::cerr << "expected loop condition and counters to fuse\n";
+    return false;
+  }
+  if (opcodes[cond + 1] != static_cast<uint8_t>(OpCode::ConstI32) ||
+      opcodes[cond + 3] != static_cast<uint8_t>(OpCode::JmpFalse)) {
+    std::cerr << "fused records must keep their original opcodes\n";
+    return false;
+  }
+
+  Simple::VM::ExecOptions options;
+  options.profile_opcode_sequences = true;
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, true, false, options);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 3) {
+    std::cerr << "expected exit 3, got " << exec.exit_code << "\n";
+    return false;
+  }
+  if (exec.opcode_counts[static_cast<uint8_t>(OpCode::IncLocalI32)] != 0) {
+    std::cerr << "profiled run should not execute superinstructions\n";
+    return false;
+  }
+  uint32_t load_const = (static_cast<uint32_t>(OpCode::LoadLocal) << 8) | static_cast<uint32_t>(OpCode::ConstI32);
+  uint32_t const_add = (static_cast<uint32_t>(OpCode::ConstI32) << 8) | static_cast<uint32_t>(OpCode::AddI32);
+  uint32_t jmp_load = (static_cast<uint32_t>(OpCode::Jmp) << 8) | static_cast<uint32_t>(OpCode::LoadLocal);
+  uint32_t load_const_add = (load_const << 8) | static_cast<uint32_t>(OpCode::AddI32);
+  if (exec.opcode_pair_counts.size() != 256 * 256 || exec.opcode_pair_counts[const_add] != 3 ||
+      exec.opcode_pair_counts[load_const] != 10 || exec.opcode_pair_counts[jmp_load] != 0) {
+    std::cerr << "unexpected opcode pair counts\n";
+    return false;
+  }
+  auto triple = exec.opcode_triple_counts.find(load_const_add);
+  if (triple == exec.opcode_triple_counts.end() || triple->second != 3) {
+    std::cerr << "unexpected opcode triple counts\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunFixtureTest(const char* path, int32_t expected_exit) {
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromFile(path);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(load.module);
   if (!vr.ok) {
     std::cerr << "verify failed: " << vr.error << "\n";
     return false;
@@ -16162,6 +16762,30 @@ bool RunUpvalueOrderTest() {
   return true;
 }
 
+bool RunClosureCallSiteCacheTest() {
+  std::vector<uint8_t> module_bytes = BuildClosureCallSiteModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  if (load.module.function_by_method.size() != load.module.methods.size()) {
+    std::cerr << "expected method to function table\n";
+    return false;
+  }
+  // apply's param is declared i32 in this minimal type table, so run unverified.
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, false);
+  if (exec.status != Simple::VM::ExecStatus::Halted) {
+    std::cerr << "exec failed: " << exec.error << "\n";
+    return false;
+  }
+  if (exec.exit_code != 54) {
+    std::cerr << "expected 54, got " << exec.exit_code << "\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunNewClosureTest() {
   std::vector<uint8_t> module_bytes = BuildNewClosureModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -18205,6 +18829,20 @@ bool RunBadUnknownOpcodeLoadTest() {
   return true;
 }
 
+bool RunBadSuperinstructionLoadTest() {
+  std::vector<uint8_t> module_bytes = BuildBadSuperinstructionModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (load.ok) {
+    std::cerr << "expected load failure\n";
+    return false;
+  }
+  if (load.error.find("superinstruction opcode") == std::string::npos) {
+    std::cerr << "expected superinstruction opcode error, got: " << load.error << "\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunBadOperandOverrunLoadTest() {
   std::vector<uint8_t> module_bytes = BuildBadOperandOverrunModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -19148,6 +19786,65 @@ bool RunBadJumpOobVerifyTest() {
   return true;
 }
 
+bool RunBadBackJumpHeightVerifyTest() {
+  std::vector<uint8_t> module_bytes = BuildBadBackJumpHeightModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(load.module);
+  if (vr.ok) {
+    std::cerr << "expected verify failure\n";
+    return false;
+  }
+  if (vr.error.find("backward jump") == std::string::npos) {
+    std::cerr << "unexpected verify error: " << vr.error << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunBadNewClosureUnderflowVerifyTest() {
+  std::vector<uint8_t> module_bytes = BuildBadNewClosureUnderflowModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(load.module);
+  if (vr.ok) {
+    std::cerr << "expected verify failure\n";
+    return false;
+  }
+  if (vr.error.find("stack underflow") == std::string::npos) {
+    std::cerr << "unexpected verify error: " << vr.error << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunVerifiedMatchesCheckedTest() {
+  std::vector<uint8_t> module_bytes = BuildRecursiveCallModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult verified = Simple::VM::ExecuteModule(load.module, true, false);
+  Simple::VM::ExecResult checked = Simple::VM::ExecuteModule(load.module, false, false);
+  if (verified.status != Simple::VM::ExecStatus::Halted || checked.status != Simple::VM::ExecStatus::Halted) {
+    std::cerr << "exec failed\n";
+    return false;
+  }
+  if (verified.exit_code != 5 || checked.exit_code != 5) {
+    std::cerr << "expected 5, got " << verified.exit_code << " verified, " << checked.exit_code
+              << " checked\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunBadJmpRuntimeTrapTest() {
   std::vector<uint8_t> module_bytes = BuildBadJmpRuntimeModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -19868,21 +20565,22 @@ bool RunImportCallHostResolverTest() {
     return false;
   }
   Simple::VM::ExecOptions options;
-  options.import_resolver =
-      [](const std::string& mod, const std::string& sym, const std::vector<uint64_t>& args,
-         uint64_t& out_ret, bool& out_has_ret, std::string& out_error) -> bool {
-        if (mod != "host" || sym != "add1") {
-          return false;
-        }
-        if (args.size() != 1) {
-          out_error = "host.add1 arg count mismatch";
-          return false;
-        }
-        int32_t value = static_cast<int32_t>(static_cast<uint32_t>(args[0]));
-        out_ret = static_cast<uint32_t>(value + 1);
-        out_has_ret = true;
-        return true;
-      };
+  int resolver_calls = 0;
+  options.import_resolver = [&](const std::string& mod, const std::string& sym) -> Simple::VM::ImportHandler {
+    ++resolver_calls;
+    if (mod != "host" || sym != "add1") return {};
+    return [](const std::vector<uint64_t>& args, uint64_t& out_ret, bool& out_has_ret,
+              std::string& out_error) -> bool {
+      if (args.size() != 1) {
+        out_error = "host.add1 arg count mismatch";
+        return false;
+      }
+      int32_t value = static_cast<int32_t>(static_cast<uint32_t>(args[0]));
+      out_ret = static_cast<uint32_t>(value + 1);
+      out_has_ret = true;
+      return true;
+    };
+  };
   Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, true, true, options);
   if (exec.status != Simple::VM::ExecStatus::Halted) {
     std::cerr << "exec failed status " << static_cast<int>(exec.status);
@@ -19896,9 +20594,79 @@ bool RunImportCallHostResolverTest() {
     std::cerr << "expected 42, got " << exec.exit_code << "\n";
     return false;
   }
+  // A loaded Vm binds the import once and reuses the handler on every run.
+  resolver_calls = 0;
+  Simple::VM::Vm vm;
+  if (!vm.Load(load.module, true, true, options)) {
+    std::cerr << "vm load failed: " << vm.error() << "\n";
+    return false;
+  }
+  for (int run = 0; run < 3; ++run) {
+    Simple::VM::ExecResult again = vm.Run();
+    if (again.status != Simple::VM::ExecStatus::Halted || again.exit_code != 42) {
+      std::cerr << "vm run " << run << " failed: " << again.error << "\n";
+      return false;
+    }
+  }
+  if (resolver_calls != 1) {
+    std::cerr << "expected one resolver call, got " << resolver_calls << "\n";
+    return false;
+  }
   return true;
 }
 
+bool RunImportCallBuiltinSkipsResolverTest() {
+  std::vector<uint8_t> module_bytes = BuildImportCallModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecOptions options;
+  options.argv = {"a", "b"};
+  int resolver_calls = 0;
+  options.import_resolver = [&](const std::string&, const std::string&) -> Simple::VM::ImportHandler {
+    ++resolver_calls;
+    return {};
+  };
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, true, true, options);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 2) {
+    std::cerr << "expected exit 2, got status " << static_cast<int>(exec.status) << " exit "
+              << exec.exit_code << " " << exec.error << "\n";
+    return false;
+  }
+  if (resolver_calls != 0) {
+    std::cerr << "resolver consulted for core.os.args_count\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunImportCallUnresolvedTest() {
+  std::vector<uint8_t> module_bytes = BuildImportCallHostModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecOptions options;
+  int resolver_calls = 0;
+  options.import_resolver = [&](const std::string& mod, const std::string& sym) -> Simple::VM::ImportHandler {
+    if (mod == "host" && sym == "add1") ++resolver_calls;
+    return {};
+  };
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, true, true, options);
+  if (exec.status != Simple::VM::ExecStatus::Trapped) {
+    std::cerr << "expected trap, got status " << static_cast<int>(exec.status) << "\n";
+    return false;
+  }
+  if (exec.error.find("import not supported: host.add1") == std::string::npos) {
+    std::cerr << "unexpected error: " << exec.error << "\n";
+    return false;
+  }
+  return resolver_calls == 1;
+}
+
 bool RunImportCallIndirectTest() {
   std::vector<uint8_t> module_bytes = BuildImportCallIndirectModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -20274,6 +21042,34 @@ bool RunImportFsReadClampTest() {
   return true;
 }
 
+bool RunImportFsReadClampU8Test() {
+  std::vector<uint8_t> module_bytes = BuildImportFsReadClampU8Module();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(load.module);
+  if (!vr.ok) {
+    std::cerr << "verify failed: " << vr.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module);
+  if (exec.status != Simple::VM::ExecStatus::Halted) {
+    std::cerr << "exec failed status " << static_cast<int>(exec.status);
+    if (!exec.error.empty()) {
+      std::cerr << ": " << exec.error;
+    }
+    std::cerr << "\n";
+    return false;
+  }
+  if (exec.exit_code != 1) {
+    std::cerr << "expected 1, got " << exec.exit_code << "\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunImportFsReadBadFdTest() {
   std::vector<uint8_t> module_bytes = BuildImportFsReadBadFdModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -21711,6 +22507,18 @@ bool RunIntrinsicCoreTest() {
   return true;
 }
 
+bool RunPrintFmtTest() {
+  return RunExpectExit(BuildPrintFmtModule(3), 5);
+}
+
+bool RunBadPrintFmtCountVerifyTest() {
+  return RunExpectVerifyFail(BuildPrintFmtModule(2), "bad_print_fmt_count");
+}
+
+bool RunPrintFmtCountTrapTest() {
+  return RunExpectTrapNoVerify(BuildPrintFmtModule(2), "print_fmt_count_trap");
+}
+
 bool RunIntrinsicTimeTest() {
   std::vector<uint8_t> module_bytes = BuildIntrinsicTimeModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -22539,6 +23347,125 @@ bool RunHeapReuseTest() {
   return true;
 }
 
+bool RunHeapPagesTest() {
+  Simple::VM::Heap heap;
+  uint32_t list = heap.Allocate(Simple::VM::ObjectKind::List, 0, 8);
+  Simple::VM::HeapObject* obj = heap.Get(list);
+  for (uint32_t i = 0; i < 64; ++i) heap.Allocate(Simple::VM::ObjectKind::String, 0, 4 + (i % 40));
+  obj->payload[0] = 0x5A;
+  heap.ResizePayload(obj, 4096);
+  if (heap.Get(list) != obj || obj->payload.size() != 4096 || obj->payload[0] != 0x5A || obj->payload[4095] != 0) {
+    std::cerr << "expected payload growth to keep record and contents\n";
+    return false;
+  }
+  uint32_t large = heap.Allocate(Simple::VM::ObjectKind::Array, 0, 100000);
+  Simple::VM::HeapObject* large_obj = heap.Get(large);
+  if (!large_obj || large_obj->payload.size() != 100000 || large_obj->payload[99999] != 0) {
+    std::cerr << "expected zeroed large object\n";
+    return false;
+  }
+  heap.ResetMarks();
+  heap.Mark(list);
+  heap.Sweep();
+  obj = heap.Get(list);
+  if (heap.LiveCount() != 1 || heap.Get(large) || !obj || obj->payload.size() != 4096 || obj->payload[0] != 0x5A) {
+    std::cerr << "expected only the marked list to survive\n";
+    return false;
+  }
+  uint32_t reused = heap.Allocate(Simple::VM::ObjectKind::String, 0, 12);
+  Simple::VM::HeapObject* reused_obj = heap.Get(reused);
+  if (!reused_obj || reused_obj->payload.size() != 12 || reused_obj->payload[11] != 0) {
+    std::cerr << "expected freed block to be reused zeroed\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunHeapGenerationalTest() {
+  Simple::VM::Heap heap;
+  uint32_t owner = heap.Allocate(Simple::VM::ObjectKind::Closure, 0, 12);
+  WriteU32Payload(heap.Get(owner)->payload, 4, 1);
+  WriteU32Payload(heap.Get(owner)->payload, 8, 0xFFFFFFFFu);
+  heap.BeginCollection();
+  heap.Mark(owner);
+  heap.FinishCollection();
+  if (!heap.Get(owner) || heap.IsYoung(owner) || heap.NurseryBytes() != 0) {
+    std::cerr << "expected minor collection to promote the rooted closure\n";
+    return false;
+  }
+  uint32_t target = heap.Allocate(Simple::VM::ObjectKind::String, 0, 8);
+  uint32_t garbage = heap.Allocate(Simple::VM::ObjectKind::String, 0, 8);
+  if (!heap.IsYoung(target)) {
+    std::cerr << "expected new objects in the nursery\n";
+    return false;
+  }
+  WriteU32Payload(heap.Get(owner)->payload, 8, target);
+  heap.RecordWrite(owner, target);
+  // No roots: the old closure survives a minor collection by definition and
+  // its dirty card keeps target alive.
+  heap.BeginCollection();
+  heap.FinishCollection();
+  if (!heap.Get(owner) || !heap.Get(target) || heap.IsYoung(target) || heap.Get(garbage)) {
+    std::cerr << "expected card-marked young object to survive and garbage to be freed\n";
+    return false;
+  }
+  heap.ResetMarks();
+  heap.Sweep();
+  if (heap.LiveCount() != 0) {
+    std::cerr << "expected major collection without roots to free old space\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunHeapPreciseTracingTest() {
+  Simple::VM::Heap heap;
+  auto maps = std::make_shared<Simple::VM::TypeRefMaps>();
+  maps->field_offsets = {{4}};
+  heap.SetTypeRefMaps(maps);
+  uint32_t array = heap.Allocate(Simple::VM::ObjectKind::Array, 0, 4 + 2 * 4, true);
+  uint32_t record = heap.Allocate(Simple::VM::ObjectKind::Artifact, 0, 8);
+  uint32_t field_target = heap.Allocate(Simple::VM::ObjectKind::String, 0, 8);
+  uint32_t scalars = heap.Allocate(Simple::VM::ObjectKind::Array, 0, 4 + 4);
+  uint32_t unreached = heap.Allocate(Simple::VM::ObjectKind::String, 0, 8);
+  WriteU32Payload(heap.Get(array)->payload, 0, 2);
+  WriteU32Payload(heap.Get(array)->payload, 4, record);
+  WriteU32Payload(heap.Get(array)->payload, 8, 0xFFFFFFFFu);
+  WriteU32Payload(heap.Get(record)->payload, 0, unreached);
+  WriteU32Payload(heap.Get(record)->payload, 4, field_target);
+  WriteU32Payload(heap.Get(scalars)->payload, 0, 1);
+  WriteU32Payload(heap.Get(scalars)->payload, 4, unreached);
+  // A long list chain: each list's only element is the previous list.
+  uint32_t chain = 0xFFFFFFFFu;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    uint32_t link = heap.Allocate(Simple::VM::ObjectKind::List, 0, 8 + 4, true);
+    WriteU32Payload(heap.Get(link)->payload, 0, 1);
+    WriteU32Payload(heap.Get(link)->payload, 4, 1);
+    WriteU32Payload(heap.Get(link)->payload, 8, chain);
+    chain = link;
+  }
+  heap.ResetMarks();
+  heap.Mark(array);
+  heap.Mark(scalars);
+  heap.Mark(chain);
+  heap.Sweep();
+  if (!heap.Get(record) || !heap.Get(field_target) || heap.Get(unreached)) {
+    std::cerr << "expected ref elements and ref fields traced, scalar words ignored\n";
+    return false;
+  }
+  if (heap.LiveCount() != 4 + 100000) {
+    std::cerr << "expected the whole list chain to survive\n";
+    return false;
+  }
+  heap.ResetMarks();
+  heap.Sweep();
+  if (heap.LiveCount() != 0) {
+    std::cerr << "expected unrooted graph to be freed\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunScratchArenaTest() {
   Simple::VM::ScratchArena arena(16);
   if (arena.Used() != 0) {
@@ -22755,6 +23682,358 @@ bool RunGcVmStressTest() {
   return true;
 }
 
+bool RunGcPolicyTest() {
+  Simple::VM::Heap heap;
+  Simple::VM::GcPolicy policy;
+  policy.nursery_bytes = 4096;
+  policy.max_heap_bytes = 64 * 1024;
+  heap.SetPolicy(policy);
+  size_t allocated = 0;
+  while (heap.Allocate(Simple::VM::ObjectKind::String, 0, 8) != Simple::VM::Heap::kNoHandle) {
+    if (++allocated > 100000) break;
+  }
+  const Simple::VM::GcStats& stats = heap.Stats();
+  if (allocated == 0 || allocated > 100000 || stats.peak_live_bytes > policy.max_heap_bytes ||
+      !heap.CollectionPending()) {
+    std::cerr << "expected allocation to stop at the heap limit with a collection pending\n";
+    return false;
+  }
+  heap.BeginCollection();
+  heap.FinishCollection();
+  if (stats.minor_collections + stats.major_collections != 1 || stats.bytes_freed != stats.bytes_allocated ||
+      heap.Allocate(Simple::VM::ObjectKind::String, 0, 8) == Simple::VM::Heap::kNoHandle) {
+    std::cerr << "expected collection to free everything and allow allocation again\n";
+    return false;
+  }
+
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(BuildGcVmStressModule());
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.gc.bytes_allocated == 0 ||
+      exec.gc.peak_live_bytes == 0) {
+    std::cerr << "expected gc stats from a default run\n";
+    return false;
+  }
+  // The loop's arrays are garbage, so reaching the limit collects and
+  // retries instead of trapping.
+  Simple::VM::ExecOptions options;
+  options.gc_max_heap_bytes = 16 * 1024;
+  exec = Simple::VM::ExecuteModule(load.module, true, true, options);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 1 || exec.gc.major_collections == 0 ||
+      exec.gc.peak_live_bytes > options.gc_max_heap_bytes) {
+    std::cerr << "expected max heap to collect garbage and finish, got: " << exec.error << "\n";
+    return false;
+  }
+  load = Simple::Byte::LoadModuleFromBytes(BuildGcOversizeArrayModule());
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  exec = Simple::VM::ExecuteModule(load.module, true, true, options);
+  if (exec.status != Simple::VM::ExecStatus::Trapped ||
+      exec.error.find("allocation failed") == std::string::npos) {
+    std::cerr << "expected max heap to trap, got: " << exec.error << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunGcSafepointTest() {
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(BuildGcVmStressModule());
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  const Simple::Byte::VerifyResult& vr = Simple::Byte::VerifyModuleCached(load.module);
+  if (!vr.ok || vr.methods.empty()) {
+    std::cerr << "verify failed: " << vr.error << "\n";
+    return false;
+  }
+  // ENTER(3) CONST_I32(5) STORE_LOCAL(5) CONST_I32(5) STORE_LOCAL(5), then
+  // the loop starts with NEW_ARRAY and ends with a backward JMP_TRUE.
+  const uint32_t base = load.module.functions[0].code_offset;
+  const uint32_t new_array_pc = base + 3 + 5 + 5 + 5 + 5;
+  const uint32_t backedge_pc = base + static_cast<uint32_t>(load.module.functions[0].code_size) - 11;
+  const auto& info = vr.methods[0];
+  if (!Simple::Byte::FindStackMap(info, new_array_pc) || !Simple::Byte::FindStackMap(info, backedge_pc) ||
+      Simple::Byte::FindStackMap(info, new_array_pc + 1)) {
+    std::cerr << "expected stack maps at the allocation and the backward jump only\n";
+    return false;
+  }
+  Simple::VM::ExecOptions options;
+  options.gc_nursery_bytes = 4096;
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, true, true, options);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 1) {
+    std::cerr << "exec failed: " << exec.error << "\n";
+    return false;
+  }
+  if (exec.gc.minor_collections == 0 || exec.gc.peak_live_bytes > 64 * 1024) {
+    std::cerr << "expected collections at safepoints to bound the heap\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunGcIncrementalTest() {
+  using Simple::VM::ObjectKind;
+  Simple::VM::Heap heap;
+  Simple::VM::GcPolicy policy;
+  policy.incremental = true;
+  policy.slice_work = 8;
+  heap.SetPolicy(policy);
+  // root -> list of 64 strings; moved is referenced only from root[0].
+  uint32_t root = heap.Allocate(ObjectKind::List, 0, 8 + 64 * 4, true);
+  WriteU32Payload(heap.Get(root)->payload, 0, 64);
+  WriteU32Payload(heap.Get(root)->payload, 4, 64);
+  std::vector<uint32_t> strings;
+  for (uint32_t i = 0; i < 64; ++i) {
+    strings.push_back(heap.Allocate(ObjectKind::String, 0, 8));
+    WriteU32Payload(heap.Get(root)->payload, 8 + i * 4, strings.back());
+  }
+  uint32_t garbage = heap.Allocate(ObjectKind::String, 0, 8);
+  // Promote everything with a minor collection, then drop garbage.
+  heap.BeginCollection();
+  heap.Mark(root);
+  heap.Mark(garbage);
+  heap.FinishCollection();
+  heap.RequestMajorCollection();
+  if (!heap.NeedsRoots()) {
+    std::cerr << "expected a requested major collection to need roots\n";
+    return false;
+  }
+  heap.BeginCollection();
+  heap.Mark(root);
+  heap.FinishCollection();
+  if (!heap.IncrementalActive() || !heap.CollectionPending() || heap.NeedsRoots()) {
+    std::cerr << "expected the root pause to start an incremental cycle\n";
+    return false;
+  }
+  // Mid-cycle: move root[0] onto the (unscanned) stack and clear the list.
+  uint32_t moved = strings[0];
+  heap.RecordOverwrite(root);
+  WriteU32Payload(heap.Get(root)->payload, 0, 0);
+  uint32_t fresh = heap.Allocate(ObjectKind::String, 0, 8);
+  size_t steps = 0;
+  while (heap.IncrementalActive() && steps < 1000) {
+    heap.Step();
+    ++steps;
+  }
+  const Simple::VM::GcStats& stats = heap.Stats();
+  if (heap.IncrementalActive() || steps < 2 || stats.major_collections != 1 || stats.incremental_steps != steps) {
+    std::cerr << "expected the cycle to finish in several slices\n";
+    return false;
+  }
+  if (!heap.Get(moved) || !heap.Get(fresh) || !heap.Get(strings[63]) || heap.Get(garbage)) {
+    std::cerr << "expected snapshot and new objects kept, garbage swept\n";
+    return false;
+  }
+  uint64_t pauses = 0;
+  for (uint64_t count : stats.pause_histogram) pauses += count;
+  if (pauses != stats.minor_collections + 1 + stats.incremental_steps) {
+    std::cerr << "expected every pause in the histogram\n";
+    return false;
+  }
+
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(BuildGcVmStressModule());
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecOptions options;
+  options.gc_incremental = true;
+  options.gc_nursery_bytes = 4096;
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module, true, true, options);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 1 || exec.gc.minor_collections == 0) {
+    std::cerr << "expected incremental run to halt with 1: " << exec.error << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunHeapStringTest() {
+  using Simple::VM::StringEncoding;
+  Simple::VM::Heap heap;
+  uint32_t latin = Simple::VM::CreateString(heap, u"caf\u00e9");
+  uint32_t wide = Simple::VM::CreateString(heap, u"\u4e2d");
+  if (Simple::VM::GetStringEncoding(heap.Get(latin)) != StringEncoding::Latin1 ||
+      heap.Get(latin)->payload.size() != Simple::VM::kStringDataOffset + 4 ||
+      Simple::VM::GetStringEncoding(heap.Get(wide)) != StringEncoding::Utf16 ||
+      Simple::VM::StringUnitAt(heap, heap.Get(latin), 3) != 0xE9 || Simple::VM::StringUnitAt(heap, heap.Get(wide), 0) != 0x4E2D) {
+    std::cerr << "expected Latin-1 strings stored a byte per unit\n";
+    return false;
+  }
+  // A loop of small appends: O(1) each, one rope node per ~kMinRopeLength units.
+  uint32_t text = Simple::VM::CreateLatin1String(heap, "");
+  for (int i = 0; i < 2000; ++i) {
+    uint32_t piece = Simple::VM::CreateLatin1String(heap, "ab");
+    text = Simple::VM::ConcatStrings(heap, text, piece);
+  }
+  heap.RequestMajorCollection();
+  heap.BeginCollection();
+  heap.Mark(text);
+  heap.Mark(wide);
+  heap.FinishCollection();
+  if (Simple::VM::GetStringEncoding(heap.Get(text)) != StringEncoding::Rope ||
+      Simple::VM::StringLength(heap.Get(text)) != 4000 || heap.LiveCount() > 200) {
+    std::cerr << "expected appends to build a compact rope\n";
+    return false;
+  }
+  std::string expected;
+  for (int i = 0; i < 2000; ++i) expected += "ab";
+  if (Simple::VM::ReadAsciiString(heap, heap.Get(text)) != expected) {
+    std::cerr << "expected the rope to read back in order\n";
+    return false;
+  }
+  uint32_t rope_hash = Simple::VM::StringHash(heap, text);
+  if (Simple::VM::GetStringEncoding(heap.Get(text)) != StringEncoding::Latin1 ||
+      Simple::VM::StringUnitAt(heap, heap.Get(text), 3999) != 'b' ||
+      rope_hash != Simple::VM::StringHash(heap, Simple::VM::CreateLatin1String(heap, expected))) {
+    std::cerr << "expected hashing to flatten the rope and match the flat string\n";
+    return false;
+  }
+  // Flattening a rope with a wide half widens it.
+  uint32_t mixed = Simple::VM::ConcatStrings(heap, text, wide);
+  if (!Simple::VM::FlattenString(heap, mixed) ||
+      Simple::VM::GetStringEncoding(heap.Get(mixed)) != StringEncoding::Utf16 ||
+      Simple::VM::StringUnitAt(heap, heap.Get(mixed), 0) != 'a' || Simple::VM::StringUnitAt(heap, heap.Get(mixed), 4000) != 0x4E2D) {
+    std::cerr << "expected a widened flat string\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunHeapStringSliceTest() {
+  using Simple::VM::StringEncoding;
+  Simple::VM::Heap heap;
+  uint32_t parent = Simple::VM::CreateLatin1String(heap, "the quick brown fox jumps");
+  uint32_t words = Simple::VM::SliceString(heap, parent, 4, 19);
+  uint32_t fox = Simple::VM::SliceString(heap, words, 6, 15);
+  uint32_t quick = Simple::VM::SliceString(heap, words, 0, 5);
+  if (Simple::VM::GetStringEncoding(heap.Get(words)) != StringEncoding::Slice ||
+      Simple::VM::GetStringEncoding(heap.Get(fox)) != StringEncoding::Slice ||
+      Simple::VM::GetStringEncoding(heap.Get(quick)) != StringEncoding::Latin1 ||
+      Simple::VM::StringUnitAt(heap, heap.Get(words), 0) != 'q' || Simple::VM::StringLength(heap.Get(fox)) != 9 ||
+      Simple::VM::SliceString(heap, words, 3, 16) != Simple::VM::Heap::kNoHandle) {
+    std::cerr << "expected views for long slices and copies for short ones\n";
+    return false;
+  }
+  // A slice of a slice refers to the flat parent, so the middle one can die.
+  heap.RequestMajorCollection();
+  heap.BeginCollection();
+  heap.Mark(fox);
+  heap.Mark(quick);
+  heap.FinishCollection();
+  if (!heap.Get(parent) || heap.Get(words) || Simple::VM::ReadAsciiString(heap, heap.Get(fox)) != "brown fox") {
+    std::cerr << "expected a slice to keep only its parent alive\n";
+    return false;
+  }
+  uint32_t joined = Simple::VM::ConcatStrings(heap, fox, quick);
+  if (Simple::VM::ReadAsciiString(heap, heap.Get(joined)) != "brown foxquick" ||
+      Simple::VM::StringHash(heap, fox) !=
+          Simple::VM::StringHash(heap, Simple::VM::CreateLatin1String(heap, "brown fox"))) {
+    std::cerr << "expected slices to concatenate and hash like flat strings\n";
+    return false;
+  }
+  // Slicing a rope flattens it first.
+  uint32_t rope = Simple::VM::ConcatStrings(heap, Simple::VM::CreateLatin1String(heap, std::string(40, 'x')),
+                                            Simple::VM::CreateString(heap, u"\u4e2d" + std::u16string(39, u'y')));
+  uint32_t tail = Simple::VM::SliceString(heap, rope, 39, 60);
+  if (Simple::VM::GetStringEncoding(heap.Get(rope)) != StringEncoding::Utf16 ||
+      Simple::VM::GetStringEncoding(heap.Get(tail)) != StringEncoding::Slice ||
+      Simple::VM::StringUnitAt(heap, heap.Get(tail), 0) != 'x' ||
+      Simple::VM::StringUnitAt(heap, heap.Get(tail), 1) != 0x4E2D) {
+    std::cerr << "expected a slice of a flattened rope\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunConstStringInternTest() {
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(BuildConstStringLoopModule());
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 7) {
+    std::cerr << "expected the label length: " << exec.error << "\n";
+    return false;
+  }
+  // One string for 5000 CONST_STRINGs.
+  if (exec.gc.bytes_allocated > 1024) {
+    std::cerr << "expected CONST_STRING to reuse an interned string, allocated " << exec.gc.bytes_allocated << "\n";
+    return false;
+  }
+  // Pinned: the interned string survives collections with no other root.
+  Simple::VM::Heap heap;
+  uint32_t pinned = Simple::VM::CreateLatin1String(heap, "label: ");
+  heap.Pin(pinned);
+  heap.BeginCollection();
+  heap.FinishCollection();
+  heap.RequestMajorCollection();
+  heap.BeginCollection();
+  heap.FinishCollection();
+  if (!heap.Get(pinned) || heap.IsYoung(pinned) || Simple::VM::StringLength(heap.Get(pinned)) != 7) {
+    std::cerr << "expected a pinned string to survive in old space\n";
+    return false;
+  }
+  return true;
+}
+
+double TrampolineMix(int32_t a, double b, float c, int64_t d) {
+  return static_cast<double>(a) + b + static_cast<double>(c) + static_cast<double>(d);
+}
+
+int64_t trampoline_sink = 0;
+
+void TrampolineSink(int64_t value) {
+  trampoline_sink = value;
+}
+
+bool RunDlTrampolineTest() {
+  using Simple::VM::DlWordClass;
+  const DlWordClass mix_args[] = {DlWordClass::I32, DlWordClass::F64, DlWordClass::F32, DlWordClass::I64};
+  Simple::VM::DlTrampoline mix = Simple::VM::LookupDlTrampoline(DlWordClass::F64, mix_args, 4);
+  if (!mix) return false;
+  const uint64_t mix_words[] = {Simple::VM::DlToWord<int32_t>(-3), Simple::VM::DlToWord<double>(0.5),
+                                Simple::VM::DlToWord<float>(0.25f), Simple::VM::DlToWord<int64_t>(1LL << 40)};
+  uint64_t ret = 0;
+  mix(reinterpret_cast<void*>(&TrampolineMix), mix_words, &ret);
+  if (Simple::VM::DlFromWord<double>(ret) != -3.0 + 0.5 + 0.25 + static_cast<double>(1LL << 40)) return false;
+
+  const DlWordClass sink_args[] = {DlWordClass::I64};
+  Simple::VM::DlTrampoline sink = Simple::VM::LookupDlTrampoline(DlWordClass::None, sink_args, 1);
+  if (!sink) return false;
+  const uint64_t sink_words[] = {Simple::VM::DlToWord<int64_t>(-42)};
+  sink(reinterpret_cast<void*>(&TrampolineSink), sink_words, nullptr);
+  if (trampoline_sink != -42) return false;
+
+  const DlWordClass too_many[] = {DlWordClass::I32, DlWordClass::I32, DlWordClass::I32,
+                                  DlWordClass::I32, DlWordClass::I32};
+  if (Simple::VM::LookupDlTrampoline(DlWordClass::I32, too_many, 5)) return false;
+  const DlWordClass unsupported[] = {DlWordClass::None};
+  return Simple::VM::LookupDlTrampoline(DlWordClass::I32, unsupported, 1) == nullptr;
+}
+
+bool RunGcRefTypedArrayTest() {
+  std::vector<uint8_t> module_bytes = BuildGcRefTypedArrayModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module);
+  if (exec.status != Simple::VM::ExecStatus::Halted || exec.exit_code != 7) {
+    std::cerr << "expected element of ref-typed NEW_ARRAY to survive minor collections, got " << exec.exit_code
+              << " (" << exec.error << ")\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunGcTest() {
   std::vector<uint8_t> module_bytes = BuildGcModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -23120,6 +24399,12 @@ static const TestCase kCoreTests[] = {
   {"jmp_table_empty", RunJmpTableEmptyTest},
   {"locals", RunLocalTest},
   {"loop", RunLoopTest},
+  {"decoded_loop", RunDecodedLoopTest},
+  {"decoded_superinstructions", RunDecodedSuperinstructionTest},
+  {"vm_instance_invoke", RunVmInstanceInvokeTest},
+  {"vm_reset_closes_files", RunVmResetClosesFilesTest},
+  {"verify_cache", RunVerifyCacheTest},
+  {"vm_isolates", RunVmIsolatesTest},
   {"fixture_add", RunFixtureAddTest},
   {"fixture_loop", RunFixtureLoopTest},
   {"fixture_fib_iter", RunFixtureFibIterTest},
@@ -23131,6 +24416,7 @@ static const TestCase kCoreTests[] = {
   {"upvalue_ops", RunUpvalueTest},
   {"upvalue_object", RunUpvalueObjectTest},
   {"upvalue_order", RunUpvalueOrderTest},
+  {"closure_call_site_cache", RunClosureCallSiteCacheTest},
   {"new_closure", RunNewClosureTest},
   {"array_i32", RunArrayTest},
   {"array_i64", RunArrayI64Test},
@@ -23226,6 +24512,9 @@ static const TestCase kCoreTests[] = {
   {"verify_metadata", RunVerifyMetadataTest},
   {"verify_metadata_nonref_global", RunVerifyMetadataNonRefGlobalTest},
   {"heap_reuse", RunHeapReuseTest},
+  {"heap_pages", RunHeapPagesTest},
+  {"heap_generational", RunHeapGenerationalTest},
+  {"heap_precise_tracing", RunHeapPreciseTracingTest},
   {"scratch_arena", RunScratchArenaTest},
   {"scratch_scope", RunScratchScopeTest},
   {"scratch_align", RunScratchArenaAlignmentTest},
@@ -23234,7 +24523,15 @@ static const TestCase kCoreTests[] = {
   {"heap_closure_mark", RunHeapClosureMarkTest},
   {"gc_stress", RunGcStressTest},
   {"gc_vm_stress", RunGcVmStressTest},
+  {"gc_ref_typed_array", RunGcRefTypedArrayTest},
   {"gc_smoke", RunGcTest},
+  {"gc_policy", RunGcPolicyTest},
+  {"gc_safepoints", RunGcSafepointTest},
+  {"gc_incremental", RunGcIncrementalTest},
+  {"heap_string", RunHeapStringTest},
+  {"heap_string_slice", RunHeapStringSliceTest},
+  {"const_string_intern", RunConstStringInternTest},
+  {"dl_trampoline", RunDlTrampolineTest},
   {"field_ops", RunFieldTest},
   {"bad_field_verify", RunBadFieldVerifyTest},
   {"bad_const_string", RunBadConstStringVerifyTest},
@@ -23242,6 +24539,7 @@ static const TestCase kCoreTests[] = {
   {"bad_intrinsic_id_verify", RunBadIntrinsicIdVerifyTest},
   {"bad_intrinsic_param_verify", RunBadIntrinsicParamVerifyTest},
   {"intrinsic_return_verify", RunIntrinsicReturnVerifyTest},
+  {"bad_print_fmt_count", RunBadPrintFmtCountVerifyTest},
   {"bad_syscall_verify", RunBadSysCallVerifyTest},
   {"bad_merge_verify", RunBadMergeVerifyTest},
   {"bad_merge_height_verify", RunBadMergeHeightVerifyTest},
@@ -23305,6 +24603,9 @@ static const TestCase kCoreTests[] = {
   {"bad_list_clear_list_verify", RunBadListClearListVerifyTest},
   {"bad_jump_boundary_verify", RunBadJumpBoundaryVerifyTest},
   {"bad_jump_oob_verify", RunBadJumpOobVerifyTest},
+  {"bad_back_jump_height_verify", RunBadBackJumpHeightVerifyTest},
+  {"bad_new_closure_underflow_verify", RunBadNewClosureUnderflowVerifyTest},
+  {"verified_matches_checked", RunVerifiedMatchesCheckedTest},
   {"bad_jmp_runtime", RunBadJmpRuntimeTrapTest},
   {"bad_jmp_true_runtime", RunBadJmpTrueRuntimeTrapTest},
   {"bad_jmp_false_runtime", RunBadJmpFalseRuntimeTrapTest},
@@ -23356,6 +24657,7 @@ static const TestCase kCoreTests[] = {
   {"bad_type_kind_ref_fields_load", RunBadTypeKindRefFieldsLoadTest},
   {"good_type_kind_ref_size_load", RunGoodTypeKindRefSizeLoadTest},
   {"bad_unknown_opcode_load", RunBadUnknownOpcodeLoadTest},
+  {"bad_superinstruction_load", RunBadSuperinstructionLoadTest},
   {"bad_operand_overrun_load", RunBadOperandOverrunLoadTest},
   {"bad_code_alignment_load", RunBadCodeAlignmentLoadTest},
   {"bad_imports_table_size_load", RunBadImportsTableSizeLoadTest},
@@ -23373,6 +24675,8 @@ static const TestCase kCoreTests[] = {
   {"bad_export_duplicate_load", RunBadExportDuplicateLoadTest},
   {"import_call", RunImportCallTest},
   {"import_call_host", RunImportCallHostResolverTest},
+  {"import_call_builtin_skips_resolver", RunImportCallBuiltinSkipsResolverTest},
+  {"import_call_unresolved", RunImportCallUnresolvedTest},
   {"import_call_indirect", RunImportCallIndirectTest},
   {"import_dl_open_null", RunImportDlOpenNullTest},
   {"import_time_mono", RunImportTimeMonoTest},
@@ -23399,6 +24703,7 @@ static const TestCase kCoreTests[] = {
   {"import_fs_read_zero_nonempty", RunImportFsReadZeroLenNonEmptyBufTest},
   {"import_core_log", RunImportCoreLogTest},
   {"import_fs_read_clamp", RunImportFsReadClampTest},
+  {"import_fs_read_clamp_u8", RunImportFsReadClampU8Test},
   {"import_fs_read_stub", RunImportFsReadStubTest},
   {"import_fs_read_non_array", RunImportFsReadNonArrayBufTest},
   {"import_fs_read_zero_len", RunImportFsReadZeroLenTest},
@@ -23478,6 +24783,8 @@ static const TestCase kCoreTests[] = {
   {"intrinsic_trap", RunIntrinsicTrapTest},
   {"intrinsic_core", RunIntrinsicCoreTest},
   {"intrinsic_time", RunIntrinsicTimeTest},
+  {"print_fmt", RunPrintFmtTest},
+  {"print_fmt_count_trap", RunPrintFmtCountTrapTest},
   {"syscall_trap", RunSysCallTrapTest},
   {"bad_call_indirect", RunBadCallIndirectTrapTest},
   {"bad_call_indirect_type", RunBadCallIndirectTypeTrapTest},
@@ -1,4 +1,6 @@
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -6449,6 +6451,245 @@ bool RunIrTextArraySetRefNegativeIndexTrapTest() {
   return RunExpectTrap(module, "ir_text_array_set_ref_neg_idx");
 }
 
+bool RunIrTextArrayU8Test() {
+  const char* text =
+      "func main locals=1 stack=8\n"
+      "  enter 1\n"
+      "  newarray.u8 0 3\n"
+      "  stloc 0\n"
+      "  ldloc 0\n"
+      "  const.i32 2\n"
+      "  const.i32 300\n"
+      "  array.set.u8\n"
+      "  ldloc 0\n"
+      "  const.i32 2\n"
+      "  array.get.u8\n"
+      "  ldloc 0\n"
+      "  array.len\n"
+      "  add.i32\n"
+      "  ret\n"
+      "end\n"
+      "entry main\n";
+  auto module = BuildIrTextModule(text, "ir_text_array_u8");
+  if (module.empty()) return false;
+  return RunExpectExit(module, 47);
+}
+
+bool RunIrTextArrayGetU8WideArrayTrapTest() {
+  const char* text =
+      "func main locals=1 stack=8\n"
+      "  enter 1\n"
+      "  newarray 0 1\n"
+      "  stloc 0\n"
+      "  ldloc 0\n"
+      "  const.i32 0\n"
+      "  array.get.u8\n"
+      "  ret\n"
+      "end\n"
+      "entry main\n";
+  auto module = BuildIrTextModule(text, "ir_text_array_get_u8_wide");
+  if (module.empty()) return false;
+  return RunExpectTrap(module, "ir_text_array_get_u8_wide");
+}
+
+// A wide store inside a byte array's length but past its payload.
+bool RunIrTextArraySetI32ByteArrayTrapTest() {
+  const char* text =
+      "func main locals=1 stack=8\n"
+      "  enter 1\n"
+      "  newarray.u8 0 1000\n"
+      "  stloc 0\n"
+      "  ldloc 0\n"
+      "  const.i32 999\n"
+      "  const.i32 7\n"
+      "  array.set.i32\n"
+      "  const.i32 0\n"
+      "  ret\n"
+      "end\n"
+      "entry main\n";
+  auto module = BuildIrTextModule(text, "ir_text_array_set_i32_byte_array");
+  if (module.empty()) return false;
+  return RunExpectTrap(module, "ir_text_array_set_i32_byte_array");
+}
+
+bool RunIrTextArrayGetI64ByteArrayTrapTest() {
+  const char* text =
+      "func main locals=1 stack=8\n"
+      "  enter 1\n"
+      "  newarray.u8 0 16\n"
+      "  stloc 0\n"
+      "  ldloc 0\n"
+      "  const.i32 15\n"
+      "  array.get.i64\n"
+      "  pop\n"
+      "  const.i32 0\n"
+      "  ret\n"
+      "end\n"
+      "entry main\n";
+  auto module = BuildIrTextModule(text, "ir_text_array_get_i64_byte_array");
+  if (module.empty()) return false;
+  return RunExpectTrap(module, "ir_text_array_get_i64_byte_array");
+}
+
+bool WriteIrTextFile(const char* path, const char* bytes) {
+  std::FILE* f = std::fopen(path, "wb");
+  if (!f) {
+    std::cerr << "cannot create " << path << "\n";
+    return false;
+  }
+  std::fputs(bytes, f);
+  std::fclose(f);
+  return true;
+}
+
+// Maps "Hello" and returns bytes[1] + len, plus munmap's status and the length
+// left afterwards: 'e' + 5 + 0 + 0.
+bool RunIrTextFsMmapTest() {
+  const char* path = "Tests/bin/ir_text_fs_mmap.bin";
+  if (!WriteIrTextFile(path, "Hello")) return false;
+  const char* text =
+      "sigs:\n"
+      "  sig main: () -> i32\n"
+      "  sig mmap_sig: (string, i32) -> ref\n"
+      "  sig munmap_sig: (ref) -> i32\n"
+      "consts:\n"
+      "  const path string \"Tests/bin/ir_text_fs_mmap.bin\"\n"
+      "imports:\n"
+      "  import fs_mmap core.fs mmap sig=mmap_sig\n"
+      "  import fs_munmap core.fs munmap sig=munmap_sig\n"
+      "func main locals=2 stack=8 sig=main\n"
+      "  locals: buf, sum\n"
+      "  enter 2\n"
+      "  const.string path\n"
+      "  const.i32 0\n"
+      "  call fs_mmap 2\n"
+      "  stloc buf\n"
+      "  ldloc buf\n"
+      "  const.i32 1\n"
+      "  array.get.u8\n"
+      "  ldloc buf\n"
+      "  array.len\n"
+      "  add.i32\n"
+      "  stloc sum\n"
+      "  ldloc buf\n"
+      "  call fs_munmap 1\n"
+      "  ldloc sum\n"
+      "  add.i32\n"
+      "  ldloc buf\n"
+      "  array.len\n"
+      "  add.i32\n"
+      "  ret\n"
+      "end\n"
+      "entry main\n";
+  auto module = BuildIrTextModule(text, "ir_text_fs_mmap");
+  if (module.empty()) return false;
+  return RunExpectExit(module, 'e' + 5);
+}
+
+// Mappings of path in this process, or -1 without /proc/self/maps.
+int CountProcMappings(const char* path) {
+  std::FILE* f = std::fopen("/proc/self/maps", "r");
+  if (!f) return -1;
+  int count = 0;
+  char line[4096];
+  while (std::fgets(line, sizeof(line), f)) {
+    if (std::strstr(line, path)) ++count;
+  }
+  std::fclose(f);
+  return count;
+}
+
+// Maps a file, drops the array and then allocates `garbage` arrays into a
+// 4 KiB nursery. The Vm keeps its state after the run, so a mapping that
+// was not released is still in /proc/self/maps.
+bool RunIrTextFsMmapMapping(int garbage, Simple::VM::Vm* vm) {
+  std::string text =
+      "sigs:\n"
+      "  sig main: () -> i32\n"
+      "  sig mmap_sig: (string, i32) -> ref\n"
+      "consts:\n"
+      "  const path string \"Tests/bin/ir_text_fs_mmap_gc.bin\"\n"
+      "imports:\n"
+      "  import fs_mmap core.fs mmap sig=mmap_sig\n"
+      "func main locals=0 stack=8 sig=main\n"
+      "  enter 0\n"
+      "  const.string path\n"
+      "  const.i32 0\n"
+      "  call fs_mmap 2\n"
+      "  pop\n";
+  for (int i = 0; i < garbage; ++i) text += "  newarray 0 512\n  pop\n";
+  text += "  const.i32 0\n  ret\nend\nentry main\n";
+  auto module_bytes = BuildIrTextModule(text, "ir_text_fs_mmap_gc");
+  if (module_bytes.empty()) return false;
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecOptions options;
+  options.gc_nursery_bytes = 4096;
+  if (!vm->Load(load.module, true, true, options)) {
+    std::cerr << "vm load failed: " << vm->error() << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult exec = vm->Run();
+  if (exec.status != Simple::VM::ExecStatus::Halted) {
+    std::cerr << "ir_text_fs_mmap_gc failed: " << exec.error << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunIrTextFsMmapReleasedByGcTest() {
+  const char* path = "Tests/bin/ir_text_fs_mmap_gc.bin";
+  if (!WriteIrTextFile(path, "Hello")) return false;
+  if (CountProcMappings(path) < 0) return true;
+  {
+    Simple::VM::Vm vm;
+    if (!RunIrTextFsMmapMapping(0, &vm)) return false;
+    if (CountProcMappings(path) != 1) {
+      std::cerr << "expected the dropped mapping to stay until a collection\n";
+      return false;
+    }
+  }
+  Simple::VM::Vm vm;
+  if (!RunIrTextFsMmapMapping(16, &vm)) return false;
+  if (CountProcMappings(path) != 0) {
+    std::cerr << "expected the collection that freed the array to unmap the file, got "
+              << CountProcMappings(path) << " mappings\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunIrTextFsMmapReadOnlyTrapTest() {
+  const char* path = "Tests/bin/ir_text_fs_mmap_ro.bin";
+  if (!WriteIrTextFile(path, "Hello")) return false;
+  const char* text =
+      "sigs:\n"
+      "  sig main: () -> i32\n"
+      "  sig mmap_sig: (string, i32) -> ref\n"
+      "consts:\n"
+      "  const path string \"Tests/bin/ir_text_fs_mmap_ro.bin\"\n"
+      "imports:\n"
+      "  import fs_mmap core.fs mmap sig=mmap_sig\n"
+      "func main locals=0 stack=8 sig=main\n"
+      "  enter 0\n"
+      "  const.string path\n"
+      "  const.i32 0\n"
+      "  call fs_mmap 2\n"
+      "  const.i32 0\n"
+      "  const.i32 74\n"
+      "  array.set.u8\n"
+      "  const.i32 0\n"
+      "  ret\n"
+      "end\n"
+      "entry main\n";
+  auto module = BuildIrTextModule(text, "ir_text_fs_mmap_read_only");
+  if (module.empty()) return false;
+  return RunExpectTrap(module, "ir_text_fs_mmap_read_only");
+}
+
 bool RunIrTextListPopEmptyTrapTest() {
   const char* text =
       "func main locals=1 stack=8\n"
@@ -7607,6 +7848,13 @@ static const TestCase kIrTests[] = {
   {"ir_text_array_set_f32_neg_idx", RunIrTextArraySetF32NegativeIndexTrapTest},
   {"ir_text_array_set_f64_neg_idx", RunIrTextArraySetF64NegativeIndexTrapTest},
   {"ir_text_array_set_ref_neg_idx", RunIrTextArraySetRefNegativeIndexTrapTest},
+  {"ir_text_array_u8", RunIrTextArrayU8Test},
+  {"ir_text_array_get_u8_wide", RunIrTextArrayGetU8WideArrayTrapTest},
+  {"ir_text_array_set_i32_byte_array", RunIrTextArraySetI32ByteArrayTrapTest},
+  {"ir_text_array_get_i64_byte_array", RunIrTextArrayGetI64ByteArrayTrapTest},
+  {"ir_text_fs_mmap", RunIrTextFsMmapTest},
+  {"ir_text_fs_mmap_read_only", RunIrTextFsMmapReadOnlyTrapTest},
+  {"ir_text_fs_mmap_released_by_gc", RunIrTextFsMmapReleasedByGcTest},
   {"ir_text_list_pop_empty", RunIrTextListPopEmptyTrapTest},
   {"ir_text_list_get_neg_idx", RunIrTextListGetNegativeIndexTrapTest},
   {"ir_text_list_set_neg_idx", RunIrTextListSetNegativeIndexTrapTest},
@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+#include "jit_ir.h"
+#include "native_jit.h"
 #include "opcode.h"
 #include "sbc_emitter.h"
 #include "sbc_loader.h"
@@ -2501,6 +2503,64 @@ std::vector<uint8_t> BuildJitCompiledArrayOpsModule() {
   return BuildModuleWithFunctionsAndSigsWithTables(funcs, locals, sig_ids, {entry_sig, callee_sig}, const_pool, types);
 }
 
+// The callee reaches Tier1 on an i32 array, then gets a byte array whose
+// length admits index 1 but whose payload is too short for an i32 read.
+std::vector<uint8_t> BuildJitCompiledArrayGetByteArrayModule() {
+  using Simple::Byte::OpCode;
+  std::vector<uint8_t> entry;
+  AppendU8(entry, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(entry, 2);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::NewArray));
+  AppendU32(entry, 0);
+  AppendU32(entry, 2);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(entry, 0);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::NewArrayU8));
+  AppendU32(entry, 0);
+  AppendU32(entry, 2);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(entry, 1);
+  for (uint32_t i = 0; i < 2 * Simple::VM::kJitTier1Threshold; ++i) {
+    AppendU8(entry, static_cast<uint8_t>(OpCode::LoadLocal));
+    AppendU32(entry, 0);
+    AppendU8(entry, static_cast<uint8_t>(OpCode::Call));
+    AppendU32(entry, 1);
+    AppendU8(entry, 1);
+    AppendU8(entry, static_cast<uint8_t>(OpCode::Pop));
+  }
+  AppendU8(entry, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(entry, 1);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::Call));
+  AppendU32(entry, 1);
+  AppendU8(entry, 1);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::Ret));
+
+  std::vector<uint8_t> callee;
+  AppendU8(callee, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(callee, 1);
+  AppendU8(callee, static_cast<uint8_t>(OpCode::Line));
+  AppendU32(callee, 1);
+  AppendU32(callee, 1);
+  AppendU8(callee, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(callee, 0);
+  AppendU8(callee, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(callee, 1);
+  AppendU8(callee, static_cast<uint8_t>(OpCode::ArrayGetI32));
+  AppendU8(callee, static_cast<uint8_t>(OpCode::Ret));
+
+  SigSpec entry_sig{0, 0, {}};
+  SigSpec callee_sig{0, 1, {1}};
+  std::vector<std::vector<uint8_t>> funcs{entry, callee};
+  std::vector<uint16_t> locals{2, 1};
+  std::vector<uint32_t> sig_ids{0, 1};
+  std::vector<uint8_t> const_pool;
+  uint32_t dummy_str_offset = static_cast<uint32_t>(AppendStringToPool(const_pool, ""));
+  uint32_t dummy_const_id = 0;
+  AppendConstString(const_pool, dummy_str_offset, &dummy_const_id);
+  std::vector<uint8_t> types = BuildTypesI32RefString();
+  return BuildModuleWithFunctionsAndSigsWithTables(funcs, locals, sig_ids, {entry_sig, callee_sig}, const_pool, types);
+}
+
 std::vector<uint8_t> BuildJitCompiledListOpsModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> entry;
@@ -2630,6 +2690,81 @@ std::vector<uint8_t> BuildJitCompiledStringLenModule() {
   return BuildModuleWithFunctionsAndSigsWithTables(funcs, locals, sig_ids, {entry_sig, callee_sig}, const_pool, types);
 }
 
+// Entry calls f1(n) through a chain f1 -> f2 -> ... where each link has the
+// most locals native code allows and stops at n == 0. Small n fits the
+// native frame; with deep set, one f1(299) call runs out of it and bails.
+std::vector<uint8_t> BuildJitNativeTransientBailModule(bool deep) {
+  using Simple::Byte::OpCode;
+  constexpr uint32_t kChain = 300;
+  constexpr uint16_t kLinkLocals = 256;
+  auto call_f1 = [](std::vector<uint8_t>& code, int32_t n) {
+    AppendU8(code, static_cast<uint8_t>(OpCode::ConstI32));
+    AppendI32(code, n);
+    AppendU8(code, static_cast<uint8_t>(OpCode::Call));
+    AppendU32(code, 1);
+    AppendU8(code, 1);
+  };
+  std::vector<uint8_t> entry;
+  AppendU8(entry, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(entry, 0);
+  for (uint32_t i = 0; i < Simple::VM::kJitTier1Threshold + 2; ++i) {
+    call_f1(entry, 2);
+    AppendU8(entry, static_cast<uint8_t>(OpCode::Pop));
+  }
+  if (deep) {
+    call_f1(entry, static_cast<int32_t>(kChain - 1));
+    AppendU8(entry, static_cast<uint8_t>(OpCode::Pop));
+  }
+  for (uint32_t i = 0; i < 4; ++i) {
+    call_f1(entry, 2);
+    AppendU8(entry, static_cast<uint8_t>(OpCode::Pop));
+  }
+  call_f1(entry, 5);
+  AppendU8(entry, static_cast<uint8_t>(OpCode::Ret));
+
+  std::vector<std::vector<uint8_t>> funcs{entry};
+  std::vector<uint16_t> locals{0};
+  std::vector<uint32_t> sig_ids{0};
+  for (uint32_t id = 1; id <= kChain; ++id) {
+    std::vector<uint8_t> link;
+    AppendU8(link, static_cast<uint8_t>(OpCode::Enter));
+    AppendU16(link, kLinkLocals);
+    if (id < kChain) {
+      AppendU8(link, static_cast<uint8_t>(OpCode::LoadLocal));
+      AppendU32(link, 0);
+      AppendU8(link, static_cast<uint8_t>(OpCode::ConstI32));
+      AppendI32(link, 0);
+      AppendU8(link, static_cast<uint8_t>(OpCode::CmpNeI32));
+      AppendU8(link, static_cast<uint8_t>(OpCode::JmpFalse));
+      size_t jmp_base_offset = link.size();
+      AppendI32(link, 0);
+      AppendU8(link, static_cast<uint8_t>(OpCode::LoadLocal));
+      AppendU32(link, 0);
+      AppendU8(link, static_cast<uint8_t>(OpCode::ConstI32));
+      AppendI32(link, 1);
+      AppendU8(link, static_cast<uint8_t>(OpCode::SubI32));
+      AppendU8(link, static_cast<uint8_t>(OpCode::Call));
+      AppendU32(link, id + 1);
+      AppendU8(link, 1);
+      AppendU8(link, static_cast<uint8_t>(OpCode::ConstI32));
+      AppendI32(link, 1);
+      AppendU8(link, static_cast<uint8_t>(OpCode::AddI32));
+      AppendU8(link, static_cast<uint8_t>(OpCode::Ret));
+      int32_t base_rel = static_cast<int32_t>(link.size()) - static_cast<int32_t>(jmp_base_offset + 4);
+      WriteU32(link, jmp_base_offset, static_cast<uint32_t>(base_rel));
+    }
+    AppendU8(link, static_cast<uint8_t>(OpCode::ConstI32));
+    AppendI32(link, 0);
+    AppendU8(link, static_cast<uint8_t>(OpCode::Ret));
+    funcs.push_back(std::move(link));
+    locals.push_back(kLinkLocals);
+    sig_ids.push_back(1);
+  }
+  SigSpec entry_sig{0, 0, {}};
+  SigSpec link_sig{0, 1, {0}};
+  return BuildModuleWithFunctionsAndSigs(funcs, locals, sig_ids, {entry_sig, link_sig});
+}
+
 std::vector<uint8_t> BuildJitCompiledCallModule() {
   using Simple::Byte::OpCode;
   std::vector<uint8_t> entry;
@@ -5229,6 +5364,212 @@ bool RunJitDifferentialTest() {
   return true;
 }
 
+bool RunJitNativeDifferentialTest() {
+  struct EnvGuard {
+    std::string name;
+    explicit EnvGuard(std::string name) : name(std::move(name)) {}
+    ~EnvGuard() { UnsetEnvVar(name); }
+  };
+  struct NativeCase {
+    const char* name;
+    std::vector<uint8_t> (*build)();
+  };
+  const NativeCase cases[] = {
+    {"i32_arith", BuildJitCompiledI32ArithmeticModule},
+    {"scalar_i32", BuildJitCompiledScalarI32Module},
+    {"i64_u64", BuildJitCompiledI64U64Module},
+    {"float_ops", BuildJitCompiledFloatOpsModule},
+    {"conversions", BuildJitCompiledConversionsModule},
+    {"compare_scalar", BuildJitCompiledCompareScalarModule},
+    {"loop", BuildJitCompiledLoopModule},
+    {"call", BuildJitCompiledCallModule},
+    {"bool_ops", BuildJitCompiledBoolOpsModule},
+    {"tier1_fallback", BuildJitTier1FallbackModule},
+  };
+  SetEnvVar("SIMPLE_JIT_NATIVE_THRESHOLD", "1");
+  EnvGuard threshold_guard("SIMPLE_JIT_NATIVE_THRESHOLD");
+  uint64_t native_execs = 0;
+  for (const auto& test_case : cases) {
+    std::vector<uint8_t> module_bytes = test_case.build();
+    Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+    if (!load.ok) {
+      std::cerr << test_case.name << " load failed: " << load.error << "\n";
+      return false;
+    }
+    Simple::VM::ExecResult exec_native = Simple::VM::ExecuteModule(load.module, true, true);
+    Simple::VM::ExecResult exec_bytecode;
+    {
+      SetEnvVar("SIMPLE_JIT_NATIVE", "0");
+      EnvGuard guard("SIMPLE_JIT_NATIVE");
+      exec_bytecode = Simple::VM::ExecuteModule(load.module, true, true);
+    }
+    if (exec_native.status != exec_bytecode.status || exec_native.exit_code != exec_bytecode.exit_code) {
+      std::cerr << test_case.name << " native diff exit code: " << exec_native.exit_code << " vs "
+                << exec_bytecode.exit_code << "\n";
+      return false;
+    }
+    if (exec_native.call_counts != exec_bytecode.call_counts ||
+        exec_native.jit_tiers != exec_bytecode.jit_tiers ||
+        exec_native.jit_compiled_exec_counts != exec_bytecode.jit_compiled_exec_counts ||
+        exec_native.jit_tier1_exec_counts != exec_bytecode.jit_tier1_exec_counts) {
+      std::cerr << test_case.name << " native diff jit counters\n";
+      return false;
+    }
+    for (uint32_t count : exec_bytecode.jit_native_exec_counts) {
+      if (count != 0) {
+        std::cerr << test_case.name << " expected no native execs with SIMPLE_JIT_NATIVE=0\n";
+        return false;
+      }
+    }
+    for (uint32_t count : exec_native.jit_native_exec_counts) native_execs += count;
+  }
+  if (SIMPLEVM_NATIVE_JIT && native_execs == 0) {
+    std::cerr << "expected native code to run\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunJitNativeTransientBailTest() {
+  struct EnvGuard {
+    std::string name;
+    explicit EnvGuard(std::string name) : name(std::move(name)) {}
+    ~EnvGuard() { UnsetEnvVar(name); }
+  };
+  SetEnvVar("SIMPLE_JIT_NATIVE_THRESHOLD", "1");
+  EnvGuard threshold_guard("SIMPLE_JIT_NATIVE_THRESHOLD");
+  auto run = [](bool deep, bool native, Simple::VM::ExecResult* out) -> bool {
+    std::vector<uint8_t> module_bytes = BuildJitNativeTransientBailModule(deep);
+    Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+    if (!load.ok) {
+      std::cerr << "load failed: " << load.error << "\n";
+      return false;
+    }
+    if (!native) SetEnvVar("SIMPLE_JIT_NATIVE", "0");
+    *out = Simple::VM::ExecuteModule(load.module, true, true);
+    if (!native) UnsetEnvVar("SIMPLE_JIT_NATIVE");
+    if (out->status != Simple::VM::ExecStatus::Halted || out->exit_code != 5) {
+      std::cerr << "expected exit 5, got status " << static_cast<int>(out->status) << " exit "
+                << out->exit_code << " " << out->error << "\n";
+      return false;
+    }
+    return true;
+  };
+  Simple::VM::ExecResult shallow;
+  Simple::VM::ExecResult deep_native;
+  Simple::VM::ExecResult deep_bytecode;
+  if (!run(false, true, &shallow) || !run(true, true, &deep_native) || !run(true, false, &deep_bytecode)) {
+    return false;
+  }
+  // The bailed call reruns on bytecode; native calls made before the bail
+  // must not be counted on top of the rerun.
+  if (deep_native.call_counts != deep_bytecode.call_counts ||
+      deep_native.jit_tiers != deep_bytecode.jit_tiers ||
+      deep_native.jit_compiled_exec_counts != deep_bytecode.jit_compiled_exec_counts ||
+      deep_native.jit_tier1_exec_counts != deep_bytecode.jit_tier1_exec_counts) {
+    std::cerr << "native bail changed jit counters\n";
+    return false;
+  }
+  if (!SIMPLEVM_NATIVE_JIT) return true;
+  // f1 keeps its native code after the bail: every other f1 call still runs
+  // natively, exactly as in the run without the deep call.
+  if (shallow.jit_native_exec_counts.size() < 2 || deep_native.jit_native_exec_counts.size() < 2) return false;
+  if (shallow.jit_native_exec_counts[1] == 0 ||
+      deep_native.jit_native_exec_counts[1] != shallow.jit_native_exec_counts[1]) {
+    std::cerr << "expected f1 native execs " << shallow.jit_native_exec_counts[1] << ", got "
+              << deep_native.jit_native_exec_counts[1] << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool RunJitIrOptimizeTest() {
+  using Simple::Byte::OpCode;
+  auto lower = [](const std::vector<uint8_t>& code, Simple::VM::IrFunction* ir) {
+    std::vector<uint8_t> module_bytes = BuildModuleWithFunctions({code}, {1});
+    Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+    if (!load.ok) {
+      std::cerr << "load failed: " << load.error << "\n";
+      return false;
+    }
+    std::string error;
+    if (!Simple::VM::LowerFunctionToIr(load.module, 0, nullptr, nullptr, ir, &error)) {
+      std::cerr << "lower failed: " << error << "\n";
+      return false;
+    }
+    Simple::VM::OptimizeIr(*ir);
+    return true;
+  };
+  auto count_kind = [](const Simple::VM::IrFunction& ir, Simple::VM::IrKind kind) {
+    size_t count = 0;
+    for (const auto& block : ir.blocks) {
+      for (const auto& inst : block.insts) {
+        if (inst.kind == kind) count += 1;
+      }
+    }
+    return count;
+  };
+
+  // (2 + 3) stored to a local, then local * local: folds to a constant return.
+  std::vector<uint8_t> folded;
+  AppendU8(folded, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(folded, 1);
+  AppendU8(folded, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(folded, 2);
+  AppendU8(folded, static_cast<uint8_t>(OpCode::ConstI32));
+  AppendI32(folded, 3);
+  AppendU8(folded, static_cast<uint8_t>(OpCode::AddI32));
+  AppendU8(folded, static_cast<uint8_t>(OpCode::StoreLocal));
+  AppendU32(folded, 0);
+  AppendU8(folded, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(folded, 0);
+  AppendU8(folded, static_cast<uint8_t>(OpCode::LoadLocal));
+  AppendU32(folded, 0);
+  AppendU8(folded, static_cast<uint8_t>(OpCode::MulI32));
+  AppendU8(folded, static_cast<uint8_t>(OpCode::Ret));
+  Simple::VM::IrFunction ir;
+  if (!lower(folded, &ir)) return false;
+  if (count_kind(ir, Simple::VM::IrKind::Binary) != 0 || count_kind(ir, Simple::VM::IrKind::Move) != 0) {
+    std::cerr << "expected arithmetic and local moves to fold away\n";
+    return false;
+  }
+  bool found_ret = false;
+  for (const auto& block : ir.blocks) {
+    for (const auto& inst : block.insts) {
+      if (inst.kind != Simple::VM::IrKind::Ret) continue;
+      for (const auto& def : block.insts) {
+        if (def.kind == Simple::VM::IrKind::Const && def.dst == inst.a && def.imm == 25) found_ret = true;
+      }
+    }
+  }
+  if (!found_ret) {
+    std::cerr << "expected Ret of constant 25\n";
+    return false;
+  }
+
+  // (x + 7) * (x + 7): the second add is a common subexpression.
+  std::vector<uint8_t> cse;
+  AppendU8(cse, static_cast<uint8_t>(OpCode::Enter));
+  AppendU16(cse, 1);
+  for (int i = 0; i < 2; ++i) {
+    AppendU8(cse, static_cast<uint8_t>(OpCode::LoadLocal));
+    AppendU32(cse, 0);
+    AppendU8(cse, static_cast<uint8_t>(OpCode::ConstI32));
+    AppendI32(cse, 7);
+    AppendU8(cse, static_cast<uint8_t>(OpCode::AddI32));
+  }
+  AppendU8(cse, static_cast<uint8_t>(OpCode::MulI32));
+  AppendU8(cse, static_cast<uint8_t>(OpCode::Ret));
+  Simple::VM::IrFunction ir_cse;
+  if (!lower(cse, &ir_cse)) return false;
+  if (count_kind(ir_cse, Simple::VM::IrKind::Binary) != 2) {
+    std::cerr << "expected CSE to leave one add and one mul, got "
+              << count_kind(ir_cse, Simple::VM::IrKind::Binary) << "\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunJitDifferentialBranchTest() {
   std::vector<uint8_t> module_bytes = BuildJitCompiledBranchModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -6416,6 +6757,32 @@ bool RunJitCompiledArrayOpsTest() {
   return true;
 }
 
+bool RunJitCompiledArrayGetByteArrayTest() {
+  std::vector<uint8_t> module_bytes = BuildJitCompiledArrayGetByteArrayModule();
+  Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
+  if (!load.ok) {
+    std::cerr << "load failed: " << load.error << "\n";
+    return false;
+  }
+  Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(load.module);
+  if (!vr.ok) {
+    std::cerr << "verify failed: " << vr.error << "\n";
+    return false;
+  }
+  Simple::VM::ExecResult exec = Simple::VM::ExecuteModule(load.module);
+  if (exec.status != Simple::VM::ExecStatus::Trapped) {
+    std::cerr << "expected trap, got status " << static_cast<int>(exec.status) << "\n";
+    return false;
+  }
+  // Compiled code bails on the byte array and the interpreter re-runs the
+  // call and traps; without the check it would read past the payload.
+  if (exec.error.find("byte array") == std::string::npos) {
+    std::cerr << "expected byte array trap, got: " << exec.error << "\n";
+    return false;
+  }
+  return true;
+}
+
 bool RunJitCompiledListOpsTest() {
   std::vector<uint8_t> module_bytes = BuildJitCompiledListOpsModule();
   Simple::Byte::LoadResult load = Simple::Byte::LoadModuleFromBytes(module_bytes);
@@ -7867,6 +8234,7 @@ static const TestCase kJitTests[] = {
   {"jit_compiled_ref_ops", RunJitCompiledRefOpsTest},
   {"jit_compiled_ref_ops_no_stack_map", RunJitCompiledRefOpsNoStackMapTest},
   {"jit_compiled_array_ops", RunJitCompiledArrayOpsTest},
+  {"jit_compiled_array_get_byte_array", RunJitCompiledArrayGetByteArrayTest},
   {"jit_compiled_list_ops", RunJitCompiledListOpsTest},
   {"jit_compiled_string_len", RunJitCompiledStringLenTest},
   {"jit_compiled_call", RunJitCompiledCallTest},
@@ -7886,6 +8254,9 @@ static const TestCase kJitTests[] = {
   {"jit_diff_bool", RunJitDifferentialCompareBoolTest},
   {"jit_diff_indirect", RunJitDifferentialIndirectTest},
   {"jit_diff_tailcall", RunJitDifferentialTailCallTest},
+  {"jit_native_diff", RunJitNativeDifferentialTest},
+  {"jit_native_transient_bail", RunJitNativeTransientBailTest},
+  {"jit_ir_optimize", RunJitIrOptimizeTest},
   {"jit_tier1_exec_count", RunJitTier1ExecCountTest},
   {"jit_tier1_skip_nop", RunJitTier1SkipNopTest},
   {"jit_opcode_hot_loop", RunJitOpcodeHotLoopTest},
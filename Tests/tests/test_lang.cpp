@@ -3,6 +3,7 @@
 #include "lang_sir.h"
 #include "lang_validate.h"
 #include "ir_lang.h"
+#include "intrinsic_ids.h"
 #include "ir_compiler.h"
 #include "simple_runner.h"
 #include "test_utils.h"
@@ -13,6 +14,7 @@
 #include <unordered_map>
 #include <vector>
 #include <cstdlib>
+#include <cstdio>
 #include <iostream>
 #ifndef _WIN32
 #include <sys/wait.h>
@@ -290,6 +292,10 @@ bool LangSimpleFixtureCoreDlOpenGlobal() {
   return RunSimpleFileExpectExit("Tests/simple/core_dl_open_global.simple", 1);
 }
 
+bool LangSimpleFixtureCoreDlCallRepeat() {
+  return RunSimpleFileExpectExit("Tests/simple/core_dl_call_repeat.simple", 1);
+}
+
 bool LangSimpleFixtureFloatLiteralContext() {
   return RunSimpleFileExpectExit("Tests/simple/float_literal_context.simple", 0);
 }
@@ -850,6 +856,12 @@ bool LangSimpleBadIndexNonIntExpr() {
       "index");
 }
 
+bool LangSimpleBadDlCallStringTooLarge() {
+  return Simple::VM::Tests::RunSimpleFileExpectTrap(
+      "Tests/simple_bad/dl_call_string_too_large.simple",
+      "core.dl.call string arguments too large");
+}
+
 bool LangSimpleBadIndexNegative() {
   return Simple::VM::Tests::RunSimpleFileExpectTrap(
       "Tests/simple_bad/index_negative.simple",
@@ -1087,6 +1099,31 @@ bool LangSirEmitsIoPrintFormat() {
   return RunSirTextExpectExit(sir, 7);
 }
 
+bool LangSirPrintlnFoldsNewline() {
+  const char* src =
+      "main : i32 () { x : i32 = 7; IO.println(\"value={}!\", x); IO.println(\"done\"); return x; }";
+  std::string sir;
+  std::string error;
+  if (!Simple::Lang::EmitSirFromString(src, &sir, &error)) return false;
+  if (sir.find("\"value={}!\\n\"") == std::string::npos) return false;
+  if (sir.find("print.fmt") == std::string::npos) return false;
+  if (sir.find("\"done\\n\"") == std::string::npos) return false;
+  if (sir.find("\"\\n\"") != std::string::npos) return false;
+  return RunSirTextExpectExit(sir, 7);
+}
+
+bool LangSirPrintFormatSingleDispatch() {
+  const char* src =
+      "main : i32 () { x : i32 = 7; y : f64 = 2.5; s : string = \"s\"; "
+      "IO.println(\"a {} b {} c {}\", x, y, s); return x; }";
+  std::string sir;
+  std::string error;
+  if (!Simple::Lang::EmitSirFromString(src, &sir, &error)) return false;
+  if (sir.find("print.fmt") == std::string::npos) return false;
+  if (sir.find("intrinsic " + std::to_string(Simple::VM::kIntrinsicPrintAny)) != std::string::npos) return false;
+  return RunSirTextExpectExit(sir, 7);
+}
+
 bool LangSirEmitsExternAbiFlatten() {
   const char* src =
       "Tex :: Artifact { id : u32; width : i32; }\n"
@@ -1261,6 +1298,73 @@ bool LangSirEmitsArrayAssign() {
   return RunSirTextExpectExit(sir, 7);
 }
 
+bool LangSirRefListSurvivesMinorGc() {
+  // The boxes are reachable only through the list and the array while the
+  // junk loop fills the nursery several times over.
+  const char* src =
+      "Box :: Artifact { v : i32 }\n"
+      "main : i32 () {\n"
+      "  boxes : Box[] = []\n"
+      "  for (i : i32 = 1; i <= 7; i += 1) {\n"
+      "    b : Box = { .v = i }\n"
+      "    boxes.push(b)\n"
+      "  }\n"
+      "  fixed : Box{2} = {{ .v = 10 }, { .v = 20 }}\n"
+      "  for (j : i32 = 0; j < 100000; j += 1) {\n"
+      "    junk : Box = { .v = j }\n"
+      "  }\n"
+      "  sum : i32 = 0\n"
+      "  for (k : i32 = 0; k < len(boxes); k += 1) {\n"
+      "    sum = sum + boxes[k].v\n"
+      "  }\n"
+      "  return sum + fixed[0].v + fixed[1].v\n"
+      "}\n";
+  std::string sir;
+  std::string error;
+  if (!Simple::Lang::EmitSirFromString(src, &sir, &error)) return false;
+  return RunSirTextExpectExit(sir, 58);
+}
+
+bool LangSirEmitsByteArrayOps() {
+  const char* src =
+      "main : i32 () { values : u8{3} = {1, 2, 250}; values[0] = 40; values[1] = 7; "
+      "return @i32(values[0]) + @i32(values[1]) + @i32(values[2]) + len(values); }";
+  std::string sir;
+  std::string error;
+  if (!Simple::Lang::EmitSirFromString(src, &sir, &error)) return false;
+  if (sir.find("newarray.u8") == std::string::npos) return false;
+  if (sir.find("array.get.u8") == std::string::npos) return false;
+  if (sir.find("array.set.u8") == std::string::npos) return false;
+  if (sir.find("array.set.i32") != std::string::npos) return false;
+  return RunSirTextExpectExit(sir, 300);
+}
+
+bool LangSirFileReadWriteByteArray() {
+  const std::string path = TempPath("simple_lang_file_bytes.bin");
+  std::string src =
+      "import system.file as File\n"
+      "main : i32 () {\n"
+      "  out : u8{4} = {7, 8, 9, 200}\n"
+      "  fd : i32 = File.open(\"" + path + "\", 1)\n"
+      "  if (File.write(fd, out, 4) != 4) { return 1 }\n"
+      "  File.close(fd)\n"
+      "  back : u8{4} = {0, 0, 0, 0}\n"
+      "  fd = File.open(\"" + path + "\", 0)\n"
+      "  if (File.read(fd, back, 4) != 4) { return 2 }\n"
+      "  File.close(fd)\n"
+      "  return @i32(back[0]) + @i32(back[1]) + @i32(back[2]) + @i32(back[3])\n"
+      "}\n";
+  std::string sir;
+  std::string error;
+  if (!Simple::Lang::EmitSirFromString(src, &sir, &error)) {
+    std::cerr << "emit failed: " << error << "\n";
+    return false;
+  }
+  bool ok = RunSirTextExpectExit(sir, 224);
+  std::remove(path.c_str());
+  return ok;
+}
+
 bool LangSirEmitsListLiteralIndex() {
   const char* src = "main : i32 () { values : i32[] = [1, 2, 3]; return values[2]; }";
   std::string sir;
@@ -3650,6 +3754,8 @@ const TestCase kLangTests[] = {
   {"lang_sir_emit_io_print_i32", LangSirEmitsIoPrintI32},
   {"lang_sir_emit_io_print_newline", LangSirEmitsIoPrintNewline},
   {"lang_sir_emit_io_print_format", LangSirEmitsIoPrintFormat},
+  {"lang_sir_println_folds_newline", LangSirPrintlnFoldsNewline},
+  {"lang_sir_print_format_single_dispatch", LangSirPrintFormatSingleDispatch},
   {"lang_sir_emit_extern_abi_flatten", LangSirEmitsExternAbiFlatten},
   {"lang_sir_implicit_main_return", LangSirImplicitMainReturn},
   {"lang_parse_missing_semicolon_same_line", LangParseMissingSemicolonSameLine},
@@ -3698,6 +3804,7 @@ const TestCase kLangTests[] = {
   {"lang_simple_fixture_extern_core_os_args_count", LangSimpleFixtureExternCoreOsArgsCount},
   {"lang_simple_fixture_core_dl_open", LangSimpleFixtureCoreDlOpen},
   {"lang_simple_fixture_core_dl_open_global", LangSimpleFixtureCoreDlOpenGlobal},
+  {"lang_simple_fixture_core_dl_call_repeat", LangSimpleFixtureCoreDlCallRepeat},
   {"lang_simple_fixture_float_literal_context", LangSimpleFixtureFloatLiteralContext},
   {"lang_simple_fixture_reserved_math", LangSimpleFixtureReservedMath},
   {"lang_simple_fixture_reserved_math_pi", LangSimpleFixtureReservedMathPi},
@@ -3763,6 +3870,7 @@ const TestCase kLangTests[] = {
   {"lang_simple_bad_extern_call_arg_count", LangSimpleBadExternCallArgCount},
   {"lang_simple_bad_call_arg_type_mismatch", LangSimpleBadCallArgTypeMismatch},
   {"lang_simple_bad_index_non_int_expr", LangSimpleBadIndexNonIntExpr},
+  {"lang_simple_bad_dl_call_string_too_large", LangSimpleBadDlCallStringTooLarge},
   {"lang_simple_bad_index_negative", LangSimpleBadIndexNegative},
   {"lang_simple_bad_index_oob", LangSimpleBadIndexOutOfBounds},
   {"lang_simple_bad_for_range_missing_end", LangSimpleBadForRangeMissingEnd},
@@ -3794,6 +3902,9 @@ const TestCase kLangTests[] = {
   {"lang_sir_emit_member_inc_dec", LangSirEmitsMemberIncDec},
   {"lang_sir_emit_array_literal_index", LangSirEmitsArrayLiteralIndex},
   {"lang_sir_emit_array_assign", LangSirEmitsArrayAssign},
+  {"lang_sir_ref_list_survives_minor_gc", LangSirRefListSurvivesMinorGc},
+  {"lang_sir_emit_byte_array_ops", LangSirEmitsByteArrayOps},
+  {"lang_sir_file_read_write_byte_array", LangSirFileReadWriteByteArray},
   {"lang_sir_emit_list_literal_index", LangSirEmitsListLiteralIndex},
   {"lang_sir_emit_list_assign", LangSirEmitsListAssign},
   {"lang_sir_emit_len", LangSirEmitsLen},
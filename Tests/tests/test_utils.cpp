@@ -41,7 +41,7 @@ void UnsetEnvVar(const std::string& name) {
 #endif
 }
 
-void WriteU32Payload(std::vector<uint8_t>& payload, size_t offset, uint32_t value) {
+void WriteU32Payload(Simple::VM::Payload& payload, size_t offset, uint32_t value) {
   payload[offset + 0] = static_cast<uint8_t>(value & 0xFF);
   payload[offset + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
   payload[offset + 2] = static_cast<uint8_t>((value >> 16) & 0xFF);
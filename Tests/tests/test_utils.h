@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#include "heap.h"
+
 namespace Simple::VM::Tests {
 
 struct TestCase {
@@ -25,7 +27,7 @@ struct TestResult {
 void SetEnvVar(const std::string& name, const std::string& value);
 void UnsetEnvVar(const std::string& name);
 
-void WriteU32Payload(std::vector<uint8_t>& payload, size_t offset, uint32_t value);
+void WriteU32Payload(Simple::VM::Payload& payload, size_t offset, uint32_t value);
 void AppendF32(std::vector<uint8_t>& out, float v);
 void AppendF64(std::vector<uint8_t>& out, double v);
 void AppendConstBlob(std::vector<uint8_t>& pool, uint32_t kind, const std::vector<uint8_t>& blob, uint32_t* out_const_id);
@@ -0,0 +1,67 @@
+#ifndef SIMPLE_VM_DECODED_CODE_H
+#define SIMPLE_VM_DECODED_CODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simple_api.h"
+#include "sbc_types.h"
+
+namespace Simple::VM {
+
+constexpr uint32_t kNoDecodedInst = 0xFFFFFFFFu;
+constexpr uint16_t kDecodedEnd = 0x1u;        // run sentinel; pc is the run end offset
+constexpr uint16_t kDecodedTruncated = 0x2u;  // operands ran past the end of code
+
+// Fixed-width form of one SBC instruction. Operands are read out of
+// module.code once so the interpreter never re-parses bytes.
+//   a     first operand, zero-extended (JMP/JMP_TRUE/JMP_FALSE: absolute target pc)
+//   b     second u32 operand (NEW_ARRAY*/NEW_LIST* length, LINE column,
+//         JMP_TABLE default rel, JMP*: index of the target instruction,
+//         CALL_INDIRECT: inline cache index, assigned on first closure call)
+//   imm8  trailing u8 operand (CALL*/TAILCALL arg count, NEW_CLOSURE upvalue count)
+struct DecodedInst {
+  uint8_t opcode = 0;
+  uint8_t imm8 = 0;
+  uint16_t flags = 0;
+  uint32_t pc = 0;
+  uint32_t next_pc = 0;
+  uint32_t b = 0;
+  uint64_t a = 0;
+};
+
+// Decoded instructions are stored as runs, one per function, each followed by
+// a kDecodedEnd sentinel, so straight-line execution is `++ip`.
+struct DecodedCode {
+  std::vector<DecodedInst> insts;
+  // Code offset -> index into insts, kNoDecodedInst for offsets that are not
+  // an instruction boundary of some run.
+  std::vector<uint32_t> pc_index;
+
+  const DecodedInst* At(size_t pc) const {
+    if (pc >= pc_index.size()) return nullptr;
+    uint32_t index = pc_index[pc];
+    if (index == kNoDecodedInst) return nullptr;
+    return &insts[index];
+  }
+
+  // Like At, but decodes a fresh run from pc to end when pc is not a known
+  // boundary (a jump into the middle of unverified code). May grow insts.
+  SIMPLEVM_API const DecodedInst* Resolve(const std::vector<uint8_t>& code, size_t pc, size_t end);
+};
+
+// Decodes the instruction at pc. Unknown opcodes decode with no operands so
+// the interpreter can trap on them; returns false if operands run past code.
+SIMPLEVM_API bool DecodeInstruction(const std::vector<uint8_t>& code, size_t pc, DecodedInst* out);
+SIMPLEVM_API DecodedCode DecodeModuleCode(const Simple::Byte::SbcModule& module);
+
+// Rewrites the head record of common opcode sequences to a superinstruction
+// (OpCode::AddLocalsI32 etc.). Only the head's opcode changes: its handler
+// reads the remaining operands from the records that follow and skips them,
+// and a jump into the middle of a fused sequence still runs the originals.
+SIMPLEVM_API void FuseSuperinstructions(DecodedCode* code);
+
+} // namespace Simple::VM
+
+#endif // SIMPLE_VM_DECODED_CODE_H
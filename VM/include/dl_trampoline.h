@@ -0,0 +1,61 @@
+#ifndef SIMPLE_VM_DL_TRAMPOLINE_H
+#define SIMPLE_VM_DL_TRAMPOLINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace Simple::VM {
+
+// Direct-call trampolines for core.dl calls whose arguments and return are
+// all scalars: a statically typed call through the function pointer instead
+// of ffi_call. Values travel as 64-bit words of one of four ABI classes;
+// integers up to 32 bits widen to int32_t, 64-bit integers and pointers are
+// int64_t, and floats keep their own class. Every combination of up to
+// kDlTrampolineMaxArgs arguments is generated at compile time; struct
+// arguments and longer signatures go through libffi.
+constexpr std::size_t kDlTrampolineMaxArgs = 4;
+
+enum class DlWordClass : uint8_t { I32, I64, F32, F64, None };
+
+using DlTrampoline = void (*)(void* fn, const uint64_t* words, uint64_t* ret);
+
+// ret_class None means a void return. Returns null when arity is over
+// kDlTrampolineMaxArgs or an argument class is None.
+DlTrampoline LookupDlTrampoline(DlWordClass ret_class, const DlWordClass* arg_classes, std::size_t arity);
+
+template <typename T>
+T DlFromWord(uint64_t word) {
+  if constexpr (std::is_same_v<T, float>) {
+    uint32_t bits = static_cast<uint32_t>(word);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  } else if constexpr (std::is_same_v<T, double>) {
+    double value;
+    std::memcpy(&value, &word, sizeof(value));
+    return value;
+  } else {
+    return static_cast<T>(word);
+  }
+}
+
+template <typename T>
+uint64_t DlToWord(T value) {
+  if constexpr (std::is_same_v<T, float>) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  } else if constexpr (std::is_same_v<T, double>) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  } else {
+    return static_cast<uint64_t>(value);
+  }
+}
+
+} // namespace Simple::VM
+
+#endif // SIMPLE_VM_DL_TRAMPOLINE_H
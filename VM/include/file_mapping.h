@@ -0,0 +1,44 @@
+#ifndef SIMPLE_VM_FILE_MAPPING_H
+#define SIMPLE_VM_FILE_MAPPING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Simple::VM {
+
+// A whole file mapped read-only or copy-on-write (core.fs.mmap), laid out to
+// back a heap byte array in place: the file bytes follow an anonymous header
+// page whose last 4 bytes hold the length, so Payload() is exactly the
+// [u32 length][bytes] payload of a NEW_ARRAY_U8 array. Nothing is copied;
+// pages are read in by the OS as they are touched.
+class FileMapping {
+ public:
+  // Array indices are i32.
+  static constexpr uint64_t kMaxLength = 0x7FFFFFFFu;
+
+  FileMapping() = default;
+  FileMapping(FileMapping&& other) noexcept;
+  FileMapping& operator=(FileMapping&& other) noexcept;
+  FileMapping(const FileMapping&) = delete;
+  FileMapping& operator=(const FileMapping&) = delete;
+  ~FileMapping() { Unmap(); }
+
+  // False, leaving nothing mapped, when the file cannot be opened or mapped,
+  // is longer than kMaxLength, or the platform has no mmap.
+  bool Map(const std::string& path, bool copy_on_write);
+  void Unmap();
+
+  bool Mapped() const { return base_ != nullptr; }
+  uint8_t* Payload() const { return base_ ? base_ + header_bytes_ - 4 : nullptr; }
+  uint32_t PayloadSize() const { return 4u + length_; }
+
+ private:
+  uint8_t* base_ = nullptr;
+  std::size_t header_bytes_ = 0;
+  uint32_t length_ = 0;
+};
+
+} // namespace Simple::VM
+
+#endif // SIMPLE_VM_FILE_MAPPING_H
@@ -1,7 +1,12 @@
 #ifndef SIMPLE_VM_HEAP_H
 #define SIMPLE_VM_HEAP_H
 
+#include <cstddef>
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace Simple::VM {
@@ -15,30 +20,295 @@ enum class ObjectKind : uint8_t {
 };
 
 struct ObjHeader {
-  ObjectKind kind;
   uint32_t size;
   uint32_t type_id;
+  ObjectKind kind;
   uint8_t marked;
-  uint8_t alive;
+  // Tri-color state of an incremental major collection (Heap::kWhite...).
+  uint8_t color;
+  uint8_t young;
+  // Array/list elements are handles (NEW_ARRAY_REF, NEW_LIST_REF, or a ref
+  // element type id); on a string, it is a rope or slice referring to other
+  // strings.
+  uint8_t ref_elements;
+  // Array elements are single bytes (NEW_ARRAY_U8), so the payload after the
+  // length can be handed to fread/fwrite as is.
+  uint8_t byte_elements;
+  // The payload is memory the VM owns outside the heap (a core.fs.mmap
+  // mapping): never copied, resized or freed here.
+  uint8_t external;
+  // Stores into the elements trap (a read-only mapping).
+  uint8_t read_only;
+};
+
+// String payload: [u32 length][u32 hash][u8 encoding][3 bytes pad] followed
+// by the code units, one byte each when they all fit Latin-1 and two
+// otherwise. A rope holds the handles of its left and right halves after the
+// header instead of units, and a slice the handle of a flat parent and the
+// offset of its first unit there. The hash is filled in on first use; 0
+// means not yet computed.
+enum class StringEncoding : uint8_t {
+  Latin1,
+  Utf16,
+  Rope,
+  Slice,
+};
+
+constexpr uint32_t kStringHashOffset = 4;
+constexpr uint32_t kStringEncodingOffset = 8;
+constexpr uint32_t kStringDataOffset = 12;
+
+// Bytes of one heap object. They normally sit inline right after the
+// object's HeapObject record; a payload that outgrows that space (list
+// growth) moves to a block of its own while the record stays put.
+class Payload {
+ public:
+  uint8_t* data() { return data_; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  uint8_t& operator[](size_t index) { return data_[index]; }
+  const uint8_t& operator[](size_t index) const { return data_[index]; }
+  uint8_t* begin() { return data_; }
+  uint8_t* end() { return data_ + size_; }
+  const uint8_t* begin() const { return data_; }
+  const uint8_t* end() const { return data_ + size_; }
+
+ private:
+  friend class Heap;
+  uint8_t* data_ = nullptr;
+  uint32_t size_ = 0;
+  uint32_t capacity_ = 0;
+  uint32_t inline_capacity_ = 0;
 };
 
 struct HeapObject {
   ObjHeader header;
-  std::vector<uint8_t> payload;
+  Payload payload;
+};
+
+// Byte offsets of the ref-typed fields of each artifact type, indexed by
+// type_id; built from the module's TypeRow/FieldRow tables. ref_types marks
+// the type ids that are refs themselves, so a NEW_ARRAY/NEW_LIST naming one
+// as its element type gets traced elements.
+struct TypeRefMaps {
+  std::vector<std::vector<uint32_t>> field_offsets;
+  std::vector<uint8_t> ref_types;
+
+  bool IsRefType(uint32_t type_id) const { return type_id < ref_types.size() && ref_types[type_id] != 0; }
+};
+
+// Collection tuning. A minor collection is requested once the nursery is 3/4
+// full; a major one once old space exceeds its limit, which each major
+// collection resets to growth_percent of the surviving bytes (at least
+// min_old_bytes). max_heap_bytes caps nursery plus old space; 0 is unlimited.
+struct GcPolicy {
+  size_t nursery_bytes = 256 * 1024;
+  uint32_t growth_percent = 200;
+  size_t min_old_bytes = 4 * 1024 * 1024;
+  size_t max_heap_bytes = 0;
+  // Run major collections incrementally: after a short root-snapshot pause,
+  // each safepoint marks or sweeps up to slice_work objects.
+  bool incremental = false;
+  uint32_t slice_work = 4096;
 };
 
+// Totals since the heap was created. Byte counts are block sizes, so they
+// include object records and size-class rounding.
+struct GcStats {
+  uint64_t minor_collections = 0;
+  uint64_t major_collections = 0;
+  uint64_t pause_ns_total = 0;
+  uint64_t pause_ns_max = 0;
+  uint64_t bytes_allocated = 0;
+  uint64_t bytes_freed = 0;
+  // Highest nursery plus old-space bytes in use at any point.
+  uint64_t peak_live_bytes = 0;
+  // Incremental mark/sweep slices; each also counts as a pause.
+  uint64_t incremental_steps = 0;
+  // Pauses by length: <10us, <100us, <1ms, <10ms, <100ms, longer.
+  std::array<uint64_t, 6> pause_histogram{};
+};
+
+// Generational heap. New objects are bump-allocated in a nursery; a minor
+// collection traces only young objects (roots plus old objects on dirty
+// cards) and evacuates the survivors by copying them into old space. Old
+// space is 64 KiB pages carved by a bump pointer into size-class blocks, each
+// holding a HeapObject record followed by its payload; freed blocks go to
+// per-class free lists and blocks larger than the biggest class are allocated
+// individually. Objects too big for the nursery, or allocated while it is
+// full, go straight to old space.
+//
+// Handles index a table of record pointers, so they stay 32-bit and stable
+// when objects move. A HeapObject pointer is valid until the next collection.
+//
+// Major collections are stop-the-world by default. With
+// GcPolicy::incremental they shade the roots in one pause, then mark and
+// sweep old space in slices between safepoints. The marker is tri-color
+// with a snapshot-at-the-beginning barrier (RecordOverwrite), and objects
+// allocated or promoted meanwhile are black. Minor collections keep running
+// during a cycle; young objects the cycle may still need are shaded before
+// they die.
+//
+// Marking is precise and iterative: closures trace their upvalues, arrays
+// and lists allocated with ref_elements their live elements, artifacts the
+// fields in their type's ref map, ropes their two halves and slices their
+// parent; flat strings and scalar containers hold no refs. The mark stack
+// is explicit, so deep object graphs cannot overflow the native stack.
 class Heap {
  public:
-  uint32_t Allocate(ObjectKind kind, uint32_t type_id, uint32_t size);
+  Heap() = default;
+  Heap(Heap&&) = default;
+  Heap& operator=(Heap&&) = default;
+  Heap(const Heap&) = delete;
+  Heap& operator=(const Heap&) = delete;
+
+  static constexpr uint32_t kNoHandle = 0xFFFFFFFFu;
+
+  // Returns kNoHandle when the object would take the heap past
+  // GcPolicy::max_heap_bytes. A refusal requests a major collection and is
+  // reported once by TakeLimitFailure, so the caller can collect and retry.
+  uint32_t Allocate(ObjectKind kind, uint32_t type_id, uint32_t size, bool ref_elements = false);
+  // An object whose payload is size bytes at data, which the caller keeps
+  // valid until it calls ReleaseExternal or the heap is destroyed.
+  uint32_t AllocateExternal(ObjectKind kind, uint32_t type_id, uint8_t* data, uint32_t size);
+  // Gives an external object a zero-filled payload of its own, so it stays
+  // safe to use once the caller releases the memory.
+  void ReleaseExternal(HeapObject* obj, uint32_t size);
   HeapObject* Get(uint32_t handle);
   const HeapObject* Get(uint32_t handle) const;
+  // Sets obj's payload to size bytes, zero-filling any new bytes. Returns
+  // false, leaving obj unchanged, if growing it would pass the heap limit.
+  bool ResizePayload(HeapObject* obj, uint32_t size);
+
+  // Takes effect for the nursery once it is next empty.
+  void SetPolicy(const GcPolicy& policy);
+  const GcPolicy& Policy() const { return policy_; }
+  const GcStats& Stats() const { return stats_; }
+
+  void SetTypeRefMaps(std::shared_ptr<const TypeRefMaps> maps) { type_refs_ = std::move(maps); }
+
+  // Card-marking write barrier: call after storing value into a ref slot of
+  // owner, so a minor collection sees old-to-young references.
+  void RecordWrite(uint32_t owner, uint32_t value) {
+    if (owner >= objects_.size() || value >= objects_.size()) return;
+    const HeapObject* source = objects_[owner];
+    const HeapObject* target = objects_[value];
+    if (source && target && target->header.young && !source->header.young) {
+      cards_[owner >> kCardShift] = 1;
+    }
+  }
+
+  // Snapshot barrier: call before changing or removing refs held by owner.
+  // While an incremental cycle is marking, owner's current refs are shaded
+  // first so everything reachable when the cycle began still gets marked.
+  void RecordOverwrite(uint32_t owner) {
+    if (phase_ == Phase::Marking) SnapshotRefs(owner);
+  }
+
+  // Set by allocation volume: the nursery filling up requests a minor
+  // collection, old space outgrowing its limit a major one. Also set while an
+  // incremental cycle has work left.
+  bool CollectionPending() const { return minor_pending_ || major_pending_ || phase_ != Phase::Idle; }
+  // True when the pending work needs the roots (a collection); otherwise it
+  // is an incremental slice for Step.
+  bool NeedsRoots() const { return minor_pending_ || (major_pending_ && phase_ == Phase::Idle); }
+  void RequestMajorCollection() { major_pending_ = true; }
+  // True if an Allocate or ResizePayload was refused by max_heap_bytes since
+  // the last call.
+  bool TakeLimitFailure() {
+    const bool failed = limit_failed_;
+    limit_failed_ = false;
+    return failed;
+  }
+  // Makes handle a root of every later collection, for objects that live as
+  // long as the heap (interned constants). It is promoted to old space by the
+  // next minor collection like any survivor.
+  void Pin(uint32_t handle) { pinned_.push_back(handle); }
+  // A collection is BeginCollection, Mark for each root, FinishCollection;
+  // it is major if one was requested, minor otherwise. With an incremental
+  // policy a major one only shades the roots and starts a cycle. ResetMarks/
+  // Sweep always run a stop-the-world major collection, finishing any cycle
+  // in progress first.
+  void BeginCollection();
+  void FinishCollection();
   void Mark(uint32_t handle);
   void Sweep();
   void ResetMarks();
+  // Runs one slice of the incremental cycle in progress, if any.
+  void Step();
+  bool IncrementalActive() const { return phase_ != Phase::Idle; }
+  size_t LiveCount() const;
+
+  static constexpr uint8_t kWhite = 0;
+  static constexpr uint8_t kGray = 1;
+  static constexpr uint8_t kBlack = 2;
+  bool IsYoung(uint32_t handle) const;
+  size_t NurseryBytes() const { return nursery_used_; }
+  size_t OldBytes() const { return old_bytes_; }
 
  private:
-  std::vector<HeapObject> objects_;
+  static constexpr size_t kPageSize = 64 * 1024;
+  static constexpr size_t kSizeClassCount = 22;
+  static constexpr size_t kMaxYoungPayload = 8 * 1024;
+  static constexpr uint32_t kCardShift = 7;  // 128 handles per card
+
+  enum class Phase : uint8_t { Idle, Marking, Sweeping };
+
+  static size_t SizeClassFor(size_t bytes);
+  static size_t SizeClassBytes(size_t size_class);
+  uint8_t* AllocateBlock(size_t bytes, size_t* block_size);
+  bool WithinLimit(size_t bytes);
+  void NoteInUse();
+  void UpdateOldLimit();
+  void FreeBlock(uint8_t* block, size_t block_size);
+  void FreeObject(uint32_t handle);
+  void TraceRefs(const HeapObject* obj);
+  void PushRef(uint32_t handle);
+  void DrainMarkStack();
+  void SweepOld();
+  void EvacuateNursery();
+  template <typename Visit>
+  void ForEachRef(const HeapObject* obj, Visit visit) const;
+  void Shade(uint32_t handle);
+  void SnapshotRefs(uint32_t owner);
+  void StartCollection(bool allow_incremental);
+  void MarkPinned();
+  void CompleteIncremental();
+  void FinishMarking();
+  void FinishSweeping();
+  void RecordPause(uint64_t pause_ns);
+
+  std::vector<HeapObject*> objects_;
   std::vector<uint32_t> free_list_;
+  std::vector<std::unique_ptr<uint8_t[]>> pages_;
+  uint8_t* bump_ = nullptr;
+  uint8_t* bump_end_ = nullptr;
+  std::vector<uint8_t*> free_blocks_[kSizeClassCount];
+  std::unordered_map<uint8_t*, std::unique_ptr<uint8_t[]>> large_blocks_;
+
+  GcPolicy policy_;
+  GcStats stats_;
+  uint64_t pause_start_ns_ = 0;
+  std::unique_ptr<uint8_t[]> nursery_;
+  size_t nursery_size_ = GcPolicy{}.nursery_bytes;
+  size_t nursery_used_ = 0;
+  std::vector<uint32_t> young_;
+  std::vector<uint8_t> cards_;
+  std::vector<uint32_t> mark_stack_;
+  std::vector<uint32_t> pinned_;
+  std::shared_ptr<const TypeRefMaps> type_refs_;
+  size_t old_bytes_ = 0;
+  size_t old_limit_ = GcPolicy{}.min_old_bytes;
+  bool minor_pending_ = false;
+  bool major_pending_ = false;
+  bool limit_failed_ = false;
+  bool minor_ = false;
+  // BeginCollection is starting an incremental cycle: Mark shades roots.
+  bool starting_cycle_ = false;
+  Phase phase_ = Phase::Idle;
+  std::vector<uint32_t> gray_;
+  size_t sweep_cursor_ = 0;
 };
 
 } // namespace Simple::VM
@@ -0,0 +1,57 @@
+#ifndef SIMPLE_VM_HEAP_STRING_H
+#define SIMPLE_VM_HEAP_STRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "heap.h"
+
+namespace Simple::VM {
+
+// Heap strings (payload layout in heap.h). Strings are sequences of UTF-16
+// code units; ones whose units all fit Latin-1 store a byte per unit.
+// Concatenation builds a rope once the result is long enough, so repeated
+// appends cost O(1) each, and a rope is flattened in place the first time
+// its units are indexed. Slicing makes a view into the flat parent rather
+// than copying. Functions taking a handle return Heap::kNoHandle or false
+// when an allocation fails.
+
+// Rope threshold: shorter concatenations are copied flat.
+constexpr uint32_t kMinRopeLength = 64;
+
+uint32_t CreateString(Heap& heap, const std::u16string& text);
+uint32_t CreateLatin1String(Heap& heap, const char* data, std::size_t length);
+inline uint32_t CreateLatin1String(Heap& heap, const std::string& text) {
+  return CreateLatin1String(heap, text.data(), text.size());
+}
+
+uint32_t ConcatStrings(Heap& heap, uint32_t left, uint32_t right);
+// Units [start, end) of handle; kNoHandle also when out of range. Flattens a
+// rope first.
+uint32_t SliceString(Heap& heap, uint32_t handle, uint32_t start, uint32_t end);
+// Rewrites a rope as a flat string under the same handle; a no-op for flat
+// strings and slices.
+bool FlattenString(Heap& heap, uint32_t handle);
+
+bool IsString(const HeapObject* obj);
+uint32_t StringLength(const HeapObject* obj);
+StringEncoding GetStringEncoding(const HeapObject* obj);
+// Code unit at index of a flat string or slice.
+uint16_t StringUnitAt(const Heap& heap, const HeapObject* obj, uint32_t index);
+
+// Copies out the units of any string without modifying it.
+std::u16string ReadString(const Heap& heap, const HeapObject* obj);
+// As ReadString, with units outside ASCII replaced by '?'.
+std::string ReadAsciiString(const Heap& heap, const HeapObject* obj);
+void AppendAsciiString(const Heap& heap, const HeapObject* obj, std::string* out);
+// Writes the StringLength(obj) ASCII units to out and returns the end.
+char* CopyAsciiString(const Heap& heap, const HeapObject* obj, char* out);
+
+// FNV-1a over the code units, so equal strings hash equally whatever their
+// encoding. Computed once and cached in the payload; flattens ropes.
+uint32_t StringHash(Heap& heap, uint32_t handle);
+
+} // namespace Simple::VM
+
+#endif // SIMPLE_VM_HEAP_STRING_H
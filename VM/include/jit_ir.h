@@ -0,0 +1,92 @@
+#ifndef SIMPLE_VM_JIT_IR_H
+#define SIMPLE_VM_JIT_IR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "opcode.h"
+#include "sbc_types.h"
+#include "sbc_verifier.h"
+#include "simple_api.h"
+
+namespace Simple::VM {
+
+constexpr uint32_t kNoIrValue = 0xFFFFFFFFu;
+
+// Register form of one function for the native tier. Values are numbered:
+//   [0, locals)                       local homes (params first)
+//   [locals, locals + stack_homes)    operand stack homes, one per depth
+//   [locals + stack_homes, ...)       temporaries, each defined exactly once
+// Stack bytecode is lowered block by block: inside a block every result is a
+// fresh temporary and stack shuffles/local loads just rename values; homes
+// carry values between blocks and are written only by the moves that end a
+// block. That keeps temporaries in SSA form without phis.
+enum class IrKind : uint8_t {
+  Const,   // dst = imm (raw slot bits)
+  Move,    // dst = a
+  Unary,   // dst = op(a)
+  Binary,  // dst = op(a, b)
+  Call,    // dst = call imm(args...); dst is kNoIrValue for void callees
+  Jump,    // goto target
+  Branch,  // JmpTrue: a != 0 ? target : fallthrough (JmpFalse inverts)
+  Ret,     // return a, or nothing when a is kNoIrValue
+  Bail,    // leave native code; the bytecode path reruns the function
+};
+
+struct IrInst {
+  IrKind kind = IrKind::Bail;
+  Simple::Byte::OpCode op = Simple::Byte::OpCode::Nop;
+  uint32_t dst = kNoIrValue;
+  uint32_t a = kNoIrValue;
+  uint32_t b = kNoIrValue;
+  uint32_t target = 0;
+  uint32_t fallthrough = 0;
+  uint64_t imm = 0;
+  std::vector<uint32_t> args;
+};
+
+// Each block ends in Jump, Branch, Ret or Bail.
+struct IrBlock {
+  std::vector<IrInst> insts;
+};
+
+struct IrFunction {
+  uint16_t param_count = 0;
+  uint32_t locals = 0;
+  uint32_t stack_homes = 0;
+  uint32_t value_count = 0;
+  bool returns_value = false;
+  // Verifier types of the locals, when the module was verified.
+  std::vector<Simple::Byte::VmType> local_types;
+  std::vector<IrBlock> blocks;
+
+  bool IsHome(uint32_t value) const { return value < locals + stack_homes; }
+};
+
+// Reports a CALL target's param count and whether it leaves a value; returns
+// false if the callee cannot be called from native code.
+using IrCalleeInfo = std::function<bool(uint32_t func_id, uint16_t* param_count, bool* returns_value)>;
+
+// Lowers the scalar subset of Tier1 bytecode (see native_jit.h). Fails with
+// a reason for anything else, which keeps the function on the bytecode path.
+SIMPLEVM_API bool LowerFunctionToIr(const Simple::Byte::SbcModule& module,
+                                    size_t func_index,
+                                    const Simple::Byte::MethodVerifyInfo* verify_info,
+                                    const IrCalleeInfo& callee_info,
+                                    IrFunction* out,
+                                    std::string* error);
+
+// Constant folding, copy propagation, local CSE and dead code elimination,
+// repeated until nothing changes.
+SIMPLEVM_API void OptimizeIr(IrFunction& func);
+
+// Evaluates a pure Unary/Binary op on slot bits with Tier1 semantics. Returns
+// false when the op cannot be folded (I32 division by zero bails at run time).
+SIMPLEVM_API bool EvalIrOp(Simple::Byte::OpCode op, uint64_t a, uint64_t b, uint64_t* out);
+
+} // namespace Simple::VM
+
+#endif // SIMPLE_VM_JIT_IR_H
@@ -0,0 +1,99 @@
+#ifndef SIMPLE_VM_NATIVE_JIT_H
+#define SIMPLE_VM_NATIVE_JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "simple_api.h"
+#include "sbc_types.h"
+#include "sbc_verifier.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define SIMPLEVM_NATIVE_JIT 1
+#else
+#define SIMPLEVM_NATIVE_JIT 0
+#endif
+
+namespace Simple::VM {
+
+// Native entry: runs one function over a slot frame laid out as
+// [locals][stack homes][temporaries][call area]. Params are in
+// frame[0..param_count) on entry and a returned value is left in frame[0].
+// Callers write arguments into their call area, which becomes the callee's
+// frame. Returns a NativeStatus; on Bail or Unsupported nothing has been
+// published and the caller must rerun the function on the bytecode path.
+using NativeEntry = uint32_t (*)(uint64_t* frame, uint64_t* limit);
+
+enum class NativeStatus : uint32_t {
+  Return = 0,
+  ReturnValue = 1,
+  // This run could not finish (frame limit reached, zero I32 divisor); later
+  // calls may still run natively.
+  Bail = 2,
+  // Reached code the native tier does not model; the function should stay on
+  // the bytecode path from now on.
+  Unsupported = 3,
+};
+
+// Invoked from native code before each native call so tiering counters keep
+// advancing as they do on the bytecode path. The VM only records these calls
+// and applies them once the outermost entry returns without bailing, so a
+// rerun on the bytecode path does not count them twice.
+struct NativeCallHook {
+  void (*fn)(void* ctx, uint32_t func_id) = nullptr;
+  void* ctx = nullptr;
+};
+
+struct NativeFunction {
+  NativeEntry entry = nullptr;
+  uint32_t frame_slots = 0;
+  uint16_t param_count = 0;
+  bool returns_value = false;
+};
+
+// Executable memory for native functions. Chunks are mapped read/write, filled,
+// then flipped to read/execute; they are released with the arena.
+class SIMPLEVM_API JitCodeArena {
+ public:
+  JitCodeArena() = default;
+  ~JitCodeArena();
+  JitCodeArena(const JitCodeArena&) = delete;
+  JitCodeArena& operator=(const JitCodeArena&) = delete;
+
+  void* Install(const std::vector<uint8_t>& code);
+
+ private:
+  struct Chunk {
+    uint8_t* base = nullptr;
+    size_t size = 0;
+    size_t used = 0;
+  };
+  std::vector<Chunk> chunks_;
+};
+
+// Returns the compiled callee for a CALL target, or nullptr if it has no
+// native code (which keeps the caller on the bytecode path).
+using NativeCalleeResolver = std::function<const NativeFunction*(uint32_t func_id)>;
+
+// Compiles func_index to machine code. The function is lowered to register
+// form and optimized (jit_ir.h), then each IR value gets a frame slot.
+// Covers the scalar subset of Tier1: consts, locals, stack shuffles,
+// I32/I64/U32/U64/F32/F64 arithmetic, comparisons, conversions, bool/bit ops,
+// null/ref compares, jumps, CALL to natively compiled callees, and RET.
+// Returns false (with a reason) for anything else; callers fall back to the
+// bytecode Tier1 path. verify_info may be null for unverified modules.
+SIMPLEVM_API bool CompileNativeFunction(const Simple::Byte::SbcModule& module,
+                                        size_t func_index,
+                                        const Simple::Byte::MethodVerifyInfo* verify_info,
+                                        const NativeCalleeResolver& resolve_callee,
+                                        NativeCallHook hook,
+                                        JitCodeArena& arena,
+                                        NativeFunction* out,
+                                        std::string* error);
+
+} // namespace Simple::VM
+
+#endif // SIMPLE_VM_NATIVE_JIT_H
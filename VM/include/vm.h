@@ -3,11 +3,15 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "heap.h"
 #include "simple_api.h"
 #include "sbc_types.h"
+#include "sbc_verifier.h"
 
 namespace Simple::VM {
 
@@ -29,11 +33,15 @@ enum class JitTier {
 constexpr uint32_t kJitTier0Threshold = 3;
 constexpr uint32_t kJitTier1Threshold = 6;
 constexpr uint32_t kJitOpcodeThreshold = 10;
+constexpr uint32_t kJitNativeThreshold = 32;
 
 struct ExecResult {
   ExecStatus status = ExecStatus::Ok;
   std::string error;
   int32_t exit_code = 0;
+  // Raw slot returned by the entry (or invoked) function.
+  uint64_t return_value = 0;
+  bool has_return_value = false;
   std::vector<JitTier> jit_tiers;
   std::vector<uint32_t> call_counts;
   std::vector<uint64_t> opcode_counts;
@@ -44,14 +52,43 @@ struct ExecResult {
   std::vector<uint32_t> jit_dispatch_counts;
   std::vector<uint32_t> jit_compiled_exec_counts;
   std::vector<uint32_t> jit_tier1_exec_counts;
+  std::vector<uint32_t> jit_native_exec_counts;
+  // Filled when ExecOptions::profile_opcode_sequences is set. Only statically
+  // adjacent instructions count. Pairs are indexed (first << 8) | second,
+  // triples keyed (first << 16) | (second << 8) | third.
+  std::vector<uint64_t> opcode_pair_counts;
+  std::unordered_map<uint32_t, uint64_t> opcode_triple_counts;
+  // Heap totals; for a Vm they run from Load or the last Reset.
+  GcStats gc;
 };
 
+// Host implementation of one import: gets the argument slots, sets out_ret
+// and out_has_ret, and returns false (with out_error) to trap.
+using ImportHandler = std::function<bool(const std::vector<uint64_t>& args, uint64_t& out_ret,
+                                         bool& out_has_ret, std::string& out_error)>;
+
 struct ExecOptions {
   std::vector<std::string> argv;
-  std::function<bool(const std::string& module, const std::string& symbol,
-                     const std::vector<uint64_t>& args, uint64_t& out_ret,
-                     bool& out_has_ret, std::string& out_error)>
-      import_resolver;
+  // Binds an import the VM does not provide itself (built-in core.* imports
+  // never reach it). Asked once per import, on its first call; the handler it
+  // returns serves every later call. An empty handler leaves the import
+  // unsupported.
+  std::function<ImportHandler(const std::string& module, const std::string& symbol)> import_resolver;
+  // Records opcode pair/triple counts and runs without superinstructions so
+  // the counts reflect the SBC opcodes.
+  bool profile_opcode_sequences = false;
+  // GC tuning (see GcPolicy). 0 means the SIMPLE_GC_NURSERY, SIMPLE_GC_GROWTH,
+  // SIMPLE_GC_MIN_HEAP and SIMPLE_GC_MAX_HEAP env overrides, or the defaults.
+  // An allocation past gc_max_heap_bytes runs a full collection and retries
+  // once; it traps only if the retry fails too.
+  size_t gc_nursery_bytes = 0;
+  uint32_t gc_growth_percent = 0;
+  size_t gc_min_heap_bytes = 0;
+  size_t gc_max_heap_bytes = 0;
+  // Incremental major collections (also SIMPLE_GC_INCREMENTAL=1), and the
+  // objects marked or swept per slice (0: SIMPLE_GC_SLICE or the default).
+  bool gc_incremental = false;
+  uint32_t gc_slice_work = 0;
 };
 
 SIMPLEVM_API ExecResult ExecuteModule(const SbcModule& module);
@@ -59,6 +96,58 @@ SIMPLEVM_API ExecResult ExecuteModule(const SbcModule& module, bool verify);
 SIMPLEVM_API ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit);
 SIMPLEVM_API ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
                                       const ExecOptions& options);
+// Runs a module the caller already verified; verified must come from
+// VerifyModule/VerifyModuleCached on this module. Traps with verified.error
+// if it did not pass.
+SIMPLEVM_API ExecResult ExecuteModule(const SbcModule& module, const Simple::Byte::VerifyResult& verified,
+                                      bool enable_jit = true, const ExecOptions& options = ExecOptions{});
+
+// A loaded module that can be run many times. Load verifies once and keeps
+// decoded code, inline caches, JIT tiers and native code warm across calls.
+// Globals and the heap persist between calls (the GC reclaims garbage at its
+// usual safepoints); the operand, frame and locals stacks are reused. Reset
+// drops heap objects, closes core.fs files and mappings, and re-runs global
+// initializers on the next call. Not
+// thread-safe: use one Vm per thread, e.g. isolates made with LoadIsolate.
+class SIMPLEVM_API Vm {
+ public:
+  Vm();
+  ~Vm();
+  Vm(const Vm&) = delete;
+  Vm& operator=(const Vm&) = delete;
+
+  // Copies and prepares module; verify and enable_jit mean the same as for
+  // ExecuteModule. Returns false with error() set if verification fails.
+  bool Load(const SbcModule& module, bool verify = true, bool enable_jit = true,
+            const ExecOptions& options = ExecOptions{});
+  // Loads the module source holds as a new isolate. The module, its verify
+  // result and decoded code are shared read-only; heap, globals, stacks,
+  // inline caches and JIT state are this Vm's own, so isolates of one source
+  // may run concurrently on different threads.
+  bool LoadIsolate(const Vm& source);
+  bool loaded() const;
+  const std::string& error() const;
+
+  // Runs the module entry point.
+  ExecResult Run();
+  // Calls an exported function (module.exports) or a function id with
+  // argument slots; the result carries return_value/has_return_value.
+  ExecResult Invoke(const std::string& export_name, const std::vector<uint64_t>& args);
+  ExecResult InvokeFunction(uint32_t func_id, const std::vector<uint64_t>& args);
+  void Reset();
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+  std::string error_;
+};
+
+// Runs the entry point of count isolates of module on up to workers threads
+// (0 picks the hardware thread count). Results are in isolate order; if the
+// module fails verification every result is that trap.
+SIMPLEVM_API std::vector<ExecResult> RunIsolates(const SbcModule& module, size_t count, size_t workers,
+                                                 bool verify = true, bool enable_jit = true,
+                                                 const ExecOptions& options = ExecOptions{});
 
 } // namespace Simple::VM
 
@@ -0,0 +1,192 @@
+#include "decoded_code.h"
+
+#include "opcode.h"
+
+namespace Simple::VM {
+
+namespace {
+
+using Simple::Byte::OpCode;
+
+uint32_t ReadU32At(const std::vector<uint8_t>& code, size_t offset) {
+  return static_cast<uint32_t>(code[offset]) |
+         (static_cast<uint32_t>(code[offset + 1]) << 8) |
+         (static_cast<uint32_t>(code[offset + 2]) << 16) |
+         (static_cast<uint32_t>(code[offset + 3]) << 24);
+}
+
+uint64_t ReadU64At(const std::vector<uint8_t>& code, size_t offset) {
+  return static_cast<uint64_t>(ReadU32At(code, offset)) |
+         (static_cast<uint64_t>(ReadU32At(code, offset + 4)) << 32);
+}
+
+bool IsWideConst(uint8_t opcode) {
+  return opcode == static_cast<uint8_t>(OpCode::ConstI64) ||
+         opcode == static_cast<uint8_t>(OpCode::ConstU64) ||
+         opcode == static_cast<uint8_t>(OpCode::ConstF64);
+}
+
+bool IsRelJump(uint8_t opcode) {
+  return opcode == static_cast<uint8_t>(OpCode::Jmp) ||
+         opcode == static_cast<uint8_t>(OpCode::JmpTrue) ||
+         opcode == static_cast<uint8_t>(OpCode::JmpFalse);
+}
+
+size_t AppendRun(DecodedCode& out, const std::vector<uint8_t>& code, size_t pc, size_t end) {
+  size_t first = out.insts.size();
+  while (pc < end) {
+    DecodedInst inst;
+    if (!DecodeInstruction(code, pc, &inst)) {
+      inst = DecodedInst{};
+      inst.opcode = 0xFF;
+      inst.flags = kDecodedTruncated;
+      inst.pc = static_cast<uint32_t>(pc);
+      inst.next_pc = static_cast<uint32_t>(code.size());
+    }
+    if (out.pc_index[pc] == kNoDecodedInst) {
+      out.pc_index[pc] = static_cast<uint32_t>(out.insts.size());
+    }
+    out.insts.push_back(inst);
+    pc = inst.next_pc;
+  }
+  DecodedInst sentinel;
+  sentinel.flags = kDecodedEnd;
+  sentinel.pc = static_cast<uint32_t>(pc);
+  sentinel.next_pc = static_cast<uint32_t>(pc);
+  out.insts.push_back(sentinel);
+  return first;
+}
+
+void LinkJumps(DecodedCode& out, size_t first) {
+  for (size_t i = first; i < out.insts.size(); ++i) {
+    DecodedInst& inst = out.insts[i];
+    if ((inst.flags & kDecodedEnd) != 0 || !IsRelJump(inst.opcode)) continue;
+    inst.b = inst.a < out.pc_index.size() ? out.pc_index[static_cast<size_t>(inst.a)] : kNoDecodedInst;
+  }
+}
+
+bool Is(const DecodedInst& inst, OpCode op) {
+  return inst.flags == 0 && inst.opcode == static_cast<uint8_t>(op);
+}
+
+bool IsCmpI32(const DecodedInst& inst) {
+  return Is(inst, OpCode::CmpEqI32) || Is(inst, OpCode::CmpNeI32) || Is(inst, OpCode::CmpLtI32) ||
+         Is(inst, OpCode::CmpLeI32) || Is(inst, OpCode::CmpGtI32) || Is(inst, OpCode::CmpGeI32);
+}
+
+// Returns the number of records fused at insts[i], or 0.
+size_t FuseAt(std::vector<DecodedInst>& insts, size_t i) {
+  if (!Is(insts[i], OpCode::LoadLocal)) return 0;
+  DecodedInst& head = insts[i];
+  // Every run ends in a sentinel that matches no opcode, so each check below
+  // stops before reading past the end of the run.
+  const DecodedInst* next = &insts[i + 1];
+  if (Is(next[0], OpCode::ConstI32)) {
+    // LOAD_LOCAL a; CONST_I32 k; CMP_*_I32; JMP_FALSE
+    if (IsCmpI32(next[1]) && Is(next[2], OpCode::JmpFalse)) {
+      head.opcode = static_cast<uint8_t>(OpCode::JmpFalseCmpLocalConstI32);
+      return 4;
+    }
+    // LOAD_LOCAL a; CONST_I32 k; ADD_I32|SUB_I32; STORE_LOCAL a
+    if ((Is(next[1], OpCode::AddI32) || Is(next[1], OpCode::SubI32)) && Is(next[2], OpCode::StoreLocal) &&
+        next[2].a == head.a) {
+      head.opcode = static_cast<uint8_t>(OpCode::IncLocalI32);
+      return 4;
+    }
+  }
+  if (Is(next[0], OpCode::LoadLocal)) {
+    if (Is(next[1], OpCode::AddI32)) {
+      head.opcode = static_cast<uint8_t>(OpCode::AddLocalsI32);
+      return 3;
+    }
+    head.opcode = static_cast<uint8_t>(OpCode::LoadLocal2);
+    return 2;
+  }
+  return 0;
+}
+
+} // namespace
+
+bool DecodeInstruction(const std::vector<uint8_t>& code, size_t pc, DecodedInst* out) {
+  if (!out || pc >= code.size()) return false;
+  DecodedInst inst;
+  inst.opcode = code[pc];
+  inst.pc = static_cast<uint32_t>(pc);
+  Simple::Byte::OpInfo info{};
+  if (!Simple::Byte::GetOpInfo(inst.opcode, &info)) {
+    inst.next_pc = static_cast<uint32_t>(pc + 1);
+    *out = inst;
+    return true;
+  }
+  size_t operands = pc + 1;
+  size_t next = operands + static_cast<size_t>(info.operand_bytes);
+  if (next > code.size()) return false;
+  inst.next_pc = static_cast<uint32_t>(next);
+  switch (info.operand_bytes) {
+    case 0:
+      break;
+    case 1:
+      inst.a = code[operands];
+      break;
+    case 2:
+      inst.a = static_cast<uint64_t>(code[operands]) | (static_cast<uint64_t>(code[operands + 1]) << 8);
+      break;
+    case 4:
+      inst.a = ReadU32At(code, operands);
+      if (IsRelJump(inst.opcode)) {
+        int64_t target = static_cast<int64_t>(next) + static_cast<int32_t>(ReadU32At(code, operands));
+        inst.a = static_cast<uint64_t>(target);
+      }
+      break;
+    case 5:
+      inst.a = ReadU32At(code, operands);
+      inst.imm8 = code[operands + 4];
+      if (inst.opcode == static_cast<uint8_t>(OpCode::CallIndirect)) inst.b = kNoDecodedInst;
+      break;
+    case 8:
+      if (IsWideConst(inst.opcode)) {
+        inst.a = ReadU64At(code, operands);
+      } else {
+        inst.a = ReadU32At(code, operands);
+        inst.b = ReadU32At(code, operands + 4);
+      }
+      break;
+    default:
+      return false;
+  }
+  *out = inst;
+  return true;
+}
+
+const DecodedInst* DecodedCode::Resolve(const std::vector<uint8_t>& code, size_t pc, size_t end) {
+  if (const DecodedInst* known = At(pc)) return known;
+  if (pc_index.size() < code.size() + 1) pc_index.resize(code.size() + 1, kNoDecodedInst);
+  if (end > code.size()) end = code.size();
+  size_t first = AppendRun(*this, code, pc, end);
+  LinkJumps(*this, first);
+  return &insts[first];
+}
+
+DecodedCode DecodeModuleCode(const Simple::Byte::SbcModule& module) {
+  DecodedCode out;
+  out.pc_index.assign(module.code.size() + 1, kNoDecodedInst);
+  for (const auto& func : module.functions) {
+    size_t end = static_cast<size_t>(func.code_offset) + func.code_size;
+    if (end > module.code.size()) continue;
+    AppendRun(out, module.code, func.code_offset, end);
+  }
+  LinkJumps(out, 0);
+  return out;
+}
+
+void FuseSuperinstructions(DecodedCode* code) {
+  if (!code) return;
+  std::vector<DecodedInst>& insts = code->insts;
+  size_t i = 0;
+  while (i < insts.size()) {
+    size_t fused = FuseAt(insts, i);
+    i += fused == 0 ? 1 : fused;
+  }
+}
+
+} // namespace Simple::VM
@@ -0,0 +1,97 @@
+#include "dl_trampoline.h"
+
+#include <array>
+#include <utility>
+
+namespace Simple::VM {
+namespace {
+
+constexpr std::size_t kWordClassCount = static_cast<std::size_t>(DlWordClass::None);
+
+template <std::size_t Class>
+struct WordType;
+template <>
+struct WordType<static_cast<std::size_t>(DlWordClass::I32)> { using type = int32_t; };
+template <>
+struct WordType<static_cast<std::size_t>(DlWordClass::I64)> { using type = int64_t; };
+template <>
+struct WordType<static_cast<std::size_t>(DlWordClass::F32)> { using type = float; };
+template <>
+struct WordType<static_cast<std::size_t>(DlWordClass::F64)> { using type = double; };
+
+template <typename Ret, typename... Args, std::size_t... I>
+void Invoke(void* fn, const uint64_t* words, uint64_t* ret, std::index_sequence<I...>) {
+  using Fn = Ret (*)(Args...);
+  Fn typed = reinterpret_cast<Fn>(fn);
+  if constexpr (std::is_void_v<Ret>) {
+    (void)ret;
+    typed(DlFromWord<Args>(words[I])...);
+  } else {
+    *ret = DlToWord<Ret>(typed(DlFromWord<Args>(words[I])...));
+  }
+}
+
+template <typename Ret, typename... Args>
+void Trampoline(void* fn, const uint64_t* words, uint64_t* ret) {
+  (void)words;
+  Invoke<Ret, Args...>(fn, words, ret, std::index_sequence_for<Args...>{});
+}
+
+// Code holds the argument classes as base-kWordClassCount digits, first
+// argument lowest.
+template <typename Ret, std::size_t Arity, std::size_t Code, typename... Args>
+constexpr DlTrampoline Select() {
+  if constexpr (sizeof...(Args) == Arity) {
+    return &Trampoline<Ret, Args...>;
+  } else {
+    return Select<Ret, Arity, Code / kWordClassCount, Args..., typename WordType<Code % kWordClassCount>::type>();
+  }
+}
+
+template <typename Ret, std::size_t Arity, std::size_t... Codes>
+constexpr std::array<DlTrampoline, sizeof...(Codes)> MakeRow(std::index_sequence<Codes...>) {
+  return {Select<Ret, Arity, Codes>()...};
+}
+
+constexpr std::size_t CodeCount(std::size_t arity) {
+  return arity == 0 ? 1 : kWordClassCount * CodeCount(arity - 1);
+}
+
+template <typename Ret>
+DlTrampoline Lookup(std::size_t arity, std::size_t code) {
+  static_assert(kDlTrampolineMaxArgs == 4, "add a row per arity");
+  static constexpr auto kArity0 = MakeRow<Ret, 0>(std::make_index_sequence<CodeCount(0)>{});
+  static constexpr auto kArity1 = MakeRow<Ret, 1>(std::make_index_sequence<CodeCount(1)>{});
+  static constexpr auto kArity2 = MakeRow<Ret, 2>(std::make_index_sequence<CodeCount(2)>{});
+  static constexpr auto kArity3 = MakeRow<Ret, 3>(std::make_index_sequence<CodeCount(3)>{});
+  static constexpr auto kArity4 = MakeRow<Ret, 4>(std::make_index_sequence<CodeCount(4)>{});
+  switch (arity) {
+    case 0: return kArity0[code];
+    case 1: return kArity1[code];
+    case 2: return kArity2[code];
+    case 3: return kArity3[code];
+    case 4: return kArity4[code];
+    default: return nullptr;
+  }
+}
+
+} // namespace
+
+DlTrampoline LookupDlTrampoline(DlWordClass ret_class, const DlWordClass* arg_classes, std::size_t arity) {
+  if (arity > kDlTrampolineMaxArgs) return nullptr;
+  std::size_t code = 0;
+  for (std::size_t i = arity; i-- > 0;) {
+    if (arg_classes[i] == DlWordClass::None) return nullptr;
+    code = code * kWordClassCount + static_cast<std::size_t>(arg_classes[i]);
+  }
+  switch (ret_class) {
+    case DlWordClass::I32: return Lookup<int32_t>(arity, code);
+    case DlWordClass::I64: return Lookup<int64_t>(arity, code);
+    case DlWordClass::F32: return Lookup<float>(arity, code);
+    case DlWordClass::F64: return Lookup<double>(arity, code);
+    case DlWordClass::None: return Lookup<void>(arity, code);
+  }
+  return nullptr;
+}
+
+} // namespace Simple::VM
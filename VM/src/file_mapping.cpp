@@ -0,0 +1,98 @@
+#include "file_mapping.h"
+
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Simple::VM {
+
+FileMapping::FileMapping(FileMapping&& other) noexcept
+    : base_(std::exchange(other.base_, nullptr)),
+      header_bytes_(std::exchange(other.header_bytes_, 0)),
+      length_(std::exchange(other.length_, 0)) {}
+
+FileMapping& FileMapping::operator=(FileMapping&& other) noexcept {
+  if (this != &other) {
+    Unmap();
+    base_ = std::exchange(other.base_, nullptr);
+    header_bytes_ = std::exchange(other.header_bytes_, 0);
+    length_ = std::exchange(other.length_, 0);
+  }
+  return *this;
+}
+
+#if defined(_WIN32)
+
+bool FileMapping::Map(const std::string& path, bool copy_on_write) {
+  (void)path;
+  (void)copy_on_write;
+  Unmap();
+  return false;
+}
+
+void FileMapping::Unmap() {
+  base_ = nullptr;
+  header_bytes_ = 0;
+  length_ = 0;
+}
+
+#else
+
+bool FileMapping::Map(const std::string& path, bool copy_on_write) {
+  Unmap();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 0 ||
+      static_cast<uint64_t>(st.st_size) > kMaxLength) {
+    ::close(fd);
+    return false;
+  }
+  long page = ::sysconf(_SC_PAGESIZE);
+  const std::size_t header_bytes = page > 0 ? static_cast<std::size_t>(page) : 4096u;
+  const std::size_t length = static_cast<std::size_t>(st.st_size);
+  // Reserve header page plus file span, then map the file over the span.
+  void* reserved = ::mmap(nullptr, header_bytes + length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserved == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  uint8_t* base = static_cast<uint8_t*>(reserved);
+  if (length > 0) {
+    const int prot = copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    if (::mmap(base + header_bytes, length, prot, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      ::munmap(reserved, header_bytes + length);
+      ::close(fd);
+      return false;
+    }
+  }
+  ::close(fd);
+  uint8_t* length_word = base + header_bytes - 4;
+  const uint32_t length32 = static_cast<uint32_t>(length);
+  length_word[0] = static_cast<uint8_t>(length32 & 0xFF);
+  length_word[1] = static_cast<uint8_t>((length32 >> 8) & 0xFF);
+  length_word[2] = static_cast<uint8_t>((length32 >> 16) & 0xFF);
+  length_word[3] = static_cast<uint8_t>((length32 >> 24) & 0xFF);
+  ::mprotect(base, header_bytes, PROT_READ);
+  base_ = base;
+  header_bytes_ = header_bytes;
+  length_ = length32;
+  return true;
+}
+
+void FileMapping::Unmap() {
+  if (base_) ::munmap(base_, header_bytes_ + length_);
+  base_ = nullptr;
+  header_bytes_ = 0;
+  length_ = 0;
+}
+
+#endif
+
+} // namespace Simple::VM
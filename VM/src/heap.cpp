@@ -1,98 +1,560 @@
 #include "heap.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstring>
+#include <new>
 
 namespace Simple::VM {
 
 namespace {
 
-uint32_t ReadU32Payload(const std::vector<uint8_t>& payload, std::size_t offset) {
+uint32_t ReadU32Payload(const Payload& payload, std::size_t offset) {
   return static_cast<uint32_t>(payload[offset]) |
          (static_cast<uint32_t>(payload[offset + 1]) << 8) |
          (static_cast<uint32_t>(payload[offset + 2]) << 16) |
          (static_cast<uint32_t>(payload[offset + 3]) << 24);
 }
 
+constexpr size_t kSmallClassCount = 16;  // 16..256 bytes in 16-byte steps
+constexpr size_t kSmallClassStep = 16;
+constexpr size_t kNoSizeClass = static_cast<size_t>(-1);
+
 } // namespace
 
-uint32_t Heap::Allocate(ObjectKind kind, uint32_t type_id, uint32_t size) {
+// Small blocks round up to a multiple of 16 bytes, larger ones to a power of
+// two up to 16 KiB; anything bigger gets a block of its own.
+size_t Heap::SizeClassFor(size_t bytes) {
+  if (bytes <= kSmallClassCount * kSmallClassStep) {
+    return bytes == 0 ? 0 : (bytes + kSmallClassStep - 1) / kSmallClassStep - 1;
+  }
+  size_t size_class = kSmallClassCount;
+  size_t class_bytes = kSmallClassCount * kSmallClassStep * 2;
+  while (class_bytes < bytes) {
+    class_bytes *= 2;
+    ++size_class;
+  }
+  return size_class < kSizeClassCount ? size_class : kNoSizeClass;
+}
+
+size_t Heap::SizeClassBytes(size_t size_class) {
+  if (size_class < kSmallClassCount) return (size_class + 1) * kSmallClassStep;
+  return (kSmallClassCount * kSmallClassStep * 2) << (size_class - kSmallClassCount);
+}
+
+uint32_t Heap::Allocate(ObjectKind kind, uint32_t type_id, uint32_t size, bool ref_elements) {
+  const size_t bytes = sizeof(HeapObject) + size;
+  const size_t young_bytes = (bytes + kSmallClassStep - 1) & ~(kSmallClassStep - 1);
+  uint8_t* block = nullptr;
+  size_t block_size = 0;
+  bool young = false;
+  if (size <= kMaxYoungPayload && nursery_used_ + young_bytes <= nursery_size_) {
+    if (!WithinLimit(young_bytes)) return kNoHandle;
+    if (!nursery_) nursery_ = std::make_unique<uint8_t[]>(nursery_size_);
+    block = nursery_.get() + nursery_used_;
+    block_size = young_bytes;
+    nursery_used_ += young_bytes;
+    young = true;
+    if (nursery_used_ >= nursery_size_ / 4 * 3) minor_pending_ = true;
+  } else {
+    if (!WithinLimit(bytes)) return kNoHandle;
+    block = AllocateBlock(bytes, &block_size);
+    if (size <= kMaxYoungPayload && nursery_size_ > 0) minor_pending_ = true;
+  }
+  stats_.bytes_allocated += block_size;
+  NoteInUse();
+  HeapObject* obj = new (block) HeapObject();
+  obj->header.kind = kind;
+  obj->header.size = size;
+  obj->header.type_id = type_id;
+  obj->header.marked = 0;
+  // Objects allocated during an incremental cycle are live for that cycle.
+  obj->header.color = phase_ == Phase::Idle ? kWhite : kBlack;
+  obj->header.young = young ? 1 : 0;
+  obj->header.ref_elements = ref_elements ? 1 : 0;
+  obj->header.byte_elements = 0;
+  obj->header.external = 0;
+  obj->header.read_only = 0;
+  obj->payload.data_ = block + sizeof(HeapObject);
+  obj->payload.size_ = size;
+  obj->payload.inline_capacity_ = static_cast<uint32_t>(block_size - sizeof(HeapObject));
+  obj->payload.capacity_ = obj->payload.inline_capacity_;
+  std::memset(obj->payload.data_, 0, size);
+
+  uint32_t handle = 0;
   if (!free_list_.empty()) {
-    uint32_t handle = free_list_.back();
+    handle = free_list_.back();
     free_list_.pop_back();
-    HeapObject& obj = objects_[handle];
-    obj.header.kind = kind;
-    obj.header.size = size;
-    obj.header.type_id = type_id;
-    obj.header.marked = 0;
-    obj.header.alive = 1;
-    obj.payload.assign(size, 0);
-    return handle;
-  }
-
-  HeapObject obj;
-  obj.header.kind = kind;
-  obj.header.size = size;
-  obj.header.type_id = type_id;
-  obj.header.marked = 0;
-  obj.header.alive = 1;
-  obj.payload.resize(size);
-  objects_.push_back(std::move(obj));
-  return static_cast<uint32_t>(objects_.size() - 1);
+    objects_[handle] = obj;
+  } else {
+    handle = static_cast<uint32_t>(objects_.size());
+    objects_.push_back(obj);
+    if ((handle >> kCardShift) >= cards_.size()) cards_.resize((handle >> kCardShift) + 1, 0);
+  }
+  if (young) {
+    young_.push_back(handle);
+  } else {
+    // Its initializing stores skip the barrier; scan it at the next minor
+    // collection in case they stored young refs.
+    cards_[handle >> kCardShift] = 1;
+  }
+  return handle;
+}
+
+uint32_t Heap::AllocateExternal(ObjectKind kind, uint32_t type_id, uint8_t* data, uint32_t size) {
+  uint32_t handle = Allocate(kind, type_id, 0);
+  if (handle == kNoHandle) return kNoHandle;
+  HeapObject* obj = objects_[handle];
+  obj->header.size = size;
+  obj->header.external = 1;
+  obj->payload.data_ = data;
+  obj->payload.size_ = size;
+  obj->payload.capacity_ = size;
+  return handle;
+}
+
+void Heap::ReleaseExternal(HeapObject* obj, uint32_t size) {
+  size_t block_size = 0;
+  uint8_t* block = AllocateBlock(size, &block_size);
+  stats_.bytes_allocated += block_size;
+  std::memset(block, 0, size);
+  obj->header.size = size;
+  obj->header.external = 0;
+  obj->payload.data_ = block;
+  obj->payload.size_ = size;
+  obj->payload.capacity_ = static_cast<uint32_t>(block_size);
+  NoteInUse();
 }
 
 HeapObject* Heap::Get(uint32_t handle) {
   if (handle >= objects_.size()) return nullptr;
-  if (!objects_[handle].header.alive) return nullptr;
-  return &objects_[handle];
+  return objects_[handle];
 }
 
 const HeapObject* Heap::Get(uint32_t handle) const {
   if (handle >= objects_.size()) return nullptr;
-  if (!objects_[handle].header.alive) return nullptr;
-  return &objects_[handle];
+  return objects_[handle];
+}
+
+bool Heap::ResizePayload(HeapObject* obj, uint32_t size) {
+  Payload& payload = obj->payload;
+  if (size > payload.capacity_) {
+    if (!WithinLimit(size)) return false;
+    size_t block_size = 0;
+    uint8_t* block = AllocateBlock(size, &block_size);
+    stats_.bytes_allocated += block_size;
+    std::memcpy(block, payload.data_, payload.size_);
+    uint8_t* inline_data = reinterpret_cast<uint8_t*>(obj) + sizeof(HeapObject);
+    if (payload.data_ != inline_data) FreeBlock(payload.data_, payload.capacity_);
+    payload.data_ = block;
+    payload.capacity_ = static_cast<uint32_t>(block_size);
+    NoteInUse();
+  }
+  if (size > payload.size_) std::memset(payload.data_ + payload.size_, 0, size - payload.size_);
+  payload.size_ = size;
+  return true;
+}
+
+void Heap::SetPolicy(const GcPolicy& policy) {
+  policy_ = policy;
+  if (nursery_used_ == 0 && nursery_size_ != policy_.nursery_bytes) {
+    nursery_.reset();
+    nursery_size_ = policy_.nursery_bytes;
+  }
+  UpdateOldLimit();
+}
+
+// Old space may grow to growth_percent of what it holds now, but only
+// halfway to the heap limit, so a major collection runs before allocation
+// starts failing.
+void Heap::UpdateOldLimit() {
+  size_t limit = std::max(policy_.min_old_bytes, old_bytes_ / 100 * policy_.growth_percent);
+  if (policy_.max_heap_bytes != 0) {
+    const size_t headroom = policy_.max_heap_bytes > old_bytes_ ? policy_.max_heap_bytes - old_bytes_ : 0;
+    limit = std::min(limit, old_bytes_ + headroom / 2);
+  }
+  old_limit_ = limit;
+  if (old_bytes_ > old_limit_) major_pending_ = true;
+}
+
+bool Heap::WithinLimit(size_t bytes) {
+  if (policy_.max_heap_bytes == 0 || old_bytes_ + nursery_used_ + bytes <= policy_.max_heap_bytes) return true;
+  // Garbage may be all that stands in the way: ask for a full collection.
+  major_pending_ = true;
+  limit_failed_ = true;
+  return false;
+}
+
+void Heap::NoteInUse() {
+  stats_.peak_live_bytes = std::max<uint64_t>(stats_.peak_live_bytes, old_bytes_ + nursery_used_);
+}
+
+bool Heap::IsYoung(uint32_t handle) const {
+  const HeapObject* obj = Get(handle);
+  return obj && obj->header.young;
+}
+
+namespace {
+
+uint64_t NowNs() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+} // namespace
+
+void Heap::BeginCollection() {
+  StartCollection(policy_.incremental);
+}
+
+void Heap::StartCollection(bool allow_incremental) {
+  pause_start_ns_ = NowNs();
+  if (allow_incremental && major_pending_ && phase_ == Phase::Idle) {
+    starting_cycle_ = true;
+    minor_ = false;
+    for (HeapObject* obj : objects_) {
+      if (obj) obj->header.color = kWhite;
+    }
+    gray_.clear();
+    MarkPinned();
+    return;
+  }
+  // A major request made while a cycle runs waits for the cycle to end.
+  minor_ = !major_pending_ || phase_ != Phase::Idle;
+  if (minor_) {
+    for (uint32_t handle : young_) {
+      if (objects_[handle]) objects_[handle]->header.marked = 0;
+    }
+  } else {
+    for (HeapObject* obj : objects_) {
+      if (obj) obj->header.marked = 0;
+    }
+  }
+  MarkPinned();
+}
+
+void Heap::MarkPinned() {
+  for (uint32_t handle : pinned_) Mark(handle);
 }
 
 void Heap::Mark(uint32_t handle) {
-  HeapObject* obj = Get(handle);
-  if (!obj) return;
-  if (obj->header.marked) return;
-  obj->header.marked = 1;
-  if (obj->header.kind == ObjectKind::Closure) {
-    if (obj->payload.size() < 8) return;
-    uint32_t upvalue_count = ReadU32Payload(obj->payload, 4);
-    std::size_t base = 8;
-    for (uint32_t i = 0; i < upvalue_count; ++i) {
-      std::size_t offset = base + static_cast<std::size_t>(i) * 4;
-      if (offset + 4 > obj->payload.size()) break;
-      uint32_t ref = ReadU32Payload(obj->payload, offset);
-      if (ref != 0xFFFFFFFFu) Mark(ref);
+  if (starting_cycle_) {
+    Shade(handle);
+    return;
+  }
+  mark_stack_.push_back(handle);
+  DrainMarkStack();
+}
+
+void Heap::DrainMarkStack() {
+  while (!mark_stack_.empty()) {
+    uint32_t handle = mark_stack_.back();
+    mark_stack_.pop_back();
+    HeapObject* obj = Get(handle);
+    if (!obj || obj->header.marked) continue;
+    // Old objects are all treated as live by a minor collection.
+    if (minor_ && !obj->header.young) continue;
+    obj->header.marked = 1;
+    TraceRefs(obj);
+  }
+}
+
+// Queues a referenced object unless it is already marked or, in a minor
+// collection, old.
+void Heap::PushRef(uint32_t handle) {
+  if (handle >= objects_.size()) return;
+  const HeapObject* obj = objects_[handle];
+  if (!obj || obj->header.marked) return;
+  if (minor_ && !obj->header.young) return;
+  mark_stack_.push_back(handle);
+}
+
+// Calls visit with each handle obj holds, using its kind's ref layout.
+template <typename Visit>
+void Heap::ForEachRef(const HeapObject* obj, Visit visit) const {
+  const Payload& payload = obj->payload;
+  switch (obj->header.kind) {
+    case ObjectKind::Closure: {
+      if (payload.size() < 8) return;
+      std::size_t count = ReadU32Payload(payload, 4);
+      count = std::min(count, (payload.size() - 8) / 4);
+      for (std::size_t i = 0; i < count; ++i) visit(ReadU32Payload(payload, 8 + i * 4));
+      return;
+    }
+    case ObjectKind::Array:
+    case ObjectKind::List: {
+      if (!obj->header.ref_elements) return;
+      // Arrays store their length at 0; lists their length and capacity.
+      const std::size_t base = obj->header.kind == ObjectKind::List ? 8 : 4;
+      if (payload.size() < base) return;
+      std::size_t count = ReadU32Payload(payload, 0);
+      count = std::min(count, (payload.size() - base) / 4);
+      for (std::size_t i = 0; i < count; ++i) visit(ReadU32Payload(payload, base + i * 4));
+      return;
+    }
+    case ObjectKind::Artifact: {
+      if (!type_refs_ || obj->header.type_id >= type_refs_->field_offsets.size()) return;
+      for (uint32_t offset : type_refs_->field_offsets[obj->header.type_id]) {
+        if (static_cast<std::size_t>(offset) + 4 <= payload.size()) visit(ReadU32Payload(payload, offset));
+      }
+      return;
+    }
+    case ObjectKind::String: {
+      if (!obj->header.ref_elements || payload.size() < kStringDataOffset + 8) return;
+      visit(ReadU32Payload(payload, kStringDataOffset));
+      // A slice's second field is its offset.
+      if (payload[kStringEncodingOffset] == static_cast<uint8_t>(StringEncoding::Rope)) {
+        visit(ReadU32Payload(payload, kStringDataOffset + 4));
+      }
+      return;
     }
   }
 }
 
-void Heap::ResetMarks() {
-  for (auto& obj : objects_) {
-    if (!obj.header.alive) continue;
-    obj.header.marked = 0;
+void Heap::TraceRefs(const HeapObject* obj) {
+  ForEachRef(obj, [this](uint32_t ref) { PushRef(ref); });
+}
+
+void Heap::Shade(uint32_t handle) {
+  if (handle >= objects_.size()) return;
+  HeapObject* obj = objects_[handle];
+  if (!obj || obj->header.color != kWhite) return;
+  obj->header.color = kGray;
+  gray_.push_back(handle);
+}
+
+void Heap::SnapshotRefs(uint32_t owner) {
+  HeapObject* obj = Get(owner);
+  if (!obj || obj->header.color == kBlack) return;
+  ForEachRef(obj, [this](uint32_t ref) { Shade(ref); });
+  obj->header.color = kBlack;
+}
+
+void Heap::Step() {
+  if (phase_ == Phase::Idle) return;
+  const uint64_t start = NowNs();
+  size_t budget = std::max<size_t>(1, policy_.slice_work);
+  if (phase_ == Phase::Marking) {
+    while (budget > 0 && !gray_.empty()) {
+      const uint32_t handle = gray_.back();
+      gray_.pop_back();
+      HeapObject* obj = Get(handle);
+      // Stale entries: objects a minor collection freed, or black ones that
+      // reused their handle.
+      if (!obj || obj->header.color == kBlack) continue;
+      ForEachRef(obj, [this](uint32_t ref) { Shade(ref); });
+      obj->header.color = kBlack;
+      --budget;
+    }
+    if (gray_.empty()) FinishMarking();
+  } else {
+    const size_t end = std::min(objects_.size(), sweep_cursor_ + budget);
+    for (; sweep_cursor_ < end; ++sweep_cursor_) {
+      HeapObject* obj = objects_[sweep_cursor_];
+      // The nursery is left to minor collections.
+      if (!obj || obj->header.young) continue;
+      if (obj->header.color == kWhite) {
+        FreeObject(static_cast<uint32_t>(sweep_cursor_));
+      } else {
+        obj->header.color = kWhite;
+      }
+    }
+    if (sweep_cursor_ >= objects_.size()) FinishSweeping();
   }
+  ++stats_.incremental_steps;
+  RecordPause(NowNs() - start);
+}
+
+void Heap::FinishMarking() {
+  phase_ = Phase::Sweeping;
+  sweep_cursor_ = 0;
+}
+
+void Heap::FinishSweeping() {
+  phase_ = Phase::Idle;
+  ++stats_.major_collections;
+  major_pending_ = false;
+  UpdateOldLimit();
+}
+
+void Heap::CompleteIncremental() {
+  while (phase_ != Phase::Idle) Step();
+}
+
+void Heap::RecordPause(uint64_t pause_ns) {
+  stats_.pause_ns_total += pause_ns;
+  stats_.pause_ns_max = std::max(stats_.pause_ns_max, pause_ns);
+  size_t bucket = 0;
+  for (uint64_t limit = 10000; bucket + 1 < stats_.pause_histogram.size() && pause_ns >= limit; limit *= 10) {
+    ++bucket;
+  }
+  ++stats_.pause_histogram[bucket];
+}
+
+void Heap::FinishCollection() {
+  if (starting_cycle_) {
+    starting_cycle_ = false;
+    major_pending_ = false;
+    phase_ = Phase::Marking;
+    RecordPause(NowNs() - pause_start_ns_);
+    return;
+  }
+  if (minor_) {
+    for (std::size_t card = 0; card < cards_.size(); ++card) {
+      if (!cards_[card]) continue;
+      std::size_t first = card << kCardShift;
+      std::size_t last = std::min(objects_.size(), (card + 1) << kCardShift);
+      for (std::size_t handle = first; handle < last; ++handle) {
+        const HeapObject* obj = objects_[handle];
+        if (obj && !obj->header.young) TraceRefs(obj);
+      }
+      DrainMarkStack();
+    }
+  } else {
+    SweepOld();
+  }
+  EvacuateNursery();
+  if (minor_) {
+    ++stats_.minor_collections;
+  } else {
+    ++stats_.major_collections;
+    major_pending_ = false;
+    UpdateOldLimit();
+  }
+  std::fill(cards_.begin(), cards_.end(), 0);
+  minor_pending_ = false;
+  minor_ = false;
+  RecordPause(NowNs() - pause_start_ns_);
+}
+
+void Heap::ResetMarks() {
+  CompleteIncremental();
+  major_pending_ = true;
+  StartCollection(false);
 }
 
 void Heap::Sweep() {
+  FinishCollection();
+}
+
+size_t Heap::LiveCount() const {
+  return objects_.size() - free_list_.size();
+}
+
+void Heap::FreeObject(uint32_t handle) {
+  HeapObject* obj = objects_[handle];
+  uint8_t* record = reinterpret_cast<uint8_t*>(obj);
+  const Payload& payload = obj->payload;
+  if (payload.data_ != record + sizeof(HeapObject) && !obj->header.external) {
+    FreeBlock(payload.data_, payload.capacity_);
+  }
+  bool young = obj->header.young != 0;
+  size_t record_size = sizeof(HeapObject) + payload.inline_capacity_;
+  obj->~HeapObject();
+  if (young) {
+    stats_.bytes_freed += record_size;
+  } else {
+    FreeBlock(record, record_size);
+  }
+  objects_[handle] = nullptr;
+  free_list_.push_back(handle);
+}
+
+void Heap::SweepOld() {
   for (uint32_t i = 0; i < objects_.size(); ++i) {
-    HeapObject& obj = objects_[i];
-    if (!obj.header.alive) continue;
-    if (obj.header.marked) {
-      obj.header.marked = 0;
+    HeapObject* obj = objects_[i];
+    if (!obj || obj->header.young) continue;
+    if (obj->header.marked) {
+      obj->header.marked = 0;
+      continue;
+    }
+    FreeObject(i);
+  }
+}
+
+// Copies marked young objects into old space and frees the rest; the
+// nursery is empty afterwards. A payload that already moved out of line
+// (list growth) stays where it is.
+void Heap::EvacuateNursery() {
+  for (uint32_t handle : young_) {
+    HeapObject* obj = objects_[handle];
+    if (!obj) continue;
+    if (!obj->header.marked) {
+      // It may be the only path the running cycle had to what it references.
+      if (phase_ == Phase::Marking && obj->header.color != kBlack) {
+        ForEachRef(obj, [this](uint32_t ref) { Shade(ref); });
+      }
+      FreeObject(handle);
       continue;
     }
-    obj.header.alive = 0;
-    obj.header.marked = 0;
-    obj.header.size = 0;
-    obj.header.type_id = 0;
-    obj.payload.clear();
-    obj.payload.shrink_to_fit();
-    free_list_.push_back(i);
+    const Payload& payload = obj->payload;
+    const bool inline_payload = payload.data_ == reinterpret_cast<uint8_t*>(obj) + sizeof(HeapObject);
+    size_t block_size = 0;
+    uint8_t* block = AllocateBlock(sizeof(HeapObject) + (inline_payload ? payload.size_ : 0), &block_size);
+    HeapObject* moved = new (block) HeapObject(*obj);
+    moved->header.marked = 0;
+    moved->header.young = 0;
+    moved->payload.inline_capacity_ = static_cast<uint32_t>(block_size - sizeof(HeapObject));
+    if (inline_payload) {
+      moved->payload.data_ = block + sizeof(HeapObject);
+      moved->payload.capacity_ = moved->payload.inline_capacity_;
+      std::memcpy(moved->payload.data_, payload.data_, payload.size_);
+    }
+    obj->~HeapObject();
+    objects_[handle] = moved;
+    // Survivors stay live for a running cycle: shaded while it marks (they
+    // may reach objects only it has not traced yet), black while it sweeps.
+    if (phase_ == Phase::Marking) Shade(handle);
+    if (phase_ == Phase::Sweeping) moved->header.color = kBlack;
+  }
+  young_.clear();
+  nursery_used_ = 0;
+  if (nursery_size_ != policy_.nursery_bytes) {
+    nursery_.reset();
+    nursery_size_ = policy_.nursery_bytes;
+  }
+}
+
+uint8_t* Heap::AllocateBlock(size_t bytes, size_t* block_size) {
+  size_t size_class = SizeClassFor(bytes);
+  uint8_t* data = nullptr;
+  if (size_class == kNoSizeClass) {
+    auto block = std::make_unique<uint8_t[]>(bytes);
+    data = block.get();
+    large_blocks_.emplace(data, std::move(block));
+    *block_size = bytes;
+  } else {
+    *block_size = SizeClassBytes(size_class);
+    std::vector<uint8_t*>& free_blocks = free_blocks_[size_class];
+    if (!free_blocks.empty()) {
+      data = free_blocks.back();
+      free_blocks.pop_back();
+    } else {
+      if (static_cast<size_t>(bump_end_ - bump_) < *block_size) {
+        pages_.push_back(std::make_unique<uint8_t[]>(kPageSize));
+        bump_ = pages_.back().get();
+        bump_end_ = bump_ + kPageSize;
+      }
+      data = bump_;
+      bump_ += *block_size;
+    }
+  }
+  old_bytes_ += *block_size;
+  if (old_bytes_ > old_limit_) major_pending_ = true;
+  return data;
+}
+
+void Heap::FreeBlock(uint8_t* block, size_t block_size) {
+  old_bytes_ -= block_size;
+  stats_.bytes_freed += block_size;
+  size_t size_class = SizeClassFor(block_size);
+  if (size_class == kNoSizeClass) {
+    large_blocks_.erase(block);
+    return;
   }
+  free_blocks_[size_class].push_back(block);
 }
 
 } // namespace Simple::VM
@@ -0,0 +1,321 @@
+#include "heap_string.h"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace Simple::VM {
+
+namespace {
+
+uint32_t ReadU32Payload(const Payload& payload, std::size_t offset) {
+  return static_cast<uint32_t>(payload[offset]) |
+         (static_cast<uint32_t>(payload[offset + 1]) << 8) |
+         (static_cast<uint32_t>(payload[offset + 2]) << 16) |
+         (static_cast<uint32_t>(payload[offset + 3]) << 24);
+}
+
+void WriteU32(uint8_t* out, uint32_t value) {
+  out[0] = static_cast<uint8_t>(value & 0xFF);
+  out[1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+  out[2] = static_cast<uint8_t>((value >> 16) & 0xFF);
+  out[3] = static_cast<uint8_t>((value >> 24) & 0xFF);
+}
+
+// Longest string whose UTF-16 payload still fits a u32 size.
+constexpr uint32_t kMaxStringLength = (std::numeric_limits<uint32_t>::max() - kStringDataOffset) / 2;
+
+// Payload bytes after the header of a rope or slice.
+constexpr uint32_t kNodeSize = 8;
+
+uint32_t FlatSize(uint32_t length, bool wide) {
+  return kStringDataOffset + length * (wide ? 2u : 1u);
+}
+
+void WriteHeader(uint8_t* payload, uint32_t length, StringEncoding encoding) {
+  WriteU32(payload, length);
+  WriteU32(payload + kStringHashOffset, 0);
+  payload[kStringEncodingOffset] = static_cast<uint8_t>(encoding);
+}
+
+// A run of units in a flat string.
+struct Span {
+  const HeapObject* flat = nullptr;
+  uint32_t offset = 0;
+  uint32_t length = 0;
+};
+
+bool IsWide(const Span& span) {
+  return GetStringEncoding(span.flat) == StringEncoding::Utf16;
+}
+
+uint16_t UnitAt(const Span& span, uint32_t index) {
+  const uint8_t* units = span.flat->payload.data() + kStringDataOffset;
+  const std::size_t at = static_cast<std::size_t>(span.offset) + index;
+  if (!IsWide(span)) return units[at];
+  return static_cast<uint16_t>(units[at * 2] | (units[at * 2 + 1] << 8));
+}
+
+// The units of a flat string or slice. A slice's parent is always flat.
+Span SpanOf(const Heap& heap, const HeapObject* obj) {
+  if (GetStringEncoding(obj) != StringEncoding::Slice) return {obj, 0, StringLength(obj)};
+  return {heap.Get(ReadU32Payload(obj->payload, kStringDataOffset)),
+          ReadU32Payload(obj->payload, kStringDataOffset + 4), StringLength(obj)};
+}
+
+// Allocates a flat string of length units and returns its unit storage.
+uint8_t* AllocateFlat(Heap& heap, uint32_t length, bool wide, uint32_t* handle) {
+  *handle = heap.Allocate(ObjectKind::String, 0, FlatSize(length, wide));
+  HeapObject* obj = heap.Get(*handle);
+  if (!obj) {
+    *handle = Heap::kNoHandle;
+    return nullptr;
+  }
+  WriteHeader(obj->payload.data(), length, wide ? StringEncoding::Utf16 : StringEncoding::Latin1);
+  return obj->payload.data() + kStringDataOffset;
+}
+
+// Copies a span to out, widening Latin-1 if wide.
+uint8_t* CopyUnits(const Span& span, uint8_t* out, bool wide) {
+  const uint8_t* units = span.flat->payload.data() + kStringDataOffset;
+  if (IsWide(span)) {
+    std::memcpy(out, units + static_cast<std::size_t>(span.offset) * 2, static_cast<std::size_t>(span.length) * 2);
+    return out + static_cast<std::size_t>(span.length) * 2;
+  }
+  units += span.offset;
+  if (!wide) {
+    std::memcpy(out, units, span.length);
+    return out + span.length;
+  }
+  for (uint32_t i = 0; i < span.length; ++i) {
+    *out++ = units[i];
+    *out++ = 0;
+  }
+  return out;
+}
+
+// Visits the spans of a string left to right. The stack is explicit: a loop
+// of appends builds a rope as deep as the loop is long.
+template <typename Visit>
+void ForEachSpan(const Heap& heap, const HeapObject* obj, Visit visit) {
+  std::vector<const HeapObject*> pending{obj};
+  while (!pending.empty()) {
+    const HeapObject* node = pending.back();
+    pending.pop_back();
+    if (!IsString(node)) continue;
+    if (GetStringEncoding(node) == StringEncoding::Rope) {
+      pending.push_back(heap.Get(ReadU32Payload(node->payload, kStringDataOffset + 4)));
+      pending.push_back(heap.Get(ReadU32Payload(node->payload, kStringDataOffset)));
+      continue;
+    }
+    visit(SpanOf(heap, node));
+  }
+}
+
+// Concatenation of two strings that are not ropes, copied flat.
+uint32_t ConcatFlat(Heap& heap, uint32_t left, uint32_t right) {
+  const Span a = SpanOf(heap, heap.Get(left));
+  const Span b = SpanOf(heap, heap.Get(right));
+  const bool wide = IsWide(a) || IsWide(b);
+  uint32_t handle = Heap::kNoHandle;
+  uint8_t* out = AllocateFlat(heap, a.length + b.length, wide, &handle);
+  if (!out) return Heap::kNoHandle;
+  // Allocation moves nothing, so the spans are still valid.
+  out = CopyUnits(a, out, wide);
+  CopyUnits(b, out, wide);
+  return handle;
+}
+
+// Allocates a rope or slice: the header followed by two u32 fields, the
+// first of them (and for a rope the second too) a handle.
+uint32_t MakeNode(Heap& heap, StringEncoding encoding, uint32_t length, uint32_t first, uint32_t second) {
+  uint32_t handle = heap.Allocate(ObjectKind::String, 0, kStringDataOffset + kNodeSize, true);
+  HeapObject* obj = heap.Get(handle);
+  if (!obj) return Heap::kNoHandle;
+  uint8_t* payload = obj->payload.data();
+  WriteHeader(payload, length, encoding);
+  WriteU32(payload + kStringDataOffset, first);
+  WriteU32(payload + kStringDataOffset + 4, second);
+  heap.RecordWrite(handle, first);
+  if (encoding == StringEncoding::Rope) heap.RecordWrite(handle, second);
+  return handle;
+}
+
+} // namespace
+
+bool IsString(const HeapObject* obj) {
+  return obj && obj->header.kind == ObjectKind::String && obj->payload.size() >= kStringDataOffset;
+}
+
+uint32_t StringLength(const HeapObject* obj) {
+  return IsString(obj) ? ReadU32Payload(obj->payload, 0) : 0;
+}
+
+StringEncoding GetStringEncoding(const HeapObject* obj) {
+  if (!IsString(obj)) return StringEncoding::Latin1;
+  return static_cast<StringEncoding>(obj->payload[kStringEncodingOffset]);
+}
+
+uint16_t StringUnitAt(const Heap& heap, const HeapObject* obj, uint32_t index) {
+  return UnitAt(SpanOf(heap, obj), index);
+}
+
+uint32_t CreateString(Heap& heap, const std::u16string& text) {
+  if (text.size() > kMaxStringLength) return Heap::kNoHandle;
+  bool wide = false;
+  for (char16_t c : text) {
+    if (c > 0xFFu) {
+      wide = true;
+      break;
+    }
+  }
+  const uint32_t length = static_cast<uint32_t>(text.size());
+  uint32_t handle = Heap::kNoHandle;
+  uint8_t* out = AllocateFlat(heap, length, wide, &handle);
+  if (!out) return Heap::kNoHandle;
+  for (char16_t c : text) {
+    *out++ = static_cast<uint8_t>(c & 0xFF);
+    if (wide) *out++ = static_cast<uint8_t>((c >> 8) & 0xFF);
+  }
+  return handle;
+}
+
+uint32_t CreateLatin1String(Heap& heap, const char* data, std::size_t length) {
+  if (length > kMaxStringLength) return Heap::kNoHandle;
+  uint32_t handle = Heap::kNoHandle;
+  uint8_t* out = AllocateFlat(heap, static_cast<uint32_t>(length), false, &handle);
+  if (!out) return Heap::kNoHandle;
+  if (length > 0) std::memcpy(out, data, length);
+  return handle;
+}
+
+uint32_t ConcatStrings(Heap& heap, uint32_t left, uint32_t right) {
+  const HeapObject* a = heap.Get(left);
+  const HeapObject* b = heap.Get(right);
+  if (!IsString(a) || !IsString(b)) return Heap::kNoHandle;
+  const uint64_t total = static_cast<uint64_t>(StringLength(a)) + StringLength(b);
+  if (total > kMaxStringLength) return Heap::kNoHandle;
+  const uint32_t length = static_cast<uint32_t>(total);
+  // Ropes are never shorter than kMinRopeLength, so neither side is one here.
+  if (length < kMinRopeLength) return ConcatFlat(heap, left, right);
+  // Appending a short piece to a rope that ends in a short piece: merge the
+  // two pieces, so a loop of small appends makes one rope node per
+  // kMinRopeLength units rather than one per append.
+  if (GetStringEncoding(a) == StringEncoding::Rope && GetStringEncoding(b) != StringEncoding::Rope) {
+    const uint32_t tail = ReadU32Payload(a->payload, kStringDataOffset + 4);
+    const HeapObject* tail_obj = heap.Get(tail);
+    if (IsString(tail_obj) && GetStringEncoding(tail_obj) != StringEncoding::Rope &&
+        StringLength(tail_obj) + StringLength(b) < kMinRopeLength) {
+      const uint32_t head = ReadU32Payload(a->payload, kStringDataOffset);
+      const uint32_t merged = ConcatFlat(heap, tail, right);
+      if (merged == Heap::kNoHandle) return Heap::kNoHandle;
+      return MakeNode(heap, StringEncoding::Rope, length, head, merged);
+    }
+  }
+  return MakeNode(heap, StringEncoding::Rope, length, left, right);
+}
+
+uint32_t SliceString(Heap& heap, uint32_t handle, uint32_t start, uint32_t end) {
+  if (!FlattenString(heap, handle)) return Heap::kNoHandle;
+  const HeapObject* obj = heap.Get(handle);
+  if (!IsString(obj) || start > end || end > StringLength(obj)) return Heap::kNoHandle;
+  Span span = SpanOf(heap, obj);
+  span.offset += start;
+  span.length = end - start;
+  // Copy slices no bigger than a view would be; they also stop a short
+  // token from keeping a large parent alive.
+  if (span.length * (IsWide(span) ? 2u : 1u) <= kNodeSize) {
+    const bool wide = IsWide(span);
+    uint32_t copy = Heap::kNoHandle;
+    uint8_t* out = AllocateFlat(heap, span.length, wide, &copy);
+    if (!out) return Heap::kNoHandle;
+    CopyUnits(span, out, wide);
+    return copy;
+  }
+  // Views always point at a flat string: slicing a slice refers to its parent.
+  uint32_t parent = handle;
+  if (GetStringEncoding(obj) == StringEncoding::Slice) parent = ReadU32Payload(obj->payload, kStringDataOffset);
+  return MakeNode(heap, StringEncoding::Slice, span.length, parent, span.offset);
+}
+
+bool FlattenString(Heap& heap, uint32_t handle) {
+  HeapObject* obj = heap.Get(handle);
+  if (GetStringEncoding(obj) != StringEncoding::Rope) return true;
+  std::vector<Span> spans;
+  bool wide = false;
+  ForEachSpan(heap, obj, [&](const Span& span) {
+    spans.push_back(span);
+    wide = wide || IsWide(span);
+  });
+  const uint32_t length = StringLength(obj);
+  std::vector<uint8_t> units(static_cast<std::size_t>(length) * (wide ? 2 : 1));
+  uint8_t* out = units.data();
+  for (const Span& span : spans) out = CopyUnits(span, out, wide);
+  // The halves are about to be dropped; an incremental cycle must still see
+  // them.
+  heap.RecordOverwrite(handle);
+  if (!heap.ResizePayload(obj, FlatSize(length, wide))) return false;
+  obj->header.ref_elements = 0;
+  WriteHeader(obj->payload.data(), length, wide ? StringEncoding::Utf16 : StringEncoding::Latin1);
+  if (!units.empty()) std::memcpy(obj->payload.data() + kStringDataOffset, units.data(), units.size());
+  return true;
+}
+
+std::u16string ReadString(const Heap& heap, const HeapObject* obj) {
+  std::u16string out;
+  if (!IsString(obj)) return out;
+  out.reserve(StringLength(obj));
+  ForEachSpan(heap, obj, [&](const Span& span) {
+    for (uint32_t i = 0; i < span.length; ++i) out.push_back(static_cast<char16_t>(UnitAt(span, i)));
+  });
+  return out;
+}
+
+std::string ReadAsciiString(const Heap& heap, const HeapObject* obj) {
+  std::string out;
+  AppendAsciiString(heap, obj, &out);
+  return out;
+}
+
+void AppendAsciiString(const Heap& heap, const HeapObject* obj, std::string* out) {
+  if (!IsString(obj)) return;
+  out->reserve(out->size() + StringLength(obj));
+  ForEachSpan(heap, obj, [&](const Span& span) {
+    for (uint32_t i = 0; i < span.length; ++i) {
+      const uint16_t unit = UnitAt(span, i);
+      out->push_back(unit <= 0x7Fu ? static_cast<char>(unit) : '?');
+    }
+  });
+}
+
+char* CopyAsciiString(const Heap& heap, const HeapObject* obj, char* out) {
+  if (!IsString(obj)) return out;
+  ForEachSpan(heap, obj, [&](const Span& span) {
+    for (uint32_t i = 0; i < span.length; ++i) {
+      const uint16_t unit = UnitAt(span, i);
+      *out++ = unit <= 0x7Fu ? static_cast<char>(unit) : '?';
+    }
+  });
+  return out;
+}
+
+uint32_t StringHash(Heap& heap, uint32_t handle) {
+  HeapObject* obj = heap.Get(handle);
+  if (!IsString(obj)) return 0;
+  uint32_t hash = ReadU32Payload(obj->payload, kStringHashOffset);
+  if (hash != 0) return hash;
+  const bool cached = FlattenString(heap, handle);
+  hash = 2166136261u;
+  ForEachSpan(heap, obj, [&](const Span& span) {
+    for (uint32_t i = 0; i < span.length; ++i) {
+      const uint16_t unit = UnitAt(span, i);
+      hash = (hash ^ static_cast<uint32_t>(unit & 0xFF)) * 16777619u;
+      hash = (hash ^ static_cast<uint32_t>(unit >> 8)) * 16777619u;
+    }
+  });
+  if (hash == 0) hash = 1;
+  if (cached) WriteU32(obj->payload.data() + kStringHashOffset, hash);
+  return hash;
+}
+
+} // namespace Simple::VM
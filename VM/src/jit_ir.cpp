@@ -0,0 +1,1192 @@
+#include "jit_ir.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include "decoded_code.h"
+
+namespace Simple::VM {
+
+namespace {
+
+using Simple::Byte::OpCode;
+
+constexpr size_t kMaxIrLocals = 256;
+constexpr size_t kMaxIrStack = 1024;
+constexpr int kMaxOptimizeRounds = 4;
+
+bool Fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+bool IsUnaryOp(OpCode op) {
+  switch (op) {
+    case OpCode::NegI32:
+    case OpCode::NegI64:
+    case OpCode::NegU32:
+    case OpCode::NegU64:
+    case OpCode::NegI8:
+    case OpCode::NegI16:
+    case OpCode::NegU8:
+    case OpCode::NegU16:
+    case OpCode::NegF32:
+    case OpCode::NegF64:
+    case OpCode::IncI32:
+    case OpCode::DecI32:
+    case OpCode::IncI64:
+    case OpCode::DecI64:
+    case OpCode::IncU32:
+    case OpCode::DecU32:
+    case OpCode::IncU64:
+    case OpCode::DecU64:
+    case OpCode::IncI8:
+    case OpCode::DecI8:
+    case OpCode::IncI16:
+    case OpCode::DecI16:
+    case OpCode::IncU8:
+    case OpCode::DecU8:
+    case OpCode::IncU16:
+    case OpCode::DecU16:
+    case OpCode::IncF32:
+    case OpCode::DecF32:
+    case OpCode::IncF64:
+    case OpCode::DecF64:
+    case OpCode::ConvI32ToI64:
+    case OpCode::ConvI64ToI32:
+    case OpCode::ConvI32ToF32:
+    case OpCode::ConvI32ToF64:
+    case OpCode::ConvF32ToI32:
+    case OpCode::ConvF64ToI32:
+    case OpCode::ConvF32ToF64:
+    case OpCode::ConvF64ToF32:
+    case OpCode::BoolNot:
+    case OpCode::IsNull:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsBinaryOp(OpCode op) {
+  switch (op) {
+    case OpCode::AddI32:
+    case OpCode::SubI32:
+    case OpCode::MulI32:
+    case OpCode::DivI32:
+    case OpCode::ModI32:
+    case OpCode::AddI64:
+    case OpCode::SubI64:
+    case OpCode::MulI64:
+    case OpCode::DivI64:
+    case OpCode::ModI64:
+    case OpCode::AddU32:
+    case OpCode::SubU32:
+    case OpCode::MulU32:
+    case OpCode::DivU32:
+    case OpCode::ModU32:
+    case OpCode::AddU64:
+    case OpCode::SubU64:
+    case OpCode::MulU64:
+    case OpCode::DivU64:
+    case OpCode::ModU64:
+    case OpCode::AddF32:
+    case OpCode::SubF32:
+    case OpCode::MulF32:
+    case OpCode::DivF32:
+    case OpCode::AddF64:
+    case OpCode::SubF64:
+    case OpCode::MulF64:
+    case OpCode::DivF64:
+    case OpCode::AndI32:
+    case OpCode::OrI32:
+    case OpCode::XorI32:
+    case OpCode::ShlI32:
+    case OpCode::ShrI32:
+    case OpCode::AndI64:
+    case OpCode::OrI64:
+    case OpCode::XorI64:
+    case OpCode::ShlI64:
+    case OpCode::ShrI64:
+    case OpCode::CmpEqI32:
+    case OpCode::CmpNeI32:
+    case OpCode::CmpLtI32:
+    case OpCode::CmpLeI32:
+    case OpCode::CmpGtI32:
+    case OpCode::CmpGeI32:
+    case OpCode::CmpEqU32:
+    case OpCode::CmpNeU32:
+    case OpCode::CmpLtU32:
+    case OpCode::CmpLeU32:
+    case OpCode::CmpGtU32:
+    case OpCode::CmpGeU32:
+    case OpCode::CmpEqI64:
+    case OpCode::CmpNeI64:
+    case OpCode::CmpLtI64:
+    case OpCode::CmpLeI64:
+    case OpCode::CmpGtI64:
+    case OpCode::CmpGeI64:
+    case OpCode::CmpEqU64:
+    case OpCode::CmpNeU64:
+    case OpCode::CmpLtU64:
+    case OpCode::CmpLeU64:
+    case OpCode::CmpGtU64:
+    case OpCode::CmpGeU64:
+    case OpCode::CmpEqF32:
+    case OpCode::CmpNeF32:
+    case OpCode::CmpLtF32:
+    case OpCode::CmpLeF32:
+    case OpCode::CmpGtF32:
+    case OpCode::CmpGeF32:
+    case OpCode::CmpEqF64:
+    case OpCode::CmpNeF64:
+    case OpCode::CmpLtF64:
+    case OpCode::CmpLeF64:
+    case OpCode::CmpGtF64:
+    case OpCode::CmpGeF64:
+    case OpCode::BoolAnd:
+    case OpCode::BoolOr:
+    case OpCode::RefEq:
+    case OpCode::RefNe:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Constant bit patterns for CONST_* operands, matching the Tier1 packing.
+uint64_t ConstBits(OpCode op, uint64_t operand) {
+  switch (op) {
+    case OpCode::ConstI8:
+      return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int8_t>(operand)));
+    case OpCode::ConstI16:
+      return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(operand)));
+    case OpCode::ConstBool:
+      return operand != 0 ? 1u : 0u;
+    case OpCode::ConstNull:
+      return 0xFFFFFFFFu;
+    case OpCode::ConstI64:
+    case OpCode::ConstU64:
+    case OpCode::ConstF64:
+      return operand;
+    default:
+      return static_cast<uint32_t>(operand);
+  }
+}
+
+bool IsConstOp(OpCode op) {
+  switch (op) {
+    case OpCode::ConstI8:
+    case OpCode::ConstI16:
+    case OpCode::ConstI32:
+    case OpCode::ConstI64:
+    case OpCode::ConstU8:
+    case OpCode::ConstU16:
+    case OpCode::ConstU32:
+    case OpCode::ConstU64:
+    case OpCode::ConstF32:
+    case OpCode::ConstF64:
+    case OpCode::ConstBool:
+    case OpCode::ConstChar:
+    case OpCode::ConstNull:
+      return true;
+    default:
+      return false;
+  }
+}
+
+float F32(uint64_t bits) {
+  uint32_t raw = static_cast<uint32_t>(bits);
+  float out = 0.0f;
+  std::memcpy(&out, &raw, sizeof(out));
+  return out;
+}
+
+double F64(uint64_t bits) {
+  double out = 0.0;
+  std::memcpy(&out, &bits, sizeof(out));
+  return out;
+}
+
+uint64_t PackF32(float value) {
+  uint32_t raw = 0;
+  std::memcpy(&raw, &value, sizeof(raw));
+  return raw;
+}
+
+uint64_t PackF64(double value) {
+  uint64_t raw = 0;
+  std::memcpy(&raw, &value, sizeof(raw));
+  return raw;
+}
+
+// ---------------------------------------------------------------------------
+// Lowering
+
+struct Lowering {
+  IrFunction& func;
+  IrBlock* block = nullptr;
+
+  uint32_t NewTemp() { return func.value_count++; }
+  uint32_t StackHome(size_t depth) const { return func.locals + static_cast<uint32_t>(depth); }
+
+  IrInst& Emit(IrKind kind) {
+    block->insts.emplace_back();
+    block->insts.back().kind = kind;
+    return block->insts.back();
+  }
+  uint32_t EmitMove(uint32_t src) {
+    IrInst& inst = Emit(IrKind::Move);
+    inst.dst = NewTemp();
+    inst.a = src;
+    return inst.dst;
+  }
+
+  // Writes the block's stack and locals back to their homes. Homes that are
+  // both read and overwritten here are first copied to temporaries so the
+  // moves behave as one parallel copy. *keep (a branch condition) is
+  // protected the same way.
+  void Flush(std::vector<uint32_t>& stack, std::vector<uint32_t>& locals, uint32_t* keep) {
+    std::vector<std::pair<uint32_t, uint32_t>> moves;
+    std::vector<bool> written(func.locals + func.stack_homes, false);
+    for (size_t i = 0; i < stack.size(); ++i) {
+      if (stack[i] != StackHome(i)) {
+        moves.emplace_back(StackHome(i), stack[i]);
+        written[StackHome(i)] = true;
+      }
+    }
+    for (uint32_t i = 0; i < locals.size(); ++i) {
+      if (locals[i] != i) {
+        moves.emplace_back(i, locals[i]);
+        written[i] = true;
+      }
+    }
+    if (keep && func.IsHome(*keep) && written[*keep]) *keep = EmitMove(*keep);
+    for (auto& move : moves) {
+      if (func.IsHome(move.second) && written[move.second]) move.second = EmitMove(move.second);
+    }
+    for (const auto& move : moves) {
+      IrInst& inst = Emit(IrKind::Move);
+      inst.dst = move.first;
+      inst.a = move.second;
+    }
+  }
+};
+
+// ---------------------------------------------------------------------------
+// Optimization
+
+bool IsPure(IrKind kind) {
+  return kind == IrKind::Const || kind == IrKind::Move || kind == IrKind::Unary || kind == IrKind::Binary;
+}
+
+struct CseKey {
+  OpCode op;
+  uint32_t a;
+  uint32_t b;
+  bool operator==(const CseKey& other) const { return op == other.op && a == other.a && b == other.b; }
+};
+
+struct CseKeyHash {
+  size_t operator()(const CseKey& key) const {
+    return (static_cast<size_t>(key.op) * 31u + key.a) * 1000003u + key.b;
+  }
+};
+
+struct ConstTable {
+  std::vector<uint8_t> known;
+  std::vector<uint64_t> bits;
+  bool Get(uint32_t value, uint64_t* out) const {
+    if (value == kNoIrValue || value >= known.size() || !known[value]) return false;
+    *out = bits[value];
+    return true;
+  }
+};
+
+ConstTable CollectConsts(const IrFunction& func) {
+  ConstTable table;
+  table.known.assign(func.value_count, 0);
+  table.bits.assign(func.value_count, 0);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.insts) {
+      if (inst.kind == IrKind::Const && !func.IsHome(inst.dst)) {
+        table.known[inst.dst] = 1;
+        table.bits[inst.dst] = inst.imm;
+      }
+    }
+  }
+  return table;
+}
+
+// An op that can bail must stay even when its result is unused.
+bool CanBail(const IrInst& inst, const ConstTable& consts) {
+  if (inst.kind != IrKind::Binary) return false;
+  if (inst.op != OpCode::DivI32 && inst.op != OpCode::ModI32) return false;
+  uint64_t divisor = 0;
+  return !consts.Get(inst.b, &divisor) || static_cast<uint32_t>(divisor) == 0;
+}
+
+// Constant folding, copy propagation and CSE in one forward pass per block.
+bool ForwardPass(IrFunction& func) {
+  bool changed = false;
+  ConstTable consts = CollectConsts(func);
+  std::vector<uint32_t> copy_of(func.value_count, kNoIrValue);
+  for (auto& block : func.blocks) {
+    std::vector<uint32_t> copies;
+    std::unordered_map<CseKey, uint32_t, CseKeyHash> available;
+    std::unordered_map<uint64_t, uint32_t> const_temps;
+    auto resolve = [&](uint32_t& value) {
+      if (value == kNoIrValue || func.IsHome(value)) return;
+      if (copy_of[value] != kNoIrValue) {
+        value = copy_of[value];
+        changed = true;
+      }
+    };
+    auto make_const = [&](IrInst& inst, uint64_t bits) {
+      inst.kind = IrKind::Const;
+      inst.imm = bits;
+      inst.a = kNoIrValue;
+      inst.b = kNoIrValue;
+      consts.known[inst.dst] = 1;
+      consts.bits[inst.dst] = bits;
+      changed = true;
+    };
+    for (auto& inst : block.insts) {
+      resolve(inst.a);
+      resolve(inst.b);
+      for (auto& arg : inst.args) resolve(arg);
+      uint64_t a_bits = 0;
+      uint64_t b_bits = 0;
+      switch (inst.kind) {
+        case IrKind::Const: {
+          // Equal constants share one temp so CSE sees equal operands.
+          if (func.IsHome(inst.dst)) break;
+          auto found = const_temps.emplace(inst.imm, inst.dst);
+          if (!found.second && found.first->second != inst.dst) {
+            copy_of[inst.dst] = found.first->second;
+            copies.push_back(inst.dst);
+          }
+          break;
+        }
+        case IrKind::Move:
+          if (func.IsHome(inst.dst)) {
+            // A home write ends every fact that read the home's old value.
+            for (uint32_t temp : copies) {
+              if (copy_of[temp] == inst.dst) copy_of[temp] = kNoIrValue;
+            }
+            for (auto it = available.begin(); it != available.end();) {
+              if (it->first.a == inst.dst || it->first.b == inst.dst) {
+                it = available.erase(it);
+              } else {
+                ++it;
+              }
+            }
+          } else if (consts.Get(inst.a, &a_bits)) {
+            make_const(inst, a_bits);
+          } else {
+            copy_of[inst.dst] = inst.a;
+            copies.push_back(inst.dst);
+          }
+          break;
+        case IrKind::Unary:
+        case IrKind::Binary: {
+          bool have_a = consts.Get(inst.a, &a_bits);
+          bool have_b = inst.kind == IrKind::Unary || consts.Get(inst.b, &b_bits);
+          uint64_t folded = 0;
+          if (have_a && have_b && EvalIrOp(inst.op, a_bits, b_bits, &folded)) {
+            make_const(inst, folded);
+            break;
+          }
+          CseKey key{inst.op, inst.a, inst.kind == IrKind::Unary ? kNoIrValue : inst.b};
+          auto found = available.find(key);
+          if (found != available.end()) {
+            inst.kind = IrKind::Move;
+            inst.a = found->second;
+            inst.b = kNoIrValue;
+            copy_of[inst.dst] = found->second;
+            copies.push_back(inst.dst);
+            changed = true;
+          } else {
+            available.emplace(key, inst.dst);
+          }
+          break;
+        }
+        case IrKind::Branch:
+          if (consts.Get(inst.a, &a_bits)) {
+            bool take = static_cast<uint32_t>(a_bits) != 0;
+            if (inst.op == OpCode::JmpFalse) take = !take;
+            inst.kind = IrKind::Jump;
+            if (!take) inst.target = inst.fallthrough;
+            inst.a = kNoIrValue;
+            changed = true;
+          }
+          break;
+        default:
+          break;
+      }
+    }
+  }
+  return changed;
+}
+
+void ForEachSuccessor(const IrBlock& block, const std::function<void(uint32_t)>& fn) {
+  if (block.insts.empty()) return;
+  const IrInst& last = block.insts.back();
+  if (last.kind == IrKind::Jump) fn(last.target);
+  if (last.kind == IrKind::Branch) {
+    fn(last.target);
+    fn(last.fallthrough);
+  }
+}
+
+bool RemoveUnreachable(IrFunction& func) {
+  std::vector<uint8_t> reached(func.blocks.size(), 0);
+  std::vector<uint32_t> work{0};
+  reached[0] = 1;
+  while (!work.empty()) {
+    uint32_t id = work.back();
+    work.pop_back();
+    ForEachSuccessor(func.blocks[id], [&](uint32_t next) {
+      if (!reached[next]) {
+        reached[next] = 1;
+        work.push_back(next);
+      }
+    });
+  }
+  bool changed = false;
+  for (size_t i = 0; i < func.blocks.size(); ++i) {
+    auto& insts = func.blocks[i].insts;
+    if (reached[i] || (insts.size() == 1 && insts[0].kind == IrKind::Bail)) continue;
+    insts.assign(1, IrInst{});
+    changed = true;
+  }
+  return changed;
+}
+
+template <typename Fn>
+void ForEachUse(const IrInst& inst, Fn fn) {
+  if (inst.a != kNoIrValue) fn(inst.a);
+  if (inst.b != kNoIrValue) fn(inst.b);
+  for (uint32_t arg : inst.args) fn(arg);
+}
+
+// Backward liveness over homes, then a sweep that drops pure instructions
+// whose result is never read.
+bool DeadCodePass(IrFunction& func) {
+  const uint32_t homes = func.locals + func.stack_homes;
+  const size_t count = func.blocks.size();
+  std::vector<std::vector<uint8_t>> live_in(count, std::vector<uint8_t>(homes, 0));
+  std::vector<std::vector<uint8_t>> live_out(count, std::vector<uint8_t>(homes, 0));
+  bool changed_live = true;
+  while (changed_live) {
+    changed_live = false;
+    for (size_t i = count; i-- > 0;) {
+      std::vector<uint8_t> out(homes, 0);
+      ForEachSuccessor(func.blocks[i], [&](uint32_t next) {
+        for (uint32_t v = 0; v < homes; ++v) out[v] |= live_in[next][v];
+      });
+      std::vector<uint8_t> in = out;
+      const auto& insts = func.blocks[i].insts;
+      for (size_t j = insts.size(); j-- > 0;) {
+        if (insts[j].dst != kNoIrValue && insts[j].dst < homes) in[insts[j].dst] = 0;
+        ForEachUse(insts[j], [&](uint32_t v) {
+          if (v < homes) in[v] = 1;
+        });
+      }
+      if (out != live_out[i] || in != live_in[i]) {
+        live_out[i] = std::move(out);
+        live_in[i] = std::move(in);
+        changed_live = true;
+      }
+    }
+  }
+
+  bool changed = false;
+  ConstTable consts = CollectConsts(func);
+  std::vector<uint8_t> live(func.value_count, 0);
+  for (size_t i = 0; i < count; ++i) {
+    std::fill(live.begin(), live.end(), 0);
+    std::copy(live_out[i].begin(), live_out[i].end(), live.begin());
+    auto& insts = func.blocks[i].insts;
+    std::vector<IrInst> kept;
+    kept.reserve(insts.size());
+    for (size_t j = insts.size(); j-- > 0;) {
+      IrInst& inst = insts[j];
+      bool dead = IsPure(inst.kind) && !live[inst.dst] && !CanBail(inst, consts);
+      if (inst.kind == IrKind::Move && inst.a == inst.dst) dead = true;
+      if (dead) {
+        changed = true;
+        continue;
+      }
+      if (inst.dst != kNoIrValue) live[inst.dst] = 0;
+      ForEachUse(inst, [&](uint32_t v) { live[v] = 1; });
+      kept.push_back(std::move(inst));
+    }
+    insts.assign(std::make_move_iterator(kept.rbegin()), std::make_move_iterator(kept.rend()));
+  }
+  return changed;
+}
+
+} // namespace
+
+bool EvalIrOp(OpCode op, uint64_t a, uint64_t b, uint64_t* out) {
+  const uint32_t ua = static_cast<uint32_t>(a);
+  const uint32_t ub = static_cast<uint32_t>(b);
+  const int32_t ia = static_cast<int32_t>(ua);
+  const int32_t ib = static_cast<int32_t>(ub);
+  const int64_t la = static_cast<int64_t>(a);
+  const int64_t lb = static_cast<int64_t>(b);
+  auto bool_bits = [](bool value) -> uint64_t { return value ? 1u : 0u; };
+  auto narrow = [&](OpCode narrow_op, uint32_t value) -> uint64_t {
+    switch (narrow_op) {
+      case OpCode::NegI8:
+      case OpCode::IncI8:
+      case OpCode::DecI8:
+        return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int8_t>(value)));
+      case OpCode::NegI16:
+      case OpCode::IncI16:
+      case OpCode::DecI16:
+        return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(value)));
+      case OpCode::NegU8:
+      case OpCode::IncU8:
+      case OpCode::DecU8:
+        return static_cast<uint8_t>(value);
+      default:
+        return static_cast<uint16_t>(value);
+    }
+  };
+  switch (op) {
+    case OpCode::AddI32:
+    case OpCode::AddU32:
+      *out = static_cast<uint32_t>(ua + ub);
+      return true;
+    case OpCode::SubI32:
+    case OpCode::SubU32:
+      *out = static_cast<uint32_t>(ua - ub);
+      return true;
+    case OpCode::MulI32:
+    case OpCode::MulU32:
+      *out = static_cast<uint32_t>(ua * ub);
+      return true;
+    case OpCode::DivI32:
+      if (ib == 0) return false;
+      *out = ib == -1 ? static_cast<uint32_t>(0u - ua) : static_cast<uint32_t>(ia / ib);
+      return true;
+    case OpCode::ModI32:
+      if (ib == 0) return false;
+      *out = ib == -1 ? 0u : static_cast<uint32_t>(ia % ib);
+      return true;
+    case OpCode::DivU32:
+      *out = ub == 0 ? 0u : ua / ub;
+      return true;
+    case OpCode::ModU32:
+      *out = ub == 0 ? 0u : ua % ub;
+      return true;
+    case OpCode::AddI64:
+    case OpCode::AddU64:
+      *out = a + b;
+      return true;
+    case OpCode::SubI64:
+    case OpCode::SubU64:
+      *out = a - b;
+      return true;
+    case OpCode::MulI64:
+    case OpCode::MulU64:
+      *out = a * b;
+      return true;
+    case OpCode::DivI64:
+      *out = lb == 0 ? 0u : (lb == -1 ? 0u - a : static_cast<uint64_t>(la / lb));
+      return true;
+    case OpCode::ModI64:
+      *out = (lb == 0 || lb == -1) ? 0u : static_cast<uint64_t>(la % lb);
+      return true;
+    case OpCode::DivU64:
+      *out = b == 0 ? 0u : a / b;
+      return true;
+    case OpCode::ModU64:
+      *out = b == 0 ? 0u : a % b;
+      return true;
+    case OpCode::AndI32:
+      *out = ua & ub;
+      return true;
+    case OpCode::OrI32:
+      *out = ua | ub;
+      return true;
+    case OpCode::XorI32:
+      *out = ua ^ ub;
+      return true;
+    case OpCode::ShlI32:
+      *out = static_cast<uint32_t>(ua << (ub & 31u));
+      return true;
+    case OpCode::ShrI32:
+      *out = ua >> (ub & 31u);
+      return true;
+    case OpCode::AndI64:
+      *out = a & b;
+      return true;
+    case OpCode::OrI64:
+      *out = a | b;
+      return true;
+    case OpCode::XorI64:
+      *out = a ^ b;
+      return true;
+    case OpCode::ShlI64:
+      *out = a << (b & 63u);
+      return true;
+    case OpCode::ShrI64:
+      *out = a >> (b & 63u);
+      return true;
+    case OpCode::AddF32:
+      *out = PackF32(F32(a) + F32(b));
+      return true;
+    case OpCode::SubF32:
+      *out = PackF32(F32(a) - F32(b));
+      return true;
+    case OpCode::MulF32:
+      *out = PackF32(F32(a) * F32(b));
+      return true;
+    case OpCode::DivF32:
+      *out = PackF32(F32(b) == 0.0f ? 0.0f : F32(a) / F32(b));
+      return true;
+    case OpCode::AddF64:
+      *out = PackF64(F64(a) + F64(b));
+      return true;
+    case OpCode::SubF64:
+      *out = PackF64(F64(a) - F64(b));
+      return true;
+    case OpCode::MulF64:
+      *out = PackF64(F64(a) * F64(b));
+      return true;
+    case OpCode::DivF64:
+      *out = PackF64(F64(b) == 0.0 ? 0.0 : F64(a) / F64(b));
+      return true;
+    case OpCode::CmpEqI32:
+    case OpCode::CmpEqU32:
+      *out = bool_bits(ua == ub);
+      return true;
+    case OpCode::CmpNeI32:
+    case OpCode::CmpNeU32:
+      *out = bool_bits(ua != ub);
+      return true;
+    case OpCode::CmpLtI32:
+      *out = bool_bits(ia < ib);
+      return true;
+    case OpCode::CmpLeI32:
+      *out = bool_bits(ia <= ib);
+      return true;
+    case OpCode::CmpGtI32:
+      *out = bool_bits(ia > ib);
+      return true;
+    case OpCode::CmpGeI32:
+      *out = bool_bits(ia >= ib);
+      return true;
+    case OpCode::CmpLtU32:
+      *out = bool_bits(ua < ub);
+      return true;
+    case OpCode::CmpLeU32:
+      *out = bool_bits(ua <= ub);
+      return true;
+    case OpCode::CmpGtU32:
+      *out = bool_bits(ua > ub);
+      return true;
+    case OpCode::CmpGeU32:
+      *out = bool_bits(ua >= ub);
+      return true;
+    case OpCode::CmpEqI64:
+    case OpCode::CmpEqU64:
+      *out = bool_bits(a == b);
+      return true;
+    case OpCode::CmpNeI64:
+    case OpCode::CmpNeU64:
+      *out = bool_bits(a != b);
+      return true;
+    case OpCode::CmpLtI64:
+      *out = bool_bits(la < lb);
+      return true;
+    case OpCode::CmpLeI64:
+      *out = bool_bits(la <= lb);
+      return true;
+    case OpCode::CmpGtI64:
+      *out = bool_bits(la > lb);
+      return true;
+    case OpCode::CmpGeI64:
+      *out = bool_bits(la >= lb);
+      return true;
+    case OpCode::CmpLtU64:
+      *out = bool_bits(a < b);
+      return true;
+    case OpCode::CmpLeU64:
+      *out = bool_bits(a <= b);
+      return true;
+    case OpCode::CmpGtU64:
+      *out = bool_bits(a > b);
+      return true;
+    case OpCode::CmpGeU64:
+      *out = bool_bits(a >= b);
+      return true;
+    case OpCode::CmpEqF32:
+      *out = bool_bits(F32(a) == F32(b));
+      return true;
+    case OpCode::CmpNeF32:
+      *out = bool_bits(F32(a) != F32(b));
+      return true;
+    case OpCode::CmpLtF32:
+      *out = bool_bits(F32(a) < F32(b));
+      return true;
+    case OpCode::CmpLeF32:
+      *out = bool_bits(F32(a) <= F32(b));
+      return true;
+    case OpCode::CmpGtF32:
+      *out = bool_bits(F32(a) > F32(b));
+      return true;
+    case OpCode::CmpGeF32:
+      *out = bool_bits(F32(a) >= F32(b));
+      return true;
+    case OpCode::CmpEqF64:
+      *out = bool_bits(F64(a) == F64(b));
+      return true;
+    case OpCode::CmpNeF64:
+      *out = bool_bits(F64(a) != F64(b));
+      return true;
+    case OpCode::CmpLtF64:
+      *out = bool_bits(F64(a) < F64(b));
+      return true;
+    case OpCode::CmpLeF64:
+      *out = bool_bits(F64(a) <= F64(b));
+      return true;
+    case OpCode::CmpGtF64:
+      *out = bool_bits(F64(a) > F64(b));
+      return true;
+    case OpCode::CmpGeF64:
+      *out = bool_bits(F64(a) >= F64(b));
+      return true;
+    case OpCode::BoolAnd:
+      *out = bool_bits(ua != 0 && ub != 0);
+      return true;
+    case OpCode::BoolOr:
+      *out = bool_bits(ua != 0 || ub != 0);
+      return true;
+    case OpCode::RefEq:
+      *out = bool_bits(a == b);
+      return true;
+    case OpCode::RefNe:
+      *out = bool_bits(a != b);
+      return true;
+    case OpCode::NegI32:
+    case OpCode::NegU32:
+      *out = static_cast<uint32_t>(0u - ua);
+      return true;
+    case OpCode::NegI64:
+    case OpCode::NegU64:
+      *out = 0u - a;
+      return true;
+    case OpCode::IncI32:
+    case OpCode::IncU32:
+      *out = static_cast<uint32_t>(ua + 1u);
+      return true;
+    case OpCode::DecI32:
+    case OpCode::DecU32:
+      *out = static_cast<uint32_t>(ua - 1u);
+      return true;
+    case OpCode::IncI64:
+    case OpCode::IncU64:
+      *out = a + 1u;
+      return true;
+    case OpCode::DecI64:
+    case OpCode::DecU64:
+      *out = a - 1u;
+      return true;
+    case OpCode::NegI8:
+    case OpCode::NegI16:
+    case OpCode::NegU8:
+    case OpCode::NegU16:
+      *out = narrow(op, 0u - ua);
+      return true;
+    case OpCode::IncI8:
+    case OpCode::IncI16:
+    case OpCode::IncU8:
+    case OpCode::IncU16:
+      *out = narrow(op, ua + 1u);
+      return true;
+    case OpCode::DecI8:
+    case OpCode::DecI16:
+    case OpCode::DecU8:
+    case OpCode::DecU16:
+      *out = narrow(op, ua - 1u);
+      return true;
+    case OpCode::NegF32:
+      *out = ua ^ 0x80000000u;
+      return true;
+    case OpCode::NegF64:
+      *out = a ^ 0x8000000000000000ull;
+      return true;
+    case OpCode::IncF32:
+      *out = PackF32(F32(a) + 1.0f);
+      return true;
+    case OpCode::DecF32:
+      *out = PackF32(F32(a) - 1.0f);
+      return true;
+    case OpCode::IncF64:
+      *out = PackF64(F64(a) + 1.0);
+      return true;
+    case OpCode::DecF64:
+      *out = PackF64(F64(a) - 1.0);
+      return true;
+    case OpCode::ConvI32ToI64:
+      *out = static_cast<uint64_t>(static_cast<int64_t>(ia));
+      return true;
+    case OpCode::ConvI64ToI32:
+      *out = ua;
+      return true;
+    case OpCode::ConvI32ToF32:
+      *out = PackF32(static_cast<float>(ia));
+      return true;
+    case OpCode::ConvI32ToF64:
+      *out = PackF64(static_cast<double>(ia));
+      return true;
+    case OpCode::ConvF32ToF64:
+      *out = PackF64(static_cast<double>(F32(a)));
+      return true;
+    case OpCode::ConvF64ToF32:
+      *out = PackF32(static_cast<float>(F64(a)));
+      return true;
+    case OpCode::BoolNot:
+      *out = bool_bits(ua == 0);
+      return true;
+    case OpCode::IsNull:
+      *out = bool_bits(ua == 0xFFFFFFFFu);
+      return true;
+    default:
+      // Float -> int conversions are left to the hardware (out of range
+      // inputs have no portable C++ result to fold to).
+      return false;
+  }
+}
+
+bool LowerFunctionToIr(const Simple::Byte::SbcModule& module,
+                       size_t func_index,
+                       const Simple::Byte::MethodVerifyInfo* verify_info,
+                       const IrCalleeInfo& callee_info,
+                       IrFunction* out,
+                       std::string* error) {
+  if (!out) return Fail(error, "JIT IR missing output");
+  if (func_index >= module.functions.size()) return Fail(error, "JIT IR invalid function id");
+  const auto& func = module.functions[func_index];
+  if (func.method_id >= module.methods.size()) return Fail(error, "JIT IR invalid method id");
+  const auto& method = module.methods[func.method_id];
+  if (method.sig_id >= module.sigs.size()) return Fail(error, "JIT IR invalid signature id");
+  const uint16_t param_count = module.sigs[method.sig_id].param_count;
+  const size_t start = func.code_offset;
+  const size_t end = start + func.code_size;
+  if (end > module.code.size()) return Fail(error, "JIT IR code out of bounds");
+
+  std::vector<DecodedInst> insts;
+  std::vector<uint32_t> index_of(func.code_size + 1, kNoDecodedInst);
+  size_t locals = 0;
+  bool saw_enter = false;
+  for (size_t pc = start; pc < end;) {
+    DecodedInst inst;
+    if (!DecodeInstruction(module.code, pc, &inst) || inst.next_pc > end) {
+      return Fail(error, "JIT IR truncated instruction");
+    }
+    if (inst.opcode == static_cast<uint8_t>(OpCode::Enter)) {
+      if (saw_enter && locals != inst.a) return Fail(error, "JIT IR ENTER mismatch");
+      locals = static_cast<size_t>(inst.a);
+      saw_enter = true;
+    }
+    index_of[pc - start] = static_cast<uint32_t>(insts.size());
+    insts.push_back(inst);
+    pc = inst.next_pc;
+  }
+  if (insts.empty()) return Fail(error, "JIT IR empty function");
+  // Locals only exist once ENTER has run, so it must come first.
+  if (saw_enter && insts[0].opcode != static_cast<uint8_t>(OpCode::Enter)) {
+    return Fail(error, "JIT IR ENTER is not first");
+  }
+  if (param_count > locals) return Fail(error, "JIT IR locals < param count");
+  if (locals > kMaxIrLocals) return Fail(error, "JIT IR too many locals");
+  if (verify_info && !verify_info->locals.empty() && verify_info->locals.size() != locals) {
+    return Fail(error, "JIT IR locals disagree with verifier");
+  }
+
+  std::vector<uint8_t> call_returns(insts.size(), 0);
+  for (size_t i = 0; i < insts.size(); ++i) {
+    const OpCode op = static_cast<OpCode>(insts[i].opcode);
+    if (op == OpCode::Call) {
+      uint16_t callee_params = 0;
+      bool returns_value = false;
+      if (!callee_info || !callee_info(static_cast<uint32_t>(insts[i].a), &callee_params, &returns_value)) {
+        return Fail(error, "JIT IR callee unavailable");
+      }
+      if (callee_params != insts[i].imm8) return Fail(error, "JIT IR CALL arg count mismatch");
+      call_returns[i] = returns_value ? 1 : 0;
+      continue;
+    }
+    bool supported = IsConstOp(op) || IsUnaryOp(op) || IsBinaryOp(op);
+    switch (op) {
+      case OpCode::Enter:
+      case OpCode::Nop:
+      case OpCode::Line:
+      case OpCode::ProfileStart:
+      case OpCode::ProfileEnd:
+      case OpCode::Pop:
+      case OpCode::Dup:
+      case OpCode::Dup2:
+      case OpCode::Swap:
+      case OpCode::Rot:
+      case OpCode::LoadLocal:
+      case OpCode::StoreLocal:
+      case OpCode::Jmp:
+      case OpCode::JmpTrue:
+      case OpCode::JmpFalse:
+      case OpCode::Ret:
+        supported = true;
+        break;
+      default:
+        break;
+    }
+    if (!supported) {
+      return Fail(error, std::string("JIT IR unsupported opcode ") + Simple::Byte::OpCodeName(insts[i].opcode));
+    }
+    if ((op == OpCode::LoadLocal || op == OpCode::StoreLocal) && insts[i].a >= locals) {
+      return Fail(error, "JIT IR local index out of range");
+    }
+  }
+
+  // Operand stack height at each reachable instruction; heights must agree
+  // where control flow merges so each depth has one home.
+  constexpr int32_t kUnreached = -1;
+  constexpr int64_t kToEnd = -1;
+  constexpr int64_t kBadTarget = -2;
+  std::vector<int32_t> heights(insts.size(), kUnreached);
+  auto target_index = [&](const DecodedInst& inst) -> int64_t {
+    if (inst.a < start || inst.a > end) return kBadTarget;
+    if (inst.a == end) return kToEnd;
+    uint32_t index = index_of[static_cast<size_t>(inst.a - start)];
+    return index == kNoDecodedInst ? kBadTarget : static_cast<int64_t>(index);
+  };
+  auto is_jump = [](const DecodedInst& inst) {
+    return inst.opcode == static_cast<uint8_t>(OpCode::Jmp) ||
+           inst.opcode == static_cast<uint8_t>(OpCode::JmpTrue) ||
+           inst.opcode == static_cast<uint8_t>(OpCode::JmpFalse);
+  };
+  int ret_kind = -1;
+  size_t max_height = 0;
+  std::vector<size_t> work{0};
+  heights[0] = 0;
+  while (!work.empty()) {
+    size_t i = work.back();
+    work.pop_back();
+    const DecodedInst& inst = insts[i];
+    const int32_t h = heights[i];
+    if (inst.opcode == static_cast<uint8_t>(OpCode::Ret)) {
+      int kind = h > 0 ? 1 : 0;
+      if (ret_kind >= 0 && ret_kind != kind) return Fail(error, "JIT IR mixed RET shapes");
+      ret_kind = kind;
+      continue;
+    }
+    Simple::Byte::OpInfo info{};
+    if (!Simple::Byte::GetOpInfo(inst.opcode, &info)) return Fail(error, "JIT IR unknown opcode");
+    int pops = info.pops;
+    int pushes = info.pushes;
+    if (inst.opcode == static_cast<uint8_t>(OpCode::Call)) {
+      pops = inst.imm8;
+      pushes = call_returns[i];
+    }
+    if (h < pops) return Fail(error, "JIT IR stack underflow");
+    const int32_t next_h = h - pops + pushes;
+    if (static_cast<size_t>(next_h) > max_height) max_height = static_cast<size_t>(next_h);
+    if (max_height > kMaxIrStack) return Fail(error, "JIT IR stack too deep");
+    auto flow = [&](int64_t to) -> bool {
+      if (to == kToEnd) return true;  // falls off the end: bails at run time
+      if (to < 0) return false;
+      size_t t = static_cast<size_t>(to);
+      if (heights[t] == kUnreached) {
+        heights[t] = next_h;
+        work.push_back(t);
+        return true;
+      }
+      return heights[t] == next_h;
+    };
+    if (is_jump(inst) && !flow(target_index(inst))) return Fail(error, "JIT IR stack merge mismatch");
+    if (inst.opcode != static_cast<uint8_t>(OpCode::Jmp)) {
+      int64_t next = i + 1 < insts.size() ? static_cast<int64_t>(i + 1) : kToEnd;
+      if (!flow(next)) return Fail(error, "JIT IR stack merge mismatch");
+    }
+  }
+
+  // Blocks start at the entry, at jump targets and after jumps and RET.
+  std::vector<uint8_t> leader(insts.size() + 1, 0);
+  leader[0] = 1;
+  leader[insts.size()] = 1;
+  for (size_t i = 0; i < insts.size(); ++i) {
+    if (is_jump(insts[i])) {
+      int64_t to = target_index(insts[i]);
+      if (to >= 0) leader[static_cast<size_t>(to)] = 1;
+      leader[i + 1] = 1;
+    } else if (insts[i].opcode == static_cast<uint8_t>(OpCode::Ret)) {
+      leader[i + 1] = 1;
+    }
+  }
+  std::vector<uint32_t> block_of(insts.size() + 1, 0);
+  uint32_t block_count = 0;
+  for (size_t i = 0; i <= insts.size(); ++i) {
+    if (leader[i]) block_of[i] = block_count++;
+  }
+  // The block at insts.size() is the shared bail exit for missing RET.
+  const uint32_t exit_block = block_of[insts.size()];
+
+  IrFunction& ir = *out;
+  ir = IrFunction{};
+  ir.param_count = param_count;
+  ir.locals = static_cast<uint32_t>(locals);
+  ir.stack_homes = static_cast<uint32_t>(max_height);
+  ir.value_count = ir.locals + ir.stack_homes;
+  ir.returns_value = ret_kind == 1;
+  if (verify_info) ir.local_types = verify_info->locals;
+  ir.blocks.resize(block_count);
+
+  Lowering lower{ir};
+  auto block_for = [&](int64_t to) { return to < 0 ? exit_block : block_of[static_cast<size_t>(to)]; };
+  for (size_t first = 0; first < insts.size();) {
+    size_t last = first + 1;
+    while (!leader[last]) ++last;
+    lower.block = &ir.blocks[block_of[first]];
+    if (heights[first] == kUnreached) {
+      lower.Emit(IrKind::Bail);
+      first = last;
+      continue;
+    }
+    std::vector<uint32_t> stack(static_cast<size_t>(heights[first]));
+    for (size_t d = 0; d < stack.size(); ++d) stack[d] = lower.StackHome(d);
+    std::vector<uint32_t> local_values(locals);
+    for (uint32_t l = 0; l < locals; ++l) local_values[l] = l;
+    auto pop = [&]() {
+      uint32_t value = stack.back();
+      stack.pop_back();
+      return value;
+    };
+    bool terminated = false;
+    for (size_t i = first; i < last && !terminated; ++i) {
+      const DecodedInst& inst = insts[i];
+      const OpCode op = static_cast<OpCode>(inst.opcode);
+      if (IsConstOp(op)) {
+        IrInst& c = lower.Emit(IrKind::Const);
+        c.dst = lower.NewTemp();
+        c.imm = ConstBits(op, inst.a);
+        stack.push_back(c.dst);
+        continue;
+      }
+      if (IsUnaryOp(op)) {
+        IrInst& u = lower.Emit(IrKind::Unary);
+        u.op = op;
+        u.a = pop();
+        u.dst = lower.NewTemp();
+        stack.push_back(u.dst);
+        continue;
+      }
+      if (IsBinaryOp(op)) {
+        uint32_t rhs = pop();
+        uint32_t lhs = pop();
+        IrInst& bin = lower.Emit(IrKind::Binary);
+        bin.op = op;
+        bin.a = lhs;
+        bin.b = rhs;
+        bin.dst = lower.NewTemp();
+        stack.push_back(bin.dst);
+        continue;
+      }
+      switch (op) {
+        case OpCode::Pop:
+          stack.pop_back();
+          break;
+        case OpCode::Dup:
+          stack.push_back(stack.back());
+          break;
+        case OpCode::Dup2: {
+          uint32_t lo = stack[stack.size() - 2];
+          uint32_t hi = stack[stack.size() - 1];
+          stack.push_back(lo);
+          stack.push_back(hi);
+          break;
+        }
+        case OpCode::Swap:
+          std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+          break;
+        case OpCode::Rot: {
+          uint32_t c = stack[stack.size() - 1];
+          uint32_t b = stack[stack.size() - 2];
+          uint32_t a = stack[stack.size() - 3];
+          stack[stack.size() - 3] = b;
+          stack[stack.size() - 2] = c;
+          stack[stack.size() - 1] = a;
+          break;
+        }
+        case OpCode::LoadLocal:
+          stack.push_back(local_values[static_cast<size_t>(inst.a)]);
+          break;
+        case OpCode::StoreLocal:
+          local_values[static_cast<size_t>(inst.a)] = pop();
+          break;
+        case OpCode::Call: {
+          IrInst call;
+          call.kind = IrKind::Call;
+          call.imm = inst.a;
+          call.args.assign(stack.end() - inst.imm8, stack.end());
+          stack.resize(stack.size() - inst.imm8);
+          if (call_returns[i]) {
+            call.dst = lower.NewTemp();
+            stack.push_back(call.dst);
+          }
+          lower.block->insts.push_back(std::move(call));
+          break;
+        }
+        case OpCode::Ret: {
+          uint32_t value = stack.empty() ? kNoIrValue : stack.back();
+          lower.Emit(IrKind::Ret).a = value;
+          terminated = true;
+          break;
+        }
+        case OpCode::Jmp:
+          lower.Flush(stack, local_values, nullptr);
+          lower.Emit(IrKind::Jump).target = block_for(target_index(inst));
+          terminated = true;
+          break;
+        case OpCode::JmpTrue:
+        case OpCode::JmpFalse: {
+          uint32_t cond = pop();
+          lower.Flush(stack, local_values, &cond);
+          IrInst& br = lower.Emit(IrKind::Branch);
+          br.op = op;
+          br.a = cond;
+          br.target = block_for(target_index(inst));
+          br.fallthrough = block_of[i + 1];
+          terminated = true;
+          break;
+        }
+        default:
+          break;
+      }
+    }
+    if (!terminated) {
+      lower.Flush(stack, local_values, nullptr);
+      lower.Emit(IrKind::Jump).target = block_of[last];
+    }
+    first = last;
+  }
+  lower.block = &ir.blocks[exit_block];
+  lower.Emit(IrKind::Bail);
+  return true;
+}
+
+void OptimizeIr(IrFunction& func) {
+  if (func.blocks.empty()) return;
+  for (int round = 0; round < kMaxOptimizeRounds; ++round) {
+    bool changed = ForwardPass(func);
+    changed = RemoveUnreachable(func) || changed;
+    changed = DeadCodePass(func) || changed;
+    if (!changed) break;
+  }
+}
+
+} // namespace Simple::VM
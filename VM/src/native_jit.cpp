@@ -0,0 +1,961 @@
+#include "native_jit.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#include "jit_ir.h"
+#include "opcode.h"
+
+#if SIMPLEVM_NATIVE_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Simple::VM {
+
+namespace {
+
+using Simple::Byte::OpCode;
+
+constexpr size_t kMaxNativeFrame = 4096;
+constexpr size_t kCodeChunkSize = 64 * 1024;
+
+#if SIMPLEVM_NATIVE_JIT
+
+// Register numbers as encoded in ModRM/REX.
+constexpr uint8_t kRax = 0;
+constexpr uint8_t kRcx = 1;
+constexpr uint8_t kXmm0 = 0;
+constexpr uint8_t kXmm1 = 1;
+
+// Condition codes for Jcc/SETcc.
+constexpr uint8_t kCondB = 0x2;
+constexpr uint8_t kCondAE = 0x3;
+constexpr uint8_t kCondE = 0x4;
+constexpr uint8_t kCondNE = 0x5;
+constexpr uint8_t kCondBE = 0x6;
+constexpr uint8_t kCondA = 0x7;
+constexpr uint8_t kCondP = 0xA;
+constexpr uint8_t kCondNP = 0xB;
+constexpr uint8_t kCondL = 0xC;
+constexpr uint8_t kCondGE = 0xD;
+constexpr uint8_t kCondLE = 0xE;
+constexpr uint8_t kCondG = 0xF;
+
+// Minimal x86-64 encoder. Slots are addressed as [rbx + 8 * index]; rbx holds
+// the frame and r12 the frame limit for the whole function.
+class X64Emitter {
+ public:
+  std::vector<uint8_t> code;
+
+  size_t NewLabel() {
+    labels_.push_back(kUnbound);
+    return labels_.size() - 1;
+  }
+  void Bind(size_t label) { labels_[label] = code.size(); }
+  bool Finish() {
+    for (const auto& fix : fixups_) {
+      size_t target = labels_[fix.label];
+      if (target == kUnbound) return false;
+      int32_t rel = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(fix.at + 4));
+      std::memcpy(code.data() + fix.at, &rel, 4);
+    }
+    return true;
+  }
+
+  void Bytes(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+  void U32(uint32_t v) {
+    for (int i = 0; i < 4; ++i) code.push_back(static_cast<uint8_t>(v >> (i * 8)));
+  }
+  void U64(uint64_t v) {
+    for (int i = 0; i < 8; ++i) code.push_back(static_cast<uint8_t>(v >> (i * 8)));
+  }
+
+  // Integer loads/stores between a general register and a slot.
+  void LoadQ(uint8_t reg, size_t slot) { MemOp(true, {0x8B}, reg, slot); }
+  void LoadD(uint8_t reg, size_t slot) { MemOp(false, {0x8B}, reg, slot); }
+  void StoreQ(size_t slot, uint8_t reg) { MemOp(true, {0x89}, reg, slot); }
+  void MovEaxImm(uint32_t v) { MovR32Imm(kRax, v); }
+  void MovRaxImm(uint64_t v) { MovR64Imm(kRax, v); }
+  void MovR32Imm(uint8_t reg, uint32_t v) {
+    code.push_back(static_cast<uint8_t>(0xB8 + reg));
+    U32(v);
+  }
+  void MovR64Imm(uint8_t reg, uint64_t v) {
+    if (v <= 0xFFFFFFFFull) {
+      MovR32Imm(reg, static_cast<uint32_t>(v));  // zero-extends
+      return;
+    }
+    Bytes({0x48, static_cast<uint8_t>(0xB8 + reg)});
+    U64(v);
+  }
+  void MovRdiImm(uint64_t v) {
+    Bytes({0x48, 0xBF});
+    U64(v);
+  }
+  void MovEsiImm(uint32_t v) {
+    code.push_back(0xBE);
+    U32(v);
+  }
+  void LeaRdiSlot(size_t slot) { MemOp(true, {0x8D}, 7, slot); }
+  void LeaRaxSlot(size_t slot) { MemOp(true, {0x8D}, kRax, slot); }
+
+  // SSE loads/stores and scalar ops; prefix is 0xF3 for f32, 0xF2 for f64.
+  void SseLoad(uint8_t prefix, uint8_t xmm, size_t slot) { PrefixedMemOp(prefix, {0x0F, 0x10}, xmm, slot); }
+  void SseStore(uint8_t prefix, size_t slot, uint8_t xmm) { PrefixedMemOp(prefix, {0x0F, 0x11}, xmm, slot); }
+  void SseOp(uint8_t prefix, uint8_t op, uint8_t dst, uint8_t src) {
+    Bytes({prefix, 0x0F, op, static_cast<uint8_t>(0xC0 | (dst << 3) | src)});
+  }
+
+  void Jmp(size_t label) {
+    code.push_back(0xE9);
+    Fixup(label);
+  }
+  void Jcc(uint8_t cond, size_t label) {
+    Bytes({0x0F, static_cast<uint8_t>(0x80 | cond)});
+    Fixup(label);
+  }
+  // setcc al; movzx eax, al
+  void SetccEax(uint8_t cond) { Bytes({0x0F, static_cast<uint8_t>(0x90 | cond), 0xC0, 0x0F, 0xB6, 0xC0}); }
+  void SetccAl(uint8_t cond) { Bytes({0x0F, static_cast<uint8_t>(0x90 | cond), 0xC0}); }
+  void SetccCl(uint8_t cond) { Bytes({0x0F, static_cast<uint8_t>(0x90 | cond), 0xC1}); }
+
+ private:
+  static constexpr size_t kUnbound = static_cast<size_t>(-1);
+  struct Fix {
+    size_t at;
+    size_t label;
+  };
+
+  void Fixup(size_t label) {
+    fixups_.push_back({code.size(), label});
+    U32(0);
+  }
+  void ModRm(uint8_t reg, size_t slot) {
+    code.push_back(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | 3));
+    U32(static_cast<uint32_t>(slot * 8));
+  }
+  void MemOp(bool wide, std::initializer_list<uint8_t> opcode, uint8_t reg, size_t slot) {
+    uint8_t rex = static_cast<uint8_t>(0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0));
+    if (rex != 0x40) code.push_back(rex);
+    code.insert(code.end(), opcode);
+    ModRm(reg, slot);
+  }
+  void PrefixedMemOp(uint8_t prefix, std::initializer_list<uint8_t> opcode, uint8_t reg, size_t slot) {
+    code.push_back(prefix);
+    code.insert(code.end(), opcode);
+    ModRm(reg, slot);
+  }
+
+  std::vector<size_t> labels_;
+  std::vector<Fix> fixups_;
+};
+
+bool Fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+bool IsWideIntOp(OpCode op) {
+  switch (op) {
+    case OpCode::AddI64:
+    case OpCode::SubI64:
+    case OpCode::MulI64:
+    case OpCode::DivI64:
+    case OpCode::ModI64:
+    case OpCode::AddU64:
+    case OpCode::SubU64:
+    case OpCode::MulU64:
+    case OpCode::DivU64:
+    case OpCode::ModU64:
+    case OpCode::AndI64:
+    case OpCode::OrI64:
+    case OpCode::XorI64:
+    case OpCode::ShlI64:
+    case OpCode::ShrI64:
+    case OpCode::CmpEqI64:
+    case OpCode::CmpNeI64:
+    case OpCode::CmpLtI64:
+    case OpCode::CmpLeI64:
+    case OpCode::CmpGtI64:
+    case OpCode::CmpGeI64:
+    case OpCode::CmpEqU64:
+    case OpCode::CmpNeU64:
+    case OpCode::CmpLtU64:
+    case OpCode::CmpLeU64:
+    case OpCode::CmpGtU64:
+    case OpCode::CmpGeU64:
+    case OpCode::RefEq:
+    case OpCode::RefNe:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool FitsSimm32(uint64_t bits) {
+  int64_t value = static_cast<int64_t>(bits);
+  return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// Condition code for an integer/ref compare, or -1 for other ops.
+int IntCompareCond(OpCode op) {
+  struct CmpShape {
+    OpCode op;
+    uint8_t cond;
+  };
+  static const CmpShape kShapes[] = {
+      {OpCode::CmpEqI32, kCondE},  {OpCode::CmpNeI32, kCondNE}, {OpCode::CmpLtI32, kCondL},
+      {OpCode::CmpLeI32, kCondLE}, {OpCode::CmpGtI32, kCondG},  {OpCode::CmpGeI32, kCondGE},
+      {OpCode::CmpEqU32, kCondE},  {OpCode::CmpNeU32, kCondNE}, {OpCode::CmpLtU32, kCondB},
+      {OpCode::CmpLeU32, kCondBE}, {OpCode::CmpGtU32, kCondA},  {OpCode::CmpGeU32, kCondAE},
+      {OpCode::CmpEqI64, kCondE},  {OpCode::CmpNeI64, kCondNE}, {OpCode::CmpLtI64, kCondL},
+      {OpCode::CmpLeI64, kCondLE}, {OpCode::CmpGtI64, kCondG},  {OpCode::CmpGeI64, kCondGE},
+      {OpCode::CmpEqU64, kCondE},  {OpCode::CmpNeU64, kCondNE}, {OpCode::CmpLtU64, kCondB},
+      {OpCode::CmpLeU64, kCondBE}, {OpCode::CmpGtU64, kCondA},  {OpCode::CmpGeU64, kCondAE},
+      {OpCode::RefEq, kCondE},     {OpCode::RefNe, kCondNE},
+  };
+  for (const auto& shape : kShapes) {
+    if (shape.op == op) return shape.cond;
+  }
+  return -1;
+}
+
+// Frame slot assignment for IR values. Homes keep their value number as slot;
+// temporaries share a pool above the homes (they never outlive their block),
+// constants become immediates, and a temporary whose only use is the move
+// into a home is computed straight into that home.
+struct SlotPlan {
+  std::vector<int64_t> slot;
+  std::vector<uint8_t> is_const;
+  std::vector<uint64_t> const_bits;
+  std::vector<std::vector<uint8_t>> skip;  // per block: coalesced moves
+  std::vector<uint8_t> fuse_branch;        // per block: compare feeds the branch
+  size_t frame_slots = 0;
+  size_t max_call_args = 0;
+};
+
+SlotPlan PlanSlots(const IrFunction& ir) {
+  SlotPlan plan;
+  const uint32_t homes = ir.locals + ir.stack_homes;
+  plan.slot.assign(ir.value_count, -1);
+  plan.is_const.assign(ir.value_count, 0);
+  plan.const_bits.assign(ir.value_count, 0);
+  for (uint32_t v = 0; v < homes; ++v) plan.slot[v] = v;
+  std::vector<uint32_t> uses(ir.value_count, 0);
+  std::vector<uint32_t> last_use(ir.value_count, 0);
+  std::vector<uint32_t> def_at(ir.value_count, 0);
+  size_t pool_size = 0;
+  plan.skip.resize(ir.blocks.size());
+  plan.fuse_branch.assign(ir.blocks.size(), 0);
+  for (size_t b = 0; b < ir.blocks.size(); ++b) {
+    const auto& insts = ir.blocks[b].insts;
+    plan.skip[b].assign(insts.size(), 0);
+    auto for_each_use = [](const IrInst& inst, auto fn) {
+      if (inst.a != kNoIrValue) fn(inst.a);
+      if (inst.b != kNoIrValue) fn(inst.b);
+      for (uint32_t arg : inst.args) fn(arg);
+    };
+    for (uint32_t j = 0; j < insts.size(); ++j) {
+      const IrInst& inst = insts[j];
+      if (inst.kind == IrKind::Call && inst.args.size() > plan.max_call_args) plan.max_call_args = inst.args.size();
+      if (inst.kind == IrKind::Const) {
+        plan.is_const[inst.dst] = 1;
+        plan.const_bits[inst.dst] = inst.imm;
+      }
+      for_each_use(inst, [&](uint32_t v) {
+        uses[v] += 1;
+        last_use[v] = j;
+      });
+      if (inst.dst != kNoIrValue) def_at[inst.dst] = j;
+    }
+    // An integer compare whose only use is the branch right after it becomes
+    // cmp + jcc with no flag materialized.
+    if (insts.size() >= 2 && insts.back().kind == IrKind::Branch) {
+      const IrInst& cmp = insts[insts.size() - 2];
+      if (cmp.kind == IrKind::Binary && cmp.dst == insts.back().a && uses[cmp.dst] == 1 && IntCompareCond(cmp.op) >= 0) {
+        plan.fuse_branch[b] = 1;
+      }
+    }
+    for (uint32_t j = 0; j < insts.size(); ++j) {
+      const IrInst& move = insts[j];
+      if (move.kind != IrKind::Move || !ir.IsHome(move.dst) || ir.IsHome(move.a)) continue;
+      uint32_t temp = move.a;
+      if (plan.is_const[temp] || uses[temp] != 1) continue;
+      bool clear = true;
+      for (uint32_t k = def_at[temp] + 1; k < j && clear; ++k) {
+        if (insts[k].dst == move.dst) clear = false;
+        for_each_use(insts[k], [&](uint32_t v) {
+          if (v == move.dst) clear = false;
+        });
+      }
+      if (!clear) continue;
+      plan.slot[temp] = move.dst;
+      plan.skip[b][j] = 1;
+    }
+    std::vector<size_t> free_slots;
+    size_t used = 0;
+    for (uint32_t j = 0; j < insts.size(); ++j) {
+      const IrInst& inst = insts[j];
+      for_each_use(inst, [&](uint32_t v) {
+        if (ir.IsHome(v) || plan.is_const[v] || last_use[v] != j) return;
+        if (plan.slot[v] >= static_cast<int64_t>(homes)) free_slots.push_back(static_cast<size_t>(plan.slot[v]));
+        last_use[v] = UINT32_MAX;  // release once even if used twice here
+      });
+      if (inst.dst == kNoIrValue || ir.IsHome(inst.dst) || plan.is_const[inst.dst]) continue;
+      if (plan.slot[inst.dst] >= 0) continue;  // coalesced into a home
+      if (free_slots.empty()) {
+        free_slots.push_back(homes + used);
+        used += 1;
+      }
+      plan.slot[inst.dst] = static_cast<int64_t>(free_slots.back());
+      // Results nobody reads (a kept DIV_I32, an ignored call result) free
+      // their slot right away.
+      if (uses[inst.dst] != 0) free_slots.pop_back();
+    }
+    if (used > pool_size) pool_size = used;
+  }
+  plan.frame_slots = homes + pool_size;
+  return plan;
+}
+
+#endif
+
+} // namespace
+
+JitCodeArena::~JitCodeArena() {
+#if SIMPLEVM_NATIVE_JIT
+  for (const auto& chunk : chunks_) {
+    munmap(chunk.base, chunk.size);
+  }
+#endif
+}
+
+void* JitCodeArena::Install(const std::vector<uint8_t>& code) {
+#if SIMPLEVM_NATIVE_JIT
+  if (code.empty()) return nullptr;
+  size_t need = (code.size() + 15) & ~static_cast<size_t>(15);
+  if (chunks_.empty() || chunks_.back().size - chunks_.back().used < need) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = need > kCodeChunkSize ? need : kCodeChunkSize;
+    size = (size + page - 1) & ~(page - 1);
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+    chunks_.push_back({static_cast<uint8_t*>(mem), size, 0});
+  } else if (mprotect(chunks_.back().base, chunks_.back().size, PROT_READ | PROT_WRITE) != 0) {
+    return nullptr;
+  }
+  Chunk& chunk = chunks_.back();
+  uint8_t* out = chunk.base + chunk.used;
+  std::memcpy(out, code.data(), code.size());
+  chunk.used += need;
+  if (mprotect(chunk.base, chunk.size, PROT_READ | PROT_EXEC) != 0) return nullptr;
+  return out;
+#else
+  (void)code;
+  return nullptr;
+#endif
+}
+
+bool CompileNativeFunction(const Simple::Byte::SbcModule& module,
+                           size_t func_index,
+                           const Simple::Byte::MethodVerifyInfo* verify_info,
+                           const NativeCalleeResolver& resolve_callee,
+                           NativeCallHook hook,
+                           JitCodeArena& arena,
+                           NativeFunction* out,
+                           std::string* error) {
+#if !SIMPLEVM_NATIVE_JIT
+  (void)module;
+  (void)func_index;
+  (void)verify_info;
+  (void)resolve_callee;
+  (void)hook;
+  (void)arena;
+  (void)out;
+  if (error) *error = "native JIT not available on this platform";
+  return false;
+#else
+  if (!out) return Fail(error, "native JIT missing output");
+  IrCalleeInfo callee_info = [&](uint32_t callee_id, uint16_t* param_count, bool* returns_value) {
+    const NativeFunction* callee = resolve_callee ? resolve_callee(callee_id) : nullptr;
+    if (!callee || !callee->entry) return false;
+    *param_count = callee->param_count;
+    *returns_value = callee->returns_value;
+    return true;
+  };
+  IrFunction ir;
+  if (!LowerFunctionToIr(module, func_index, verify_info, callee_info, &ir, error)) return false;
+  OptimizeIr(ir);
+  SlotPlan plan = PlanSlots(ir);
+  if (plan.frame_slots + plan.max_call_args > kMaxNativeFrame) return Fail(error, "native JIT frame too large");
+  const size_t call_area = plan.frame_slots;
+
+  X64Emitter em;
+  const size_t bail = em.NewLabel();
+  const size_t unsupported = em.NewLabel();
+  const size_t epilogue = em.NewLabel();
+  std::vector<size_t> block_labels(ir.blocks.size());
+  for (auto& label : block_labels) label = em.NewLabel();
+
+  auto slot_of = [&](uint32_t value) { return static_cast<size_t>(plan.slot[value]); };
+  // Operand loads; constants become immediates.
+  auto load_gpr = [&](uint8_t reg, uint32_t value, bool wide) {
+    if (plan.is_const[value]) {
+      uint64_t bits = plan.const_bits[value];
+      if (wide) {
+        em.MovR64Imm(reg, bits);
+      } else {
+        em.MovR32Imm(reg, static_cast<uint32_t>(bits));
+      }
+    } else if (wide) {
+      em.LoadQ(reg, slot_of(value));
+    } else {
+      em.LoadD(reg, slot_of(value));
+    }
+  };
+  auto load_xmm = [&](uint8_t xmm, uint32_t value, bool f64) {
+    if (plan.is_const[value]) {
+      em.MovRaxImm(plan.const_bits[value]);
+      em.Bytes({0x66, 0x48, 0x0F, 0x6E, static_cast<uint8_t>(0xC0 | (xmm << 3))});  // movq xmm, rax
+    } else {
+      em.SseLoad(f64 ? 0xF2 : 0xF3, xmm, slot_of(value));
+    }
+  };
+  auto store_f32 = [&](uint32_t dst) {
+    em.Bytes({0x66, 0x0F, 0x7E, 0xC0});  // movd eax, xmm0
+    em.StoreQ(slot_of(dst), kRax);
+  };
+  auto store_float = [&](uint32_t dst, bool f64) {
+    if (f64) {
+      em.SseStore(0xF2, slot_of(dst), kXmm0);
+    } else {
+      store_f32(dst);
+    }
+  };
+  // Integer ALU op `rax op= b` using an immediate when b is a small constant.
+  // digit is the /r of the 0x81 group (add 0, or 1, and 4, sub 5, xor 6, cmp 7).
+  auto alu = [&](uint8_t digit, uint8_t reg_opcode, uint32_t b, bool wide) {
+    if (plan.is_const[b] && (!wide || FitsSimm32(plan.const_bits[b]))) {
+      if (wide) em.code.push_back(0x48);
+      em.Bytes({0x81, static_cast<uint8_t>(0xC0 | (digit << 3))});
+      em.U32(static_cast<uint32_t>(plan.const_bits[b]));
+      return;
+    }
+    load_gpr(kRcx, b, wide);
+    if (wide) em.code.push_back(0x48);
+    em.Bytes({reg_opcode, 0xC8});  // op eax/rax, ecx/rcx
+  };
+
+  // Prologue: push rbx/r12/r13 (keeps rsp 16-byte aligned for calls),
+  // rbx = frame, r12 = limit; bail if the frame and call area do not fit;
+  // zero non-param locals.
+  em.Bytes({0x53, 0x41, 0x54, 0x41, 0x55});
+  em.Bytes({0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4});
+  em.LeaRaxSlot(plan.frame_slots + plan.max_call_args);
+  em.Bytes({0x4C, 0x39, 0xE0});  // cmp rax, r12
+  em.Jcc(kCondA, bail);
+  if (ir.locals > ir.param_count) {
+    em.Bytes({0x31, 0xC0});  // xor eax, eax
+    for (size_t i = ir.param_count; i < ir.locals; ++i) em.StoreQ(i, kRax);
+  }
+
+  for (size_t b = 0; b < ir.blocks.size(); ++b) {
+    em.Bind(block_labels[b]);
+    const auto& insts = ir.blocks[b].insts;
+    for (size_t j = 0; j < insts.size(); ++j) {
+      if (plan.skip[b][j]) continue;
+      const IrInst& inst = insts[j];
+      const OpCode op = inst.op;
+      switch (inst.kind) {
+        case IrKind::Const:
+          break;
+        case IrKind::Move:
+          load_gpr(kRax, inst.a, true);
+          em.StoreQ(slot_of(inst.dst), kRax);
+          break;
+        case IrKind::Jump:
+          if (inst.target != b + 1) em.Jmp(block_labels[inst.target]);
+          break;
+        case IrKind::Branch:
+          load_gpr(kRax, inst.a, false);
+          em.Bytes({0x85, 0xC0});  // test eax, eax
+          em.Jcc(op == OpCode::JmpTrue ? kCondNE : kCondE, block_labels[inst.target]);
+          if (inst.fallthrough != b + 1) em.Jmp(block_labels[inst.fallthrough]);
+          break;
+        case IrKind::Ret:
+          if (inst.a != kNoIrValue) {
+            load_gpr(kRax, inst.a, true);
+            em.StoreQ(0, kRax);
+            em.MovEaxImm(static_cast<uint32_t>(NativeStatus::ReturnValue));
+          } else {
+            em.MovEaxImm(static_cast<uint32_t>(NativeStatus::Return));
+          }
+          em.Jmp(epilogue);
+          break;
+        case IrKind::Bail:
+          em.Jmp(unsupported);
+          break;
+        case IrKind::Call: {
+          uint32_t callee_id = static_cast<uint32_t>(inst.imm);
+          const NativeFunction* callee = resolve_callee(callee_id);
+          for (size_t i = 0; i < inst.args.size(); ++i) {
+            load_gpr(kRax, inst.args[i], true);
+            em.StoreQ(call_area + i, kRax);
+          }
+          if (hook.fn) {
+            em.MovRdiImm(reinterpret_cast<uint64_t>(hook.ctx));
+            em.MovEsiImm(callee_id);
+            em.Bytes({0x48, 0xB8});  // mov rax, imm64
+            em.U64(reinterpret_cast<uint64_t>(hook.fn));
+            em.Bytes({0xFF, 0xD0});  // call rax
+          }
+          em.LeaRdiSlot(call_area);
+          em.Bytes({0x4C, 0x89, 0xE6});  // mov rsi, r12
+          em.Bytes({0x48, 0xB8});
+          em.U64(reinterpret_cast<uint64_t>(callee->entry));
+          em.Bytes({0xFF, 0xD0});
+          // A failed callee's status (Bail or Unsupported) is passed up as is.
+          em.Bytes({0x83, 0xF8, static_cast<uint8_t>(NativeStatus::Bail)});  // cmp eax, Bail
+          em.Jcc(kCondAE, epilogue);
+          if (inst.dst != kNoIrValue) {
+            em.LoadQ(kRax, call_area);
+            em.StoreQ(slot_of(inst.dst), kRax);
+          }
+          break;
+        }
+        case IrKind::Unary:
+        case IrKind::Binary:
+          switch (op) {
+            case OpCode::AddI32:
+            case OpCode::AddU32:
+            case OpCode::AddI64:
+            case OpCode::AddU64:
+            case OpCode::SubI32:
+            case OpCode::SubU32:
+            case OpCode::SubI64:
+            case OpCode::SubU64:
+            case OpCode::AndI32:
+            case OpCode::AndI64:
+            case OpCode::OrI32:
+            case OpCode::OrI64:
+            case OpCode::XorI32:
+            case OpCode::XorI64: {
+              bool wide = IsWideIntOp(op);
+              uint8_t digit = 0;
+              uint8_t reg_opcode = 0x01;
+              if (op == OpCode::SubI32 || op == OpCode::SubU32 || op == OpCode::SubI64 || op == OpCode::SubU64) {
+                digit = 5;
+                reg_opcode = 0x29;
+              } else if (op == OpCode::AndI32 || op == OpCode::AndI64) {
+                digit = 4;
+                reg_opcode = 0x21;
+              } else if (op == OpCode::OrI32 || op == OpCode::OrI64) {
+                digit = 1;
+                reg_opcode = 0x09;
+              } else if (op == OpCode::XorI32 || op == OpCode::XorI64) {
+                digit = 6;
+                reg_opcode = 0x31;
+              }
+              load_gpr(kRax, inst.a, wide);
+              alu(digit, reg_opcode, inst.b, wide);
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::MulI32:
+            case OpCode::MulU32:
+            case OpCode::MulI64:
+            case OpCode::MulU64: {
+              bool wide = IsWideIntOp(op);
+              load_gpr(kRax, inst.a, wide);
+              if (plan.is_const[inst.b] && (!wide || FitsSimm32(plan.const_bits[inst.b]))) {
+                if (wide) em.code.push_back(0x48);
+                em.Bytes({0x69, 0xC0});  // imul eax, eax, imm32
+                em.U32(static_cast<uint32_t>(plan.const_bits[inst.b]));
+              } else {
+                load_gpr(kRcx, inst.b, wide);
+                if (wide) em.code.push_back(0x48);
+                em.Bytes({0x0F, 0xAF, 0xC1});  // imul eax, ecx
+              }
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::ShlI32:
+            case OpCode::ShrI32:
+            case OpCode::ShlI64:
+            case OpCode::ShrI64: {
+              // The hardware masks the count to 5/6 bits, matching `& 31` / `& 63`.
+              bool wide = IsWideIntOp(op);
+              uint8_t modrm = (op == OpCode::ShlI32 || op == OpCode::ShlI64) ? 0xE0 : 0xE8;
+              load_gpr(kRax, inst.a, wide);
+              if (plan.is_const[inst.b]) {
+                if (wide) em.code.push_back(0x48);
+                em.Bytes({0xC1, modrm, static_cast<uint8_t>(plan.const_bits[inst.b] & (wide ? 63u : 31u))});
+              } else {
+                load_gpr(kRcx, inst.b, false);
+                if (wide) em.code.push_back(0x48);
+                em.Bytes({0xD3, modrm});
+              }
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::DivI32:
+            case OpCode::ModI32:
+            case OpCode::DivU32:
+            case OpCode::ModU32:
+            case OpCode::DivI64:
+            case OpCode::ModI64:
+            case OpCode::DivU64:
+            case OpCode::ModU64: {
+              bool wide = IsWideIntOp(op);
+              bool is_signed =
+                  op == OpCode::DivI32 || op == OpCode::ModI32 || op == OpCode::DivI64 || op == OpCode::ModI64;
+              bool is_mod =
+                  op == OpCode::ModI32 || op == OpCode::ModU32 || op == OpCode::ModI64 || op == OpCode::ModU64;
+              size_t done = em.NewLabel();
+              size_t divide = em.NewLabel();
+              load_gpr(kRax, inst.a, wide);
+              load_gpr(kRcx, inst.b, wide);
+              if (wide) {
+                em.Bytes({0x48, 0x85, 0xC9});  // test rcx, rcx
+              } else {
+                em.Bytes({0x85, 0xC9});  // test ecx, ecx
+              }
+              if (op == OpCode::DivI32 || op == OpCode::ModI32) {
+                // Tier1 bytecode deopts on a zero I32 divisor; do the same.
+                em.Jcc(kCondE, bail);
+              } else {
+                em.Jcc(kCondNE, divide);
+                em.Bytes({0x31, 0xC0});  // xor eax, eax
+                em.Jmp(done);
+              }
+              em.Bind(divide);
+              if (is_signed) {
+                // x / -1 and x % -1 are computed without idiv so INT_MIN cannot fault.
+                size_t general = em.NewLabel();
+                if (wide) {
+                  em.Bytes({0x48, 0x83, 0xF9, 0xFF});  // cmp rcx, -1
+                } else {
+                  em.Bytes({0x83, 0xF9, 0xFF});  // cmp ecx, -1
+                }
+                em.Jcc(kCondNE, general);
+                if (is_mod) {
+                  em.Bytes({0x31, 0xC0});
+                } else if (wide) {
+                  em.Bytes({0x48, 0xF7, 0xD8});  // neg rax
+                } else {
+                  em.Bytes({0xF7, 0xD8});  // neg eax
+                }
+                em.Jmp(done);
+                em.Bind(general);
+                if (wide) {
+                  em.Bytes({0x48, 0x99, 0x48, 0xF7, 0xF9});  // cqo; idiv rcx
+                } else {
+                  em.Bytes({0x99, 0xF7, 0xF9});  // cdq; idiv ecx
+                }
+              } else if (wide) {
+                em.Bytes({0x31, 0xD2, 0x48, 0xF7, 0xF1});  // xor edx, edx; div rcx
+              } else {
+                em.Bytes({0x31, 0xD2, 0xF7, 0xF1});  // xor edx, edx; div ecx
+              }
+              if (is_mod) {
+                if (wide) {
+                  em.Bytes({0x48, 0x89, 0xD0});  // mov rax, rdx
+                } else {
+                  em.Bytes({0x89, 0xD0});  // mov eax, edx
+                }
+              }
+              em.Bind(done);
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::NegI32:
+            case OpCode::NegU32:
+            case OpCode::NegI64:
+            case OpCode::NegU64: {
+              bool wide = op == OpCode::NegI64 || op == OpCode::NegU64;
+              load_gpr(kRax, inst.a, wide);
+              if (wide) em.code.push_back(0x48);
+              em.Bytes({0xF7, 0xD8});
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::IncI32:
+            case OpCode::IncU32:
+            case OpCode::DecI32:
+            case OpCode::DecU32:
+            case OpCode::IncI64:
+            case OpCode::IncU64:
+            case OpCode::DecI64:
+            case OpCode::DecU64: {
+              bool wide =
+                  op == OpCode::IncI64 || op == OpCode::IncU64 || op == OpCode::DecI64 || op == OpCode::DecU64;
+              bool inc =
+                  op == OpCode::IncI32 || op == OpCode::IncU32 || op == OpCode::IncI64 || op == OpCode::IncU64;
+              load_gpr(kRax, inst.a, wide);
+              if (wide) em.code.push_back(0x48);
+              em.Bytes({0x83, static_cast<uint8_t>(inc ? 0xC0 : 0xE8), 0x01});
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::NegI8:
+            case OpCode::NegI16:
+            case OpCode::NegU8:
+            case OpCode::NegU16:
+            case OpCode::IncI8:
+            case OpCode::DecI8:
+            case OpCode::IncI16:
+            case OpCode::DecI16:
+            case OpCode::IncU8:
+            case OpCode::DecU8:
+            case OpCode::IncU16:
+            case OpCode::DecU16: {
+              load_gpr(kRax, inst.a, false);
+              if (op == OpCode::NegI8 || op == OpCode::NegI16 || op == OpCode::NegU8 || op == OpCode::NegU16) {
+                em.Bytes({0xF7, 0xD8});
+              } else {
+                bool inc = op == OpCode::IncI8 || op == OpCode::IncI16 || op == OpCode::IncU8 || op == OpCode::IncU16;
+                em.Bytes({0x83, static_cast<uint8_t>(inc ? 0xC0 : 0xE8), 0x01});
+              }
+              // Narrow back to the declared width: movsx/movzx eax, al/ax.
+              if (op == OpCode::NegI8 || op == OpCode::IncI8 || op == OpCode::DecI8) {
+                em.Bytes({0x0F, 0xBE, 0xC0});
+              } else if (op == OpCode::NegI16 || op == OpCode::IncI16 || op == OpCode::DecI16) {
+                em.Bytes({0x0F, 0xBF, 0xC0});
+              } else if (op == OpCode::NegU8 || op == OpCode::IncU8 || op == OpCode::DecU8) {
+                em.Bytes({0x0F, 0xB6, 0xC0});
+              } else {
+                em.Bytes({0x0F, 0xB7, 0xC0});
+              }
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::AddF32:
+            case OpCode::SubF32:
+            case OpCode::MulF32:
+            case OpCode::AddF64:
+            case OpCode::SubF64:
+            case OpCode::MulF64: {
+              bool f64 = op == OpCode::AddF64 || op == OpCode::SubF64 || op == OpCode::MulF64;
+              uint8_t sse = (op == OpCode::AddF32 || op == OpCode::AddF64)   ? 0x58
+                            : (op == OpCode::SubF32 || op == OpCode::SubF64) ? 0x5C
+                                                                             : 0x59;
+              load_xmm(kXmm0, inst.a, f64);
+              load_xmm(kXmm1, inst.b, f64);
+              em.SseOp(f64 ? 0xF2 : 0xF3, sse, kXmm0, kXmm1);
+              store_float(inst.dst, f64);
+              break;
+            }
+            case OpCode::DivF32:
+            case OpCode::DivF64: {
+              // b == 0.0 yields 0.0, matching the bytecode tier.
+              bool f64 = op == OpCode::DivF64;
+              size_t divide = em.NewLabel();
+              size_t done = em.NewLabel();
+              load_xmm(kXmm1, inst.b, f64);
+              em.Bytes({0x0F, 0x57, 0xC0});  // xorps xmm0, xmm0
+              if (f64) em.code.push_back(0x66);
+              em.Bytes({0x0F, 0x2E, 0xC8});  // ucomis xmm1, xmm0
+              em.Jcc(kCondP, divide);
+              em.Jcc(kCondNE, divide);
+              em.Jmp(done);
+              em.Bind(divide);
+              load_xmm(kXmm0, inst.a, f64);
+              em.SseOp(f64 ? 0xF2 : 0xF3, 0x5E, kXmm0, kXmm1);
+              em.Bind(done);
+              store_float(inst.dst, f64);
+              break;
+            }
+            case OpCode::NegF32:
+              load_gpr(kRax, inst.a, false);
+              em.code.push_back(0x35);  // xor eax, imm32
+              em.U32(0x80000000u);
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            case OpCode::NegF64:
+              load_gpr(kRax, inst.a, true);
+              em.Bytes({0x48, 0x0F, 0xBA, 0xF8, 0x3F});  // btc rax, 63
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            case OpCode::IncF32:
+            case OpCode::DecF32:
+              load_xmm(kXmm0, inst.a, false);
+              em.MovEaxImm(0x3F800000u);
+              em.Bytes({0x66, 0x0F, 0x6E, 0xC8});  // movd xmm1, eax
+              em.SseOp(0xF3, op == OpCode::IncF32 ? 0x58 : 0x5C, kXmm0, kXmm1);
+              store_f32(inst.dst);
+              break;
+            case OpCode::IncF64:
+            case OpCode::DecF64:
+              load_xmm(kXmm0, inst.a, true);
+              em.MovRaxImm(0x3FF0000000000000ull);
+              em.Bytes({0x66, 0x48, 0x0F, 0x6E, 0xC8});  // movq xmm1, rax
+              em.SseOp(0xF2, op == OpCode::IncF64 ? 0x58 : 0x5C, kXmm0, kXmm1);
+              em.SseStore(0xF2, slot_of(inst.dst), kXmm0);
+              break;
+            case OpCode::CmpEqI32:
+            case OpCode::CmpNeI32:
+            case OpCode::CmpLtI32:
+            case OpCode::CmpLeI32:
+            case OpCode::CmpGtI32:
+            case OpCode::CmpGeI32:
+            case OpCode::CmpEqU32:
+            case OpCode::CmpNeU32:
+            case OpCode::CmpLtU32:
+            case OpCode::CmpLeU32:
+            case OpCode::CmpGtU32:
+            case OpCode::CmpGeU32:
+            case OpCode::CmpEqI64:
+            case OpCode::CmpNeI64:
+            case OpCode::CmpLtI64:
+            case OpCode::CmpLeI64:
+            case OpCode::CmpGtI64:
+            case OpCode::CmpGeI64:
+            case OpCode::CmpEqU64:
+            case OpCode::CmpNeU64:
+            case OpCode::CmpLtU64:
+            case OpCode::CmpLeU64:
+            case OpCode::CmpGtU64:
+            case OpCode::CmpGeU64:
+            case OpCode::RefEq:
+            case OpCode::RefNe: {
+              bool wide = IsWideIntOp(op);
+              load_gpr(kRax, inst.a, wide);
+              alu(7, 0x39, inst.b, wide);  // cmp
+              uint8_t cond = static_cast<uint8_t>(IntCompareCond(op));
+              if (j + 2 == insts.size() && plan.fuse_branch[b]) {
+                const IrInst& branch = insts.back();
+                // x86 condition codes come in pairs; the low bit negates.
+                em.Jcc(branch.op == OpCode::JmpTrue ? cond : static_cast<uint8_t>(cond ^ 1),
+                       block_labels[branch.target]);
+                if (branch.fallthrough != b + 1) em.Jmp(block_labels[branch.fallthrough]);
+                j += 1;
+                break;
+              }
+              em.SetccEax(cond);
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::CmpEqF32:
+            case OpCode::CmpNeF32:
+            case OpCode::CmpLtF32:
+            case OpCode::CmpLeF32:
+            case OpCode::CmpGtF32:
+            case OpCode::CmpGeF32:
+            case OpCode::CmpEqF64:
+            case OpCode::CmpNeF64:
+            case OpCode::CmpLtF64:
+            case OpCode::CmpLeF64:
+            case OpCode::CmpGtF64:
+            case OpCode::CmpGeF64: {
+              // ucomis sets ZF/PF/CF; unordered operands compare false except for !=.
+              bool f64 = op >= OpCode::CmpEqF64 && op <= OpCode::CmpGeF64;
+              load_xmm(kXmm0, inst.a, f64);
+              load_xmm(kXmm1, inst.b, f64);
+              bool swapped = op == OpCode::CmpLtF32 || op == OpCode::CmpLeF32 || op == OpCode::CmpLtF64 ||
+                             op == OpCode::CmpLeF64;
+              if (f64) em.code.push_back(0x66);
+              em.Bytes({0x0F, 0x2E, static_cast<uint8_t>(swapped ? 0xC8 : 0xC1)});
+              if (op == OpCode::CmpEqF32 || op == OpCode::CmpEqF64) {
+                em.SetccAl(kCondE);
+                em.SetccCl(kCondNP);
+                em.Bytes({0x20, 0xC8, 0x0F, 0xB6, 0xC0});  // and al, cl; movzx eax, al
+              } else if (op == OpCode::CmpNeF32 || op == OpCode::CmpNeF64) {
+                em.SetccAl(kCondNE);
+                em.SetccCl(kCondP);
+                em.Bytes({0x08, 0xC8, 0x0F, 0xB6, 0xC0});  // or al, cl; movzx eax, al
+              } else if (op == OpCode::CmpGtF32 || op == OpCode::CmpGtF64 || op == OpCode::CmpLtF32 ||
+                         op == OpCode::CmpLtF64) {
+                em.SetccEax(kCondA);
+              } else {
+                em.SetccEax(kCondAE);
+              }
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::BoolNot:
+              load_gpr(kRax, inst.a, false);
+              em.Bytes({0x85, 0xC0});
+              em.SetccEax(kCondE);
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            case OpCode::BoolAnd:
+            case OpCode::BoolOr:
+              load_gpr(kRax, inst.a, false);
+              load_gpr(kRcx, inst.b, false);
+              em.Bytes({0x85, 0xC0});
+              em.SetccAl(kCondNE);
+              em.Bytes({0x85, 0xC9});
+              em.SetccCl(kCondNE);
+              em.Bytes({static_cast<uint8_t>(op == OpCode::BoolAnd ? 0x20 : 0x08), 0xC8, 0x0F, 0xB6, 0xC0});
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            case OpCode::IsNull:
+              load_gpr(kRax, inst.a, false);
+              em.Bytes({0x83, 0xF8, 0xFF});  // cmp eax, -1
+              em.SetccEax(kCondE);
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            case OpCode::ConvI32ToI64:
+              load_gpr(kRax, inst.a, false);
+              em.Bytes({0x48, 0x63, 0xC0});  // movsxd rax, eax
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            case OpCode::ConvI64ToI32:
+              load_gpr(kRax, inst.a, false);
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            case OpCode::ConvI32ToF32:
+            case OpCode::ConvI32ToF64: {
+              bool f64 = op == OpCode::ConvI32ToF64;
+              load_gpr(kRax, inst.a, false);
+              em.Bytes({static_cast<uint8_t>(f64 ? 0xF2 : 0xF3), 0x0F, 0x2A, 0xC0});  // cvtsi2ss/sd xmm0, eax
+              store_float(inst.dst, f64);
+              break;
+            }
+            case OpCode::ConvF32ToI32:
+            case OpCode::ConvF64ToI32: {
+              bool f64 = op == OpCode::ConvF64ToI32;
+              load_xmm(kXmm0, inst.a, f64);
+              em.Bytes({static_cast<uint8_t>(f64 ? 0xF2 : 0xF3), 0x0F, 0x2C, 0xC0});  // cvtts*2si eax, xmm0
+              em.StoreQ(slot_of(inst.dst), kRax);
+              break;
+            }
+            case OpCode::ConvF32ToF64:
+              load_xmm(kXmm0, inst.a, false);
+              em.Bytes({0xF3, 0x0F, 0x5A, 0xC0});  // cvtss2sd xmm0, xmm0
+              store_float(inst.dst, true);
+              break;
+            case OpCode::ConvF64ToF32:
+              load_xmm(kXmm0, inst.a, true);
+              em.Bytes({0xF2, 0x0F, 0x5A, 0xC0});  // cvtsd2ss xmm0, xmm0
+              store_float(inst.dst, false);
+              break;
+            default:
+              return Fail(error, std::string("native JIT unsupported opcode ") +
+                                     Simple::Byte::OpCodeName(static_cast<uint8_t>(op)));
+          }
+          break;
+      }
+    }
+  }
+  em.Bind(unsupported);
+  em.MovEaxImm(static_cast<uint32_t>(NativeStatus::Unsupported));
+  em.Jmp(epilogue);
+  em.Bind(bail);
+  em.MovEaxImm(static_cast<uint32_t>(NativeStatus::Bail));
+  em.Bind(epilogue);
+  em.Bytes({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});  // pop r13; pop r12; pop rbx; ret
+  if (!em.Finish()) return Fail(error, "native JIT unbound label");
+
+  void* entry = arena.Install(em.code);
+  if (!entry) return Fail(error, "native JIT could not map code");
+  out->entry = reinterpret_cast<NativeEntry>(entry);
+  out->frame_slots = static_cast<uint32_t>(plan.frame_slots);
+  out->param_count = ir.param_count;
+  out->returns_value = ir.returns_value;
+  return true;
+#endif
+}
+
+} // namespace Simple::VM
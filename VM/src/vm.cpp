@@ -1,7 +1,11 @@
 #include "vm.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <cstdio>
 #include <cstdint>
 #include <cstdlib>
@@ -9,20 +13,32 @@
 #if !defined(_WIN32)
 #include <dlfcn.h>
 #include <ffi.h>
+#include <unistd.h>
+#else
+#include <io.h>
 #endif
 #include <filesystem>
 #include <limits>
+#include <memory>
 #include <sstream>
+#include <string_view>
 #include <thread>
 #include <tuple>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "decoded_code.h"
+#include "dl_trampoline.h"
+#include "file_mapping.h"
 #include "heap.h"
+#include "heap_string.h"
 #include "intrinsic_ids.h"
+#include "native_jit.h"
 #include "opcode.h"
+#include "sbc_loader.h"
 #include "scratch_arena.h"
 #include "sbc_verifier.h"
 
@@ -84,10 +100,6 @@ inline bool IsStringLikeImportType(TypeKind kind) {
   return kind == TypeKind::String || kind == TypeKind::Ref;
 }
 
-std::u16string AsciiToU16(const std::string& text);
-std::string U16ToAscii(const std::u16string& text);
-uint32_t CreateString(Heap& heap, const std::u16string& text);
-std::u16string ReadString(const HeapObject* obj);
 
 const char* GetEnvVar(const std::string& name, std::string* owned_value) {
 #if defined(_WIN32)
@@ -210,10 +222,37 @@ inline bool IsNullRef(Slot value) {
   return UnpackRef(value) == kNullRef;
 }
 
+// Region of a call's scratch frame that receives its string arguments as
+// NUL-terminated copies; sized before marshalling so it never grows.
+struct DlStringArea {
+  char* next = nullptr;
+  char* end = nullptr;
+};
+
+// Upper bound on one call's string copies, so a huge string fails the call
+// instead of growing the scratch arena without limit.
+constexpr size_t kDlMaxStringBytes = size_t{16} << 20;
+
+bool CopyDlString(const Heap& heap,
+                  const HeapObject* obj,
+                  DlStringArea& strings,
+                  const char** out,
+                  std::string* out_error) {
+  const size_t bytes = static_cast<size_t>(StringLength(obj)) + 1;
+  if (static_cast<size_t>(strings.end - strings.next) < bytes) {
+    if (out_error) *out_error = "core.dl.call string area overflow";
+    return false;
+  }
+  *CopyAsciiString(heap, obj, strings.next) = '\0';
+  *out = strings.next;
+  strings.next += bytes;
+  return true;
+}
+
 template <typename T>
 bool ConvertDlArg(Slot slot,
                   Heap& heap,
-                  std::vector<std::string>& owned_strings,
+                  DlStringArea& strings,
                   T* out,
                   std::string* out_error) {
   if (!out) return false;
@@ -261,9 +300,7 @@ bool ConvertDlArg(Slot slot,
       if (out_error) *out_error = "core.dl.call string argument is not a string";
       return false;
     }
-    owned_strings.push_back(U16ToAscii(ReadString(obj)));
-    *out = owned_strings.back().c_str();
-    return true;
+    return CopyDlString(heap, obj, strings, out, out_error);
   }
   if (out_error) *out_error = "core.dl.call unsupported argument type conversion";
   return false;
@@ -310,7 +347,7 @@ bool PackDlReturn(T value, Heap& heap, Slot* out_ret, std::string* out_error) {
       *out_ret = PackRef(kNullRef);
       return true;
     }
-    uint32_t handle = CreateString(heap, AsciiToU16(value));
+    uint32_t handle = CreateLatin1String(heap, value);
     *out_ret = PackRef(handle);
     return true;
   }
@@ -318,168 +355,6 @@ bool PackDlReturn(T value, Heap& heap, Slot* out_ret, std::string* out_error) {
   return false;
 }
 
-template <typename Ret, typename... Args>
-bool InvokeDlFunctionTyped(int64_t ptr_bits,
-                           const std::vector<Slot>& args,
-                           size_t arg_base,
-                           Heap& heap,
-                           Slot* out_ret,
-                           std::string* out_error) {
-  std::vector<std::string> owned_strings;
-  owned_strings.reserve(sizeof...(Args));
-  std::tuple<std::decay_t<Args>...> converted{};
-  bool ok = true;
-  size_t index = 0;
-  auto convert_one = [&](auto& dst) {
-    if (!ok) return;
-    using ArgT = std::decay_t<decltype(dst)>;
-    if (arg_base + index >= args.size()) {
-      ok = false;
-      if (out_error) *out_error = "core.dl.call arg index out of range";
-      return;
-    }
-    if (!ConvertDlArg<ArgT>(args[arg_base + index], heap, owned_strings, &dst, out_error)) {
-      ok = false;
-      return;
-    }
-    ++index;
-  };
-  std::apply([&](auto&... vals) { (convert_one(vals), ...); }, converted);
-  if (!ok) return false;
-  using Fn = Ret (*)(Args...);
-  Fn fn = reinterpret_cast<Fn>(ptr_bits);
-  Ret value = std::apply([&](auto... vals) -> Ret { return fn(vals...); }, converted);
-  return PackDlReturn<Ret>(value, heap, out_ret, out_error);
-}
-
-template <typename... Args>
-bool InvokeDlFunctionVoidTyped(int64_t ptr_bits,
-                               const std::vector<Slot>& args,
-                               size_t arg_base,
-                               Heap& heap,
-                               std::string* out_error) {
-  std::vector<std::string> owned_strings;
-  owned_strings.reserve(sizeof...(Args));
-  std::tuple<std::decay_t<Args>...> converted{};
-  bool ok = true;
-  size_t index = 0;
-  auto convert_one = [&](auto& dst) {
-    if (!ok) return;
-    using ArgT = std::decay_t<decltype(dst)>;
-    if (arg_base + index >= args.size()) {
-      ok = false;
-      if (out_error) *out_error = "core.dl.call arg index out of range";
-      return;
-    }
-    if (!ConvertDlArg<ArgT>(args[arg_base + index], heap, owned_strings, &dst, out_error)) {
-      ok = false;
-      return;
-    }
-    ++index;
-  };
-  std::apply([&](auto&... vals) { (convert_one(vals), ...); }, converted);
-  if (!ok) return false;
-  using Fn = void (*)(Args...);
-  Fn fn = reinterpret_cast<Fn>(ptr_bits);
-  std::apply([&](auto... vals) { fn(vals...); }, converted);
-  return true;
-}
-
-#define SIMPLE_DL_FOREACH_TYPE(X) \
-  X(TypeKind::I8, int8_t)         \
-  X(TypeKind::I16, int16_t)       \
-  X(TypeKind::I32, int32_t)       \
-  X(TypeKind::I64, int64_t)       \
-  X(TypeKind::U8, uint8_t)        \
-  X(TypeKind::U16, uint16_t)      \
-  X(TypeKind::U32, uint32_t)      \
-  X(TypeKind::U64, uint64_t)      \
-  X(TypeKind::F32, float)         \
-  X(TypeKind::F64, double)        \
-  X(TypeKind::Bool, bool)         \
-  X(TypeKind::Char, uint8_t)      \
-  X(TypeKind::String, const char*)
-
-template <typename Ret>
-bool DispatchDlCall1(TypeKind arg0_kind,
-                     int64_t ptr_bits,
-                     const std::vector<Slot>& args,
-                     size_t arg_base,
-                     Heap& heap,
-                     Slot* out_ret,
-                     std::string* out_error) {
-  switch (arg0_kind) {
-#define SIMPLE_DL_CASE_ARG0(kind, cpp_type) \
-    case kind:                              \
-      return InvokeDlFunctionTyped<Ret, cpp_type>(ptr_bits, args, arg_base, heap, out_ret, out_error);
-    SIMPLE_DL_FOREACH_TYPE(SIMPLE_DL_CASE_ARG0)
-#undef SIMPLE_DL_CASE_ARG0
-    default:
-      if (out_error) *out_error = "core.dl.call unsupported parameter type";
-      return false;
-  }
-}
-
-template <typename Arg0>
-bool DispatchDlCall2Arg1Void(TypeKind arg1_kind,
-                             int64_t ptr_bits,
-                             const std::vector<Slot>& args,
-                             size_t arg_base,
-                             Heap& heap,
-                             std::string* out_error) {
-  switch (arg1_kind) {
-#define SIMPLE_DL_CASE_ARG1_VOID(kind, cpp_type) \
-    case kind:                                   \
-      return InvokeDlFunctionVoidTyped<Arg0, cpp_type>(ptr_bits, args, arg_base, heap, out_error);
-    SIMPLE_DL_FOREACH_TYPE(SIMPLE_DL_CASE_ARG1_VOID)
-#undef SIMPLE_DL_CASE_ARG1_VOID
-    default:
-      if (out_error) *out_error = "core.dl.call unsupported parameter type";
-      return false;
-  }
-}
-
-template <typename Ret, typename Arg0>
-bool DispatchDlCall2Arg1(TypeKind arg1_kind,
-                         int64_t ptr_bits,
-                         const std::vector<Slot>& args,
-                         size_t arg_base,
-                         Heap& heap,
-                         Slot* out_ret,
-                         std::string* out_error) {
-  switch (arg1_kind) {
-#define SIMPLE_DL_CASE_ARG1(kind, cpp_type) \
-    case kind:                              \
-      return InvokeDlFunctionTyped<Ret, Arg0, cpp_type>(ptr_bits, args, arg_base, heap, out_ret, out_error);
-    SIMPLE_DL_FOREACH_TYPE(SIMPLE_DL_CASE_ARG1)
-#undef SIMPLE_DL_CASE_ARG1
-    default:
-      if (out_error) *out_error = "core.dl.call unsupported parameter type";
-      return false;
-  }
-}
-
-template <typename Ret>
-bool DispatchDlCall2(TypeKind arg0_kind,
-                     TypeKind arg1_kind,
-                     int64_t ptr_bits,
-                     const std::vector<Slot>& args,
-                     size_t arg_base,
-                     Heap& heap,
-                     Slot* out_ret,
-                     std::string* out_error) {
-  switch (arg0_kind) {
-#define SIMPLE_DL_CASE_ARG0_2(kind, cpp_type) \
-    case kind:                                \
-      return DispatchDlCall2Arg1<Ret, cpp_type>(arg1_kind, ptr_bits, args, arg_base, heap, out_ret, out_error);
-    SIMPLE_DL_FOREACH_TYPE(SIMPLE_DL_CASE_ARG0_2)
-#undef SIMPLE_DL_CASE_ARG0_2
-    default:
-      if (out_error) *out_error = "core.dl.call unsupported parameter type";
-      return false;
-  }
-}
-
 #if !defined(_WIN32)
 struct DlOwnedFfiType {
   ffi_type type{};
@@ -500,6 +375,99 @@ struct DlAbiCache {
   std::vector<std::unique_ptr<DlOwnedFfiType>> owned_types;
 };
 
+// Word class of a scalar type kind; None when it has no trampoline class.
+DlWordClass DlWordClassOf(TypeKind kind) {
+  switch (kind) {
+    case TypeKind::I8:
+    case TypeKind::I16:
+    case TypeKind::I32:
+    case TypeKind::U8:
+    case TypeKind::U16:
+    case TypeKind::U32:
+    case TypeKind::Bool:
+    case TypeKind::Char:
+      return DlWordClass::I32;
+    case TypeKind::I64:
+    case TypeKind::U64:
+      return DlWordClass::I64;
+    case TypeKind::String:
+    case TypeKind::Ref:
+      return sizeof(void*) == sizeof(int64_t) ? DlWordClass::I64 : DlWordClass::None;
+    case TypeKind::F32:
+      return DlWordClass::F32;
+    case TypeKind::F64:
+      return DlWordClass::F64;
+    default:
+      return DlWordClass::None;
+  }
+}
+
+// Widens a value marshalled into its C type to its trampoline word.
+uint64_t DlWordFromStorage(TypeKind kind, const uint8_t* storage) {
+  auto load = [&](auto value) {
+    std::memcpy(&value, storage, sizeof(value));
+    return value;
+  };
+  switch (kind) {
+    case TypeKind::I8: return DlToWord<int32_t>(load(int8_t{}));
+    case TypeKind::I16: return DlToWord<int32_t>(load(int16_t{}));
+    case TypeKind::I32: return DlToWord<int32_t>(load(int32_t{}));
+    case TypeKind::U8:
+    case TypeKind::Bool:
+    case TypeKind::Char:
+      return DlToWord<int32_t>(load(uint8_t{}));
+    case TypeKind::U16: return DlToWord<int32_t>(load(uint16_t{}));
+    case TypeKind::U32: return DlToWord<int32_t>(static_cast<int32_t>(load(uint32_t{})));
+    case TypeKind::F32: return DlToWord<float>(load(float{}));
+    case TypeKind::F64: return DlToWord<double>(load(double{}));
+    default: return load(uint64_t{});
+  }
+}
+
+// Narrows a trampoline return word back to the C type of kind.
+void StoreDlReturnWord(TypeKind kind, uint64_t word, uint8_t* storage) {
+  auto store = [&](auto value) { std::memcpy(storage, &value, sizeof(value)); };
+  switch (kind) {
+    case TypeKind::I8: store(static_cast<int8_t>(word)); break;
+    case TypeKind::I16: store(static_cast<int16_t>(word)); break;
+    case TypeKind::I32: store(static_cast<int32_t>(word)); break;
+    case TypeKind::U8:
+    case TypeKind::Bool:
+    case TypeKind::Char:
+      store(static_cast<uint8_t>(word));
+      break;
+    case TypeKind::U16: store(static_cast<uint16_t>(word)); break;
+    case TypeKind::U32: store(static_cast<uint32_t>(word)); break;
+    case TypeKind::F32: store(DlFromWord<float>(word)); break;
+    default: store(word); break;
+  }
+}
+
+// Prepared libffi call of one call site: the CIF and the layout of the
+// per-call frame (argument values, return value, argument pointer array),
+// which is carved from the scratch arena as a single block.
+struct DlCallPlan {
+  ffi_cif cif{};
+  std::vector<ffi_type*> arg_types;
+  ffi_type* ret_type = &ffi_type_void;
+  // Set when the signature has a direct-call trampoline; cif is then unused.
+  DlTrampoline trampoline = nullptr;
+  std::vector<size_t> arg_offsets;
+  size_t ret_offset = 0;
+  size_t values_offset = 0;
+  size_t frame_bytes = 0;
+  // String arguments and struct fields; when nonzero, each call sizes their
+  // copies and appends that much string area to its frame.
+  size_t string_count = 0;
+};
+
+// libffi state kept for the lifetime of a VM instance: the struct types and
+// marshal layouts every plan points into, and the plan of each call site.
+struct DlCallCache {
+  DlAbiCache abi;
+  std::vector<std::unique_ptr<DlCallPlan>> plans;
+};
+
 size_t AlignSize(size_t value, size_t align) {
   if (align <= 1) return value;
   size_t mask = align - 1;
@@ -640,11 +608,11 @@ bool PrepareStructOffsets(const SbcModule& module,
   return true;
 }
 
-bool ReadVmPayloadScalar(const std::vector<uint8_t>& payload,
+bool ReadVmPayloadScalar(const Payload& payload,
                          size_t offset,
                          TypeKind kind,
                          Heap& heap,
-                         std::vector<std::string>& owned_strings,
+                         DlStringArea& strings,
                          void* out_value,
                          std::string* out_error) {
   auto require = [&](size_t n) -> bool {
@@ -736,9 +704,7 @@ bool ReadVmPayloadScalar(const std::vector<uint8_t>& payload,
         if (out_error) *out_error = "core.dl.call struct string field is not a string";
         return false;
       }
-      owned_strings.push_back(U16ToAscii(ReadString(obj)));
-      *static_cast<const char**>(out_value) = owned_strings.back().c_str();
-      return true;
+      return CopyDlString(heap, obj, strings, static_cast<const char**>(out_value), out_error);
     }
     default:
       if (out_error) *out_error = "core.dl.call unsupported struct field type";
@@ -746,7 +712,7 @@ bool ReadVmPayloadScalar(const std::vector<uint8_t>& payload,
   }
 }
 
-bool WriteVmPayloadScalar(std::vector<uint8_t>* payload,
+bool WriteVmPayloadScalar(Payload* payload,
                           size_t offset,
                           TypeKind kind,
                           const void* value,
@@ -817,7 +783,7 @@ bool WriteVmPayloadScalar(std::vector<uint8_t>* payload,
       if (!require(4)) return false;
       const char* text = *static_cast<const char* const*>(value);
       uint32_t ref = kNullRef;
-      if (text) ref = CreateString(heap, AsciiToU16(text));
+      if (text) ref = CreateLatin1String(heap, text);
       std::memcpy(payload->data() + offset, &ref, sizeof(ref));
       return true;
     }
@@ -832,7 +798,7 @@ bool MarshalVmArtifactToFfi(const SbcModule& module,
                             uint32_t handle,
                             DlAbiCache& cache,
                             Heap& heap,
-                            std::vector<std::string>& owned_strings,
+                            DlStringArea& strings,
                             void* out_value,
                             std::string* out_error);
 
@@ -849,7 +815,7 @@ bool MarshalVmArtifactToFfi(const SbcModule& module,
                             uint32_t handle,
                             DlAbiCache& cache,
                             Heap& heap,
-                            std::vector<std::string>& owned_strings,
+                            DlStringArea& strings,
                             void* out_value,
                             std::string* out_error) {
   if (!IsStructTypeId(module, type_id)) {
@@ -884,13 +850,13 @@ bool MarshalVmArtifactToFfi(const SbcModule& module,
       }
       uint32_t nested = 0;
       std::memcpy(&nested, obj->payload.data() + vm_offset, sizeof(nested));
-      if (!MarshalVmArtifactToFfi(module, field_type_id, nested, cache, heap, owned_strings, dst, out_error)) {
+      if (!MarshalVmArtifactToFfi(module, field_type_id, nested, cache, heap, strings, dst, out_error)) {
         return false;
       }
       continue;
     }
     TypeKind field_kind = static_cast<TypeKind>(module.types[field_type_id].kind);
-    if (!ReadVmPayloadScalar(obj->payload, vm_offset, field_kind, heap, owned_strings, dst, out_error)) {
+    if (!ReadVmPayloadScalar(obj->payload, vm_offset, field_kind, heap, strings, dst, out_error)) {
       return false;
     }
   }
@@ -948,7 +914,7 @@ bool FillScalarArgStorage(const SbcModule& module,
                           uint32_t type_id,
                           Slot slot,
                           Heap& heap,
-                          std::vector<std::string>& owned_strings,
+                          DlStringArea& strings,
                           void* out_value,
                           std::string* out_error) {
   if (type_id >= module.types.size()) {
@@ -957,95 +923,202 @@ bool FillScalarArgStorage(const SbcModule& module,
   }
   TypeKind kind = static_cast<TypeKind>(module.types[type_id].kind);
   switch (kind) {
-    case TypeKind::I8: return ConvertDlArg<int8_t>(slot, heap, owned_strings, static_cast<int8_t*>(out_value), out_error);
-    case TypeKind::I16: return ConvertDlArg<int16_t>(slot, heap, owned_strings, static_cast<int16_t*>(out_value), out_error);
-    case TypeKind::I32: return ConvertDlArg<int32_t>(slot, heap, owned_strings, static_cast<int32_t*>(out_value), out_error);
-    case TypeKind::I64: return ConvertDlArg<int64_t>(slot, heap, owned_strings, static_cast<int64_t*>(out_value), out_error);
+    case TypeKind::I8: return ConvertDlArg<int8_t>(slot, heap, strings, static_cast<int8_t*>(out_value), out_error);
+    case TypeKind::I16: return ConvertDlArg<int16_t>(slot, heap, strings, static_cast<int16_t*>(out_value), out_error);
+    case TypeKind::I32: return ConvertDlArg<int32_t>(slot, heap, strings, static_cast<int32_t*>(out_value), out_error);
+    case TypeKind::I64: return ConvertDlArg<int64_t>(slot, heap, strings, static_cast<int64_t*>(out_value), out_error);
     case TypeKind::U8:
     case TypeKind::Bool:
     case TypeKind::Char:
-      return ConvertDlArg<uint8_t>(slot, heap, owned_strings, static_cast<uint8_t*>(out_value), out_error);
+      return ConvertDlArg<uint8_t>(slot, heap, strings, static_cast<uint8_t*>(out_value), out_error);
     case TypeKind::U16:
-      return ConvertDlArg<uint16_t>(slot, heap, owned_strings, static_cast<uint16_t*>(out_value), out_error);
+      return ConvertDlArg<uint16_t>(slot, heap, strings, static_cast<uint16_t*>(out_value), out_error);
     case TypeKind::U32:
-      return ConvertDlArg<uint32_t>(slot, heap, owned_strings, static_cast<uint32_t*>(out_value), out_error);
+      return ConvertDlArg<uint32_t>(slot, heap, strings, static_cast<uint32_t*>(out_value), out_error);
     case TypeKind::U64:
     case TypeKind::Ref:
-      return ConvertDlArg<uint64_t>(slot, heap, owned_strings, static_cast<uint64_t*>(out_value), out_error);
+      return ConvertDlArg<uint64_t>(slot, heap, strings, static_cast<uint64_t*>(out_value), out_error);
     case TypeKind::F32:
-      return ConvertDlArg<float>(slot, heap, owned_strings, static_cast<float*>(out_value), out_error);
+      return ConvertDlArg<float>(slot, heap, strings, static_cast<float*>(out_value), out_error);
     case TypeKind::F64:
-      return ConvertDlArg<double>(slot, heap, owned_strings, static_cast<double*>(out_value), out_error);
+      return ConvertDlArg<double>(slot, heap, strings, static_cast<double*>(out_value), out_error);
     case TypeKind::String:
-      return ConvertDlArg<const char*>(slot, heap, owned_strings, static_cast<const char**>(out_value), out_error);
+      return ConvertDlArg<const char*>(slot, heap, strings, static_cast<const char**>(out_value), out_error);
     default:
       if (out_error) *out_error = "core.dl.call unsupported parameter type";
       return false;
   }
 }
 
-bool DispatchDynamicDlCall(int64_t ptr_bits,
-                           const SbcModule& module,
-                           uint32_t ret_type_id,
-                           bool has_ret,
-                           const std::vector<uint32_t>& arg_type_ids,
-                           const std::vector<Slot>& args,
-                           size_t arg_base,
-                           Heap& heap,
-                           Slot* out_ret,
-                           std::string* out_error) {
-  DlAbiCache cache;
-  std::vector<std::string> owned_strings;
-  std::vector<ffi_type*> ffi_arg_types(arg_type_ids.size(), nullptr);
+DlTrampoline FindDlTrampoline(const SbcModule& module,
+                              uint32_t ret_type_id,
+                              bool has_ret,
+                              const std::vector<uint32_t>& arg_type_ids) {
+  if (arg_type_ids.size() > kDlTrampolineMaxArgs) return nullptr;
+  DlWordClass arg_classes[kDlTrampolineMaxArgs] = {};
   for (size_t i = 0; i < arg_type_ids.size(); ++i) {
-    ffi_arg_types[i] = BuildDlFfiType(module, arg_type_ids[i], cache, out_error);
-    if (!ffi_arg_types[i]) return false;
+    if (IsStructTypeId(module, arg_type_ids[i])) return nullptr;
+    arg_classes[i] = DlWordClassOf(static_cast<TypeKind>(module.types[arg_type_ids[i]].kind));
+    if (arg_classes[i] == DlWordClass::None) return nullptr;
   }
-
-  ffi_type* ffi_ret_type = &ffi_type_void;
+  DlWordClass ret_class = DlWordClass::None;
   if (has_ret) {
-    ffi_ret_type = BuildDlFfiType(module, ret_type_id, cache, out_error);
-    if (!ffi_ret_type) return false;
+    if (IsStructTypeId(module, ret_type_id)) return nullptr;
+    ret_class = DlWordClassOf(static_cast<TypeKind>(module.types[ret_type_id].kind));
+    if (ret_class == DlWordClass::None) return nullptr;
+  }
+  return LookupDlTrampoline(ret_class, arg_classes, arg_type_ids.size());
+}
+
+size_t CountDlStrings(const SbcModule& module, uint32_t type_id, const DlAbiCache& cache) {
+  auto meta_it = cache.struct_meta.find(type_id);
+  if (meta_it == cache.struct_meta.end()) {
+    return static_cast<TypeKind>(module.types[type_id].kind) == TypeKind::String ? 1u : 0u;
+  }
+  size_t count = 0;
+  for (uint32_t field_type_id : meta_it->second.field_type_ids) {
+    count += CountDlStrings(module, field_type_id, cache);
   }
+  return count;
+}
 
-  ffi_cif cif;
-  if (ffi_prep_cif(&cif,
+// Bytes the string copies of one argument need, terminators included.
+// Values the marshalling will reject count nothing.
+size_t DlStringBytes(const SbcModule& module, uint32_t type_id, Slot slot, const DlAbiCache& cache, const Heap& heap) {
+  if (!IsStructTypeId(module, type_id)) {
+    if (static_cast<TypeKind>(module.types[type_id].kind) != TypeKind::String || IsNullRef(slot)) return 0;
+    const HeapObject* obj = heap.Get(UnpackRef(slot));
+    if (!obj || obj->header.kind != ObjectKind::String) return 0;
+    return static_cast<size_t>(StringLength(obj)) + 1;
+  }
+  auto meta_it = cache.struct_meta.find(type_id);
+  if (meta_it == cache.struct_meta.end()) return 0;
+  const DlStructMeta& meta = meta_it->second;
+  const HeapObject* obj = IsNullRef(slot) ? nullptr : heap.Get(UnpackRef(slot));
+  if (!obj || obj->header.kind != ObjectKind::Artifact || obj->header.type_id != type_id) return 0;
+  size_t bytes = 0;
+  for (size_t i = 0; i < meta.field_type_ids.size(); ++i) {
+    const size_t vm_offset = static_cast<size_t>(meta.vm_offsets[i]);
+    if (vm_offset + 4 > obj->payload.size()) continue;
+    uint32_t ref = kNullRef;
+    std::memcpy(&ref, obj->payload.data() + vm_offset, sizeof(ref));
+    bytes += DlStringBytes(module, meta.field_type_ids[i], PackRef(ref), cache, heap);
+  }
+  return bytes;
+}
+
+std::unique_ptr<DlCallPlan> PrepareDlCallPlan(const SbcModule& module,
+                                              uint32_t ret_type_id,
+                                              bool has_ret,
+                                              const std::vector<uint32_t>& arg_type_ids,
+                                              DlAbiCache& cache,
+                                              std::string* out_error) {
+  auto plan = std::make_unique<DlCallPlan>();
+  plan->arg_types.assign(arg_type_ids.size(), nullptr);
+  for (size_t i = 0; i < arg_type_ids.size(); ++i) {
+    plan->arg_types[i] = BuildDlFfiType(module, arg_type_ids[i], cache, out_error);
+    if (!plan->arg_types[i]) return nullptr;
+  }
+  if (has_ret) {
+    plan->ret_type = BuildDlFfiType(module, ret_type_id, cache, out_error);
+    if (!plan->ret_type) return nullptr;
+  }
+  if (ffi_prep_cif(&plan->cif,
                    FFI_DEFAULT_ABI,
                    static_cast<unsigned int>(arg_type_ids.size()),
-                   ffi_ret_type,
-                   ffi_arg_types.data()) != FFI_OK) {
+                   plan->ret_type,
+                   plan->arg_types.data()) != FFI_OK) {
     if (out_error) *out_error = "core.dl.call ffi_prep_cif failed";
-    return false;
+    return nullptr;
   }
   for (uint32_t type_id : arg_type_ids) {
     if (IsStructTypeId(module, type_id) && !PrepareStructOffsets(module, type_id, cache, out_error)) {
-      return false;
+      return nullptr;
     }
+    plan->string_count += CountDlStrings(module, type_id, cache);
   }
   if (has_ret && IsStructTypeId(module, ret_type_id) &&
       !PrepareStructOffsets(module, ret_type_id, cache, out_error)) {
+    return nullptr;
+  }
+  plan->trampoline = FindDlTrampoline(module, ret_type_id, has_ret, arg_type_ids);
+  const size_t align = alignof(std::max_align_t);
+  size_t offset = 0;
+  plan->arg_offsets.reserve(arg_type_ids.size());
+  for (ffi_type* type : plan->arg_types) {
+    offset = AlignSize(offset, align);
+    plan->arg_offsets.push_back(offset);
+    offset += type->size > 0 ? type->size : sizeof(uint64_t);
+  }
+  if (has_ret) {
+    // libffi widens integral returns to a full ffi_arg.
+    offset = AlignSize(offset, align);
+    plan->ret_offset = offset;
+    offset += std::max<size_t>(plan->ret_type->size, sizeof(ffi_arg));
+  }
+  offset = AlignSize(offset, alignof(void*));
+  plan->values_offset = offset;
+  offset += arg_type_ids.size() * sizeof(void*);
+  plan->frame_bytes = std::max<size_t>(offset, 1);
+  return plan;
+}
+
+// site identifies the call site (the import index) whose plan is cached.
+bool DispatchDynamicDlCall(int64_t ptr_bits,
+                           const SbcModule& module,
+                           uint32_t ret_type_id,
+                           bool has_ret,
+                           const std::vector<uint32_t>& arg_type_ids,
+                           const std::vector<Slot>& args,
+                           size_t arg_base,
+                           Heap& heap,
+                           ScratchArena& scratch,
+                           DlCallCache& cache,
+                           size_t site,
+                           Slot* out_ret,
+                           std::string* out_error) {
+  if (site >= cache.plans.size()) cache.plans.resize(site + 1);
+  if (!cache.plans[site]) {
+    cache.plans[site] = PrepareDlCallPlan(module, ret_type_id, has_ret, arg_type_ids, cache.abi, out_error);
+    if (!cache.plans[site]) return false;
+  }
+  DlCallPlan& plan = *cache.plans[site];
+  size_t string_bytes = 0;
+  if (plan.string_count > 0) {
+    for (size_t i = 0; i < arg_type_ids.size() && arg_base + i < args.size(); ++i) {
+      string_bytes += DlStringBytes(module, arg_type_ids[i], args[arg_base + i], cache.abi, heap);
+    }
+    if (string_bytes > kDlMaxStringBytes) {
+      if (out_error) *out_error = "core.dl.call string arguments too large";
+      return false;
+    }
+  }
+  ScratchScope scratch_scope(scratch);
+  uint8_t* frame = scratch.Allocate(plan.frame_bytes + string_bytes, alignof(std::max_align_t));
+  if (!frame) {
+    if (out_error) *out_error = "core.dl.call frame allocation failed";
     return false;
   }
-  std::vector<std::vector<uint8_t>> arg_storage(arg_type_ids.size());
-  std::vector<void*> ffi_arg_values(arg_type_ids.size(), nullptr);
+  std::memset(frame, 0, plan.frame_bytes);
+  DlStringArea strings{reinterpret_cast<char*>(frame + plan.frame_bytes),
+                       reinterpret_cast<char*>(frame + plan.frame_bytes + string_bytes)};
+  void** ffi_arg_values = reinterpret_cast<void**>(frame + plan.values_offset);
   for (size_t i = 0; i < arg_type_ids.size(); ++i) {
     if (arg_base + i >= args.size()) {
       if (out_error) *out_error = "core.dl.call arg index out of range";
       return false;
     }
-    ffi_type* field_ffi = ffi_arg_types[i];
-    size_t size = (field_ffi && field_ffi->size > 0) ? field_ffi->size : sizeof(uint64_t);
-    arg_storage[i].assign(size, 0);
+    uint8_t* arg_storage = frame + plan.arg_offsets[i];
     uint32_t type_id = arg_type_ids[i];
     if (IsStructTypeId(module, type_id)) {
       uint32_t ref = UnpackRef(args[arg_base + i]);
       if (!MarshalVmArtifactToFfi(module,
                                   type_id,
                                   ref,
-                                  cache,
+                                  cache.abi,
                                   heap,
-                                  owned_strings,
-                                  arg_storage[i].data(),
+                                  strings,
+                                  arg_storage,
                                   out_error)) {
         return false;
       }
@@ -1053,26 +1126,33 @@ bool DispatchDynamicDlCall(int64_t ptr_bits,
                                      type_id,
                                      args[arg_base + i],
                                      heap,
-                                     owned_strings,
-                                     arg_storage[i].data(),
+                                     strings,
+                                     arg_storage,
                                      out_error)) {
       return false;
     }
-    ffi_arg_values[i] = arg_storage[i].data();
-  }
-  std::vector<uint8_t> ret_storage;
-  void* ret_ptr = nullptr;
-  if (has_ret) {
-    size_t size = (ffi_ret_type && ffi_ret_type->size > 0) ? ffi_ret_type->size : sizeof(uint64_t);
-    ret_storage.assign(size, 0);
-    ret_ptr = ret_storage.data();
+    ffi_arg_values[i] = arg_storage;
   }
+  uint8_t* ret_storage = has_ret ? frame + plan.ret_offset : nullptr;
 
-  void (*fn)() = reinterpret_cast<void (*)()>(static_cast<uintptr_t>(ptr_bits));
-  ffi_call(&cif,
-           FFI_FN(fn),
-           ret_ptr,
-           ffi_arg_values.data());
+  if (plan.trampoline) {
+    uint64_t words[kDlTrampolineMaxArgs] = {};
+    for (size_t i = 0; i < arg_type_ids.size(); ++i) {
+      TypeKind kind = static_cast<TypeKind>(module.types[arg_type_ids[i]].kind);
+      words[i] = DlWordFromStorage(kind, frame + plan.arg_offsets[i]);
+    }
+    uint64_t ret_word = 0;
+    plan.trampoline(reinterpret_cast<void*>(static_cast<uintptr_t>(ptr_bits)), words, &ret_word);
+    if (has_ret) {
+      StoreDlReturnWord(static_cast<TypeKind>(module.types[ret_type_id].kind), ret_word, ret_storage);
+    }
+  } else {
+    void (*fn)() = reinterpret_cast<void (*)()>(static_cast<uintptr_t>(ptr_bits));
+    ffi_call(&plan.cif,
+             FFI_FN(fn),
+             ret_storage,
+             ffi_arg_values);
+  }
 
   if (!has_ret) return true;
   if (!out_ret) {
@@ -1081,7 +1161,7 @@ bool DispatchDynamicDlCall(int64_t ptr_bits,
   }
   if (IsStructTypeId(module, ret_type_id)) {
     uint32_t handle = kNullRef;
-    if (!MarshalFfiToVmArtifact(module, ret_type_id, ret_storage.data(), cache, heap, &handle, out_error)) {
+    if (!MarshalFfiToVmArtifact(module, ret_type_id, ret_storage, cache.abi, heap, &handle, out_error)) {
       return false;
     }
     *out_ret = PackRef(handle);
@@ -1089,27 +1169,29 @@ bool DispatchDynamicDlCall(int64_t ptr_bits,
   }
   TypeKind ret_kind = static_cast<TypeKind>(module.types[ret_type_id].kind);
   switch (ret_kind) {
-    case TypeKind::I8: return PackDlReturn<int8_t>(*reinterpret_cast<int8_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::I16: return PackDlReturn<int16_t>(*reinterpret_cast<int16_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::I32: return PackDlReturn<int32_t>(*reinterpret_cast<int32_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::I64: return PackDlReturn<int64_t>(*reinterpret_cast<int64_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::U8: return PackDlReturn<uint8_t>(*reinterpret_cast<uint8_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::U16: return PackDlReturn<uint16_t>(*reinterpret_cast<uint16_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::U32: return PackDlReturn<uint32_t>(*reinterpret_cast<uint32_t*>(ret_storage.data()), heap, out_ret, out_error);
+    case TypeKind::I8: return PackDlReturn<int8_t>(*reinterpret_cast<int8_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::I16: return PackDlReturn<int16_t>(*reinterpret_cast<int16_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::I32: return PackDlReturn<int32_t>(*reinterpret_cast<int32_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::I64: return PackDlReturn<int64_t>(*reinterpret_cast<int64_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::U8: return PackDlReturn<uint8_t>(*reinterpret_cast<uint8_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::U16: return PackDlReturn<uint16_t>(*reinterpret_cast<uint16_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::U32: return PackDlReturn<uint32_t>(*reinterpret_cast<uint32_t*>(ret_storage), heap, out_ret, out_error);
     case TypeKind::U64:
     case TypeKind::Ref:
-      return PackDlReturn<uint64_t>(*reinterpret_cast<uint64_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::F32: return PackDlReturn<float>(*reinterpret_cast<float*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::F64: return PackDlReturn<double>(*reinterpret_cast<double*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::Bool: return PackDlReturn<bool>((*reinterpret_cast<uint8_t*>(ret_storage.data())) != 0, heap, out_ret, out_error);
-    case TypeKind::Char: return PackDlReturn<uint8_t>(*reinterpret_cast<uint8_t*>(ret_storage.data()), heap, out_ret, out_error);
-    case TypeKind::String: return PackDlReturn<const char*>(*reinterpret_cast<const char**>(ret_storage.data()), heap, out_ret, out_error);
+      return PackDlReturn<uint64_t>(*reinterpret_cast<uint64_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::F32: return PackDlReturn<float>(*reinterpret_cast<float*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::F64: return PackDlReturn<double>(*reinterpret_cast<double*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::Bool: return PackDlReturn<bool>((*reinterpret_cast<uint8_t*>(ret_storage)) != 0, heap, out_ret, out_error);
+    case TypeKind::Char: return PackDlReturn<uint8_t>(*reinterpret_cast<uint8_t*>(ret_storage), heap, out_ret, out_error);
+    case TypeKind::String: return PackDlReturn<const char*>(*reinterpret_cast<const char**>(ret_storage), heap, out_ret, out_error);
     default:
       if (out_error) *out_error = "core.dl.call unsupported return type";
       return false;
   }
 }
 #else
+struct DlCallCache {};
+
 bool DispatchDynamicDlCall(int64_t /*ptr_bits*/,
                            const SbcModule& /*module*/,
                            uint32_t /*ret_type_id*/,
@@ -1118,6 +1200,9 @@ bool DispatchDynamicDlCall(int64_t /*ptr_bits*/,
                            const std::vector<Slot>& /*args*/,
                            size_t /*arg_base*/,
                            Heap& /*heap*/,
+                           ScratchArena& /*scratch*/,
+                           DlCallCache& /*cache*/,
+                           size_t /*site*/,
                            Slot* /*out_ret*/,
                            std::string* out_error) {
   if (out_error) *out_error = "core.dl.call is unsupported on windows";
@@ -1125,8 +1210,6 @@ bool DispatchDynamicDlCall(int64_t /*ptr_bits*/,
 }
 #endif
 
-#undef SIMPLE_DL_FOREACH_TYPE
-
 std::string ReadConstPoolString(const SbcModule& module, uint32_t offset) {
   if (offset >= module.const_pool.size()) return {};
   std::string out;
@@ -1138,30 +1221,14 @@ std::string ReadConstPoolString(const SbcModule& module, uint32_t offset) {
   return out;
 }
 
-std::u16string AsciiToU16(const std::string& text) {
-  std::u16string out;
-  out.reserve(text.size());
-  for (unsigned char c : text) {
-    out.push_back(static_cast<char16_t>(c));
-  }
-  return out;
-}
-
-std::string U16ToAscii(const std::u16string& text) {
-  std::string out;
-  out.reserve(text.size());
-  for (char16_t c : text) {
-    if (c <= 0x7Fu) {
-      out.push_back(static_cast<char>(c));
-    } else {
-      out.push_back('?');
-    }
-  }
-  return out;
-}
+constexpr size_t kInitialFrameCapacity = 256;
+constexpr size_t kInitialLocalsCapacity = 4096;
 
 struct Frame {
   size_t func_index = 0;
+  // pc of the call this frame is suspended at; its stack map describes the
+  // frame's operands while the callee runs.
+  size_t call_pc = 0;
   size_t return_pc = 0;
   size_t stack_base = 0;
   uint32_t closure_ref = kNullRef;
@@ -1177,6 +1244,16 @@ struct JitStub {
   bool disabled = false;
 };
 
+// Per-callsite cache of closure method id -> function index for
+// CALL_INDIRECT. Holds up to kWays targets; once full the site is
+// megamorphic and misses go straight to function_by_method.
+struct CallIndirectCache {
+  static constexpr uint8_t kWays = 4;
+  uint32_t method_ids[kWays] = {};
+  uint32_t func_indices[kWays] = {};
+  uint8_t count = 0;
+};
+
 struct TrapContext {
   Frame* current = nullptr;
   const std::vector<Frame>* call_stack = nullptr;
@@ -1199,6 +1276,66 @@ struct TrapContextGuard {
   }
 };
 
+// Interpreter dispatch. GCC/Clang builds jump straight to each handler through
+// a label table (computed goto); other compilers use the plain switch.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(SIMPLEVM_NO_COMPUTED_GOTO)
+#define SIMPLEVM_COMPUTED_GOTO 1
+#define VM_CASE(name) case OpCode::name: vm_op_##name:
+#define VM_DEFAULT() default: vm_op_default:
+#else
+#define SIMPLEVM_COMPUTED_GOTO 0
+#define VM_CASE(name) case OpCode::name:
+#define VM_DEFAULT() default:
+#endif
+
+// Opcodes with a VM_CASE handler in the ExecuteModule loop.
+#define VM_INTERPRETER_OPCODES(X) \
+  X(Nop) X(Halt) X(Trap) X(Breakpoint) X(Pop) X(Dup) X(Dup2) X(Swap) X(Rot) X(ConstI32) X(ConstI64) \
+  X(ConstU32) X(ConstU64) X(ConstI8) X(ConstI16) X(ConstU8) X(ConstU16) X(ConstF32) X(ConstF64) \
+  X(ConstI128) X(ConstU128) X(ConstChar) X(ConstBool) X(ConstString) X(ConstNull) X(LoadLocal) \
+  X(StoreLocal) X(LoadGlobal) X(StoreGlobal) X(LoadUpvalue) X(StoreUpvalue) X(NewObject) \
+  X(NewClosure) X(LoadField) X(StoreField) X(IsNull) X(RefEq) X(RefNe) X(TypeOf) X(NewArray) \
+  X(NewArrayI64) X(NewArrayF64) X(NewArrayF32) X(NewArrayRef) X(NewArrayU8) X(ArrayLen) \
+  X(ArrayGetI32) X(ArrayGetI64) X(ArrayGetF32) X(ArrayGetF64) X(ArrayGetRef) X(ArrayGetU8) \
+  X(ArraySetI32) X(ArraySetI64) X(ArraySetF32) X(ArraySetF64) X(ArraySetRef) X(ArraySetU8) \
+  X(NewList) X(NewListI64) X(NewListF64) X(NewListF32) \
+  X(NewListRef) X(ListLen) X(ListGetI32) X(ListGetI64) X(ListGetF32) X(ListGetF64) X(ListGetRef) \
+  X(ListSetI32) X(ListSetI64) X(ListSetF32) X(ListSetF64) X(ListSetRef) X(ListPushI32) \
+  X(ListPushI64) X(ListPushF32) X(ListPushF64) X(ListPushRef) X(ListPopI32) X(ListPopI64) \
+  X(ListPopF32) X(ListPopF64) X(ListPopRef) X(ListInsertI32) X(ListInsertI64) X(ListInsertF32) \
+  X(ListInsertF64) X(ListInsertRef) X(ListRemoveI32) X(ListRemoveI64) X(ListRemoveF32) \
+  X(ListRemoveF64) X(ListRemoveRef) X(ListClear) X(StringLen) X(StringConcat) X(StringGetChar) \
+  X(StringSlice) X(CallCheck) X(Line) X(ProfileStart) X(ProfileEnd) X(Intrinsic) X(PrintFmt) \
+  X(SysCall) \
+  X(AddI32) X(SubI32) X(MulI32) X(DivI32) X(ModI32) X(NegI32) X(IncI32) X(DecI32) X(AddU32) \
+  X(SubU32) X(MulU32) X(DivU32) X(ModU32) X(IncU32) X(DecU32) X(IncI8) X(DecI8) X(IncI16) X(DecI16) \
+  X(IncU8) X(DecU8) X(IncU16) X(DecU16) X(NegI8) X(NegI16) X(NegU8) X(NegU16) X(NegU32) X(AndI32) \
+  X(OrI32) X(XorI32) X(ShlI32) X(ShrI32) X(AddI64) X(SubI64) X(MulI64) X(DivI64) X(ModI64) \
+  X(NegI64) X(NegU64) X(IncI64) X(DecI64) X(AddU64) X(SubU64) X(MulU64) X(DivU64) X(ModU64) \
+  X(IncU64) X(DecU64) X(AndI64) X(OrI64) X(XorI64) X(ShlI64) X(ShrI64) X(AddF32) X(SubF32) \
+  X(MulF32) X(DivF32) X(NegF32) X(IncF32) X(DecF32) X(AddF64) X(SubF64) X(MulF64) X(DivF64) \
+  X(NegF64) X(IncF64) X(DecF64) X(CmpEqI32) X(CmpLtI32) X(CmpNeI32) X(CmpLeI32) X(CmpGtI32) \
+  X(CmpGeI32) X(CmpEqU32) X(CmpLtU32) X(CmpNeU32) X(CmpLeU32) X(CmpGtU32) X(CmpGeU32) X(CmpEqI64) \
+  X(CmpLtI64) X(CmpNeI64) X(CmpLeI64) X(CmpGtI64) X(CmpGeI64) X(CmpEqU64) X(CmpLtU64) X(CmpNeU64) \
+  X(CmpLeU64) X(CmpGtU64) X(CmpGeU64) X(CmpEqF32) X(CmpLtF32) X(CmpNeF32) X(CmpLeF32) X(CmpGtF32) \
+  X(CmpGeF32) X(CmpEqF64) X(CmpLtF64) X(CmpNeF64) X(CmpLeF64) X(CmpGtF64) X(CmpGeF64) X(BoolNot) \
+  X(BoolAnd) X(BoolOr) X(Jmp) X(JmpTable) X(JmpTrue) X(JmpFalse) X(Enter) X(Leave) X(Call) \
+  X(CallIndirect) X(TailCall) X(ConvI32ToI64) X(ConvI64ToI32) X(ConvI32ToF32) X(ConvI32ToF64) \
+  X(ConvF32ToI32) X(ConvF64ToI32) X(ConvF32ToF64) X(ConvF64ToF32) X(Ret) X(AddLocalsI32) X(IncLocalI32) \
+  X(JmpFalseCmpLocalConstI32) X(LoadLocal2)
+
+bool CompareI32(uint8_t opcode, int32_t lhs, int32_t rhs) {
+  switch (static_cast<OpCode>(opcode)) {
+    case OpCode::CmpEqI32: return lhs == rhs;
+    case OpCode::CmpNeI32: return lhs != rhs;
+    case OpCode::CmpLtI32: return lhs < rhs;
+    case OpCode::CmpLeI32: return lhs <= rhs;
+    case OpCode::CmpGtI32: return lhs > rhs;
+    case OpCode::CmpGeI32: return lhs >= rhs;
+    default: return false;
+  }
+}
+
 int32_t ReadI32(const std::vector<uint8_t>& code, size_t& pc) {
   uint32_t v = static_cast<uint32_t>(code[pc]) |
                (static_cast<uint32_t>(code[pc + 1]) << 8) |
@@ -1264,14 +1401,64 @@ void Push(std::vector<Slot>& stack, Slot v) {
   stack.push_back(v);
 }
 
-uint32_t ReadU32Payload(const std::vector<uint8_t>& payload, size_t offset) {
+// Operand stack used for modules that passed VerifyModule. The verifier bounds
+// each function's height by stack_max and rejects underflow, so the interpreter
+// reserves stack_max slots per frame and push/pop run without capacity or
+// emptiness checks. Mirrors the subset of std::vector the interpreter uses.
+class VerifiedStack {
+ public:
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  Slot& back() { return data_[size_ - 1]; }
+  Slot& operator[](size_t index) { return data_[index]; }
+  void push_back(Slot v) { data_[size_++] = v; }
+  void pop_back() { --size_; }
+  // Pops leave slots in place, so an opcode that failed after popping its
+  // operands can put them back and run again.
+  void Restore(size_t count) { size_ = count; }
+  void resize(size_t count) {
+    if (count > size_) {
+      reserve(count);
+      std::fill(data_ + size_, data_ + count, Slot{0});
+    }
+    size_ = count;
+  }
+  void reserve(size_t count) {
+    if (count <= slots_.size()) return;
+    slots_.resize(std::max(count, slots_.size() * 2));
+    data_ = slots_.data();
+  }
+
+ private:
+  std::vector<Slot> slots_;
+  Slot* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+Slot Pop(VerifiedStack& stack) {
+  Slot v = stack.back();
+  stack.pop_back();
+  return v;
+}
+
+void Push(VerifiedStack& stack, Slot v) {
+  stack.push_back(v);
+}
+
+template <bool kChecked>
+using OperandStack = std::conditional_t<kChecked, std::vector<Slot>, VerifiedStack>;
+
+// Bytes is a heap Payload or a byte vector (const pool, blobs).
+template <typename Bytes>
+uint32_t ReadU32Payload(const Bytes& payload, size_t offset) {
   return static_cast<uint32_t>(payload[offset]) |
          (static_cast<uint32_t>(payload[offset + 1]) << 8) |
          (static_cast<uint32_t>(payload[offset + 2]) << 16) |
          (static_cast<uint32_t>(payload[offset + 3]) << 24);
 }
 
-uint64_t ReadU64Payload(const std::vector<uint8_t>& payload, size_t offset) {
+template <typename Bytes>
+uint64_t ReadU64Payload(const Bytes& payload, size_t offset) {
   return static_cast<uint64_t>(payload[offset]) |
          (static_cast<uint64_t>(payload[offset + 1]) << 8) |
          (static_cast<uint64_t>(payload[offset + 2]) << 16) |
@@ -1282,14 +1469,16 @@ uint64_t ReadU64Payload(const std::vector<uint8_t>& payload, size_t offset) {
          (static_cast<uint64_t>(payload[offset + 7]) << 56);
 }
 
-void WriteU32Payload(std::vector<uint8_t>& payload, size_t offset, uint32_t value) {
+template <typename Bytes>
+void WriteU32Payload(Bytes& payload, size_t offset, uint32_t value) {
   payload[offset + 0] = static_cast<uint8_t>(value & 0xFF);
   payload[offset + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
   payload[offset + 2] = static_cast<uint8_t>((value >> 16) & 0xFF);
   payload[offset + 3] = static_cast<uint8_t>((value >> 24) & 0xFF);
 }
 
-void WriteU64Payload(std::vector<uint8_t>& payload, size_t offset, uint64_t value) {
+template <typename Bytes>
+void WriteU64Payload(Bytes& payload, size_t offset, uint64_t value) {
   payload[offset + 0] = static_cast<uint8_t>(value & 0xFF);
   payload[offset + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
   payload[offset + 2] = static_cast<uint8_t>((value >> 16) & 0xFF);
@@ -1300,17 +1489,7 @@ void WriteU64Payload(std::vector<uint8_t>& payload, size_t offset, uint64_t valu
   payload[offset + 7] = static_cast<uint8_t>((value >> 56) & 0xFF);
 }
 
-uint16_t ReadU16Payload(const std::vector<uint8_t>& payload, size_t offset) {
-  return static_cast<uint16_t>(payload[offset]) |
-         (static_cast<uint16_t>(payload[offset + 1]) << 8);
-}
-
-void WriteU16Payload(std::vector<uint8_t>& payload, size_t offset, uint16_t value) {
-  payload[offset + 0] = static_cast<uint8_t>(value & 0xFF);
-  payload[offset + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
-}
-
-bool EnsureListCapacity(HeapObject* obj, uint32_t min_capacity, size_t elem_size) {
+bool EnsureListCapacity(Heap& heap, HeapObject* obj, uint32_t min_capacity, size_t elem_size) {
   if (!obj) return false;
   uint32_t capacity = ReadU32Payload(obj->payload, 4);
   if (capacity >= min_capacity) return true;
@@ -1319,40 +1498,12 @@ bool EnsureListCapacity(HeapObject* obj, uint32_t min_capacity, size_t elem_size
     new_capacity = (new_capacity < (1u << 31)) ? (new_capacity * 2u) : min_capacity;
   }
   const size_t new_size = 8u + static_cast<size_t>(new_capacity) * elem_size;
-  obj->payload.resize(new_size);
+  if (new_size > std::numeric_limits<uint32_t>::max()) return false;
+  if (!heap.ResizePayload(obj, static_cast<uint32_t>(new_size))) return false;
   WriteU32Payload(obj->payload, 4, new_capacity);
   return true;
 }
 
-uint32_t CreateString(Heap& heap, const std::u16string& text) {
-  uint32_t length = static_cast<uint32_t>(text.size());
-  uint32_t size = 4 + length * 2;
-  uint32_t handle = heap.Allocate(ObjectKind::String, 0, size);
-  HeapObject* obj = heap.Get(handle);
-  if (!obj) return 0xFFFFFFFFu;
-  WriteU32Payload(obj->payload, 0, length);
-  size_t offset = 4;
-  for (uint32_t i = 0; i < length; ++i) {
-    WriteU16Payload(obj->payload, offset, text[i]);
-    offset += 2;
-  }
-  return handle;
-}
-
-std::u16string ReadString(const HeapObject* obj) {
-  if (!obj || obj->header.kind != ObjectKind::String) return {};
-  uint32_t length = ReadU32Payload(obj->payload, 0);
-  std::u16string out;
-  out.resize(length);
-  size_t offset = 4;
-  for (uint32_t i = 0; i < length; ++i) {
-    out[i] = static_cast<char16_t>(ReadU16Payload(obj->payload, offset));
-    offset += 2;
-  }
-  return out;
-}
-
-
 ExecResult Trap(const std::string& message) {
   ExecResult result;
   result.status = ExecStatus::Trapped;
@@ -1487,34 +1638,523 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit)
   return ExecuteModule(module, verify, enable_jit, ExecOptions{});
 }
 
-ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit, const ExecOptions& options) {
-  Simple::Byte::VerifyResult vr = Simple::Byte::VerifyModule(module);
-  if (verify && !vr.ok) return Trap(vr.error);
-  bool have_meta = vr.ok;
-  if (module.functions.empty()) return Trap("no functions to execute");
-  if (module.header.entry_method_id == 0xFFFFFFFFu) return Trap("no entry point");
+namespace {
+
+enum NativeState : uint8_t { kNativeUntried, kNativeCompiling, kNativeCompiled, kNativeUnsupported };
+
+// Native code calls its tier hook through a fixed address, so the hook points
+// at this relay and each run re-targets it at that run's counters.
+struct NativeCallRelay {
+  void (*fn)(void* ctx, uint32_t func_id) = nullptr;
+  void* ctx = nullptr;
+};
+
+// Built-in handler of an import, looked up from its module and symbol names.
+enum class ImportOp : uint8_t {
+  None,  // not built in; only a handler from ExecOptions::import_resolver can run it
+  OsArgsCount,
+  OsArgsGet,
+  OsEnvGet,
+  OsCwdGet,
+  OsTimeMonoNs,
+  OsTimeWallNs,
+  OsSleepMs,
+  FsOpen,
+  FsRead,
+  FsWrite,
+  FsClose,
+  FsMmap,
+  FsMunmap,
+  IoBufferNew,
+  IoBufferLen,
+  IoBufferFill,
+  IoBufferCopy,
+  LogLog,
+  DlOpen,
+  DlSym,
+  DlClose,
+  DlLastError,
+  DlCall,
+};
+
+// An ImportRow resolved once per module, so an import call indexes a table
+// and switches on op instead of reading and comparing names.
+struct ResolvedImport {
+  std::string module;
+  std::string symbol;
+  ImportOp op = ImportOp::None;
+  bool has_ret = false;
+  TypeKind ret_kind = TypeKind::Unspecified;
+  uint32_t ret_type_id = 0xFFFFFFFFu;
+  uint16_t param_count = 0;
+  // core.dl.call$*: type ids of the arguments after the function pointer.
+  std::vector<uint32_t> dl_arg_types;
+  // Why the import cannot be called, reported when it is.
+  std::string error;
+  // Set for DlCall when the signature does not describe a callable pointer.
+  std::string dl_error;
+};
+
+ImportOp LookupImportOp(const std::string& module, const std::string& symbol) {
+  struct Entry {
+    const char* module;
+    const char* symbol;
+    ImportOp op;
+  };
+  static const Entry kEntries[] = {
+      {"core.os", "args_count", ImportOp::OsArgsCount},
+      {"core.os", "args_get", ImportOp::OsArgsGet},
+      {"core.os", "env_get", ImportOp::OsEnvGet},
+      {"core.os", "cwd_get", ImportOp::OsCwdGet},
+      {"core.os", "time_mono_ns", ImportOp::OsTimeMonoNs},
+      {"core.os", "time_wall_ns", ImportOp::OsTimeWallNs},
+      {"core.os", "sleep_ms", ImportOp::OsSleepMs},
+      {"core.fs", "open", ImportOp::FsOpen},
+      {"core.fs", "read", ImportOp::FsRead},
+      {"core.fs", "write", ImportOp::FsWrite},
+      {"core.fs", "close", ImportOp::FsClose},
+      {"core.fs", "mmap", ImportOp::FsMmap},
+      {"core.fs", "munmap", ImportOp::FsMunmap},
+      {"core.io", "buffer_new", ImportOp::IoBufferNew},
+      {"core.io", "buffer_len", ImportOp::IoBufferLen},
+      {"core.io", "buffer_fill", ImportOp::IoBufferFill},
+      {"core.io", "buffer_copy", ImportOp::IoBufferCopy},
+      {"core.log", "log", ImportOp::LogLog},
+      {"core.dl", "open", ImportOp::DlOpen},
+      {"core.dl", "sym", ImportOp::DlSym},
+      {"core.dl", "close", ImportOp::DlClose},
+      {"core.dl", "last_error", ImportOp::DlLastError},
+  };
+  for (const Entry& entry : kEntries) {
+    if (module == entry.module && symbol == entry.symbol) return entry.op;
+  }
+  if (module == "core.dl" && symbol.rfind("call$", 0) == 0) return ImportOp::DlCall;
+  return ImportOp::None;
+}
+
+std::vector<ResolvedImport> ResolveImports(const SbcModule& module) {
+  std::vector<ResolvedImport> imports(module.imports.size());
+  size_t import_base = module.functions.size() - std::min(module.functions.size(), module.imports.size());
+  for (size_t i = 0; i < module.imports.size(); ++i) {
+    ResolvedImport& out = imports[i];
+    const Simple::Byte::ImportRow& row = module.imports[i];
+    out.module = ReadConstPoolString(module, row.module_name_str);
+    out.symbol = ReadConstPoolString(module, row.symbol_name_str);
+    if (out.module.empty() || out.symbol.empty()) {
+      out.error = "import name invalid";
+      continue;
+    }
+    size_t func_id = import_base + i;
+    if (func_id >= module.functions.size()) {
+      out.error = "import function id invalid";
+      continue;
+    }
+    const auto& func = module.functions[func_id];
+    if (func.method_id >= module.methods.size()) {
+      out.error = "import method id invalid";
+      continue;
+    }
+    const auto& method = module.methods[func.method_id];
+    if (method.sig_id >= module.sigs.size()) {
+      out.error = "import signature id invalid";
+      continue;
+    }
+    const auto& sig = module.sigs[method.sig_id];
+    out.has_ret = (sig.ret_type_id != 0xFFFFFFFFu);
+    if (out.has_ret) {
+      if (sig.ret_type_id >= module.types.size()) {
+        out.error = "import return type out of range";
+        continue;
+      }
+      out.ret_kind = static_cast<TypeKind>(module.types[sig.ret_type_id].kind);
+    }
+    out.ret_type_id = sig.ret_type_id;
+    out.param_count = sig.param_count;
+    out.op = LookupImportOp(out.module, out.symbol);
+    if (out.op != ImportOp::DlCall || sig.param_count == 0) continue;
+    if (static_cast<size_t>(sig.param_type_start) + sig.param_count > module.param_types.size()) {
+      out.dl_error = "core.dl.call parameter type out of range";
+      continue;
+    }
+    uint32_t ptr_type_id = module.param_types[sig.param_type_start];
+    if (ptr_type_id >= module.types.size()) {
+      out.dl_error = "core.dl.call pointer type out of range";
+      continue;
+    }
+    TypeKind ptr_kind = static_cast<TypeKind>(module.types[ptr_type_id].kind);
+    if (ptr_kind != TypeKind::I64 && ptr_kind != TypeKind::U64) {
+      out.dl_error = "core.dl.call first parameter must be i64/u64";
+      continue;
+    }
+    out.dl_arg_types.reserve(static_cast<size_t>(sig.param_count - 1));
+    for (uint16_t p = 1; p < sig.param_count; ++p) {
+      uint32_t type_id = module.param_types[sig.param_type_start + p];
+      if (type_id >= module.types.size()) {
+        out.dl_error = "core.dl.call parameter type out of range";
+        break;
+      }
+      out.dl_arg_types.push_back(type_id);
+    }
+  }
+  return imports;
+}
 
+// Read-only form of a module's code, built once and shared by every isolate
+// running the module: the decoded stream with each CALL_INDIRECT site given
+// its inline cache slot up front, plus the method -> function map when the
+// loader did not build one, the artifact ref maps the GC traces with, and
+// the resolved import table.
+struct PreparedCode {
+  DecodedCode decoded;
+  uint32_t call_indirect_sites = 0;
+  std::vector<uint32_t> built_function_by_method;
+  std::shared_ptr<const TypeRefMaps> type_refs;
+  std::vector<ResolvedImport> imports;
+};
+
+// Same ref test the verifier applies to field and global types.
+bool IsRefTypeRow(const Simple::Byte::TypeRow& row) {
+  switch (static_cast<TypeKind>(row.kind)) {
+    case TypeKind::Ref:
+    case TypeKind::String:
+    case TypeKind::I128:
+    case TypeKind::U128:
+      return true;
+    case TypeKind::Unspecified:
+      return (row.flags & 0x1u) != 0u;
+    default:
+      return false;
+  }
+}
+
+std::shared_ptr<const TypeRefMaps> BuildTypeRefMaps(const SbcModule& module) {
+  auto maps = std::make_shared<TypeRefMaps>();
+  maps->field_offsets.resize(module.types.size());
+  maps->ref_types.resize(module.types.size());
+  for (size_t type_id = 0; type_id < module.types.size(); ++type_id) {
+    const auto& row = module.types[type_id];
+    maps->ref_types[type_id] = IsRefTypeRow(row) ? 1 : 0;
+    if (row.field_start + row.field_count > module.fields.size()) continue;
+    for (uint32_t i = 0; i < row.field_count; ++i) {
+      const auto& field = module.fields[row.field_start + i];
+      if (field.type_id < module.types.size() && IsRefTypeRow(module.types[field.type_id])) {
+        maps->field_offsets[type_id].push_back(field.offset);
+      }
+    }
+  }
+  return maps;
+}
+
+std::shared_ptr<const PreparedCode> PrepareCode(const SbcModule& module, bool fuse) {
+  auto code = std::make_shared<PreparedCode>();
+  code->decoded = DecodeModuleCode(module);
+  if (fuse) FuseSuperinstructions(&code->decoded);
+  for (auto& inst : code->decoded.insts) {
+    if (inst.opcode == static_cast<uint8_t>(OpCode::CallIndirect)) inst.b = code->call_indirect_sites++;
+  }
+  if (module.function_by_method.size() != module.methods.size()) {
+    code->built_function_by_method = Simple::Byte::BuildFunctionByMethod(module);
+  }
+  code->type_refs = BuildTypeRefMaps(module);
+  code->imports = ResolveImports(module);
+  return code;
+}
+
+// print_any output. Pieces are rendered straight into the buffer, which goes
+// to stdout in one write when it fills, at a newline when stdout is a
+// terminal, before imports or DL calls that may write output themselves, and
+// when execution returns.
+class StdoutBuffer {
+ public:
+  static constexpr size_t kCapacity = 64 * 1024;
+
+  std::string& bytes() { return bytes_; }
+  // Call after appending to bytes().
+  void Appended() {
+    if (bytes_.size() >= kCapacity) {
+      Flush();
+    } else if (line_flush_ && bytes_.find('\n', checked_) != std::string::npos) {
+      Flush();
+    } else {
+      checked_ = bytes_.size();
+    }
+  }
+  void Flush() {
+    checked_ = 0;
+    if (bytes_.empty()) return;
+    std::fwrite(bytes_.data(), 1, bytes_.size(), stdout);
+    std::fflush(stdout);
+    bytes_.clear();
+  }
+
+ private:
+  static bool StdoutIsTerminal() {
+#if defined(_WIN32)
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return isatty(fileno(stdout)) != 0;
+#endif
+  }
+
+  std::string bytes_;
+  size_t checked_ = 0;
+  bool line_flush_ = StdoutIsTerminal();
+};
+
+// Renders one print_any / PRINT_FMT argument into out. Returns a trap
+// message, or nullptr on success.
+const char* AppendPrintValue(const Heap& heap, Slot value, uint32_t tag, std::string* out) {
+  auto append_int = [out](auto number) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), number).ptr;
+    out->append(digits, end);
+  };
+  switch (tag) {
+    case kPrintAnyTagString: {
+      const HeapObject* obj = heap.Get(UnpackRef(value));
+      if (!obj || obj->header.kind != ObjectKind::String) return "print_any: unsupported ref kind";
+      AppendAsciiString(heap, obj, out);
+      return nullptr;
+    }
+    case kPrintAnyTagI8:
+      append_int(static_cast<int32_t>(static_cast<int8_t>(UnpackI32(value))));
+      return nullptr;
+    case kPrintAnyTagI16:
+      append_int(static_cast<int32_t>(static_cast<int16_t>(UnpackI32(value))));
+      return nullptr;
+    case kPrintAnyTagI32:
+      append_int(static_cast<int32_t>(UnpackI32(value)));
+      return nullptr;
+    case kPrintAnyTagI64:
+      append_int(static_cast<int64_t>(UnpackI64(value)));
+      return nullptr;
+    case kPrintAnyTagU8:
+      append_int(static_cast<uint32_t>(static_cast<uint8_t>(UnpackI32(value))));
+      return nullptr;
+    case kPrintAnyTagU16:
+      append_int(static_cast<uint32_t>(static_cast<uint16_t>(UnpackI32(value))));
+      return nullptr;
+    case kPrintAnyTagU32:
+      append_int(static_cast<uint32_t>(UnpackI32(value)));
+      return nullptr;
+    case kPrintAnyTagU64:
+      append_int(static_cast<uint64_t>(UnpackI64(value)));
+      return nullptr;
+    case kPrintAnyTagF32:
+      *out += std::to_string(BitsToF32(UnpackU32Bits(value)));
+      return nullptr;
+    case kPrintAnyTagF64:
+      *out += std::to_string(BitsToF64(UnpackU64Bits(value)));
+      return nullptr;
+    case kPrintAnyTagBool:
+      *out += (UnpackI32(value) != 0) ? "true" : "false";
+      return nullptr;
+    case kPrintAnyTagChar: {
+      uint32_t ch = static_cast<uint32_t>(UnpackI32(value)) & 0xFFu;
+      out->push_back((ch <= 0x7Fu) ? static_cast<char>(ch) : '?');
+      return nullptr;
+    }
+    default:
+      return "print_any: unsupported tag";
+  }
+}
+
+// A core.fs.mmap mapping and the byte array viewing it. The array can be
+// collected first, after which its handle may be reused, so lookups also
+// compare the payload pointer.
+struct MappedFile {
+  uint32_t handle = 0;
+  FileMapping mapping;
+};
+
+// Everything a run builds that can outlive it. ExecuteModule uses a fresh
+// ModuleState per call; Vm keeps one per loaded module so decoded code, inline
+// caches, JIT tiers, native code, the heap and globals stay warm.
+struct ModuleState {
+  bool prepared = false;
+  bool globals_ready = false;
+  std::shared_ptr<const PreparedCode> code;
+  // Private copy of code->decoded for the checked loop, which may decode new
+  // runs when unverified code jumps between instruction boundaries.
+  DecodedCode own_decoded;
+  std::vector<CallIndirectCache> call_indirect_caches;
   Heap heap;
+  // Interned CONST_STRING handles by const id; pinned in heap.
+  std::unordered_map<uint32_t, uint32_t> const_strings;
   ScratchArena scratch_arena;
-  scratch_arena.SetRequireScope(true);
-  std::vector<Slot> globals(module.globals.size());
+  std::vector<Slot> globals;
   std::vector<Slot> locals_arena;
-  std::vector<Slot> jit_stack;
-  std::vector<Slot> jit_locals;
-  std::vector<uint32_t> call_counts(module.functions.size(), 0);
-  std::vector<JitTier> jit_tiers(module.functions.size(), JitTier::None);
-  std::vector<JitStub> jit_stubs(module.functions.size());
-  std::vector<uint64_t> opcode_counts(256, 0);
-  std::vector<uint32_t> compile_counts(module.functions.size(), 0);
-  std::vector<uint32_t> func_opcode_counts(module.functions.size(), 0);
-  std::vector<uint64_t> compile_ticks_tier0(module.functions.size(), 0);
-  std::vector<uint64_t> compile_ticks_tier1(module.functions.size(), 0);
-  std::vector<uint32_t> jit_dispatch_counts(module.functions.size(), 0);
-  std::vector<uint32_t> jit_compiled_exec_counts(module.functions.size(), 0);
-  std::vector<uint32_t> jit_tier1_exec_counts(module.functions.size(), 0);
+  std::vector<Frame> call_stack;
+  std::vector<Slot> call_args;
+  std::vector<uint32_t> call_counts;
+  std::vector<JitTier> jit_tiers;
+  std::vector<JitStub> jit_stubs;
+  std::vector<uint64_t> opcode_counts;
+  std::vector<uint32_t> compile_counts;
+  std::vector<uint32_t> func_opcode_counts;
+  std::vector<uint64_t> compile_ticks_tier0;
+  std::vector<uint64_t> compile_ticks_tier1;
+  std::vector<uint32_t> jit_dispatch_counts;
+  std::vector<uint32_t> jit_compiled_exec_counts;
+  std::vector<uint32_t> jit_tier1_exec_counts;
+  std::vector<uint32_t> jit_native_exec_counts;
   std::vector<std::FILE*> open_files;
+  std::vector<MappedFile> mapped_files;
+  StdoutBuffer stdout_buffer;
   std::string dl_last_error;
+  DlCallCache dl_call_cache;
   uint64_t compile_tick = 0;
+  std::vector<uint8_t> compile_stack;
+  JitCodeArena native_arena;
+  std::vector<NativeFunction> native_funcs;
+  std::vector<uint8_t> native_state;
+  std::unique_ptr<Slot[]> native_frame;
+  NativeCallRelay native_relay;
+  // Calls native code made during the current native entry, per function id,
+  // and the ids with a nonzero count; applied only if the entry does not bail.
+  std::vector<uint32_t> native_pending_calls;
+  std::vector<uint32_t> native_pending_ids;
+  // ExecOptions::import_resolver bindings by import index, made on first call.
+  std::vector<ImportHandler> import_handlers;
+  std::vector<uint8_t> import_bound;
+
+  // shared_code, when given, is another isolate's PrepareCode result for the
+  // same module.
+  void Prepare(const SbcModule& module, bool fuse, std::shared_ptr<const PreparedCode> shared_code = nullptr) {
+    if (prepared) return;
+    code = shared_code ? std::move(shared_code) : PrepareCode(module, fuse);
+    call_indirect_caches.assign(code->call_indirect_sites, CallIndirectCache{});
+    heap.SetTypeRefMaps(code->type_refs);
+    scratch_arena.SetRequireScope(true);
+    size_t count = module.functions.size();
+    globals.assign(module.globals.size(), 0);
+    call_stack.reserve(kInitialFrameCapacity);
+    locals_arena.resize(kInitialLocalsCapacity);
+    call_counts.assign(count, 0);
+    jit_tiers.assign(count, JitTier::None);
+    jit_stubs.assign(count, JitStub{});
+    opcode_counts.assign(256, 0);
+    compile_counts.assign(count, 0);
+    func_opcode_counts.assign(count, 0);
+    compile_ticks_tier0.assign(count, 0);
+    compile_ticks_tier1.assign(count, 0);
+    jit_dispatch_counts.assign(count, 0);
+    jit_compiled_exec_counts.assign(count, 0);
+    jit_tier1_exec_counts.assign(count, 0);
+    jit_native_exec_counts.assign(count, 0);
+    compile_stack.assign(count, 0);
+    native_funcs.assign(count, NativeFunction{});
+    native_state.assign(count, kNativeUntried);
+    native_pending_calls.assign(count, 0);
+    import_handlers.assign(module.imports.size(), ImportHandler{});
+    import_bound.assign(module.imports.size(), 0);
+    prepared = true;
+  }
+
+  // Unmaps the files whose array the GC has freed; called after every
+  // collection step, so a dropped mapping does not outlive its array.
+  void ReleaseDeadMappings() {
+    if (mapped_files.empty()) return;
+    mapped_files.erase(std::remove_if(mapped_files.begin(), mapped_files.end(),
+                                      [&](const MappedFile& entry) {
+                                        const HeapObject* obj = heap.Get(entry.handle);
+                                        return !obj || obj->payload.data() != entry.mapping.Payload();
+                                      }),
+                       mapped_files.end());
+  }
+
+  // Drops heap objects and global values, closes files and unmaps mappings,
+  // and forgets dl.call plans, whose struct layouts marshal heap objects;
+  // code and JIT state stay.
+  void ResetData(const SbcModule& module) {
+    for (std::FILE* f : open_files) {
+      if (f) std::fclose(f);
+    }
+    open_files.clear();
+    heap = Heap();
+    // After the heap, so no array outlives the mapping it views.
+    mapped_files.clear();
+    dl_call_cache = DlCallCache();
+    dl_last_error.clear();
+    const_strings.clear();
+    if (code) heap.SetTypeRefMaps(code->type_refs);
+    globals.assign(module.globals.size(), 0);
+    globals_ready = false;
+  }
+};
+
+// Function to run and its arguments; kNoFunctionIndex runs the module entry.
+struct EntryCall {
+  size_t func_index = Simple::Byte::kNoFunctionIndex;
+  const std::vector<Slot>* args = nullptr;
+};
+
+#if SIMPLEVM_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+// kChecked selects the interpreter flavour. The checked loop guards every
+// stack access and operand index itself and is used for unverified modules.
+// The unchecked loop runs modules that passed VerifyModule on a VerifiedStack
+// and skips the checks the verifier has already proven (stack height, local,
+// global, field and function indices, jump bounds). Null, heap-kind and
+// element-bounds checks stay in both since the verifier only types refs.
+// verified is null for unverified runs; the GC and the JIT then verify the
+// module lazily, the first time they need stack maps.
+template <bool kChecked>
+ExecResult ExecuteModuleImpl(const SbcModule& module, const Simple::Byte::VerifyResult* verified, bool enable_jit,
+                             const ExecOptions& options, ModuleState& state, const EntryCall& entry) {
+  // Returns the verifier metadata (stack maps, ref bits) or null when the
+  // module does not verify.
+  auto meta = [&]() -> const Simple::Byte::VerifyResult* {
+    if (!verified) verified = &Simple::Byte::VerifyModuleCached(module);
+    return verified->ok ? verified : nullptr;
+  };
+  if (module.functions.empty()) return Trap("no functions to execute");
+  if (entry.func_index == Simple::Byte::kNoFunctionIndex && module.header.entry_method_id == 0xFFFFFFFFu) {
+    return Trap("no entry point");
+  }
+  const bool profile_sequences = options.profile_opcode_sequences;
+  state.Prepare(module, !profile_sequences);
+  if (kChecked && state.own_decoded.insts.empty()) state.own_decoded = state.code->decoded;
+  const DecodedCode& decoded = kChecked ? state.own_decoded : state.code->decoded;
+  std::vector<CallIndirectCache>& call_indirect_caches = state.call_indirect_caches;
+  const std::vector<uint32_t>* function_by_method = &module.function_by_method;
+  if (function_by_method->size() != module.methods.size()) {
+    function_by_method = &state.code->built_function_by_method;
+  }
+
+  Heap& heap = state.heap;
+  StdoutBuffer& stdout_buffer = state.stdout_buffer;
+  struct FlushOnReturn {
+    StdoutBuffer& buffer;
+    ~FlushOnReturn() { buffer.Flush(); }
+  } flush_on_return{stdout_buffer};
+  ScratchArena& scratch_arena = state.scratch_arena;
+  std::vector<Slot>& globals = state.globals;
+  std::vector<Slot>& locals_arena = state.locals_arena;
+  std::vector<uint32_t>& call_counts = state.call_counts;
+  std::vector<JitTier>& jit_tiers = state.jit_tiers;
+  std::vector<JitStub>& jit_stubs = state.jit_stubs;
+  std::vector<uint64_t>& opcode_counts = state.opcode_counts;
+  std::vector<uint64_t> opcode_pair_counts(profile_sequences ? 256 * 256 : 0, 0);
+  std::unordered_map<uint32_t, uint64_t> opcode_triple_counts;
+  uint32_t seq_history = 0;  // last two opcodes, most recent in the low byte
+  size_t seq_len = 0;
+  size_t seq_next_pc = 0;
+  std::vector<uint32_t>& compile_counts = state.compile_counts;
+  std::vector<uint32_t>& func_opcode_counts = state.func_opcode_counts;
+  std::vector<uint64_t>& compile_ticks_tier0 = state.compile_ticks_tier0;
+  std::vector<uint64_t>& compile_ticks_tier1 = state.compile_ticks_tier1;
+  std::vector<uint32_t>& jit_dispatch_counts = state.jit_dispatch_counts;
+  std::vector<uint32_t>& jit_compiled_exec_counts = state.jit_compiled_exec_counts;
+  std::vector<uint32_t>& jit_tier1_exec_counts = state.jit_tier1_exec_counts;
+  std::vector<uint32_t>& jit_native_exec_counts = state.jit_native_exec_counts;
+  std::vector<std::FILE*>& open_files = state.open_files;
+  std::vector<MappedFile>& mapped_files = state.mapped_files;
+  std::string& dl_last_error = state.dl_last_error;
+  DlCallCache& dl_call_cache = state.dl_call_cache;
+  uint64_t& compile_tick = state.compile_tick;
   auto read_threshold = [&](const char* name, uint32_t fallback) -> uint32_t {
     std::string owned_value;
     const char* raw = GetEnvVar(name, &owned_value);
@@ -1533,6 +2173,41 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
   uint32_t jit_opcode_threshold = read_threshold("SIMPLE_JIT_OPCODE", kJitOpcodeThreshold);
   if (jit_tier0_threshold == 0) jit_tier0_threshold = kJitTier0Threshold;
   if (jit_tier1_threshold < jit_tier0_threshold) jit_tier1_threshold = jit_tier0_threshold;
+  std::string native_env_storage;
+  const char* native_env = GetEnvVar("SIMPLE_JIT_NATIVE", &native_env_storage);
+  const bool jit_native =
+      enable_jit && SIMPLEVM_NATIVE_JIT && !(native_env && std::strcmp(native_env, "0") == 0);
+  uint32_t jit_native_threshold = read_threshold("SIMPLE_JIT_NATIVE_THRESHOLD", kJitNativeThreshold);
+  auto read_size = [&](const char* name, size_t fallback) -> size_t {
+    std::string owned_value;
+    const char* raw = GetEnvVar(name, &owned_value);
+    if (!raw || raw[0] == '\0') return fallback;
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(raw, &end, 10);
+    if (end == raw || parsed == 0) return fallback;
+    if (parsed > std::numeric_limits<size_t>::max()) parsed = std::numeric_limits<size_t>::max();
+    return static_cast<size_t>(parsed);
+  };
+  {
+    GcPolicy gc_policy;
+    gc_policy.nursery_bytes = options.gc_nursery_bytes
+                                  ? options.gc_nursery_bytes
+                                  : read_size("SIMPLE_GC_NURSERY", gc_policy.nursery_bytes);
+    gc_policy.growth_percent = options.gc_growth_percent
+                                   ? options.gc_growth_percent
+                                   : read_threshold("SIMPLE_GC_GROWTH", gc_policy.growth_percent);
+    gc_policy.min_old_bytes = options.gc_min_heap_bytes
+                                  ? options.gc_min_heap_bytes
+                                  : read_size("SIMPLE_GC_MIN_HEAP", gc_policy.min_old_bytes);
+    gc_policy.max_heap_bytes = options.gc_max_heap_bytes
+                                   ? options.gc_max_heap_bytes
+                                   : read_size("SIMPLE_GC_MAX_HEAP", gc_policy.max_heap_bytes);
+    gc_policy.incremental = options.gc_incremental || read_threshold("SIMPLE_GC_INCREMENTAL", 0) != 0;
+    gc_policy.slice_work = options.gc_slice_work ? options.gc_slice_work
+                                                 : read_threshold("SIMPLE_GC_SLICE", gc_policy.slice_work);
+    if (gc_policy.growth_percent < 100) gc_policy.growth_percent = 100;
+    heap.SetPolicy(gc_policy);
+  }
   auto handle_import_call = [&](uint32_t func_id, const std::vector<Slot>& args, Slot& out_ret,
                                 bool& out_has_ret, std::string& out_error) -> bool {
     if (module.imports.empty()) {
@@ -1549,53 +2224,42 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
       out_error = "import index out of range";
       return false;
     }
-    const Simple::Byte::ImportRow& row = module.imports[import_index];
-    std::string mod = ReadConstPoolString(module, row.module_name_str);
-    std::string sym = ReadConstPoolString(module, row.symbol_name_str);
-    if (mod.empty() || sym.empty()) {
-      out_error = "import name invalid";
-      return false;
-    }
-    if (func_id >= module.functions.size()) {
-      out_error = "import function id invalid";
+    const ResolvedImport& import = state.code->imports[import_index];
+    if (!import.error.empty()) {
+      out_error = import.error;
       return false;
     }
-    const auto& func = module.functions[func_id];
-    if (func.method_id >= module.methods.size()) {
-      out_error = "import method id invalid";
-      return false;
-    }
-    const auto& method = module.methods[func.method_id];
-    if (method.sig_id >= module.sigs.size()) {
-      out_error = "import signature id invalid";
-      return false;
-    }
-    const auto& sig = module.sigs[method.sig_id];
-    out_has_ret = (sig.ret_type_id != 0xFFFFFFFFu);
-    TypeKind ret_kind = TypeKind::Unspecified;
-    if (out_has_ret) {
-      if (sig.ret_type_id >= module.types.size()) {
-        out_error = "import return type out of range";
-        return false;
-      }
-      ret_kind = static_cast<TypeKind>(module.types[sig.ret_type_id].kind);
+    out_has_ret = import.has_ret;
+    const TypeKind ret_kind = import.ret_kind;
+    // core.io only touches VM buffers; other imports and resolvers may write
+    // output of their own.
+    switch (import.op) {
+      case ImportOp::IoBufferNew:
+      case ImportOp::IoBufferLen:
+      case ImportOp::IoBufferFill:
+      case ImportOp::IoBufferCopy:
+        break;
+      default:
+        stdout_buffer.Flush();
+        break;
     }
-    if (options.import_resolver) {
-      Slot custom_ret = out_ret;
-      bool custom_has_ret = out_has_ret;
-      std::string custom_error;
-      if (options.import_resolver(mod, sym, args, custom_ret, custom_has_ret, custom_error)) {
-        out_ret = custom_ret;
-        out_has_ret = custom_has_ret;
-        return true;
-      }
-      if (!custom_error.empty()) {
-        out_error = custom_error;
+    if (import.op == ImportOp::None && options.import_resolver) {
+      if (!state.import_bound[import_index]) {
+        state.import_handlers[import_index] = options.import_resolver(import.module, import.symbol);
+        state.import_bound[import_index] = 1;
+      }
+      const ImportHandler& handler = state.import_handlers[import_index];
+      if (handler) {
+        if (handler(args, out_ret, out_has_ret, out_error)) return true;
+        if (out_error.empty()) out_error = "import failed: " + import.module + "." + import.symbol;
         return false;
       }
     }
-    if (mod == "core.os") {
-      if (sym == "args_count") {
+    auto set_dl_error = [&](const std::string& text) {
+      dl_last_error = text;
+    };
+    switch (import.op) {
+      case ImportOp::OsArgsCount: {
         if (IsI32LikeImportType(ret_kind)) {
           out_ret = PackI32(static_cast<int32_t>(options.argv.size()));
           return true;
@@ -1603,12 +2267,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         out_error = "core.os.args_count return type mismatch";
         return false;
       }
-      if (sym == "args_get" || sym == "env_get") {
+      case ImportOp::OsArgsGet:
+      case ImportOp::OsEnvGet: {
         if (!IsStringLikeImportType(ret_kind)) {
           out_error = "core.os ref return type mismatch";
           return false;
         }
-        if (sym == "args_get") {
+        if (import.op == ImportOp::OsArgsGet) {
           if (args.size() != 1) {
             out_error = "core.os.args_get arg count mismatch";
             return false;
@@ -1618,11 +2283,11 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             out_ret = PackRef(kNullRef);
             return true;
           }
-          uint32_t handle = CreateString(heap, AsciiToU16(options.argv[static_cast<size_t>(index)]));
+          uint32_t handle = CreateLatin1String(heap, options.argv[static_cast<size_t>(index)]);
           out_ret = PackRef(handle);
           return true;
         }
-        if (sym == "env_get") {
+        if (import.op == ImportOp::OsEnvGet) {
           if (args.size() != 1) {
             out_error = "core.os.env_get arg count mismatch";
             return false;
@@ -1633,8 +2298,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             return true;
           }
           HeapObject* name_obj = heap.Get(name_ref);
-          std::u16string name_u16 = ReadString(name_obj);
-          std::string name = U16ToAscii(name_u16);
+          std::string name = ReadAsciiString(heap, name_obj);
           if (name.empty()) {
             out_ret = PackRef(kNullRef);
             return true;
@@ -1645,21 +2309,21 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             out_ret = PackRef(kNullRef);
             return true;
           }
-          uint32_t handle = CreateString(heap, AsciiToU16(value));
+          uint32_t handle = CreateLatin1String(heap, value);
           out_ret = PackRef(handle);
           return true;
         }
         out_ret = PackRef(kNullRef);
         return true;
       }
-      if (sym == "cwd_get") {
+      case ImportOp::OsCwdGet: {
         if (!IsStringLikeImportType(ret_kind)) {
           out_error = "core.os.cwd_get return type mismatch";
           return false;
         }
         try {
           std::string cwd = std::filesystem::current_path().u8string();
-          uint32_t handle = CreateString(heap, AsciiToU16(cwd));
+          uint32_t handle = CreateLatin1String(heap, cwd);
           out_ret = PackRef(handle);
           return true;
         } catch (...) {
@@ -1667,12 +2331,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           return true;
         }
       }
-      if (sym == "time_mono_ns" || sym == "time_wall_ns") {
+      case ImportOp::OsTimeMonoNs:
+      case ImportOp::OsTimeWallNs: {
         if (!IsI64LikeImportType(ret_kind)) {
           out_error = "core.os time return type mismatch";
           return false;
         }
-        if (sym == "time_mono_ns") {
+        if (import.op == ImportOp::OsTimeMonoNs) {
           auto now = std::chrono::steady_clock::now().time_since_epoch();
           auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
           out_ret = PackI64(static_cast<int64_t>(ns));
@@ -1683,7 +2348,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         out_ret = PackI64(static_cast<int64_t>(ns));
         return true;
       }
-      if (sym == "sleep_ms") {
+      case ImportOp::OsSleepMs: {
         out_has_ret = false;
         if (args.size() != 1) {
           out_error = "core.os.sleep_ms arg count mismatch";
@@ -1695,9 +2360,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         }
         return true;
       }
-    }
-    if (mod == "core.fs") {
-      if (sym == "open") {
+      case ImportOp::FsOpen: {
         if (!IsI32LikeImportType(ret_kind)) {
           out_error = "core.fs return type mismatch";
           return false;
@@ -1717,7 +2380,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           out_ret = PackI32(-1);
           return true;
         }
-        std::string path = U16ToAscii(ReadString(path_obj));
+        std::string path = ReadAsciiString(heap, path_obj);
         const char* mode = "rb";
         if (flags & 0x2) {
           mode = (flags & 0x1) ? "ab" : "ab";
@@ -1735,7 +2398,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         out_ret = PackI32(static_cast<int32_t>(open_files.size() - 1));
         return true;
       }
-      if (sym == "read" || sym == "write") {
+      case ImportOp::FsRead:
+      case ImportOp::FsWrite: {
         if (!IsI32LikeImportType(ret_kind)) {
           out_error = "core.fs return type mismatch";
           return false;
@@ -1765,6 +2429,21 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         uint32_t max_len = length;
         uint32_t req = static_cast<uint32_t>(len);
         if (req > max_len) req = max_len;
+        if (import.op == ImportOp::FsRead && buf_obj->header.read_only) {
+          out_ret = PackI32(-1);
+          return true;
+        }
+        if (buf_obj->header.byte_elements) {
+          // Byte arrays hold the file bytes as is: no staging copy.
+          uint8_t* bytes = buf_obj->payload.data() + 4;
+          size_t done = 0;
+          if (req > 0) {
+            done = import.op == ImportOp::FsRead ? std::fread(bytes, 1, req, f)
+                                                 : std::fwrite(bytes, 1, req, f);
+          }
+          out_ret = PackI32(static_cast<int32_t>(done));
+          return true;
+        }
         ScratchScope scratch_scope(scratch_arena);
         uint8_t* tmp = nullptr;
         if (req > 0) {
@@ -1773,11 +2452,11 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             out_ret = PackI32(-1);
             return true;
           }
-          if (sym == "read") {
+          if (import.op == ImportOp::FsRead) {
             std::memset(tmp, 0, req);
           }
         }
-        if (sym == "read") {
+        if (import.op == ImportOp::FsRead) {
           size_t got = (req > 0) ? std::fread(tmp, 1, req, f) : 0;
           for (size_t i = 0; i < got; ++i) {
             WriteU32Payload(buf_obj->payload, 4 + i * 4, tmp[i]);
@@ -1792,7 +2471,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         out_ret = PackI32(static_cast<int32_t>(wrote));
         return true;
       }
-      if (sym == "close") {
+      case ImportOp::FsClose: {
         out_has_ret = false;
         if (args.size() != 1) {
           out_error = "core.fs.close arg count mismatch";
@@ -1809,9 +2488,67 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         }
         return true;
       }
-    }
-    if (mod == "core.io") {
-      if (sym == "buffer_new") {
+      case ImportOp::FsMmap: {
+        if (ret_kind != TypeKind::Ref) {
+          out_error = "core.fs.mmap return type mismatch";
+          return false;
+        }
+        if (args.size() != 2) {
+          out_error = "core.fs.mmap arg count mismatch";
+          return false;
+        }
+        uint32_t path_ref = UnpackRef(args[0]);
+        int32_t flags = UnpackI32(args[1]);
+        HeapObject* path_obj = path_ref == kNullRef ? nullptr : heap.Get(path_ref);
+        if (!path_obj || path_obj->header.kind != ObjectKind::String) {
+          out_ret = PackRef(kNullRef);
+          return true;
+        }
+        const bool copy_on_write = (flags & 0x1) != 0;
+        FileMapping mapping;
+        if (!mapping.Map(ReadAsciiString(heap, path_obj), copy_on_write)) {
+          out_ret = PackRef(kNullRef);
+          return true;
+        }
+        uint32_t handle =
+            heap.AllocateExternal(ObjectKind::Array, 0, mapping.Payload(), mapping.PayloadSize());
+        HeapObject* obj = heap.Get(handle);
+        if (!obj) {
+          out_ret = PackRef(kNullRef);
+          return true;
+        }
+        obj->header.byte_elements = 1;
+        obj->header.read_only = copy_on_write ? 0 : 1;
+        mapped_files.push_back({handle, std::move(mapping)});
+        out_ret = PackRef(handle);
+        return true;
+      }
+      case ImportOp::FsMunmap: {
+        if (!IsI32LikeImportType(ret_kind)) {
+          out_error = "core.fs.munmap return type mismatch";
+          return false;
+        }
+        if (args.size() != 1) {
+          out_error = "core.fs.munmap arg count mismatch";
+          return false;
+        }
+        uint32_t buf_ref = UnpackRef(args[0]);
+        HeapObject* buf_obj = buf_ref == kNullRef ? nullptr : heap.Get(buf_ref);
+        auto it = std::find_if(mapped_files.begin(), mapped_files.end(), [&](const MappedFile& entry) {
+          return entry.handle == buf_ref && buf_obj && buf_obj->payload.data() == entry.mapping.Payload();
+        });
+        if (it == mapped_files.end()) {
+          out_ret = PackI32(-1);
+          return true;
+        }
+        // The array stays usable as an empty one.
+        heap.ReleaseExternal(buf_obj, 4);
+        buf_obj->header.read_only = 0;
+        mapped_files.erase(it);
+        out_ret = PackI32(0);
+        return true;
+      }
+      case ImportOp::IoBufferNew: {
         if (ret_kind != TypeKind::Ref) {
           out_error = "core.io.buffer_new return type mismatch";
           return false;
@@ -1838,7 +2575,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         out_ret = PackRef(handle);
         return true;
       }
-      if (sym == "buffer_len") {
+      case ImportOp::IoBufferLen: {
         if (!IsI32LikeImportType(ret_kind)) {
           out_error = "core.io.buffer_len return type mismatch";
           return false;
@@ -1862,7 +2599,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         out_ret = PackI32(static_cast<int32_t>(length));
         return true;
       }
-      if (sym == "buffer_fill") {
+      case ImportOp::IoBufferFill: {
         if (!IsI32LikeImportType(ret_kind)) {
           out_error = "core.io.buffer_fill return type mismatch";
           return false;
@@ -1884,17 +2621,26 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           out_ret = PackI32(-1);
           return true;
         }
+        if (buf_obj->header.read_only) {
+          out_ret = PackI32(-1);
+          return true;
+        }
         uint32_t length = ReadU32Payload(buf_obj->payload, 0);
         const size_t elem_base = (buf_obj->header.kind == ObjectKind::List) ? 8u : 4u;
         uint32_t n = static_cast<uint32_t>(count);
         if (n > length) n = length;
+        if (buf_obj->header.byte_elements) {
+          std::memset(buf_obj->payload.data() + elem_base, static_cast<uint8_t>(value), n);
+          out_ret = PackI32(static_cast<int32_t>(n));
+          return true;
+        }
         for (uint32_t i = 0; i < n; ++i) {
           WriteU32Payload(buf_obj->payload, elem_base + i * 4, static_cast<uint32_t>(value));
         }
         out_ret = PackI32(static_cast<int32_t>(n));
         return true;
       }
-      if (sym == "buffer_copy") {
+      case ImportOp::IoBufferCopy: {
         if (!IsI32LikeImportType(ret_kind)) {
           out_error = "core.io.buffer_copy return type mismatch";
           return false;
@@ -1919,6 +2665,10 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           out_ret = PackI32(-1);
           return true;
         }
+        if (dst_obj->header.read_only) {
+          out_ret = PackI32(-1);
+          return true;
+        }
         uint32_t dst_len = ReadU32Payload(dst_obj->payload, 0);
         uint32_t src_len = ReadU32Payload(src_obj->payload, 0);
         const size_t dst_base = (dst_obj->header.kind == ObjectKind::List) ? 8u : 4u;
@@ -1926,25 +2676,32 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         uint32_t n = static_cast<uint32_t>(count);
         if (n > dst_len) n = dst_len;
         if (n > src_len) n = src_len;
+        const bool dst_bytes = dst_obj->header.byte_elements != 0;
+        const bool src_bytes = src_obj->header.byte_elements != 0;
+        if (dst_bytes && src_bytes) {
+          std::memmove(dst_obj->payload.data() + dst_base, src_obj->payload.data() + src_base, n);
+          out_ret = PackI32(static_cast<int32_t>(n));
+          return true;
+        }
+        heap.RecordOverwrite(dst_ref);
         for (uint32_t i = 0; i < n; ++i) {
-          uint32_t v = ReadU32Payload(src_obj->payload, src_base + i * 4);
+          uint32_t v = src_bytes ? src_obj->payload[src_base + i]
+                                 : ReadU32Payload(src_obj->payload, src_base + i * 4);
+          if (dst_bytes) {
+            dst_obj->payload[dst_base + i] = static_cast<uint8_t>(v);
+            continue;
+          }
           WriteU32Payload(dst_obj->payload, dst_base + i * 4, v);
+          heap.RecordWrite(dst_ref, v);
         }
         out_ret = PackI32(static_cast<int32_t>(n));
         return true;
       }
-    }
-    if (mod == "core.log") {
-      if (sym == "log") {
+      case ImportOp::LogLog: {
         out_has_ret = false;
         return true;
       }
-    }
-    if (mod == "core.dl") {
-      auto set_dl_error = [&](const std::string& text) {
-        dl_last_error = text;
-      };
-      if (sym == "open") {
+      case ImportOp::DlOpen: {
         if (!IsI64LikeImportType(ret_kind)) {
           out_error = "core.dl.open return type mismatch";
           return false;
@@ -1965,7 +2722,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           out_ret = PackI64(0);
           return true;
         }
-        std::string path = U16ToAscii(ReadString(path_obj));
+        std::string path = ReadAsciiString(heap, path_obj);
 #if defined(_WIN32)
         (void)path;
         set_dl_error("core.dl.open is unsupported on windows");
@@ -1985,7 +2742,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         return true;
 #endif
       }
-      if (sym == "sym") {
+      case ImportOp::DlSym: {
         if (!IsI64LikeImportType(ret_kind)) {
           out_error = "core.dl.sym return type mismatch";
           return false;
@@ -2012,7 +2769,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           out_ret = PackI64(0);
           return true;
         }
-        std::string name = U16ToAscii(ReadString(name_obj));
+        std::string name = ReadAsciiString(heap, name_obj);
 #if defined(_WIN32)
         (void)name;
         set_dl_error("core.dl.sym is unsupported on windows");
@@ -2032,7 +2789,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         return true;
 #endif
       }
-      if (sym == "close") {
+      case ImportOp::DlClose: {
         if (!IsI32LikeImportType(ret_kind)) {
           out_error = "core.dl.close return type mismatch";
           return false;
@@ -2064,7 +2821,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         return true;
 #endif
       }
-      if (sym == "last_error") {
+      case ImportOp::DlLastError: {
         if (!IsStringLikeImportType(ret_kind)) {
           out_error = "core.dl.last_error return type mismatch";
           return false;
@@ -2077,27 +2834,21 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           out_ret = PackRef(kNullRef);
           return true;
         }
-        uint32_t handle = CreateString(heap, AsciiToU16(dl_last_error));
+        uint32_t handle = CreateLatin1String(heap, dl_last_error);
         out_ret = PackRef(handle);
         return true;
       }
-      if (sym.rfind("call$", 0) == 0) {
-        if (sig.param_count == 0) {
+      case ImportOp::DlCall: {
+        if (import.param_count == 0) {
           out_error = "core.dl.call signature missing function pointer";
           return false;
         }
-        if (args.size() != sig.param_count) {
+        if (args.size() != import.param_count) {
           out_error = "core.dl.call arg count mismatch";
           return false;
         }
-        uint32_t ptr_type_id = module.param_types[sig.param_type_start];
-        if (ptr_type_id >= module.types.size()) {
-          out_error = "core.dl.call pointer type out of range";
-          return false;
-        }
-        TypeKind ptr_kind = static_cast<TypeKind>(module.types[ptr_type_id].kind);
-        if (ptr_kind != TypeKind::I64 && ptr_kind != TypeKind::U64) {
-          out_error = "core.dl.call first parameter must be i64/u64";
+        if (!import.dl_error.empty()) {
+          out_error = import.dl_error;
           return false;
         }
         int64_t ptr_bits = UnpackI64(args[0]);
@@ -2110,24 +2861,17 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           }
           return false;
         }
-        std::vector<uint32_t> arg_type_ids;
-        arg_type_ids.reserve(sig.param_count > 0 ? static_cast<size_t>(sig.param_count - 1) : 0u);
-        for (uint16_t i = 1; i < sig.param_count; ++i) {
-          uint32_t type_id = module.param_types[sig.param_type_start + i];
-          if (type_id >= module.types.size()) {
-            out_error = "core.dl.call parameter type out of range";
-            return false;
-          }
-          arg_type_ids.push_back(type_id);
-        }
         if (!DispatchDynamicDlCall(ptr_bits,
                                    module,
-                                   sig.ret_type_id,
+                                   import.ret_type_id,
                                    out_has_ret,
-                                   arg_type_ids,
+                                   import.dl_arg_types,
                                    args,
                                    1,
                                    heap,
+                                   scratch_arena,
+                                   dl_call_cache,
+                                   import_index,
                                    &out_ret,
                                    &out_error)) {
           return false;
@@ -2135,11 +2879,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         dl_last_error.clear();
         return true;
       }
+      case ImportOp::None:
+        break;
     }
-    out_error = "import not supported: " + mod + "." + sym;
+    out_error = "import not supported: " + import.module + "." + import.symbol;
     return false;
   };
-  std::vector<uint8_t> compile_stack(module.functions.size(), 0);
+  std::vector<uint8_t>& compile_stack = state.compile_stack;
   auto can_compile = [&](auto&& self, size_t func_index) -> bool {
     if (func_index >= module.functions.size()) return false;
     if (compile_stack[func_index]) return false;
@@ -2440,9 +3186,10 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
       if (locals_count < sig.param_count) return false;
     }
     if (needs_stack_map) {
-      if (!have_meta) return false;
-      if (func_index >= vr.methods.size()) return false;
-      if (vr.methods[func_index].stack_maps.empty()) return false;
+      const Simple::Byte::VerifyResult* vr = meta();
+      if (!vr) return false;
+      if (func_index >= vr->methods.size()) return false;
+      if (vr->methods[func_index].stack_maps.empty()) return false;
     }
     return true;
   };
@@ -2469,6 +3216,62 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
       }
     }
   };
+  // Tier1 functions in the scalar subset that keep running get machine code
+  // (native_jit.h). Native calls report through the hook and are applied to
+  // the tier counters, as the bytecode Tier1 path would count them, once the
+  // native entry returns; a bailed entry drops them since its rerun counts.
+  constexpr size_t kNativeFrameSlots = 64 * 1024;
+  JitCodeArena& native_arena = state.native_arena;
+  std::vector<NativeFunction>& native_funcs = state.native_funcs;
+  std::vector<uint8_t>& native_state = state.native_state;
+  std::unique_ptr<Slot[]>& native_frame = state.native_frame;
+  std::vector<uint32_t>& native_pending_calls = state.native_pending_calls;
+  std::vector<uint32_t>& native_pending_ids = state.native_pending_ids;
+  auto native_call = [&](uint32_t func_id) {
+    if (native_pending_calls[func_id]++ == 0) native_pending_ids.push_back(func_id);
+  };
+  // Applies (or, after a bail, drops) the recorded calls in first-call order.
+  auto settle_native_calls = [&](bool apply) {
+    for (uint32_t func_id : native_pending_ids) {
+      for (uint32_t n = apply ? native_pending_calls[func_id] : 0; n > 0; --n) {
+        update_tier(func_id);
+        jit_compiled_exec_counts[func_id] += 1;
+        if (jit_tiers[func_id] == JitTier::Tier1) {
+          jit_tier1_exec_counts[func_id] += 1;
+        }
+        jit_native_exec_counts[func_id] += 1;
+      }
+      native_pending_calls[func_id] = 0;
+    }
+    native_pending_ids.clear();
+  };
+  state.native_relay.fn = [](void* ctx, uint32_t func_id) { (*static_cast<decltype(native_call)*>(ctx))(func_id); };
+  state.native_relay.ctx = &native_call;
+  NativeCallHook native_hook;
+  native_hook.fn = [](void* ctx, uint32_t func_id) {
+    const NativeCallRelay* relay = static_cast<const NativeCallRelay*>(ctx);
+    relay->fn(relay->ctx, func_id);
+  };
+  native_hook.ctx = &state.native_relay;
+  auto native_for = [&](auto&& self, uint32_t func_id) -> const NativeFunction* {
+    if (!jit_native || func_id >= native_state.size()) return nullptr;
+    if (native_state[func_id] == kNativeCompiled) return &native_funcs[func_id];
+    if (native_state[func_id] != kNativeUntried) return nullptr;
+    if (!can_compile_func(func_id)) {
+      native_state[func_id] = kNativeUnsupported;
+      return nullptr;
+    }
+    native_state[func_id] = kNativeCompiling;
+    NativeCalleeResolver resolve = [&](uint32_t callee_id) { return self(self, callee_id); };
+    std::string error;
+    const Simple::Byte::VerifyResult* vr = meta();
+    const Simple::Byte::MethodVerifyInfo* verify_info =
+        vr && func_id < vr->methods.size() ? &vr->methods[func_id] : nullptr;
+    bool ok = CompileNativeFunction(module, func_id, verify_info, resolve, native_hook, native_arena,
+                                    &native_funcs[func_id], &error);
+    native_state[func_id] = ok ? kNativeCompiled : kNativeUnsupported;
+    return ok ? &native_funcs[func_id] : nullptr;
+  };
   auto run_compiled = [&](auto&& self, size_t func_index, const std::vector<Slot>& args, Slot& out_ret,
                           bool& out_has_ret, std::string& error) -> bool {
     if (func_index >= module.functions.size()) {
@@ -2493,6 +3296,29 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
       error = "JIT compiled arg count mismatch";
       return false;
     }
+    if (jit_tiers[func_index] == JitTier::Tier1 && jit_tier1_exec_counts[func_index] >= jit_native_threshold) {
+      if (const NativeFunction* native = native_for(native_for, static_cast<uint32_t>(func_index))) {
+        // Left uninitialized: native code zeroes its own non-param locals.
+        if (!native_frame) native_frame.reset(new Slot[kNativeFrameSlots]);
+        std::copy(args.begin(), args.end(), native_frame.get());
+        uint32_t status = native->entry(native_frame.get(), native_frame.get() + kNativeFrameSlots);
+        const bool finished = status < static_cast<uint32_t>(NativeStatus::Bail);
+        settle_native_calls(finished);
+        if (finished) {
+          jit_native_exec_counts[func_index] += 1;
+          out_has_ret = status == static_cast<uint32_t>(NativeStatus::ReturnValue);
+          if (out_has_ret) out_ret = native_frame[0];
+          return true;
+        }
+        // Rerun on the bytecode path, which reports the failure (or handles
+        // what native code could not, e.g. a frame deeper than native_frame).
+        // Only code native code cannot run at all retires the function; a
+        // Bail depends on this call's arguments.
+        if (status == static_cast<uint32_t>(NativeStatus::Unsupported)) {
+          native_state[func_index] = kNativeUnsupported;
+        }
+      }
+    }
     size_t pc = func.code_offset;
     size_t end_pc = func.code_offset + func.code_size;
     std::vector<Slot> local_stack;
@@ -3554,6 +4380,9 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           if (!obj || obj->header.kind != ObjectKind::Array) {
             return jit_fail("JIT compiled ARRAY_GET on non-array", op, inst_pc);
           }
+          if (obj->header.byte_elements) {
+            return jit_fail("JIT compiled ARRAY_GET on byte array", op, inst_pc);
+          }
           uint32_t length = ReadU32Payload(obj->payload, 0);
           int32_t index = UnpackI32(idx_val);
           if (index < 0 || static_cast<uint32_t>(index) >= length) {
@@ -3581,6 +4410,9 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           if (!obj || obj->header.kind != ObjectKind::Array) {
             return jit_fail("JIT compiled ARRAY_SET on non-array", op, inst_pc);
           }
+          if (obj->header.byte_elements) {
+            return jit_fail("JIT compiled ARRAY_SET on byte array", op, inst_pc);
+          }
           uint32_t length = ReadU32Payload(obj->payload, 0);
           int32_t index = UnpackI32(idx_val);
           if (index < 0 || static_cast<uint32_t>(index) >= length) {
@@ -3671,7 +4503,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           if (!obj || obj->header.kind != ObjectKind::String) {
             return jit_fail("JIT compiled STRING_LEN on non-string", op, inst_pc);
           }
-          uint32_t length = ReadU32Payload(obj->payload, 0);
+          uint32_t length = StringLength(obj);
           local_stack.push_back(PackI32(static_cast<int32_t>(length)));
           break;
         }
@@ -3885,25 +4717,41 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
     result.jit_dispatch_counts = jit_dispatch_counts;
     result.jit_compiled_exec_counts = jit_compiled_exec_counts;
     result.jit_tier1_exec_counts = jit_tier1_exec_counts;
+    result.jit_native_exec_counts = jit_native_exec_counts;
+    result.opcode_pair_counts = opcode_pair_counts;
+    result.opcode_triple_counts = opcode_triple_counts;
+    result.gc = heap.Stats();
     return result;
   };
-  auto read_const_string = [&](uint32_t const_id, Slot& out_value) -> bool {
-    uint32_t kind = ReadU32Payload(module.const_pool, const_id);
-    if (kind != 0) return false;
-    if (const_id + 8 > module.const_pool.size()) return false;
+  // Const-pool strings are created once per module instance and pinned, so
+  // CONST_STRING in a loop pushes the same handle instead of allocating.
+  // Returns Heap::kNoHandle and sets error when the constant is bad.
+  // Finds the bytes of a string const; returns an error or nullptr.
+  auto find_const_string = [&](uint32_t const_id, std::string_view* out) -> const char* {
+    if (const_id + 8 > module.const_pool.size()) return "out of bounds";
+    if (ReadU32Payload(module.const_pool, const_id) != 0) return "wrong const kind";
     uint32_t str_offset = ReadU32Payload(module.const_pool, const_id + 4);
-    if (str_offset >= module.const_pool.size()) return false;
+    if (str_offset >= module.const_pool.size()) return "bad offset";
     const char* base = reinterpret_cast<const char*>(module.const_pool.data() + str_offset);
-    std::u16string text;
-    for (size_t i = 0; str_offset + i < module.const_pool.size(); ++i) {
-      char c = base[i];
-      if (c == '\0') break;
-      text.push_back(static_cast<char16_t>(static_cast<unsigned char>(c)));
+    const size_t avail = module.const_pool.size() - str_offset;
+    const char* nul = static_cast<const char*>(std::memchr(base, '\0', avail));
+    *out = std::string_view(base, nul ? static_cast<size_t>(nul - base) : avail);
+    return nullptr;
+  };
+  auto intern_const_string = [&](uint32_t const_id, const char** error) -> uint32_t {
+    auto interned = state.const_strings.find(const_id);
+    if (interned != state.const_strings.end()) return interned->second;
+    std::string_view bytes;
+    *error = find_const_string(const_id, &bytes);
+    if (*error) return Heap::kNoHandle;
+    uint32_t handle = CreateLatin1String(heap, bytes.data(), bytes.size());
+    if (handle == Heap::kNoHandle) {
+      *error = "allocation failed";
+      return Heap::kNoHandle;
     }
-    uint32_t handle = CreateString(heap, text);
-    if (handle == 0xFFFFFFFFu) return false;
-    out_value = PackRef(handle);
-    return true;
+    heap.Pin(handle);
+    state.const_strings.emplace(const_id, handle);
+    return handle;
   };
   auto is_ref_like_global = [&](size_t global_index) -> bool {
     if (global_index >= module.globals.size()) return false;
@@ -3915,63 +4763,86 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
     if (kind == TypeKind::Unspecified && (row.flags & 0x1u) != 0u) return true;
     return false;
   };
-  for (size_t i = 0; i < module.globals.size(); ++i) {
-    uint32_t const_id = module.globals[i].init_const_id;
-    if (const_id == 0xFFFFFFFFu) continue;
-    if (const_id + 4 > module.const_pool.size()) return Trap("GLOBAL init const out of bounds");
-    uint32_t kind = ReadU32Payload(module.const_pool, const_id);
-    if (kind == 0) {
-      Slot value = 0;
-      if (!read_const_string(const_id, value)) return Trap("GLOBAL init string failed");
-      globals[i] = value;
-      continue;
-    }
-    if (kind == 3) {
-      if (const_id + 8 > module.const_pool.size()) return Trap("GLOBAL init f32 out of bounds");
-      uint32_t bits = ReadU32Payload(module.const_pool, const_id + 4);
-      if (bits == 0 && is_ref_like_global(i)) {
-        globals[i] = PackRef(kNullRef);
+  if (!state.globals_ready) {
+    for (size_t i = 0; i < module.globals.size(); ++i) {
+      uint32_t const_id = module.globals[i].init_const_id;
+      if (const_id == 0xFFFFFFFFu) continue;
+      if (const_id + 4 > module.const_pool.size()) return Trap("GLOBAL init const out of bounds");
+      uint32_t kind = ReadU32Payload(module.const_pool, const_id);
+      if (kind == 0) {
+        const char* error = nullptr;
+        uint32_t handle = intern_const_string(const_id, &error);
+        if (handle == Heap::kNoHandle) return Trap("GLOBAL init string failed");
+        globals[i] = PackRef(handle);
         continue;
       }
-      globals[i] = PackF32Bits(bits);
-      continue;
-    }
-    if (kind == 4) {
-      if (const_id + 12 > module.const_pool.size()) return Trap("GLOBAL init f64 out of bounds");
-      uint64_t bits = ReadU64Payload(module.const_pool, const_id + 4);
-      if (bits == 0 && is_ref_like_global(i)) {
-        globals[i] = PackRef(kNullRef);
+      if (kind == 3) {
+        if (const_id + 8 > module.const_pool.size()) return Trap("GLOBAL init f32 out of bounds");
+        uint32_t bits = ReadU32Payload(module.const_pool, const_id + 4);
+        if (bits == 0 && is_ref_like_global(i)) {
+          globals[i] = PackRef(kNullRef);
+          continue;
+        }
+        globals[i] = PackF32Bits(bits);
         continue;
       }
-      globals[i] = PackF64Bits(bits);
-      continue;
+      if (kind == 4) {
+        if (const_id + 12 > module.const_pool.size()) return Trap("GLOBAL init f64 out of bounds");
+        uint64_t bits = ReadU64Payload(module.const_pool, const_id + 4);
+        if (bits == 0 && is_ref_like_global(i)) {
+          globals[i] = PackRef(kNullRef);
+          continue;
+        }
+        globals[i] = PackF64Bits(bits);
+        continue;
+      }
+      return Trap("GLOBAL init const unsupported");
     }
-    return Trap("GLOBAL init const unsupported");
+    state.globals_ready = true;
   }
 
-  size_t entry_func_index = 0;
-  bool found = false;
-  for (size_t i = 0; i < module.functions.size(); ++i) {
-    if (module.functions[i].method_id == module.header.entry_method_id) {
-      entry_func_index = i;
-      found = true;
-      break;
+  size_t entry_func_index = entry.func_index;
+  if (entry_func_index == Simple::Byte::kNoFunctionIndex) {
+    if (module.header.entry_method_id >= function_by_method->size() ||
+        (*function_by_method)[module.header.entry_method_id] == Simple::Byte::kNoFunctionIndex) {
+      return Trap("entry method not found in functions table");
     }
+    entry_func_index = (*function_by_method)[module.header.entry_method_id];
   }
-  if (!found) return Trap("entry method not found in functions table");
 
-  std::vector<Slot> stack;
-  std::vector<Frame> call_stack;
-  std::vector<Slot> call_args;
+  OperandStack<kChecked> stack;
+  // Frames and locals are stacks that only grow their storage: a return pops
+  // by moving locals_top back, so calls never reallocate in steady state.
+  std::vector<Frame>& call_stack = state.call_stack;
+  call_stack.clear();
+  std::vector<Slot>& call_args = state.call_args;
+  size_t locals_top = 0;
 
   auto alloc_locals = [&](uint16_t count) -> size_t {
-    size_t base = locals_arena.size();
-    locals_arena.resize(base + count);
-    std::fill(locals_arena.begin() + base, locals_arena.end(), 0);
+    size_t base = locals_top;
+    locals_top += count;
+    if (locals_top > locals_arena.size()) locals_arena.resize(std::max(locals_top, locals_arena.size() * 2));
+    std::fill(locals_arena.begin() + static_cast<std::ptrdiff_t>(base),
+              locals_arena.begin() + static_cast<std::ptrdiff_t>(locals_top), Slot{0});
     return base;
   };
+  // Moves the top arg_count operands into the new frame's first locals.
+  auto move_args_to_locals = [&](const Frame& frame, size_t args_base, uint8_t arg_count) {
+    size_t count = std::min<size_t>(arg_count, frame.locals_count);
+    for (size_t i = 0; i < count; ++i) {
+      locals_arena[frame.locals_base + i] = stack[args_base + i];
+    }
+    stack.resize(args_base);
+  };
+  auto stage_args = [&](size_t args_base, uint8_t arg_count) {
+    call_args.resize(arg_count);
+    for (size_t i = 0; i < arg_count; ++i) call_args[i] = stack[args_base + i];
+  };
   auto setup_frame = [&](size_t func_index, size_t return_pc, size_t stack_base, uint32_t closure_ref) -> Frame {
     update_tier(func_index);
+    if constexpr (!kChecked) {
+      stack.reserve(stack_base + module.functions[func_index].stack_max);
+    }
     Frame frame;
     frame.func_index = func_index;
     frame.return_pc = return_pc;
@@ -3991,8 +4862,34 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
     return frame;
   };
 
+  if (entry.args && enable_jit && jit_stubs[entry_func_index].compiled) {
+    update_tier(entry_func_index);
+    jit_compiled_exec_counts[entry_func_index] += 1;
+    if (jit_tiers[entry_func_index] == JitTier::Tier1) {
+      jit_tier1_exec_counts[entry_func_index] += 1;
+    }
+    Slot ret = 0;
+    bool has_ret = false;
+    std::string error;
+    if (run_compiled(run_compiled, entry_func_index, *entry.args, ret, has_ret, error)) {
+      ExecResult result;
+      result.status = ExecStatus::Halted;
+      if (has_ret) result.exit_code = UnpackI32(ret);
+      result.return_value = ret;
+      result.has_return_value = has_ret;
+      return finish(result);
+    }
+    jit_stubs[entry_func_index].compiled = false;
+    jit_stubs[entry_func_index].disabled = true;
+  }
+
   size_t func_start = module.functions[entry_func_index].code_offset;
   Frame current = setup_frame(entry_func_index, 0, 0, kNullRef);
+  if (entry.args) {
+    size_t count = std::min<size_t>(entry.args->size(), current.locals_count);
+    std::copy(entry.args->begin(), entry.args->begin() + static_cast<std::ptrdiff_t>(count),
+              locals_arena.begin() + static_cast<std::ptrdiff_t>(current.locals_base));
+  }
   TrapContext trap_ctx;
   trap_ctx.current = &current;
   trap_ctx.call_stack = &call_stack;
@@ -4003,37 +4900,49 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
   size_t pc = func_start;
   size_t end = func_start + module.functions[entry_func_index].code_size;
 
-  size_t op_counter = 0;
   auto ref_bit_set = [&](const std::vector<uint8_t>& bits, size_t index) -> bool {
     size_t byte = index / 8;
     if (byte >= bits.size()) return false;
     return (bits[byte] & static_cast<uint8_t>(1u << (index % 8))) != 0;
   };
-  auto find_stack_map = [&](size_t func_index, size_t pc_value) -> const Simple::Byte::StackMap* {
-    if (!have_meta || func_index >= vr.methods.size()) return nullptr;
-    const auto& maps = vr.methods[func_index].stack_maps;
-    for (const auto& map : maps) {
-      if (map.pc == pc_value) return &map;
-    }
-    return nullptr;
+  auto find_stack_map = [&](const Simple::Byte::VerifyResult& vr, size_t func_index,
+                            size_t pc_value) -> const Simple::Byte::StackMap* {
+    if (func_index >= vr.methods.size()) return nullptr;
+    return Simple::Byte::FindStackMap(vr.methods[func_index], static_cast<uint32_t>(pc_value));
   };
-  auto maybe_collect = [&]() {
-    if (!have_meta) return;
-    if (op_counter % 1000 != 0) return;
-    const Simple::Byte::StackMap* stack_map = find_stack_map(current.func_index, pc);
-    if (!stack_map) return;
-    heap.ResetMarks();
+  // Marks globals, every frame's ref locals and operands, and the current
+  // frame's operands per stack_map, the map at the pc being executed.
+  auto mark_roots = [&](const Simple::Byte::VerifyResult& vr, const Simple::Byte::StackMap& stack_map) {
     for (size_t i = 0; i < globals.size(); ++i) {
       if (ref_bit_set(vr.globals_ref_bits, i) && !IsNullRef(globals[i])) {
         heap.Mark(UnpackRef(globals[i]));
       }
     }
-    for (size_t i = 0; i < stack_map->stack_height && i < stack.size(); ++i) {
-      if (ref_bit_set(stack_map->ref_bits, i) && !IsNullRef(stack[i])) {
-        heap.Mark(UnpackRef(stack[i]));
+    // Each caller's operands sit below its outgoing call's arguments and are
+    // described by the stack map at that call. Without one, any slot that
+    // names a live object keeps it (handles never move, so this only
+    // over-retains).
+    const size_t frame_base = std::min(current.stack_base, stack.size());
+    size_t caller_base = 0;
+    for (const auto& f : call_stack) {
+      const size_t caller_top = std::min(f.stack_base, frame_base);
+      const Simple::Byte::StackMap* call_map = find_stack_map(vr, f.func_index, f.call_pc);
+      for (size_t i = caller_base; i < caller_top; ++i) {
+        const size_t slot = i - caller_base;
+        const bool is_ref = call_map ? (slot < call_map->stack_height && ref_bit_set(call_map->ref_bits, slot))
+                                     : !IsNullRef(stack[i]);
+        if (is_ref && !IsNullRef(stack[i])) heap.Mark(UnpackRef(stack[i]));
+      }
+      caller_base = std::max(caller_base, caller_top);
+    }
+    for (size_t i = 0; i < stack_map.stack_height && frame_base + i < stack.size(); ++i) {
+      if (ref_bit_set(stack_map.ref_bits, i) && !IsNullRef(stack[frame_base + i])) {
+        heap.Mark(UnpackRef(stack[frame_base + i]));
       }
     }
+    if (current.closure_ref != kNullRef) heap.Mark(current.closure_ref);
     for (const auto& f : call_stack) {
+      if (f.closure_ref != kNullRef) heap.Mark(f.closure_ref);
       if (f.func_index >= vr.methods.size()) continue;
       const auto& bits = vr.methods[f.func_index].locals_ref_bits;
       for (size_t i = 0; i < f.locals_count; ++i) {
@@ -4052,14 +4961,92 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         }
       }
     }
-    heap.Sweep();
   };
+  // Runs the collection the heap requested, or the next slice of an
+  // incremental cycle, if pc has a stack map; otherwise the work stays
+  // pending until the next safepoint. Allocation-free runs
+  // never get here, so unverified ones never pay for verification.
+  auto maybe_collect = [&]() {
+    const Simple::Byte::VerifyResult* meta_result = meta();
+    if (!meta_result) return;
+    const Simple::Byte::VerifyResult& vr = *meta_result;
+    const Simple::Byte::StackMap* stack_map = find_stack_map(vr, current.func_index, pc);
+    if (!stack_map) return;
+    if (!heap.NeedsRoots()) {
+      heap.Step();
+    } else {
+      heap.BeginCollection();
+      mark_roots(vr, *stack_map);
+      heap.FinishCollection();
+    }
+    state.ReleaseDeadMappings();
+  };
+
+#if SIMPLEVM_COMPUTED_GOTO
+  void* dispatch_table[256];
+  for (auto& entry : dispatch_table) entry = &&vm_op_default;
+#define VM_BIND_HANDLER(name) dispatch_table[static_cast<uint8_t>(OpCode::name)] = &&vm_op_##name;
+  VM_INTERPRETER_OPCODES(VM_BIND_HANDLER)
+#undef VM_BIND_HANDLER
+#endif
+  // Verified code only reaches instruction boundaries, so the shared stream
+  // never needs extending; a miss there means pc >= end, which the loop
+  // checks before reading ip.
+  auto resolve_ip = [&]() -> const DecodedInst* {
+    if (kChecked) return state.own_decoded.Resolve(module.code, pc, end);
+    return decoded.At(pc);
+  };
+  const DecodedInst* ip = resolve_ip();
+  // Steps over the records a superinstruction consumed after its head and
+  // counts them toward the function's JIT opcode threshold.
+  auto skip_fused = [&](size_t count) {
+    pc = ip[count - 1].next_pc;
+    ip += count;
+    if (current.func_index < func_opcode_counts.size()) {
+      func_opcode_counts[current.func_index] += static_cast<uint32_t>(count);
+    }
+  };
+
+  // An allocating opcode the heap limit refused gets one stop-the-world
+  // collection at its safepoint: its popped operands go back on the stack, the
+  // roots are marked from its stack map and it runs again. A second refusal
+  // of that same attempt traps. Unverified runs keep their operands in a
+  // std::vector, which does not keep popped slots, so they trap at once.
+  size_t alloc_retry_pc = static_cast<size_t>(-1);
+  uint64_t alloc_retry_count = 0;
+  auto collect_and_retry = [&](const DecodedInst& failed) -> bool {
+    if (!heap.TakeLimitFailure()) return false;
+    if constexpr (kChecked) {
+      return false;
+    } else {
+      if (failed.pc == alloc_retry_pc && opcode_counts[failed.opcode] == alloc_retry_count + 1) return false;
+      const Simple::Byte::VerifyResult* vr = meta();
+      if (!vr) return false;
+      const Simple::Byte::StackMap* stack_map = find_stack_map(*vr, current.func_index, failed.pc);
+      if (!stack_map || current.stack_base + stack_map->stack_height < stack.size()) return false;
+      stack.Restore(current.stack_base + stack_map->stack_height);
+      heap.ResetMarks();
+      mark_roots(*vr, *stack_map);
+      heap.Sweep();
+      state.ReleaseDeadMappings();
+      alloc_retry_pc = failed.pc;
+      alloc_retry_count = opcode_counts[failed.opcode];
+      pc = failed.pc;
+      ip = resolve_ip();
+      return true;
+    }
+  };
+// Traps with message unless collect_and_retry rewound to the failed opcode.
+#define VM_ALLOC_FAILED(message)             \
+  {                                          \
+    if (collect_and_retry(inst)) continue;   \
+    return Trap(message);                    \
+  }
 
   while (pc < module.code.size()) {
     trap_ctx.pc = pc;
     trap_ctx.func_start = func_start;
-    ++op_counter;
-    maybe_collect();
+    if (heap.CollectionPending()) maybe_collect();
     if (pc >= end) {
       if (call_stack.empty()) {
         ExecResult done;
@@ -4069,9 +5056,19 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
       return Trap("pc out of bounds for function");
     }
 
-    uint8_t opcode = module.code[pc++];
+    const DecodedInst inst = *ip++;
+    uint8_t opcode = inst.opcode;
+    pc = inst.next_pc;
     trap_ctx.last_opcode = opcode;
     opcode_counts[opcode] += 1;
+    if (profile_sequences) {
+      if (inst.pc != seq_next_pc) seq_len = 0;
+      if (seq_len >= 1) opcode_pair_counts[((seq_history & 0xFFu) << 8) | opcode] += 1;
+      if (seq_len >= 2) opcode_triple_counts[((seq_history & 0xFFFFu) << 8) | opcode] += 1;
+      seq_history = (seq_history << 8) | opcode;
+      seq_len = std::min<size_t>(seq_len + 1, 2);
+      seq_next_pc = inst.next_pc;
+    }
     if (current.func_index < func_opcode_counts.size()) {
       uint32_t& count = func_opcode_counts[current.func_index];
       count += 1;
@@ -4084,10 +5081,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         compile_ticks_tier0[current.func_index] = ++compile_tick;
       }
     }
+#if SIMPLEVM_COMPUTED_GOTO
+    goto *dispatch_table[opcode];
+#endif
     switch (static_cast<OpCode>(opcode)) {
-      case OpCode::Nop:
+      VM_CASE(Nop)
         break;
-      case OpCode::Halt: {
+      VM_CASE(Halt) {
         ExecResult result;
         result.status = ExecStatus::Halted;
         if (!stack.empty()) {
@@ -4095,38 +5095,38 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         }
         return finish(result);
       }
-      case OpCode::Trap:
+      VM_CASE(Trap)
         return Trap("TRAP");
-      case OpCode::Breakpoint:
+      VM_CASE(Breakpoint)
         break;
-      case OpCode::Pop: {
-        if (stack.empty()) return Trap("POP on empty stack");
+      VM_CASE(Pop) {
+        if (kChecked && stack.empty()) return Trap("POP on empty stack");
         stack.pop_back();
         break;
       }
-      case OpCode::Dup: {
-        if (stack.empty()) return Trap("DUP on empty stack");
+      VM_CASE(Dup) {
+        if (kChecked && stack.empty()) return Trap("DUP on empty stack");
         stack.push_back(stack.back());
         break;
       }
-      case OpCode::Dup2: {
-        if (stack.size() < 2) return Trap("DUP2 on short stack");
+      VM_CASE(Dup2) {
+        if (kChecked && stack.size() < 2) return Trap("DUP2 on short stack");
         Slot b = stack[stack.size() - 1];
         Slot a = stack[stack.size() - 2];
         stack.push_back(a);
         stack.push_back(b);
         break;
       }
-      case OpCode::Swap: {
-        if (stack.size() < 2) return Trap("SWAP on short stack");
+      VM_CASE(Swap) {
+        if (kChecked && stack.size() < 2) return Trap("SWAP on short stack");
         Slot a = stack[stack.size() - 1];
         Slot b = stack[stack.size() - 2];
         stack[stack.size() - 1] = b;
         stack[stack.size() - 2] = a;
         break;
       }
-      case OpCode::Rot: {
-        if (stack.size() < 3) return Trap("ROT on short stack");
+      VM_CASE(Rot) {
+        if (kChecked && stack.size() < 3) return Trap("ROT on short stack");
         Slot c = stack[stack.size() - 1];
         Slot b = stack[stack.size() - 2];
         Slot a = stack[stack.size() - 3];
@@ -4135,59 +5135,59 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         stack[stack.size() - 1] = a;
         break;
       }
-      case OpCode::ConstI32: {
-        int32_t value = ReadI32(module.code, pc);
+      VM_CASE(ConstI32) {
+        int32_t value = static_cast<int32_t>(inst.a);
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ConstI64: {
-        int64_t value = ReadI64(module.code, pc);
+      VM_CASE(ConstI64) {
+        int64_t value = static_cast<int64_t>(inst.a);
         Push(stack, PackI64(value));
         break;
       }
-      case OpCode::ConstU32: {
-        uint32_t value = ReadU32(module.code, pc);
+      VM_CASE(ConstU32) {
+        uint32_t value = static_cast<uint32_t>(inst.a);
         Push(stack, PackI32(static_cast<int32_t>(value)));
         break;
       }
-      case OpCode::ConstU64: {
-        uint64_t value = ReadU64(module.code, pc);
+      VM_CASE(ConstU64) {
+        uint64_t value = inst.a;
         Push(stack, PackI64(static_cast<int64_t>(value)));
         break;
       }
-      case OpCode::ConstI8: {
-        int8_t value = static_cast<int8_t>(ReadU8(module.code, pc));
+      VM_CASE(ConstI8) {
+        int8_t value = static_cast<int8_t>(inst.a);
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ConstI16: {
-        int16_t value = static_cast<int16_t>(ReadU16(module.code, pc));
+      VM_CASE(ConstI16) {
+        int16_t value = static_cast<int16_t>(inst.a);
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ConstU8: {
-        uint8_t value = ReadU8(module.code, pc);
+      VM_CASE(ConstU8) {
+        uint8_t value = static_cast<uint8_t>(inst.a);
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ConstU16: {
-        uint16_t value = ReadU16(module.code, pc);
+      VM_CASE(ConstU16) {
+        uint16_t value = static_cast<uint16_t>(inst.a);
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ConstF32: {
-        uint32_t bits = ReadU32(module.code, pc);
+      VM_CASE(ConstF32) {
+        uint32_t bits = static_cast<uint32_t>(inst.a);
         Push(stack, PackF32Bits(bits));
         break;
       }
-      case OpCode::ConstF64: {
-        uint64_t bits = ReadU64(module.code, pc);
+      VM_CASE(ConstF64) {
+        uint64_t bits = inst.a;
         Push(stack, PackF64Bits(bits));
         break;
       }
-      case OpCode::ConstI128:
-      case OpCode::ConstU128: {
-        uint32_t const_id = ReadU32(module.code, pc);
+      VM_CASE(ConstI128)
+      VM_CASE(ConstU128) {
+        uint32_t const_id = static_cast<uint32_t>(inst.a);
         if (const_id + 8 > module.const_pool.size()) return Trap("CONST_I128/U128 out of bounds");
         uint32_t kind = ReadU32Payload(module.const_pool, const_id);
         uint32_t want = (opcode == static_cast<uint8_t>(OpCode::ConstI128)) ? 1u : 2u;
@@ -4200,65 +5200,103 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackRef(kNullRef));
         break;
       }
-      case OpCode::ConstChar: {
-        uint16_t value = ReadU16(module.code, pc);
+      VM_CASE(ConstChar) {
+        uint16_t value = static_cast<uint16_t>(inst.a);
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ConstBool: {
-        uint8_t v = ReadU8(module.code, pc);
+      VM_CASE(ConstBool) {
+        uint8_t v = static_cast<uint8_t>(inst.a);
         Push(stack, PackI32(v ? 1 : 0));
         break;
       }
-      case OpCode::ConstString: {
-        uint32_t const_id = ReadU32(module.code, pc);
-        if (const_id + 8 > module.const_pool.size()) return Trap("CONST_STRING out of bounds");
-        uint32_t kind = ReadU32Payload(module.const_pool, const_id);
-        if (kind != 0) return Trap("CONST_STRING wrong const kind");
-        uint32_t str_offset = ReadU32Payload(module.const_pool, const_id + 4);
-        if (str_offset >= module.const_pool.size()) return Trap("CONST_STRING bad offset");
-        const char* base = reinterpret_cast<const char*>(module.const_pool.data() + str_offset);
-        std::u16string text;
-        for (size_t i = 0; str_offset + i < module.const_pool.size(); ++i) {
-          char c = base[i];
-          if (c == '\0') break;
-          text.push_back(static_cast<char16_t>(static_cast<unsigned char>(c)));
-        }
-        uint32_t handle = CreateString(heap, text);
-        if (handle == 0xFFFFFFFFu) return Trap("CONST_STRING allocation failed");
+      VM_CASE(ConstString) {
+        const char* error = nullptr;
+        uint32_t handle = intern_const_string(static_cast<uint32_t>(inst.a), &error);
+        if (handle == Heap::kNoHandle) VM_ALLOC_FAILED(std::string("CONST_STRING ") + error);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::ConstNull: {
+      VM_CASE(ConstNull) {
         Push(stack, PackRef(kNullRef));
         break;
       }
-      case OpCode::LoadLocal: {
-        uint32_t idx = ReadU32(module.code, pc);
-        if (idx >= current.locals_count) return Trap("LOAD_LOCAL out of range");
+      VM_CASE(LoadLocal) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
+        if (kChecked && idx >= current.locals_count) return Trap("LOAD_LOCAL out of range");
         Push(stack, locals_arena[current.locals_base + idx]);
         break;
       }
-      case OpCode::StoreLocal: {
-        uint32_t idx = ReadU32(module.code, pc);
-        if (idx >= current.locals_count) return Trap("STORE_LOCAL out of range");
+      VM_CASE(StoreLocal) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
+        if (kChecked && idx >= current.locals_count) return Trap("STORE_LOCAL out of range");
         locals_arena[current.locals_base + idx] = Pop(stack);
         break;
       }
-      case OpCode::LoadGlobal: {
-        uint32_t idx = ReadU32(module.code, pc);
-        if (idx >= globals.size()) return Trap("LOAD_GLOBAL out of range");
+      // Superinstructions: ip points at the record after the fused head.
+      VM_CASE(LoadLocal2) {
+        uint32_t first = static_cast<uint32_t>(inst.a);
+        uint32_t second = static_cast<uint32_t>(ip[0].a);
+        if (kChecked && (first >= current.locals_count || second >= current.locals_count)) {
+          return Trap("LOAD_LOCAL out of range");
+        }
+        Push(stack, locals_arena[current.locals_base + first]);
+        Push(stack, locals_arena[current.locals_base + second]);
+        skip_fused(1);
+        break;
+      }
+      VM_CASE(AddLocalsI32) {
+        uint32_t first = static_cast<uint32_t>(inst.a);
+        uint32_t second = static_cast<uint32_t>(ip[0].a);
+        if (kChecked && (first >= current.locals_count || second >= current.locals_count)) {
+          return Trap("LOAD_LOCAL out of range");
+        }
+        int32_t lhs = UnpackI32(locals_arena[current.locals_base + first]);
+        int32_t rhs = UnpackI32(locals_arena[current.locals_base + second]);
+        Push(stack, PackI32(lhs + rhs));
+        skip_fused(2);
+        break;
+      }
+      VM_CASE(IncLocalI32) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
+        if (kChecked && idx >= current.locals_count) return Trap("LOAD_LOCAL out of range");
+        int32_t step = static_cast<int32_t>(ip[0].a);
+        Slot& local = locals_arena[current.locals_base + idx];
+        int32_t value = UnpackI32(local);
+        value = ip[1].opcode == static_cast<uint8_t>(OpCode::SubI32) ? value - step : value + step;
+        local = PackI32(value);
+        skip_fused(3);
+        break;
+      }
+      VM_CASE(JmpFalseCmpLocalConstI32) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
+        if (kChecked && idx >= current.locals_count) return Trap("LOAD_LOCAL out of range");
+        int32_t lhs = UnpackI32(locals_arena[current.locals_base + idx]);
+        int32_t rhs = static_cast<int32_t>(ip[0].a);
+        bool take = !CompareI32(ip[1].opcode, lhs, rhs);
+        const DecodedInst& jump = ip[2];
+        skip_fused(3);
+        if (take) {
+          pc = static_cast<size_t>(jump.a);
+          if (kChecked && (pc < func_start || pc > end)) return Trap("JMP out of bounds");
+          ip = jump.b != kNoDecodedInst ? &decoded.insts[jump.b] : resolve_ip();
+        }
+        break;
+      }
+      VM_CASE(LoadGlobal) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
+        if (kChecked && idx >= globals.size()) return Trap("LOAD_GLOBAL out of range");
         Push(stack, globals[idx]);
         break;
       }
-      case OpCode::StoreGlobal: {
-        uint32_t idx = ReadU32(module.code, pc);
-        if (idx >= globals.size()) return Trap("STORE_GLOBAL out of range");
+      VM_CASE(StoreGlobal) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
+        if (kChecked && idx >= globals.size()) return Trap("STORE_GLOBAL out of range");
         globals[idx] = Pop(stack);
         break;
       }
-      case OpCode::LoadUpvalue: {
-        uint32_t idx = ReadU32(module.code, pc);
+      VM_CASE(LoadUpvalue) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
         if (current.closure_ref == kNullRef) return Trap("LOAD_UPVALUE without closure");
         HeapObject* obj = heap.Get(current.closure_ref);
         if (!obj || obj->header.kind != ObjectKind::Closure) return Trap("LOAD_UPVALUE on non-closure");
@@ -4271,8 +5309,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::StoreUpvalue: {
-        uint32_t idx = ReadU32(module.code, pc);
+      VM_CASE(StoreUpvalue) {
+        uint32_t idx = static_cast<uint32_t>(inst.a);
         Slot v = Pop(stack);
         if (current.closure_ref == kNullRef) return Trap("STORE_UPVALUE without closure");
         HeapObject* obj = heap.Get(current.closure_ref);
@@ -4282,28 +5320,31 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         if (idx >= count) return Trap("STORE_UPVALUE out of bounds");
         size_t offset = 8 + static_cast<size_t>(idx) * 4;
         if (offset + 4 > obj->payload.size()) return Trap("STORE_UPVALUE out of bounds");
+        heap.RecordOverwrite(current.closure_ref);
         WriteU32Payload(obj->payload, offset, UnpackRef(v));
+        heap.RecordWrite(current.closure_ref, UnpackRef(v));
         break;
       }
-      case OpCode::NewObject: {
-        uint32_t type_id = ReadU32(module.code, pc);
-        if (type_id >= module.types.size()) return Trap("NEW_OBJECT bad type id");
+      VM_CASE(NewObject) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        if (kChecked && type_id >= module.types.size()) return Trap("NEW_OBJECT bad type id");
         uint32_t size = module.types[type_id].size;
         uint32_t handle = heap.Allocate(ObjectKind::Artifact, type_id, size);
+        if (handle == Heap::kNoHandle) VM_ALLOC_FAILED("NEW_OBJECT allocation failed");
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::NewClosure: {
-        uint32_t method_id = ReadU32(module.code, pc);
-        uint8_t upvalue_count = ReadU8(module.code, pc);
-        if (method_id >= module.methods.size()) return Trap("NEW_CLOSURE bad method id");
+      VM_CASE(NewClosure) {
+        uint32_t method_id = static_cast<uint32_t>(inst.a);
+        uint8_t upvalue_count = inst.imm8;
+        if (kChecked && method_id >= module.methods.size()) return Trap("NEW_CLOSURE bad method id");
         uint32_t size = 8 + static_cast<uint32_t>(upvalue_count) * 4u;
         uint32_t handle = heap.Allocate(ObjectKind::Closure, method_id, size);
         HeapObject* obj = heap.Get(handle);
-        if (!obj) return Trap("NEW_CLOSURE allocation failed");
+        if (!obj) VM_ALLOC_FAILED("NEW_CLOSURE allocation failed");
         WriteU32Payload(obj->payload, 0, method_id);
         WriteU32Payload(obj->payload, 4, static_cast<uint32_t>(upvalue_count));
-        if (stack.size() < upvalue_count) return Trap("NEW_CLOSURE stack underflow");
+        if (kChecked && stack.size() < upvalue_count) return Trap("NEW_CLOSURE stack underflow");
         for (int32_t i = static_cast<int32_t>(upvalue_count) - 1; i >= 0; --i) {
           Slot v = Pop(stack);
           WriteU32Payload(obj->payload, 8 + static_cast<uint32_t>(i) * 4u, UnpackRef(v));
@@ -4311,10 +5352,10 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::LoadField: {
-        uint32_t field_id = ReadU32(module.code, pc);
+      VM_CASE(LoadField) {
+        uint32_t field_id = static_cast<uint32_t>(inst.a);
         Slot v = Pop(stack);
-        if (field_id >= module.fields.size()) return Trap("LOAD_FIELD bad field id");
+        if (kChecked && field_id >= module.fields.size()) return Trap("LOAD_FIELD bad field id");
         if (IsNullRef(v)) return Trap("LOAD_FIELD on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Artifact) return Trap("LOAD_FIELD on non-object");
@@ -4324,26 +5365,30 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::StoreField: {
-        uint32_t field_id = ReadU32(module.code, pc);
+      VM_CASE(StoreField) {
+        uint32_t field_id = static_cast<uint32_t>(inst.a);
         Slot value = Pop(stack);
         Slot v = Pop(stack);
-        if (field_id >= module.fields.size()) return Trap("STORE_FIELD bad field id");
+        if (kChecked && field_id >= module.fields.size()) return Trap("STORE_FIELD bad field id");
         if (IsNullRef(v)) return Trap("STORE_FIELD on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Artifact) return Trap("STORE_FIELD on non-object");
         uint32_t offset = module.fields[field_id].offset;
         if (offset + 4 > obj->payload.size()) return Trap("STORE_FIELD out of bounds");
+        heap.RecordOverwrite(UnpackRef(v));
         WriteU32Payload(obj->payload, offset, static_cast<uint32_t>(UnpackI32(value)));
+        // Fields are untyped here; the barrier ignores values that are not
+        // young handles.
+        heap.RecordWrite(UnpackRef(v), static_cast<uint32_t>(UnpackI32(value)));
         break;
       }
-      case OpCode::IsNull: {
+      VM_CASE(IsNull) {
         Slot v = Pop(stack);
         Push(stack, PackI32(IsNullRef(v) ? 1 : 0));
         break;
       }
-      case OpCode::RefEq:
-      case OpCode::RefNe: {
+      VM_CASE(RefEq)
+      VM_CASE(RefNe) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         bool out = (UnpackRef(a) == UnpackRef(b));
@@ -4351,7 +5396,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::TypeOf: {
+      VM_CASE(TypeOf) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("TYPEOF on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4359,42 +5404,57 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(obj->header.type_id)));
         break;
       }
-      case OpCode::NewArray: {
-        uint32_t type_id = ReadU32(module.code, pc);
-        uint32_t length = ReadU32(module.code, pc);
+      VM_CASE(NewArray) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        uint32_t length = inst.b;
         uint32_t size = 4 + length * 4;
-        uint32_t handle = heap.Allocate(ObjectKind::Array, type_id, size);
+        // SIR lowers `newarray ref N` here too; the element type decides tracing.
+        const bool ref_elements = state.code->type_refs->IsRefType(type_id);
+        uint32_t handle = heap.Allocate(ObjectKind::Array, type_id, size, ref_elements);
         HeapObject* obj = heap.Get(handle);
-        if (!obj) return Trap("NEW_ARRAY allocation failed");
+        if (!obj) VM_ALLOC_FAILED("NEW_ARRAY allocation failed");
         WriteU32Payload(obj->payload, 0, length);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::NewArrayI64:
-      case OpCode::NewArrayF64: {
-        uint32_t type_id = ReadU32(module.code, pc);
-        uint32_t length = ReadU32(module.code, pc);
+      VM_CASE(NewArrayI64)
+      VM_CASE(NewArrayF64) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        uint32_t length = inst.b;
         uint32_t size = 4 + length * 8;
         uint32_t handle = heap.Allocate(ObjectKind::Array, type_id, size);
         HeapObject* obj = heap.Get(handle);
-        if (!obj) return Trap("NEW_ARRAY allocation failed");
+        if (!obj) VM_ALLOC_FAILED("NEW_ARRAY allocation failed");
         WriteU32Payload(obj->payload, 0, length);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::NewArrayF32:
-      case OpCode::NewArrayRef: {
-        uint32_t type_id = ReadU32(module.code, pc);
-        uint32_t length = ReadU32(module.code, pc);
+      VM_CASE(NewArrayF32)
+      VM_CASE(NewArrayRef) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        uint32_t length = inst.b;
         uint32_t size = 4 + length * 4;
+        const bool ref_elements = opcode == static_cast<uint8_t>(OpCode::NewArrayRef);
+        uint32_t handle = heap.Allocate(ObjectKind::Array, type_id, size, ref_elements);
+        HeapObject* obj = heap.Get(handle);
+        if (!obj) VM_ALLOC_FAILED("NEW_ARRAY allocation failed");
+        WriteU32Payload(obj->payload, 0, length);
+        Push(stack, PackRef(handle));
+        break;
+      }
+      VM_CASE(NewArrayU8) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        uint32_t length = inst.b;
+        uint32_t size = 4 + length;
         uint32_t handle = heap.Allocate(ObjectKind::Array, type_id, size);
         HeapObject* obj = heap.Get(handle);
-        if (!obj) return Trap("NEW_ARRAY allocation failed");
+        if (!obj) VM_ALLOC_FAILED("NEW_ARRAY allocation failed");
+        obj->header.byte_elements = 1;
         WriteU32Payload(obj->payload, 0, length);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::ArrayLen: {
+      VM_CASE(ArrayLen) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_LEN on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4403,12 +5463,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(length)));
         break;
       }
-      case OpCode::ArrayGetI32: {
+      VM_CASE(ArrayGetI32) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_GET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_GET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_GET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_GET out of bounds");
@@ -4417,12 +5478,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ArrayGetI64: {
+      VM_CASE(ArrayGetI64) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_GET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_GET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_GET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_GET out of bounds");
@@ -4431,12 +5493,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(value));
         break;
       }
-      case OpCode::ArrayGetF32: {
+      VM_CASE(ArrayGetF32) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_GET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_GET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_GET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_GET out of bounds");
@@ -4445,12 +5508,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF32Bits(bits));
         break;
       }
-      case OpCode::ArrayGetF64: {
+      VM_CASE(ArrayGetF64) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_GET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_GET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_GET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_GET out of bounds");
@@ -4459,12 +5523,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF64Bits(bits));
         break;
       }
-      case OpCode::ArrayGetRef: {
+      VM_CASE(ArrayGetRef) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_GET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_GET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_GET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_GET out of bounds");
@@ -4473,13 +5538,28 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::ArraySetI32: {
+      VM_CASE(ArrayGetU8) {
+        Slot idx = Pop(stack);
+        Slot v = Pop(stack);
+        if (IsNullRef(v)) return Trap("ARRAY_GET on non-ref");
+        HeapObject* obj = heap.Get(UnpackRef(v));
+        if (!obj || obj->header.kind != ObjectKind::Array || !obj->header.byte_elements) {
+          return Trap("ARRAY_GET on non-byte-array");
+        }
+        uint32_t length = ReadU32Payload(obj->payload, 0);
+        int32_t index = UnpackI32(idx);
+        if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_GET out of bounds");
+        Push(stack, PackI32(obj->payload[4 + static_cast<size_t>(index)]));
+        break;
+      }
+      VM_CASE(ArraySetI32) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_SET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_SET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_SET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_SET out of bounds");
@@ -4487,13 +5567,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, offset, static_cast<uint32_t>(UnpackI32(value)));
         break;
       }
-      case OpCode::ArraySetI64: {
+      VM_CASE(ArraySetI64) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_SET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_SET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_SET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_SET out of bounds");
@@ -4501,13 +5582,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU64Payload(obj->payload, offset, static_cast<uint64_t>(UnpackI64(value)));
         break;
       }
-      case OpCode::ArraySetF32: {
+      VM_CASE(ArraySetF32) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_SET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_SET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_SET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_SET out of bounds");
@@ -4515,13 +5597,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, offset, UnpackU32Bits(value));
         break;
       }
-      case OpCode::ArraySetF64: {
+      VM_CASE(ArraySetF64) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_SET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_SET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_SET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_SET out of bounds");
@@ -4529,59 +5612,80 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU64Payload(obj->payload, offset, UnpackU64Bits(value));
         break;
       }
-      case OpCode::ArraySetRef: {
+      VM_CASE(ArraySetRef) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("ARRAY_SET on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::Array) return Trap("ARRAY_SET on non-array");
+        if (obj->header.byte_elements) return Trap("ARRAY_SET on byte array");
         uint32_t length = ReadU32Payload(obj->payload, 0);
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_SET out of bounds");
         size_t offset = 4 + static_cast<size_t>(index) * 4;
+        heap.RecordOverwrite(UnpackRef(v));
         WriteU32Payload(obj->payload, offset, UnpackRef(value));
+        heap.RecordWrite(UnpackRef(v), UnpackRef(value));
+        break;
+      }
+      VM_CASE(ArraySetU8) {
+        Slot value = Pop(stack);
+        Slot idx = Pop(stack);
+        Slot v = Pop(stack);
+        if (IsNullRef(v)) return Trap("ARRAY_SET on non-ref");
+        HeapObject* obj = heap.Get(UnpackRef(v));
+        if (!obj || obj->header.kind != ObjectKind::Array || !obj->header.byte_elements) {
+          return Trap("ARRAY_SET on non-byte-array");
+        }
+        if (obj->header.read_only) return Trap("ARRAY_SET on read-only array");
+        uint32_t length = ReadU32Payload(obj->payload, 0);
+        int32_t index = UnpackI32(idx);
+        if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("ARRAY_SET out of bounds");
+        obj->payload[4 + static_cast<size_t>(index)] = static_cast<uint8_t>(UnpackI32(value));
         break;
       }
-      case OpCode::NewList: {
-        uint32_t type_id = ReadU32(module.code, pc);
-        uint32_t capacity = ReadU32(module.code, pc);
+      VM_CASE(NewList) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        uint32_t capacity = inst.b;
         uint32_t size = 8 + capacity * 4;
-        uint32_t handle = heap.Allocate(ObjectKind::List, type_id, size);
+        const bool ref_elements = state.code->type_refs->IsRefType(type_id);
+        uint32_t handle = heap.Allocate(ObjectKind::List, type_id, size, ref_elements);
         HeapObject* obj = heap.Get(handle);
-        if (!obj) return Trap("NEW_LIST allocation failed");
+        if (!obj) VM_ALLOC_FAILED("NEW_LIST allocation failed");
         WriteU32Payload(obj->payload, 0, 0);
         WriteU32Payload(obj->payload, 4, capacity);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::NewListI64:
-      case OpCode::NewListF64: {
-        uint32_t type_id = ReadU32(module.code, pc);
-        uint32_t capacity = ReadU32(module.code, pc);
+      VM_CASE(NewListI64)
+      VM_CASE(NewListF64) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        uint32_t capacity = inst.b;
         uint32_t size = 8 + capacity * 8;
         uint32_t handle = heap.Allocate(ObjectKind::List, type_id, size);
         HeapObject* obj = heap.Get(handle);
-        if (!obj) return Trap("NEW_LIST allocation failed");
+        if (!obj) VM_ALLOC_FAILED("NEW_LIST allocation failed");
         WriteU32Payload(obj->payload, 0, 0);
         WriteU32Payload(obj->payload, 4, capacity);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::NewListF32:
-      case OpCode::NewListRef: {
-        uint32_t type_id = ReadU32(module.code, pc);
-        uint32_t capacity = ReadU32(module.code, pc);
+      VM_CASE(NewListF32)
+      VM_CASE(NewListRef) {
+        uint32_t type_id = static_cast<uint32_t>(inst.a);
+        uint32_t capacity = inst.b;
         uint32_t size = 8 + capacity * 4;
-        uint32_t handle = heap.Allocate(ObjectKind::List, type_id, size);
+        const bool ref_elements = opcode == static_cast<uint8_t>(OpCode::NewListRef);
+        uint32_t handle = heap.Allocate(ObjectKind::List, type_id, size, ref_elements);
         HeapObject* obj = heap.Get(handle);
-        if (!obj) return Trap("NEW_LIST allocation failed");
+        if (!obj) VM_ALLOC_FAILED("NEW_LIST allocation failed");
         WriteU32Payload(obj->payload, 0, 0);
         WriteU32Payload(obj->payload, 4, capacity);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::ListLen: {
+      VM_CASE(ListLen) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_LEN on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4590,7 +5694,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(length)));
         break;
       }
-      case OpCode::ListGetI32: {
+      VM_CASE(ListGetI32) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_GET on non-ref");
@@ -4604,7 +5708,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ListGetI64: {
+      VM_CASE(ListGetI64) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_GET on non-ref");
@@ -4618,7 +5722,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(value));
         break;
       }
-      case OpCode::ListGetF32: {
+      VM_CASE(ListGetF32) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_GET on non-ref");
@@ -4632,7 +5736,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF32Bits(bits));
         break;
       }
-      case OpCode::ListGetF64: {
+      VM_CASE(ListGetF64) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_GET on non-ref");
@@ -4646,7 +5750,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF64Bits(bits));
         break;
       }
-      case OpCode::ListGetRef: {
+      VM_CASE(ListGetRef) {
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_GET on non-ref");
@@ -4660,7 +5764,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::ListSetI32: {
+      VM_CASE(ListSetI32) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
@@ -4674,7 +5778,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, offset, static_cast<uint32_t>(UnpackI32(value)));
         break;
       }
-      case OpCode::ListSetI64: {
+      VM_CASE(ListSetI64) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
@@ -4688,7 +5792,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU64Payload(obj->payload, offset, static_cast<uint64_t>(UnpackI64(value)));
         break;
       }
-      case OpCode::ListSetF32: {
+      VM_CASE(ListSetF32) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
@@ -4702,7 +5806,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, offset, UnpackU32Bits(value));
         break;
       }
-      case OpCode::ListSetF64: {
+      VM_CASE(ListSetF64) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
@@ -4716,7 +5820,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU64Payload(obj->payload, offset, UnpackU64Bits(value));
         break;
       }
-      case OpCode::ListSetRef: {
+      VM_CASE(ListSetRef) {
         Slot value = Pop(stack);
         Slot idx = Pop(stack);
         Slot v = Pop(stack);
@@ -4727,75 +5831,78 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         int32_t index = UnpackI32(idx);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("LIST_SET out of bounds");
         size_t offset = 8 + static_cast<size_t>(index) * 4;
+        heap.RecordOverwrite(UnpackRef(v));
         WriteU32Payload(obj->payload, offset, UnpackRef(value));
+        heap.RecordWrite(UnpackRef(v), UnpackRef(value));
         break;
       }
-      case OpCode::ListPushI32: {
+      VM_CASE(ListPushI32) {
         Slot value = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_PUSH on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_PUSH on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 4)) return Trap("LIST_PUSH invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 4)) VM_ALLOC_FAILED("LIST_PUSH invalid list");
         size_t offset = 8 + static_cast<size_t>(length) * 4;
         WriteU32Payload(obj->payload, offset, static_cast<uint32_t>(UnpackI32(value)));
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListPushI64: {
+      VM_CASE(ListPushI64) {
         Slot value = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_PUSH on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_PUSH on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 8)) return Trap("LIST_PUSH invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 8)) VM_ALLOC_FAILED("LIST_PUSH invalid list");
         size_t offset = 8 + static_cast<size_t>(length) * 8;
         WriteU64Payload(obj->payload, offset, static_cast<uint64_t>(UnpackI64(value)));
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListPushF32: {
+      VM_CASE(ListPushF32) {
         Slot value = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_PUSH on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_PUSH on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 4)) return Trap("LIST_PUSH invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 4)) VM_ALLOC_FAILED("LIST_PUSH invalid list");
         size_t offset = 8 + static_cast<size_t>(length) * 4;
         WriteU32Payload(obj->payload, offset, UnpackU32Bits(value));
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListPushF64: {
+      VM_CASE(ListPushF64) {
         Slot value = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_PUSH on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_PUSH on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 8)) return Trap("LIST_PUSH invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 8)) VM_ALLOC_FAILED("LIST_PUSH invalid list");
         size_t offset = 8 + static_cast<size_t>(length) * 8;
         WriteU64Payload(obj->payload, offset, UnpackU64Bits(value));
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListPushRef: {
+      VM_CASE(ListPushRef) {
         Slot value = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_PUSH on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_PUSH on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 4)) return Trap("LIST_PUSH invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 4)) VM_ALLOC_FAILED("LIST_PUSH invalid list");
         size_t offset = 8 + static_cast<size_t>(length) * 4;
         WriteU32Payload(obj->payload, offset, UnpackRef(value));
         WriteU32Payload(obj->payload, 0, length + 1);
+        heap.RecordWrite(UnpackRef(v), UnpackRef(value));
         break;
       }
-      case OpCode::ListPopI32: {
+      VM_CASE(ListPopI32) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_POP on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4809,7 +5916,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(value));
         break;
       }
-      case OpCode::ListPopI64: {
+      VM_CASE(ListPopI64) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_POP on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4823,7 +5930,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(value));
         break;
       }
-      case OpCode::ListPopF32: {
+      VM_CASE(ListPopF32) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_POP on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4837,7 +5944,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF32Bits(bits));
         break;
       }
-      case OpCode::ListPopF64: {
+      VM_CASE(ListPopF64) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_POP on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4851,7 +5958,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF64Bits(bits));
         break;
       }
-      case OpCode::ListPopRef: {
+      VM_CASE(ListPopRef) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_POP on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
@@ -4861,11 +5968,12 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         uint32_t index = length - 1;
         size_t offset = 8 + static_cast<size_t>(index) * 4;
         uint32_t handle = ReadU32Payload(obj->payload, offset);
+        heap.RecordOverwrite(UnpackRef(v));
         WriteU32Payload(obj->payload, 0, length - 1);
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::ListInsertI32: {
+      VM_CASE(ListInsertI32) {
         Slot value = Pop(stack);
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
@@ -4873,7 +5981,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_INSERT on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 4)) return Trap("LIST_INSERT invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 4)) VM_ALLOC_FAILED("LIST_INSERT invalid list");
         int32_t index = UnpackI32(idx_val);
         if (index < 0 || static_cast<uint32_t>(index) > length) return Trap("LIST_INSERT out of bounds");
         for (uint32_t i = length; i > static_cast<uint32_t>(index); --i) {
@@ -4886,7 +5994,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListInsertI64: {
+      VM_CASE(ListInsertI64) {
         Slot value = Pop(stack);
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
@@ -4894,7 +6002,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_INSERT on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 8)) return Trap("LIST_INSERT invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 8)) VM_ALLOC_FAILED("LIST_INSERT invalid list");
         int32_t index = UnpackI32(idx_val);
         if (index < 0 || static_cast<uint32_t>(index) > length) return Trap("LIST_INSERT out of bounds");
         for (uint32_t i = length; i > static_cast<uint32_t>(index); --i) {
@@ -4907,7 +6015,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListInsertF32: {
+      VM_CASE(ListInsertF32) {
         Slot value = Pop(stack);
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
@@ -4915,7 +6023,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_INSERT on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 4)) return Trap("LIST_INSERT invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 4)) VM_ALLOC_FAILED("LIST_INSERT invalid list");
         int32_t index = UnpackI32(idx_val);
         if (index < 0 || static_cast<uint32_t>(index) > length) return Trap("LIST_INSERT out of bounds");
         for (uint32_t i = length; i > static_cast<uint32_t>(index); --i) {
@@ -4928,7 +6036,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListInsertF64: {
+      VM_CASE(ListInsertF64) {
         Slot value = Pop(stack);
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
@@ -4936,7 +6044,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_INSERT on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 8)) return Trap("LIST_INSERT invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 8)) VM_ALLOC_FAILED("LIST_INSERT invalid list");
         int32_t index = UnpackI32(idx_val);
         if (index < 0 || static_cast<uint32_t>(index) > length) return Trap("LIST_INSERT out of bounds");
         for (uint32_t i = length; i > static_cast<uint32_t>(index); --i) {
@@ -4949,7 +6057,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         WriteU32Payload(obj->payload, 0, length + 1);
         break;
       }
-      case OpCode::ListInsertRef: {
+      VM_CASE(ListInsertRef) {
         Slot value = Pop(stack);
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
@@ -4957,7 +6065,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_INSERT on non-list");
         uint32_t length = ReadU32Payload(obj->payload, 0);
-        if (!EnsureListCapacity(obj, length + 1, 4)) return Trap("LIST_INSERT invalid list");
+        if (!EnsureListCapacity(heap, obj, length + 1, 4)) VM_ALLOC_FAILED("LIST_INSERT invalid list");
         int32_t index = UnpackI32(idx_val);
         if (index < 0 || static_cast<uint32_t>(index) > length) return Trap("LIST_INSERT out of bounds");
         for (uint32_t i = length; i > static_cast<uint32_t>(index); --i) {
@@ -4968,9 +6076,10 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         size_t offset = 8 + static_cast<size_t>(index) * 4;
         WriteU32Payload(obj->payload, offset, UnpackRef(value));
         WriteU32Payload(obj->payload, 0, length + 1);
+        heap.RecordWrite(UnpackRef(v), UnpackRef(value));
         break;
       }
-      case OpCode::ListRemoveI32: {
+      VM_CASE(ListRemoveI32) {
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_REMOVE on non-ref");
@@ -4990,7 +6099,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(removed));
         break;
       }
-      case OpCode::ListRemoveI64: {
+      VM_CASE(ListRemoveI64) {
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_REMOVE on non-ref");
@@ -5010,7 +6119,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(removed));
         break;
       }
-      case OpCode::ListRemoveF32: {
+      VM_CASE(ListRemoveF32) {
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_REMOVE on non-ref");
@@ -5030,7 +6139,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF32Bits(removed));
         break;
       }
-      case OpCode::ListRemoveF64: {
+      VM_CASE(ListRemoveF64) {
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_REMOVE on non-ref");
@@ -5050,7 +6159,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF64Bits(removed));
         break;
       }
-      case OpCode::ListRemoveRef: {
+      VM_CASE(ListRemoveRef) {
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_REMOVE on non-ref");
@@ -5061,6 +6170,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("LIST_REMOVE out of bounds");
         size_t offset = 8 + static_cast<size_t>(index) * 4;
         uint32_t removed = ReadU32Payload(obj->payload, offset);
+        heap.RecordOverwrite(UnpackRef(v));
         for (uint32_t i = static_cast<uint32_t>(index) + 1; i < length; ++i) {
           size_t from = 8 + static_cast<size_t>(i) * 4;
           size_t to = 8 + static_cast<size_t>(i - 1) * 4;
@@ -5070,24 +6180,25 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackRef(removed));
         break;
       }
-      case OpCode::ListClear: {
+      VM_CASE(ListClear) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("LIST_CLEAR on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::List) return Trap("LIST_CLEAR on non-list");
+        heap.RecordOverwrite(UnpackRef(v));
         WriteU32Payload(obj->payload, 0, 0);
         break;
       }
-      case OpCode::StringLen: {
+      VM_CASE(StringLen) {
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("STRING_LEN on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::String) return Trap("STRING_LEN on non-string");
-        uint32_t length = ReadU32Payload(obj->payload, 0);
+        uint32_t length = StringLength(obj);
         Push(stack, PackI32(static_cast<int32_t>(length)));
         break;
       }
-      case OpCode::StringConcat: {
+      VM_CASE(StringConcat) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         if (IsNullRef(a) || IsNullRef(b)) return Trap("STRING_CONCAT on non-ref");
@@ -5096,72 +6207,63 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         if (!obj_a || !obj_b || obj_a->header.kind != ObjectKind::String || obj_b->header.kind != ObjectKind::String) {
           return Trap("STRING_CONCAT on non-string");
         }
-        std::u16string sa = ReadString(obj_a);
-        std::u16string sb = ReadString(obj_b);
-        std::u16string combined = sa + sb;
-        uint32_t handle = CreateString(heap, combined);
-        if (handle == 0xFFFFFFFFu) return Trap("STRING_CONCAT allocation failed");
+        uint32_t handle = ConcatStrings(heap, UnpackRef(a), UnpackRef(b));
+        if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("STRING_CONCAT allocation failed");
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::StringGetChar: {
+      VM_CASE(StringGetChar) {
         Slot idx_val = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("STRING_GET_CHAR on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::String) return Trap("STRING_GET_CHAR on non-string");
-        uint32_t length = ReadU32Payload(obj->payload, 0);
+        uint32_t length = StringLength(obj);
         int32_t index = UnpackI32(idx_val);
         if (index < 0 || static_cast<uint32_t>(index) >= length) return Trap("STRING_GET_CHAR out of bounds");
-        size_t offset = 4 + static_cast<size_t>(index) * 2;
-        uint16_t ch = ReadU16Payload(obj->payload, offset);
+        if (!FlattenString(heap, UnpackRef(v))) VM_ALLOC_FAILED("STRING_GET_CHAR allocation failed");
+        uint16_t ch = StringUnitAt(heap, obj, static_cast<uint32_t>(index));
         Push(stack, PackI32(ch));
         break;
       }
-      case OpCode::StringSlice: {
+      VM_CASE(StringSlice) {
         Slot end_val = Pop(stack);
         Slot start_val = Pop(stack);
         Slot v = Pop(stack);
         if (IsNullRef(v)) return Trap("STRING_SLICE on non-ref");
         HeapObject* obj = heap.Get(UnpackRef(v));
         if (!obj || obj->header.kind != ObjectKind::String) return Trap("STRING_SLICE on non-string");
-        uint32_t length = ReadU32Payload(obj->payload, 0);
+        uint32_t length = StringLength(obj);
         int32_t start = UnpackI32(start_val);
         int32_t end_idx = UnpackI32(end_val);
         if (start < 0 || end_idx < 0 || start > end_idx || static_cast<uint32_t>(end_idx) > length) {
           return Trap("STRING_SLICE out of bounds");
         }
-        std::u16string text = ReadString(obj);
-        std::u16string slice = text.substr(static_cast<size_t>(start), static_cast<size_t>(end_idx - start));
-        uint32_t handle = CreateString(heap, slice);
-        if (handle == 0xFFFFFFFFu) return Trap("STRING_SLICE allocation failed");
+        uint32_t handle = SliceString(heap, UnpackRef(v), static_cast<uint32_t>(start), static_cast<uint32_t>(end_idx));
+        if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("STRING_SLICE allocation failed");
         Push(stack, PackRef(handle));
         break;
       }
-      case OpCode::CallCheck: {
+      VM_CASE(CallCheck) {
         if (!call_stack.empty()) return Trap("CALLCHECK not in root");
         break;
       }
-      case OpCode::Line: {
-        uint32_t line = ReadU32(module.code, pc);
-        uint32_t column = ReadU32(module.code, pc);
+      VM_CASE(Line) {
+        uint32_t line = static_cast<uint32_t>(inst.a);
+        uint32_t column = inst.b;
         current.line = line;
         current.column = column;
         break;
       }
-      case OpCode::ProfileStart: {
-        ReadU32(module.code, pc);
-        break;
-      }
-      case OpCode::ProfileEnd: {
-        ReadU32(module.code, pc);
+      VM_CASE(ProfileStart)
+      VM_CASE(ProfileEnd)
         break;
-      }
-      case OpCode::Intrinsic: {
-        uint32_t id = ReadU32(module.code, pc);
+      VM_CASE(Intrinsic) {
+        uint32_t id = static_cast<uint32_t>(inst.a);
+        if (id >= kIntrinsicDlCallI8 && id <= kIntrinsicDlCallStr0) stdout_buffer.Flush();
         switch (id) {
           case kIntrinsicTrap: {
-            if (stack.empty()) return Trap("INTRINSIC trap stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC trap stack underflow");
             int32_t code = UnpackI32(Pop(stack));
             return Trap("INTRINSIC trap code=" + std::to_string(code));
           }
@@ -5172,24 +6274,24 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           case kIntrinsicLogF32:
           case kIntrinsicLogF64:
           case kIntrinsicLogRef:
-            if (stack.empty()) return Trap("INTRINSIC log stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC log stack underflow");
             Pop(stack);
             break;
           case kIntrinsicAbsI32: {
-            if (stack.empty()) return Trap("INTRINSIC abs_i32 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC abs_i32 stack underflow");
             int32_t value = UnpackI32(Pop(stack));
             Push(stack, PackI32(value < 0 ? -value : value));
             break;
           }
           case kIntrinsicAbsI64: {
-            if (stack.empty()) return Trap("INTRINSIC abs_i64 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC abs_i64 stack underflow");
             int64_t value = UnpackI64(Pop(stack));
             Push(stack, PackI64(value < 0 ? -value : value));
             break;
           }
           case kIntrinsicMinI32:
           case kIntrinsicMaxI32: {
-            if (stack.size() < 2) return Trap("INTRINSIC min/max i32 stack underflow");
+            if (kChecked && stack.size() < 2) return Trap("INTRINSIC min/max i32 stack underflow");
             int32_t b = UnpackI32(Pop(stack));
             int32_t a = UnpackI32(Pop(stack));
             int32_t out = (id == kIntrinsicMinI32) ? (a < b ? a : b) : (a > b ? a : b);
@@ -5198,7 +6300,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           }
           case kIntrinsicMinI64:
           case kIntrinsicMaxI64: {
-            if (stack.size() < 2) return Trap("INTRINSIC min/max i64 stack underflow");
+            if (kChecked && stack.size() < 2) return Trap("INTRINSIC min/max i64 stack underflow");
             int64_t b = UnpackI64(Pop(stack));
             int64_t a = UnpackI64(Pop(stack));
             int64_t out = (id == kIntrinsicMinI64) ? (a < b ? a : b) : (a > b ? a : b);
@@ -5207,7 +6309,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           }
           case kIntrinsicMinF32:
           case kIntrinsicMaxF32: {
-            if (stack.size() < 2) return Trap("INTRINSIC min/max f32 stack underflow");
+            if (kChecked && stack.size() < 2) return Trap("INTRINSIC min/max f32 stack underflow");
             float b = BitsToF32(UnpackU32Bits(Pop(stack)));
             float a = BitsToF32(UnpackU32Bits(Pop(stack)));
             float out = (id == kIntrinsicMinF32) ? (a < b ? a : b) : (a > b ? a : b);
@@ -5216,7 +6318,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           }
           case kIntrinsicMinF64:
           case kIntrinsicMaxF64: {
-            if (stack.size() < 2) return Trap("INTRINSIC min/max f64 stack underflow");
+            if (kChecked && stack.size() < 2) return Trap("INTRINSIC min/max f64 stack underflow");
             double b = BitsToF64(UnpackU64Bits(Pop(stack)));
             double a = BitsToF64(UnpackU64Bits(Pop(stack)));
             double out = (id == kIntrinsicMinF64) ? (a < b ? a : b) : (a > b ? a : b);
@@ -5224,14 +6326,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicSqrtF32: {
-            if (stack.empty()) return Trap("INTRINSIC sqrt f32 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC sqrt f32 stack underflow");
             float v = BitsToF32(UnpackU32Bits(Pop(stack)));
             float out = static_cast<float>(std::sqrt(v));
             Push(stack, PackF32Bits(F32ToBits(out)));
             break;
           }
           case kIntrinsicSqrtF64: {
-            if (stack.empty()) return Trap("INTRINSIC sqrt f64 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC sqrt f64 stack underflow");
             double v = BitsToF64(UnpackU64Bits(Pop(stack)));
             double out = std::sqrt(v);
             Push(stack, PackF64Bits(F64ToBits(out)));
@@ -5258,136 +6360,77 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           case kIntrinsicWriteStdout:
           case kIntrinsicWriteStderr:
-            if (stack.size() < 2) return Trap("INTRINSIC write stack underflow");
+            if (kChecked && stack.size() < 2) return Trap("INTRINSIC write stack underflow");
             Pop(stack); // length
             Pop(stack); // ref
             break;
           case kIntrinsicPrintAny: {
-            if (stack.size() < 2) return Trap("INTRINSIC print_any stack underflow");
+            if (kChecked && stack.size() < 2) return Trap("INTRINSIC print_any stack underflow");
             uint32_t tag = static_cast<uint32_t>(UnpackI32(Pop(stack)));
             Slot value = Pop(stack);
-            auto write_text = [](const std::string& text) {
-              if (!text.empty()) std::fwrite(text.data(), 1, text.size(), stdout);
-            };
-            switch (tag) {
-              case kPrintAnyTagString: {
-                uint32_t ref = UnpackRef(value);
-                HeapObject* obj = heap.Get(ref);
-                if (!obj || obj->header.kind != ObjectKind::String) {
-                  return Trap("print_any: unsupported ref kind");
-                }
-                write_text(U16ToAscii(ReadString(obj)));
-                break;
-              }
-              case kPrintAnyTagI8:
-                write_text(std::to_string(static_cast<int32_t>(static_cast<int8_t>(UnpackI32(value)))));
-                break;
-              case kPrintAnyTagI16:
-                write_text(std::to_string(static_cast<int32_t>(static_cast<int16_t>(UnpackI32(value)))));
-                break;
-              case kPrintAnyTagI32:
-                write_text(std::to_string(static_cast<int32_t>(UnpackI32(value))));
-                break;
-              case kPrintAnyTagI64:
-                write_text(std::to_string(static_cast<int64_t>(UnpackI64(value))));
-                break;
-              case kPrintAnyTagU8:
-                write_text(std::to_string(static_cast<uint32_t>(static_cast<uint8_t>(UnpackI32(value)))));
-                break;
-              case kPrintAnyTagU16:
-                write_text(std::to_string(static_cast<uint32_t>(static_cast<uint16_t>(UnpackI32(value)))));
-                break;
-              case kPrintAnyTagU32:
-                write_text(std::to_string(static_cast<uint32_t>(UnpackI32(value))));
-                break;
-              case kPrintAnyTagU64:
-                write_text(std::to_string(static_cast<uint64_t>(UnpackI64(value))));
-                break;
-              case kPrintAnyTagF32: {
-                float v = BitsToF32(UnpackU32Bits(value));
-                write_text(std::to_string(v));
-                break;
-              }
-              case kPrintAnyTagF64: {
-                double v = BitsToF64(UnpackU64Bits(value));
-                write_text(std::to_string(v));
-                break;
-              }
-              case kPrintAnyTagBool: {
-                const char* text = (UnpackI32(value) != 0) ? "true" : "false";
-                std::fwrite(text, 1, std::strlen(text), stdout);
-                break;
-              }
-              case kPrintAnyTagChar: {
-                uint32_t ch = static_cast<uint32_t>(UnpackI32(value)) & 0xFFu;
-                char out = (ch <= 0x7Fu) ? static_cast<char>(ch) : '?';
-                std::fwrite(&out, 1, 1, stdout);
-                break;
-              }
-              default:
-                return Trap("print_any: unsupported tag");
-            }
-            std::fflush(stdout);
+            const char* error = AppendPrintValue(heap, value, tag, &stdout_buffer.bytes());
+            if (error) return Trap(error);
+            stdout_buffer.Appended();
             break;
           }
           case kIntrinsicStrI32: {
-            if (stack.empty()) return Trap("INTRINSIC str_i32 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC str_i32 stack underflow");
             int32_t value = UnpackI32(Pop(stack));
-            uint32_t handle = CreateString(heap, AsciiToU16(std::to_string(value)));
-            if (handle == 0xFFFFFFFFu) return Trap("INTRINSIC str_i32 allocation failed");
+            uint32_t handle = CreateLatin1String(heap, std::to_string(value));
+            if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("INTRINSIC str_i32 allocation failed");
             Push(stack, PackRef(handle));
             break;
           }
           case kIntrinsicStrI64: {
-            if (stack.empty()) return Trap("INTRINSIC str_i64 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC str_i64 stack underflow");
             int64_t value = UnpackI64(Pop(stack));
-            uint32_t handle = CreateString(heap, AsciiToU16(std::to_string(value)));
-            if (handle == 0xFFFFFFFFu) return Trap("INTRINSIC str_i64 allocation failed");
+            uint32_t handle = CreateLatin1String(heap, std::to_string(value));
+            if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("INTRINSIC str_i64 allocation failed");
             Push(stack, PackRef(handle));
             break;
           }
           case kIntrinsicStrU32: {
-            if (stack.empty()) return Trap("INTRINSIC str_u32 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC str_u32 stack underflow");
             uint32_t value = static_cast<uint32_t>(UnpackI32(Pop(stack)));
-            uint32_t handle = CreateString(heap, AsciiToU16(std::to_string(value)));
-            if (handle == 0xFFFFFFFFu) return Trap("INTRINSIC str_u32 allocation failed");
+            uint32_t handle = CreateLatin1String(heap, std::to_string(value));
+            if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("INTRINSIC str_u32 allocation failed");
             Push(stack, PackRef(handle));
             break;
           }
           case kIntrinsicStrU64: {
-            if (stack.empty()) return Trap("INTRINSIC str_u64 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC str_u64 stack underflow");
             uint64_t value = static_cast<uint64_t>(UnpackI64(Pop(stack)));
-            uint32_t handle = CreateString(heap, AsciiToU16(std::to_string(value)));
-            if (handle == 0xFFFFFFFFu) return Trap("INTRINSIC str_u64 allocation failed");
+            uint32_t handle = CreateLatin1String(heap, std::to_string(value));
+            if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("INTRINSIC str_u64 allocation failed");
             Push(stack, PackRef(handle));
             break;
           }
           case kIntrinsicStrF32: {
-            if (stack.empty()) return Trap("INTRINSIC str_f32 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC str_f32 stack underflow");
             float value = BitsToF32(UnpackU32Bits(Pop(stack)));
-            uint32_t handle = CreateString(heap, AsciiToU16(std::to_string(value)));
-            if (handle == 0xFFFFFFFFu) return Trap("INTRINSIC str_f32 allocation failed");
+            uint32_t handle = CreateLatin1String(heap, std::to_string(value));
+            if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("INTRINSIC str_f32 allocation failed");
             Push(stack, PackRef(handle));
             break;
           }
           case kIntrinsicStrF64: {
-            if (stack.empty()) return Trap("INTRINSIC str_f64 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC str_f64 stack underflow");
             double value = BitsToF64(UnpackU64Bits(Pop(stack)));
-            uint32_t handle = CreateString(heap, AsciiToU16(std::to_string(value)));
-            if (handle == 0xFFFFFFFFu) return Trap("INTRINSIC str_f64 allocation failed");
+            uint32_t handle = CreateLatin1String(heap, std::to_string(value));
+            if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("INTRINSIC str_f64 allocation failed");
             Push(stack, PackRef(handle));
             break;
           }
           case kIntrinsicStrBool: {
-            if (stack.empty()) return Trap("INTRINSIC str_bool stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC str_bool stack underflow");
             bool value = UnpackI32(Pop(stack)) != 0;
-            uint32_t handle = CreateString(heap, AsciiToU16(value ? "true" : "false"));
-            if (handle == 0xFFFFFFFFu) return Trap("INTRINSIC str_bool allocation failed");
+            uint32_t handle = CreateLatin1String(heap, value ? "true" : "false");
+            if (handle == 0xFFFFFFFFu) VM_ALLOC_FAILED("INTRINSIC str_bool allocation failed");
             Push(stack, PackRef(handle));
             break;
           }
           case kIntrinsicDlCallI8: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_i8 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_i8 stack underflow");
             int8_t b = static_cast<int8_t>(UnpackI32(Pop(stack)));
             int8_t a = static_cast<int8_t>(UnpackI32(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5398,7 +6441,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallI16: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_i16 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_i16 stack underflow");
             int16_t b = static_cast<int16_t>(UnpackI32(Pop(stack)));
             int16_t a = static_cast<int16_t>(UnpackI32(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5409,7 +6452,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallI32: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_i32 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_i32 stack underflow");
             int32_t b = UnpackI32(Pop(stack));
             int32_t a = UnpackI32(Pop(stack));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5420,7 +6463,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallI64: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_i64 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_i64 stack underflow");
             int64_t b = UnpackI64(Pop(stack));
             int64_t a = UnpackI64(Pop(stack));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5431,7 +6474,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallU8: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_u8 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_u8 stack underflow");
             uint8_t b = static_cast<uint8_t>(UnpackI32(Pop(stack)));
             uint8_t a = static_cast<uint8_t>(UnpackI32(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5442,7 +6485,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallU16: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_u16 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_u16 stack underflow");
             uint16_t b = static_cast<uint16_t>(UnpackI32(Pop(stack)));
             uint16_t a = static_cast<uint16_t>(UnpackI32(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5453,7 +6496,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallU32: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_u32 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_u32 stack underflow");
             uint32_t b = static_cast<uint32_t>(UnpackI32(Pop(stack)));
             uint32_t a = static_cast<uint32_t>(UnpackI32(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5464,7 +6507,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallU64: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_u64 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_u64 stack underflow");
             uint64_t b = static_cast<uint64_t>(UnpackI64(Pop(stack)));
             uint64_t a = static_cast<uint64_t>(UnpackI64(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5475,7 +6518,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallF32: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_f32 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_f32 stack underflow");
             float b = BitsToF32(UnpackU32Bits(Pop(stack)));
             float a = BitsToF32(UnpackU32Bits(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5487,7 +6530,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallF64: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_f64 stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_f64 stack underflow");
             double b = BitsToF64(UnpackU64Bits(Pop(stack)));
             double a = BitsToF64(UnpackU64Bits(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5499,7 +6542,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallBool: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_bool stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_bool stack underflow");
             bool b = (UnpackI32(Pop(stack)) != 0);
             bool a = (UnpackI32(Pop(stack)) != 0);
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5510,7 +6553,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallChar: {
-            if (stack.size() < 3) return Trap("INTRINSIC dl_call_char stack underflow");
+            if (kChecked && stack.size() < 3) return Trap("INTRINSIC dl_call_char stack underflow");
             uint8_t b = static_cast<uint8_t>(UnpackI32(Pop(stack)));
             uint8_t a = static_cast<uint8_t>(UnpackI32(Pop(stack)));
             int64_t ptr_bits = UnpackI64(Pop(stack));
@@ -5521,7 +6564,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             break;
           }
           case kIntrinsicDlCallStr0: {
-            if (stack.empty()) return Trap("INTRINSIC dl_call_str0 stack underflow");
+            if (kChecked && stack.empty()) return Trap("INTRINSIC dl_call_str0 stack underflow");
             int64_t ptr_bits = UnpackI64(Pop(stack));
             if (ptr_bits == 0) return Trap("core.dl.call_str0 null ptr");
             using Fn = const char* (*)();
@@ -5531,7 +6574,7 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
               Push(stack, PackRef(kNullRef));
               break;
             }
-            uint32_t handle = CreateString(heap, AsciiToU16(out));
+            uint32_t handle = CreateLatin1String(heap, out);
             Push(stack, PackRef(handle));
             break;
           }
@@ -5540,15 +6583,53 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         }
         break;
       }
-      case OpCode::SysCall: {
-        uint32_t id = ReadU32(module.code, pc);
+      VM_CASE(PrintFmt) {
+        // Each "{}" in the format takes the next (value, tag) pair; the pairs
+        // sit on the stack in argument order.
+        const size_t arg_slots = static_cast<size_t>(inst.imm8) * 2;
+        if (kChecked && stack.size() < arg_slots) return Trap("PRINT_FMT stack underflow");
+        std::string_view fmt;
+        if (const char* error = find_const_string(static_cast<uint32_t>(inst.a), &fmt)) {
+          return Trap(std::string("PRINT_FMT ") + error);
+        }
+        const size_t base = stack.size() - arg_slots;
+        size_t arg = base;
+        size_t segment = 0;
+        std::string& out = stdout_buffer.bytes();
+        const size_t out_start = out.size();
+        const char* error = nullptr;
+        for (size_t hole = fmt.find("{}"); hole != std::string_view::npos && !error;
+             hole = fmt.find("{}", segment)) {
+          if (arg == stack.size()) {
+            error = "PRINT_FMT placeholder count mismatch";
+            break;
+          }
+          out.append(fmt.data() + segment, hole - segment);
+          uint32_t tag = static_cast<uint32_t>(UnpackI32(stack[arg + 1]));
+          error = AppendPrintValue(heap, stack[arg], tag, &out);
+          arg += 2;
+          segment = hole + 2;
+        }
+        if (!error && arg != stack.size()) error = "PRINT_FMT placeholder count mismatch";
+        if (error) {
+          // Drop the partial line so a trap leaves no half-rendered output.
+          out.resize(out_start);
+          return Trap(error);
+        }
+        out.append(fmt.data() + segment, fmt.size() - segment);
+        stack.resize(base);
+        stdout_buffer.Appended();
+        break;
+      }
+      VM_CASE(SysCall) {
+        uint32_t id = static_cast<uint32_t>(inst.a);
         return Trap("SYS_CALL not supported id=" + std::to_string(id));
       }
-      case OpCode::AddI32:
-      case OpCode::SubI32:
-      case OpCode::MulI32:
-      case OpCode::DivI32:
-      case OpCode::ModI32: {
+      VM_CASE(AddI32)
+      VM_CASE(SubI32)
+      VM_CASE(MulI32)
+      VM_CASE(DivI32)
+      VM_CASE(ModI32) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         int32_t lhs = UnpackI32(a);
@@ -5562,14 +6643,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out));
         break;
       }
-      case OpCode::NegI32: {
+      VM_CASE(NegI32) {
         Slot a = Pop(stack);
         int32_t out = -UnpackI32(a);
         Push(stack, PackI32(out));
         break;
       }
-      case OpCode::IncI32:
-      case OpCode::DecI32: {
+      VM_CASE(IncI32)
+      VM_CASE(DecI32) {
         Slot a = Pop(stack);
         int32_t out = UnpackI32(a);
         if (opcode == static_cast<uint8_t>(OpCode::IncI32)) {
@@ -5580,11 +6661,11 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out));
         break;
       }
-      case OpCode::AddU32:
-      case OpCode::SubU32:
-      case OpCode::MulU32:
-      case OpCode::DivU32:
-      case OpCode::ModU32: {
+      VM_CASE(AddU32)
+      VM_CASE(SubU32)
+      VM_CASE(MulU32)
+      VM_CASE(DivU32)
+      VM_CASE(ModU32) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         uint32_t lhs = static_cast<uint32_t>(UnpackI32(a));
@@ -5598,8 +6679,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::IncU32:
-      case OpCode::DecU32: {
+      VM_CASE(IncU32)
+      VM_CASE(DecU32) {
         Slot a = Pop(stack);
         uint32_t out = static_cast<uint32_t>(UnpackI32(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncU32)) {
@@ -5610,8 +6691,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::IncI8:
-      case OpCode::DecI8: {
+      VM_CASE(IncI8)
+      VM_CASE(DecI8) {
         Slot a = Pop(stack);
         int8_t out = static_cast<int8_t>(UnpackI32(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncI8)) {
@@ -5622,8 +6703,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out));
         break;
       }
-      case OpCode::IncI16:
-      case OpCode::DecI16: {
+      VM_CASE(IncI16)
+      VM_CASE(DecI16) {
         Slot a = Pop(stack);
         int16_t out = static_cast<int16_t>(UnpackI32(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncI16)) {
@@ -5634,8 +6715,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out));
         break;
       }
-      case OpCode::IncU8:
-      case OpCode::DecU8: {
+      VM_CASE(IncU8)
+      VM_CASE(DecU8) {
         Slot a = Pop(stack);
         uint8_t out = static_cast<uint8_t>(UnpackI32(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncU8)) {
@@ -5646,8 +6727,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::IncU16:
-      case OpCode::DecU16: {
+      VM_CASE(IncU16)
+      VM_CASE(DecU16) {
         Slot a = Pop(stack);
         uint16_t out = static_cast<uint16_t>(UnpackI32(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncU16)) {
@@ -5658,46 +6739,46 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::NegI8: {
+      VM_CASE(NegI8) {
         Slot a = Pop(stack);
         int8_t v = static_cast<int8_t>(UnpackI32(a));
         int8_t out = static_cast<int8_t>(-v);
         Push(stack, PackI32(out));
         break;
       }
-      case OpCode::NegI16: {
+      VM_CASE(NegI16) {
         Slot a = Pop(stack);
         int16_t v = static_cast<int16_t>(UnpackI32(a));
         int16_t out = static_cast<int16_t>(-v);
         Push(stack, PackI32(out));
         break;
       }
-      case OpCode::NegU8: {
+      VM_CASE(NegU8) {
         Slot a = Pop(stack);
         uint8_t v = static_cast<uint8_t>(UnpackI32(a));
         uint8_t out = static_cast<uint8_t>(0u - v);
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::NegU16: {
+      VM_CASE(NegU16) {
         Slot a = Pop(stack);
         uint16_t v = static_cast<uint16_t>(UnpackI32(a));
         uint16_t out = static_cast<uint16_t>(0u - v);
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::NegU32: {
+      VM_CASE(NegU32) {
         Slot a = Pop(stack);
         uint32_t v = static_cast<uint32_t>(UnpackI32(a));
         uint32_t out = 0u - v;
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::AndI32:
-      case OpCode::OrI32:
-      case OpCode::XorI32:
-      case OpCode::ShlI32:
-      case OpCode::ShrI32: {
+      VM_CASE(AndI32)
+      VM_CASE(OrI32)
+      VM_CASE(XorI32)
+      VM_CASE(ShlI32)
+      VM_CASE(ShrI32) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         uint32_t lhs = static_cast<uint32_t>(UnpackI32(a));
@@ -5711,11 +6792,11 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(static_cast<int32_t>(out)));
         break;
       }
-      case OpCode::AddI64:
-      case OpCode::SubI64:
-      case OpCode::MulI64:
-      case OpCode::DivI64:
-      case OpCode::ModI64: {
+      VM_CASE(AddI64)
+      VM_CASE(SubI64)
+      VM_CASE(MulI64)
+      VM_CASE(DivI64)
+      VM_CASE(ModI64) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         int64_t lhs = UnpackI64(a);
@@ -5729,21 +6810,21 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(out));
         break;
       }
-      case OpCode::NegI64: {
+      VM_CASE(NegI64) {
         Slot a = Pop(stack);
         int64_t out = -UnpackI64(a);
         Push(stack, PackI64(out));
         break;
       }
-      case OpCode::NegU64: {
+      VM_CASE(NegU64) {
         Slot a = Pop(stack);
         uint64_t v = static_cast<uint64_t>(UnpackI64(a));
         uint64_t out = 0u - v;
         Push(stack, PackI64(static_cast<int64_t>(out)));
         break;
       }
-      case OpCode::IncI64:
-      case OpCode::DecI64: {
+      VM_CASE(IncI64)
+      VM_CASE(DecI64) {
         Slot a = Pop(stack);
         int64_t out = UnpackI64(a);
         if (opcode == static_cast<uint8_t>(OpCode::IncI64)) {
@@ -5754,11 +6835,11 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(out));
         break;
       }
-      case OpCode::AddU64:
-      case OpCode::SubU64:
-      case OpCode::MulU64:
-      case OpCode::DivU64:
-      case OpCode::ModU64: {
+      VM_CASE(AddU64)
+      VM_CASE(SubU64)
+      VM_CASE(MulU64)
+      VM_CASE(DivU64)
+      VM_CASE(ModU64) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         uint64_t lhs = static_cast<uint64_t>(UnpackI64(a));
@@ -5772,8 +6853,8 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(static_cast<int64_t>(out)));
         break;
       }
-      case OpCode::IncU64:
-      case OpCode::DecU64: {
+      VM_CASE(IncU64)
+      VM_CASE(DecU64) {
         Slot a = Pop(stack);
         uint64_t out = static_cast<uint64_t>(UnpackI64(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncU64)) {
@@ -5784,11 +6865,11 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(static_cast<int64_t>(out)));
         break;
       }
-      case OpCode::AndI64:
-      case OpCode::OrI64:
-      case OpCode::XorI64:
-      case OpCode::ShlI64:
-      case OpCode::ShrI64: {
+      VM_CASE(AndI64)
+      VM_CASE(OrI64)
+      VM_CASE(XorI64)
+      VM_CASE(ShlI64)
+      VM_CASE(ShrI64) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         uint64_t lhs = static_cast<uint64_t>(UnpackI64(a));
@@ -5802,10 +6883,10 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI64(static_cast<int64_t>(out)));
         break;
       }
-      case OpCode::AddF32:
-      case OpCode::SubF32:
-      case OpCode::MulF32:
-      case OpCode::DivF32: {
+      VM_CASE(AddF32)
+      VM_CASE(SubF32)
+      VM_CASE(MulF32)
+      VM_CASE(DivF32) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         float lhs = BitsToF32(static_cast<uint32_t>(a));
@@ -5818,14 +6899,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF32Bits(F32ToBits(out)));
         break;
       }
-      case OpCode::NegF32: {
+      VM_CASE(NegF32) {
         Slot a = Pop(stack);
         float out = -BitsToF32(static_cast<uint32_t>(a));
         Push(stack, PackF32Bits(F32ToBits(out)));
         break;
       }
-      case OpCode::IncF32:
-      case OpCode::DecF32: {
+      VM_CASE(IncF32)
+      VM_CASE(DecF32) {
         Slot a = Pop(stack);
         float out = BitsToF32(static_cast<uint32_t>(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncF32)) {
@@ -5836,10 +6917,10 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF32Bits(F32ToBits(out)));
         break;
       }
-      case OpCode::AddF64:
-      case OpCode::SubF64:
-      case OpCode::MulF64:
-      case OpCode::DivF64: {
+      VM_CASE(AddF64)
+      VM_CASE(SubF64)
+      VM_CASE(MulF64)
+      VM_CASE(DivF64) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         double lhs = BitsToF64(static_cast<uint64_t>(a));
@@ -5852,14 +6933,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF64Bits(F64ToBits(out)));
         break;
       }
-      case OpCode::NegF64: {
+      VM_CASE(NegF64) {
         Slot a = Pop(stack);
         double out = -BitsToF64(static_cast<uint64_t>(a));
         Push(stack, PackF64Bits(F64ToBits(out)));
         break;
       }
-      case OpCode::IncF64:
-      case OpCode::DecF64: {
+      VM_CASE(IncF64)
+      VM_CASE(DecF64) {
         Slot a = Pop(stack);
         double out = BitsToF64(static_cast<uint64_t>(a));
         if (opcode == static_cast<uint8_t>(OpCode::IncF64)) {
@@ -5870,12 +6951,12 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackF64Bits(F64ToBits(out)));
         break;
       }
-      case OpCode::CmpEqI32:
-      case OpCode::CmpLtI32:
-      case OpCode::CmpNeI32:
-      case OpCode::CmpLeI32:
-      case OpCode::CmpGtI32:
-      case OpCode::CmpGeI32: {
+      VM_CASE(CmpEqI32)
+      VM_CASE(CmpLtI32)
+      VM_CASE(CmpNeI32)
+      VM_CASE(CmpLeI32)
+      VM_CASE(CmpGtI32)
+      VM_CASE(CmpGeI32) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         int32_t lhs = UnpackI32(a);
@@ -5890,12 +6971,12 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::CmpEqU32:
-      case OpCode::CmpLtU32:
-      case OpCode::CmpNeU32:
-      case OpCode::CmpLeU32:
-      case OpCode::CmpGtU32:
-      case OpCode::CmpGeU32: {
+      VM_CASE(CmpEqU32)
+      VM_CASE(CmpLtU32)
+      VM_CASE(CmpNeU32)
+      VM_CASE(CmpLeU32)
+      VM_CASE(CmpGtU32)
+      VM_CASE(CmpGeU32) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         uint32_t lhs = static_cast<uint32_t>(UnpackI32(a));
@@ -5910,12 +6991,12 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::CmpEqI64:
-      case OpCode::CmpLtI64:
-      case OpCode::CmpNeI64:
-      case OpCode::CmpLeI64:
-      case OpCode::CmpGtI64:
-      case OpCode::CmpGeI64: {
+      VM_CASE(CmpEqI64)
+      VM_CASE(CmpLtI64)
+      VM_CASE(CmpNeI64)
+      VM_CASE(CmpLeI64)
+      VM_CASE(CmpGtI64)
+      VM_CASE(CmpGeI64) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         int64_t lhs = UnpackI64(a);
@@ -5930,12 +7011,12 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::CmpEqU64:
-      case OpCode::CmpLtU64:
-      case OpCode::CmpNeU64:
-      case OpCode::CmpLeU64:
-      case OpCode::CmpGtU64:
-      case OpCode::CmpGeU64: {
+      VM_CASE(CmpEqU64)
+      VM_CASE(CmpLtU64)
+      VM_CASE(CmpNeU64)
+      VM_CASE(CmpLeU64)
+      VM_CASE(CmpGtU64)
+      VM_CASE(CmpGeU64) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         uint64_t lhs = static_cast<uint64_t>(UnpackI64(a));
@@ -5950,12 +7031,12 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::CmpEqF32:
-      case OpCode::CmpLtF32:
-      case OpCode::CmpNeF32:
-      case OpCode::CmpLeF32:
-      case OpCode::CmpGtF32:
-      case OpCode::CmpGeF32: {
+      VM_CASE(CmpEqF32)
+      VM_CASE(CmpLtF32)
+      VM_CASE(CmpNeF32)
+      VM_CASE(CmpLeF32)
+      VM_CASE(CmpGtF32)
+      VM_CASE(CmpGeF32) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         float lhs = BitsToF32(static_cast<uint32_t>(a));
@@ -5970,12 +7051,12 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::CmpEqF64:
-      case OpCode::CmpLtF64:
-      case OpCode::CmpNeF64:
-      case OpCode::CmpLeF64:
-      case OpCode::CmpGtF64:
-      case OpCode::CmpGeF64: {
+      VM_CASE(CmpEqF64)
+      VM_CASE(CmpLtF64)
+      VM_CASE(CmpNeF64)
+      VM_CASE(CmpLeF64)
+      VM_CASE(CmpGtF64)
+      VM_CASE(CmpGeF64) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         double lhs = BitsToF64(static_cast<uint64_t>(a));
@@ -5990,13 +7071,13 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::BoolNot: {
+      VM_CASE(BoolNot) {
         Slot v = Pop(stack);
         Push(stack, PackI32(UnpackI32(v) ? 0 : 1));
         break;
       }
-      case OpCode::BoolAnd:
-      case OpCode::BoolOr: {
+      VM_CASE(BoolAnd)
+      VM_CASE(BoolOr) {
         Slot b = Pop(stack);
         Slot a = Pop(stack);
         bool out = (opcode == static_cast<uint8_t>(OpCode::BoolAnd)) ?
@@ -6005,26 +7086,26 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
         Push(stack, PackI32(out ? 1 : 0));
         break;
       }
-      case OpCode::Jmp: {
-        int32_t rel = ReadI32(module.code, pc);
-        pc = static_cast<size_t>(static_cast<int64_t>(pc) + rel);
-        if (pc < func_start || pc > end) return Trap("JMP out of bounds");
+      VM_CASE(Jmp) {
+        pc = static_cast<size_t>(inst.a);
+        if (kChecked && (pc < func_start || pc > end)) return Trap("JMP out of bounds");
+        ip = inst.b != kNoDecodedInst ? &decoded.insts[inst.b] : resolve_ip();
         break;
       }
-      case OpCode::JmpTable: {
-        uint32_t const_id = ReadU32(module.code, pc);
-        int32_t default_rel = ReadI32(module.code, pc);
+      VM_CASE(JmpTable) {
+        uint32_t const_id = static_cast<uint32_t>(inst.a);
+        int32_t default_rel = static_cast<int32_t>(inst.b);
         Slot index = Pop(stack);
-        if (const_id + 8 > module.const_pool.size()) return Trap("JMP_TABLE const id bad");
+        if (kChecked && const_id + 8 > module.const_pool.size()) return Trap("JMP_TABLE const id bad");
         uint32_t kind = ReadU32Payload(module.const_pool, const_id);
-        if (kind != 6) return Trap("JMP_TABLE const kind mismatch");
+        if (kChecked && kind != 6) return Trap("JMP_TABLE const kind mismatch");
         uint32_t payload = ReadU32Payload(module.const_pool, const_id + 4);
-        if (payload + 4 > module.const_pool.size()) return Trap("JMP_TABLE blob out of bounds");
+        if (kChecked && payload + 4 > module.const_pool.size()) return Trap("JMP_TABLE blob out of bounds");
         uint32_t blob_len = ReadU32Payload(module.const_pool, payload);
-        if (payload + 4 + blob_len > module.const_pool.size()) return Trap("JMP_TABLE blob out of bounds");
-        if (blob_len < 4 || (blob_len - 4) % 4 != 0) return Trap("JMP_TABLE blob size invalid");
+        if (kChecked && payload + 4 + blob_len > module.const_pool.size()) return Trap("JMP_TABLE blob out of bounds");
+        if (kChecked && (blob_len < 4 || (blob_len - 4) % 4 != 0)) return Trap("JMP_TABLE blob size invalid");
         uint32_t count = ReadU32Payload(module.const_pool, payload + 4);
-        if (blob_len != 4 + count * 4) return Trap("JMP_TABLE blob size mismatch");
+        if (kChecked && blob_len != 4 + count * 4) return Trap("JMP_TABLE blob size mismatch");
         int32_t rel = default_rel;
         int32_t idx_val = UnpackI32(index);
         if (idx_val >= 0 && static_cast<uint32_t>(idx_val) < count) {
@@ -6033,45 +7114,45 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           rel = static_cast<int32_t>(raw);
         }
         pc = static_cast<size_t>(static_cast<int64_t>(pc) + rel);
-        if (pc < func_start || pc > end) return Trap("JMP_TABLE out of bounds");
+        if (kChecked && (pc < func_start || pc > end)) return Trap("JMP_TABLE out of bounds");
+        ip = resolve_ip();
         break;
       }
-      case OpCode::JmpTrue:
-      case OpCode::JmpFalse: {
-        int32_t rel = ReadI32(module.code, pc);
+      VM_CASE(JmpTrue)
+      VM_CASE(JmpFalse) {
         Slot cond = Pop(stack);
         bool take = UnpackI32(cond) != 0;
         if (opcode == static_cast<uint8_t>(OpCode::JmpFalse)) take = !take;
         if (take) {
-          pc = static_cast<size_t>(static_cast<int64_t>(pc) + rel);
-          if (pc < func_start || pc > end) return Trap("JMP out of bounds");
+          pc = static_cast<size_t>(inst.a);
+          if (kChecked && (pc < func_start || pc > end)) return Trap("JMP out of bounds");
+          ip = inst.b != kNoDecodedInst ? &decoded.insts[inst.b] : resolve_ip();
         }
         break;
       }
-      case OpCode::Enter: {
-        uint16_t locals = ReadU16(module.code, pc);
-        if (locals != current.locals_count) return Trap("ENTER local count mismatch");
+      VM_CASE(Enter) {
+        uint16_t locals = static_cast<uint16_t>(inst.a);
+        if (kChecked && locals != current.locals_count) return Trap("ENTER local count mismatch");
         break;
       }
-      case OpCode::Leave:
+      VM_CASE(Leave)
         break;
-      case OpCode::Call: {
-        uint32_t func_id = ReadU32(module.code, pc);
-        uint8_t arg_count = ReadU8(module.code, pc);
-        if (func_id >= module.functions.size()) return Trap("CALL invalid function id");
+      VM_CASE(Call) {
+        uint32_t func_id = static_cast<uint32_t>(inst.a);
+        uint8_t arg_count = inst.imm8;
+        if (kChecked && func_id >= module.functions.size()) return Trap("CALL invalid function id");
         const auto& func = module.functions[func_id];
-        if (func.method_id >= module.methods.size()) return Trap("CALL invalid method id");
+        if (kChecked && func.method_id >= module.methods.size()) return Trap("CALL invalid method id");
         const auto& method = module.methods[func.method_id];
-        if (method.sig_id >= module.sigs.size()) return Trap("CALL invalid signature id");
+        if (kChecked && method.sig_id >= module.sigs.size()) return Trap("CALL invalid signature id");
         const auto& sig = module.sigs[method.sig_id];
-        if (arg_count != sig.param_count) return Trap("CALL arg count mismatch");
-        if (stack.size() < arg_count) return Trap("CALL stack underflow");
+        if (kChecked && arg_count != sig.param_count) return Trap("CALL arg count mismatch");
+        if (kChecked && stack.size() < arg_count) return Trap("CALL stack underflow");
 
-        call_args.resize(arg_count);
-        for (int i = static_cast<int>(arg_count) - 1; i >= 0; --i) {
-          call_args[static_cast<size_t>(i)] = Pop(stack);
-        }
+        size_t args_base = stack.size() - arg_count;
         if (func_id < module.function_is_import.size() && module.function_is_import[func_id]) {
+          stage_args(args_base, arg_count);
+          stack.resize(args_base);
           Slot ret = 0;
           bool has_ret = false;
           std::string error;
@@ -6095,7 +7176,9 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           Slot ret = 0;
           bool has_ret = false;
           std::string error;
+          stage_args(args_base, arg_count);
           if (run_compiled(run_compiled, func_id, call_args, ret, has_ret, error)) {
+            stack.resize(args_base);
             if (has_ret) Push(stack, ret);
             break;
           }
@@ -6103,25 +7186,25 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           jit_stubs[func_id].disabled = true;
         }
 
+        current.call_pc = inst.pc;
         current.return_pc = pc;
-        current.stack_base = stack.size();
+        current.stack_base = args_base;
         call_stack.push_back(current);
-        current = setup_frame(func_id, pc, stack.size(), kNullRef);
-        for (size_t i = 0; i < call_args.size() && i < current.locals_count; ++i) {
-          locals_arena[current.locals_base + i] = call_args[i];
-        }
+        current = setup_frame(func_id, pc, args_base, kNullRef);
+        move_args_to_locals(current, args_base, arg_count);
         func_start = func.code_offset;
         pc = func_start;
         end = func_start + func.code_size;
+        ip = resolve_ip();
         break;
       }
-      case OpCode::CallIndirect: {
-        uint32_t sig_id = ReadU32(module.code, pc);
-        uint8_t arg_count = ReadU8(module.code, pc);
-        if (sig_id >= module.sigs.size()) return Trap("CALL_INDIRECT invalid signature id");
+      VM_CASE(CallIndirect) {
+        uint32_t sig_id = static_cast<uint32_t>(inst.a);
+        uint8_t arg_count = inst.imm8;
+        if (kChecked && sig_id >= module.sigs.size()) return Trap("CALL_INDIRECT invalid signature id");
         const auto& sig = module.sigs[sig_id];
-        if (arg_count != sig.param_count) return Trap("CALL_INDIRECT arg count mismatch");
-        if (stack.size() < static_cast<size_t>(arg_count) + 1u) return Trap("CALL_INDIRECT stack underflow");
+        if (kChecked && arg_count != sig.param_count) return Trap("CALL_INDIRECT arg count mismatch");
+        if (kChecked && stack.size() < static_cast<size_t>(arg_count) + 1u) return Trap("CALL_INDIRECT stack underflow");
         Slot func_val = Pop(stack);
         int64_t func_index = -1;
         uint32_t closure_ref = kNullRef;
@@ -6130,15 +7213,32 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           HeapObject* obj = heap.Get(handle);
           if (obj && obj->header.kind == ObjectKind::Closure) {
             uint32_t method_id = ReadU32Payload(obj->payload, 0);
-            bool closure_found = false;
-            for (size_t i = 0; i < module.functions.size(); ++i) {
-              if (module.functions[i].method_id == method_id) {
-                func_index = static_cast<int64_t>(i);
-                closure_found = true;
+            uint32_t cache_index = inst.b;
+            if (cache_index == kNoDecodedInst) {
+              cache_index = static_cast<uint32_t>(call_indirect_caches.size());
+              call_indirect_caches.emplace_back();
+              // Only runs decoded lazily by the checked loop lack a slot.
+              state.own_decoded.insts[static_cast<size_t>(ip - 1 - decoded.insts.data())].b = cache_index;
+            }
+            CallIndirectCache& cache = call_indirect_caches[cache_index];
+            for (uint8_t i = 0; i < cache.count; ++i) {
+              if (cache.method_ids[i] == method_id) {
+                func_index = cache.func_indices[i];
                 break;
               }
             }
-            if (!closure_found) return Trap("CALL_INDIRECT closure method not found");
+            if (func_index < 0) {
+              if (method_id >= function_by_method->size() ||
+                  (*function_by_method)[method_id] == Simple::Byte::kNoFunctionIndex) {
+                return Trap("CALL_INDIRECT closure method not found");
+              }
+              func_index = (*function_by_method)[method_id];
+              if (cache.count < CallIndirectCache::kWays) {
+                cache.method_ids[cache.count] = method_id;
+                cache.func_indices[cache.count] = static_cast<uint32_t>(func_index);
+                cache.count += 1;
+              }
+            }
             closure_ref = handle;
           }
         }
@@ -6150,15 +7250,14 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           func_index = idx;
         }
 
-        call_args.resize(arg_count);
-        for (int i = static_cast<int>(arg_count) - 1; i >= 0; --i) {
-          call_args[static_cast<size_t>(i)] = Pop(stack);
-        }
+        size_t args_base = stack.size() - arg_count;
         if (static_cast<size_t>(func_index) < module.function_is_import.size() &&
             module.function_is_import[static_cast<size_t>(func_index)]) {
           if (closure_ref != kNullRef) {
             return Trap("CALL_INDIRECT import closure unsupported");
           }
+          stage_args(args_base, arg_count);
+          stack.resize(args_base);
           Slot ret = 0;
           bool has_ret = false;
           std::string error;
@@ -6183,7 +7282,9 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           Slot ret = 0;
           bool has_ret = false;
           std::string error;
+          stage_args(args_base, arg_count);
           if (run_compiled(run_compiled, static_cast<size_t>(func_index), call_args, ret, has_ret, error)) {
+            stack.resize(args_base);
             if (has_ret) Push(stack, ret);
             break;
           }
@@ -6191,40 +7292,39 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           jit_stubs[static_cast<size_t>(func_index)].disabled = true;
         }
 
+        current.call_pc = inst.pc;
         current.return_pc = pc;
-        current.stack_base = stack.size();
+        current.stack_base = args_base;
         call_stack.push_back(current);
-        current = setup_frame(static_cast<size_t>(func_index), pc, stack.size(), closure_ref);
-        for (size_t i = 0; i < call_args.size() && i < current.locals_count; ++i) {
-          locals_arena[current.locals_base + i] = call_args[i];
-        }
+        current = setup_frame(static_cast<size_t>(func_index), pc, args_base, closure_ref);
+        move_args_to_locals(current, args_base, arg_count);
         const auto& func = module.functions[static_cast<size_t>(func_index)];
         func_start = func.code_offset;
         pc = func_start;
         end = func_start + func.code_size;
+        ip = resolve_ip();
         break;
       }
-      case OpCode::TailCall: {
-        uint32_t func_id = ReadU32(module.code, pc);
-        uint8_t arg_count = ReadU8(module.code, pc);
-        if (func_id >= module.functions.size()) return Trap("TAILCALL invalid function id");
+      VM_CASE(TailCall) {
+        uint32_t func_id = static_cast<uint32_t>(inst.a);
+        uint8_t arg_count = inst.imm8;
+        if (kChecked && func_id >= module.functions.size()) return Trap("TAILCALL invalid function id");
         if (enable_jit && jit_stubs[func_id].active) {
           // JIT stub placeholder: still runs interpreter path.
           jit_dispatch_counts[func_id] += 1;
         }
         const auto& func = module.functions[func_id];
-        if (func.method_id >= module.methods.size()) return Trap("TAILCALL invalid method id");
+        if (kChecked && func.method_id >= module.methods.size()) return Trap("TAILCALL invalid method id");
         const auto& method = module.methods[func.method_id];
-        if (method.sig_id >= module.sigs.size()) return Trap("TAILCALL invalid signature id");
+        if (kChecked && method.sig_id >= module.sigs.size()) return Trap("TAILCALL invalid signature id");
         const auto& sig = module.sigs[method.sig_id];
-        if (arg_count != sig.param_count) return Trap("TAILCALL arg count mismatch");
-        if (stack.size() < arg_count) return Trap("TAILCALL stack underflow");
+        if (kChecked && arg_count != sig.param_count) return Trap("TAILCALL arg count mismatch");
+        if (kChecked && stack.size() < arg_count) return Trap("TAILCALL stack underflow");
 
-        call_args.resize(arg_count);
-        for (int i = static_cast<int>(arg_count) - 1; i >= 0; --i) {
-          call_args[static_cast<size_t>(i)] = Pop(stack);
-        }
+        size_t args_base = stack.size() - arg_count;
         if (func_id < module.function_is_import.size() && module.function_is_import[func_id]) {
+          stage_args(args_base, arg_count);
+          stack.resize(args_base);
           Slot ret = 0;
           bool has_ret = false;
           std::string error;
@@ -6235,18 +7335,20 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
             ExecResult result;
             result.status = ExecStatus::Halted;
             if (has_ret) result.exit_code = UnpackI32(ret);
+            result.return_value = ret;
+            result.has_return_value = has_ret;
             return finish(result);
           }
-          Frame caller = call_stack.back();
+          current = call_stack.back();
           call_stack.pop_back();
-          stack.resize(caller.stack_base);
-          locals_arena.resize(caller.locals_base + caller.locals_count);
+          stack.resize(current.stack_base);
+          locals_top = current.locals_base + current.locals_count;
           if (has_ret) Push(stack, ret);
-          current = caller;
           pc = current.return_pc;
           const auto& current_func = module.functions[current.func_index];
           func_start = current_func.code_offset;
           end = func_start + current_func.code_size;
+          ip = resolve_ip();
           break;
         }
 
@@ -6259,23 +7361,26 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           Slot ret = 0;
           bool has_ret = false;
           std::string error;
+          stage_args(args_base, arg_count);
           if (run_compiled(run_compiled, func_id, call_args, ret, has_ret, error)) {
             if (call_stack.empty()) {
               ExecResult result;
               result.status = ExecStatus::Halted;
               if (has_ret) result.exit_code = UnpackI32(ret);
+              result.return_value = ret;
+              result.has_return_value = has_ret;
               return finish(result);
             }
-            Frame caller = call_stack.back();
+            current = call_stack.back();
             call_stack.pop_back();
-            stack.resize(caller.stack_base);
-            locals_arena.resize(caller.locals_base + caller.locals_count);
+            stack.resize(current.stack_base);
+            locals_top = current.locals_base + current.locals_count;
             if (has_ret) Push(stack, ret);
-            current = caller;
             pc = current.return_pc;
             const auto& current_func = module.functions[current.func_index];
             func_start = current_func.code_offset;
             end = func_start + current_func.code_size;
+            ip = resolve_ip();
             break;
           }
           jit_stubs[func_id].compiled = false;
@@ -6284,64 +7389,63 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
 
         size_t return_pc = current.return_pc;
         size_t stack_base = current.stack_base;
-        locals_arena.resize(current.locals_base);
-        stack.resize(stack_base);
+        locals_top = current.locals_base;
         current = setup_frame(func_id, return_pc, stack_base, kNullRef);
-        for (size_t i = 0; i < call_args.size() && i < current.locals_count; ++i) {
-          locals_arena[current.locals_base + i] = call_args[i];
-        }
+        move_args_to_locals(current, args_base, arg_count);
+        stack.resize(stack_base);
         func_start = func.code_offset;
         pc = func_start;
         end = func_start + func.code_size;
+        ip = resolve_ip();
         break;
       }
-      case OpCode::ConvI32ToI64: {
+      VM_CASE(ConvI32ToI64) {
         Slot v = Pop(stack);
         Push(stack, PackI64(static_cast<int64_t>(UnpackI32(v))));
         break;
       }
-      case OpCode::ConvI64ToI32: {
+      VM_CASE(ConvI64ToI32) {
         Slot v = Pop(stack);
         Push(stack, PackI32(static_cast<int32_t>(UnpackI64(v))));
         break;
       }
-      case OpCode::ConvI32ToF32: {
+      VM_CASE(ConvI32ToF32) {
         Slot v = Pop(stack);
         float out = static_cast<float>(UnpackI32(v));
         Push(stack, PackF32Bits(F32ToBits(out)));
         break;
       }
-      case OpCode::ConvI32ToF64: {
+      VM_CASE(ConvI32ToF64) {
         Slot v = Pop(stack);
         double out = static_cast<double>(UnpackI32(v));
         Push(stack, PackF64Bits(F64ToBits(out)));
         break;
       }
-      case OpCode::ConvF32ToI32: {
+      VM_CASE(ConvF32ToI32) {
         Slot v = Pop(stack);
         float in = BitsToF32(static_cast<uint32_t>(v));
         Push(stack, PackI32(static_cast<int32_t>(in)));
         break;
       }
-      case OpCode::ConvF64ToI32: {
+      VM_CASE(ConvF64ToI32) {
         Slot v = Pop(stack);
         double in = BitsToF64(static_cast<uint64_t>(v));
         Push(stack, PackI32(static_cast<int32_t>(in)));
         break;
       }
-      case OpCode::ConvF32ToF64: {
+      VM_CASE(ConvF32ToF64) {
         Slot v = Pop(stack);
         double out = static_cast<double>(BitsToF32(static_cast<uint32_t>(v)));
         Push(stack, PackF64Bits(F64ToBits(out)));
         break;
       }
-      case OpCode::ConvF64ToF32: {
+      VM_CASE(ConvF64ToF32) {
         Slot v = Pop(stack);
         float out = static_cast<float>(BitsToF64(static_cast<uint64_t>(v)));
         Push(stack, PackF32Bits(F32ToBits(out)));
         break;
       }
-      case OpCode::Ret: {
+      VM_CASE(Ret) {
         Slot ret = 0;
         bool has_ret = false;
         if (!stack.empty()) {
@@ -6352,28 +7456,184 @@ ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit,
           ExecResult result;
           result.status = ExecStatus::Halted;
           if (has_ret) result.exit_code = UnpackI32(ret);
+          result.return_value = ret;
+          result.has_return_value = has_ret;
           return finish(result);
         }
-        Frame caller = call_stack.back();
+        current = call_stack.back();
         call_stack.pop_back();
-        stack.resize(caller.stack_base);
-        locals_arena.resize(caller.locals_base + caller.locals_count);
+        stack.resize(current.stack_base);
+        locals_top = current.locals_base + current.locals_count;
         if (has_ret) Push(stack, ret);
-        current = caller;
         pc = current.return_pc;
         const auto& func = module.functions[current.func_index];
         func_start = func.code_offset;
         end = func_start + func.code_size;
+        ip = resolve_ip();
         break;
       }
-      default:
+      VM_DEFAULT()
+        if ((inst.flags & kDecodedTruncated) != 0) return Trap("instruction operands out of bounds");
         return Trap("unsupported opcode");
     }
   }
+#undef VM_ALLOC_FAILED
 
   ExecResult result;
   result.status = ExecStatus::Halted;
   return finish(result);
 }
+#if SIMPLEVM_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+} // namespace
+
+ExecResult ExecuteModule(const SbcModule& module, bool verify, bool enable_jit, const ExecOptions& options) {
+  // Unverified runs skip analysis up front; see ExecuteModuleImpl.
+  if (!verify) {
+    ModuleState state;
+    return ExecuteModuleImpl<true>(module, nullptr, enable_jit, options, state, EntryCall{});
+  }
+  return ExecuteModule(module, Simple::Byte::VerifyModuleCached(module), enable_jit, options);
+}
+
+ExecResult ExecuteModule(const SbcModule& module, const Simple::Byte::VerifyResult& verified, bool enable_jit,
+                         const ExecOptions& options) {
+  if (!verified.ok) return Trap(verified.error);
+  ModuleState state;
+  return ExecuteModuleImpl<false>(module, &verified, enable_jit, options, state, EntryCall{});
+}
+
+struct Vm::Impl {
+  // Shared read-only with isolates created by LoadIsolate.
+  std::shared_ptr<const SbcModule> module;
+  bool verify = true;
+  bool enable_jit = true;
+  ExecOptions options;
+  ModuleState state;
+  std::unordered_map<std::string, uint32_t> exports;
+
+  ExecResult Execute(const EntryCall& entry) {
+    if (verify) return ExecuteModuleImpl<false>(*module, &Simple::Byte::VerifyModuleCached(*module), enable_jit,
+                                                 options, state, entry);
+    return ExecuteModuleImpl<true>(*module, nullptr, enable_jit, options, state, entry);
+  }
+};
+
+Vm::Vm() = default;
+Vm::~Vm() = default;
+
+bool Vm::Load(const SbcModule& module, bool verify, bool enable_jit, const ExecOptions& options) {
+  auto impl = std::make_unique<Impl>();
+  auto copy = std::make_shared<SbcModule>(module);
+  // The copy starts with an empty cache; reuse the caller's result if any.
+  copy->verify_cache.result = std::atomic_load(&module.verify_cache.result);
+  impl->module = std::move(copy);
+  if (verify) {
+    const Simple::Byte::VerifyResult& vr = Simple::Byte::VerifyModuleCached(*impl->module);
+    if (!vr.ok) {
+      impl_.reset();
+      error_ = vr.error;
+      return false;
+    }
+  }
+  impl->verify = verify;
+  impl->enable_jit = enable_jit;
+  impl->options = options;
+  impl->state.Prepare(*impl->module, !options.profile_opcode_sequences);
+  for (const auto& row : impl->module->exports) {
+    impl->exports.emplace(ReadConstPoolString(*impl->module, row.symbol_name_str), row.func_id);
+  }
+  impl_ = std::move(impl);
+  error_.clear();
+  return true;
+}
+
+bool Vm::LoadIsolate(const Vm& source) {
+  if (!source.impl_) {
+    impl_.reset();
+    error_ = "source vm has no module loaded";
+    return false;
+  }
+  const Impl& from = *source.impl_;
+  auto impl = std::make_unique<Impl>();
+  impl->module = from.module;
+  impl->verify = from.verify;
+  impl->enable_jit = from.enable_jit;
+  impl->options = from.options;
+  impl->exports = from.exports;
+  impl->state.Prepare(*impl->module, !from.options.profile_opcode_sequences, from.state.code);
+  impl_ = std::move(impl);
+  error_.clear();
+  return true;
+}
+
+bool Vm::loaded() const { return impl_ != nullptr; }
+
+const std::string& Vm::error() const { return error_; }
+
+ExecResult Vm::Run() {
+  if (!impl_) return Trap("vm has no module loaded");
+  return impl_->Execute(EntryCall{});
+}
+
+ExecResult Vm::Invoke(const std::string& export_name, const std::vector<uint64_t>& args) {
+  if (!impl_) return Trap("vm has no module loaded");
+  auto it = impl_->exports.find(export_name);
+  if (it == impl_->exports.end()) return Trap("export not found: " + export_name);
+  return InvokeFunction(it->second, args);
+}
+
+ExecResult Vm::InvokeFunction(uint32_t func_id, const std::vector<uint64_t>& args) {
+  if (!impl_) return Trap("vm has no module loaded");
+  const SbcModule& module = *impl_->module;
+  if (func_id >= module.functions.size()) return Trap("invoke invalid function id");
+  if (func_id < module.function_is_import.size() && module.function_is_import[func_id]) {
+    return Trap("invoke of import function unsupported");
+  }
+  uint32_t method_id = module.functions[func_id].method_id;
+  if (method_id >= module.methods.size() || module.methods[method_id].sig_id >= module.sigs.size()) {
+    return Trap("invoke invalid method signature");
+  }
+  if (args.size() != module.sigs[module.methods[method_id].sig_id].param_count) {
+    return Trap("invoke arg count mismatch");
+  }
+  EntryCall entry;
+  entry.func_index = func_id;
+  entry.args = &args;
+  return impl_->Execute(entry);
+}
+
+void Vm::Reset() {
+  if (impl_) impl_->state.ResetData(*impl_->module);
+}
+
+std::vector<ExecResult> RunIsolates(const SbcModule& module, size_t count, size_t workers, bool verify,
+                                    bool enable_jit, const ExecOptions& options) {
+  std::vector<ExecResult> results(count);
+  if (count == 0) return results;
+  Vm base;
+  if (!base.Load(module, verify, enable_jit, options)) {
+    for (auto& result : results) result = Trap(base.error());
+    return results;
+  }
+  if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+  workers = std::min(workers, count);
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+      Vm isolate;
+      isolate.LoadIsolate(base);
+      results[i] = isolate.Run();
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(workers - 1);
+  for (size_t i = 1; i < workers; ++i) threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads) thread.join();
+  return results;
+}
 
 } // namespace Simple::VM